@@ -8,6 +8,9 @@
 #include <string>
 #include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <queue>
+#include <unistd.h>
 
 IndexManager* IndexManager::_index_manager = 0;
 
@@ -20,6 +23,7 @@ IndexManager* IndexManager::instance()
 }
 
 IndexManager::IndexManager()
+: _bulk_load_buffer_pages(IX_BULK_LOAD_BUFFER_PAGES)
 {
 }
 
@@ -47,6 +51,7 @@ RC IndexManager::createFile(const string &fileName)
     // Initialize the first page with metadata. root page will be page 1
     MetaHeader meta;
     meta.rootPage = 1;
+    meta.freePage = 0;
     setMetaData(meta, pageData);
     rc = handle.appendPage(pageData);
     if (rc)
@@ -78,6 +83,7 @@ RC IndexManager::createFile(const string &fileName)
     leafHeader.prev            = 0;
     leafHeader.entriesNumber   = 0;
     leafHeader.freeSpaceOffset = PAGE_SIZE;
+    leafHeader.prefixLength    = 0;
     setLeafHeader(leafHeader, pageData);
     rc = handle.appendPage(pageData);
     if (rc)
@@ -105,6 +111,8 @@ RC IndexManager::openFile(const string &fileName, IXFileHandle &ixfileHandle)
     PagedFileManager *pfm = PagedFileManager::instance();
     if (pfm->openFile(fileName, ixfileHandle.fh))
         return IX_OPEN_FAILED;
+    ixfileHandle.fileName = fileName;
+    ixfileHandle.syncCache();
     return SUCCESS;
 }
 
@@ -113,12 +121,15 @@ RC IndexManager::closeFile(IXFileHandle &ixfileHandle)
     PagedFileManager *pfm = PagedFileManager::instance();
     if (pfm->closeFile(ixfileHandle.fh))
         return IX_CLOSE_FAILED;
+    ixfileHandle.fileName.clear();
+    ixfileHandle.clearCache();
+    ixfileHandle.cacheFileId = UINT_MAX;
     return SUCCESS;
 }
 
 RC IndexManager::insertEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid)
 {
-    ChildEntry childEntry = {.key = NULL, .childPage = 0};
+    ChildEntry childEntry = {.key = NULL, .rid = {0, 0}, .childPage = 0};
     int32_t rootPage;
     RC rc = getRootPageNum(ixfileHandle, rootPage);
     if (rc)
@@ -131,7 +142,7 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
     void *pageData = malloc(PAGE_SIZE);
     if(pageData == NULL)
         return IX_MALLOC_FAILED;
-    if (fileHandle.readPage(pageID, pageData))
+    if (fetchNode(fileHandle, pageID, pageData))
     {
         free(pageData);
         return IX_READ_FAILED;
@@ -141,7 +152,7 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
 
     if (type == IX_TYPE_INTERNAL)
     {
-        int32_t childPage = getNextChildPage(attribute, key, pageData);
+        int32_t childPage = getNextChildPage(attribute, key, pageData, &rid);
 
         free (pageData);
         if (childPage == 0)
@@ -155,7 +166,7 @@ RC IndexManager::insert(const Attribute &attribute, const void *key, const RID &
             return SUCCESS;
         // If we're here, we need to handle a split
         pageData = malloc(PAGE_SIZE);
-        if (fileHandle.readPage(pageID, pageData))
+        if (fetchNode(fileHandle, pageID, pageData))
         {
             free(pageData);
             return IX_READ_FAILED;
@@ -233,109 +244,118 @@ RC IndexManager::splitLeaf(IXFileHandle &fileHandle, const Attribute &attribute,
 
     // Create new leaf to hold overflow
     void *newLeaf = calloc(PAGE_SIZE, 1);
+    if (newLeaf == NULL)
+        return IX_MALLOC_FAILED;
     setNodeType(IX_TYPE_LEAF, newLeaf);
     LeafHeader newHeader;
     newHeader.prev = pageID;
     newHeader.next = originalHeader.next;
     newHeader.entriesNumber = 0;
     newHeader.freeSpaceOffset = PAGE_SIZE;
+    newHeader.prefixLength = 0;
     setLeafHeader(newHeader, newLeaf);
 
-    int32_t newPageNum = fileHandle.getNumberOfPages();
-    originalHeader.next = newPageNum;
-    setLeafHeader(originalHeader, originalLeaf);
-
+    // Keep the slots filling about half of the used space, and at least one slot for the new leaf.
+    // Near the middle, the slot that needs the shortest separator from the next one wins.
+    int usable = PAGE_SIZE - sizeof(NodeType) - sizeof(LeafHeader);
+    int used = usable - getFreeSpaceLeaf(originalLeaf);
     int size = 0;
-    int i;
-    int lastSize = 0;
-    for (i = 0; i < originalHeader.entriesNumber; i++)
+    int i = -1;
+    int best = -1;
+    int bestLength = 0;
+    int bestDistance = 0;
+    // A key that does not share the prefix is below or above every key of the leaf, and half of the
+    // leaf may not take it back. It goes to the end of the leaf with a single slot instead.
+    if (attribute.type == TypeVarChar && getSharedPrefixLength(ins_key, originalLeaf) < originalHeader.prefixLength)
+        i = compareLeafSlot(attribute, ins_key, originalLeaf, 0) < 0 ? 0 : max(0, originalHeader.entriesNumber - 2);
+    for (int j = 0; i < 0 && j < originalHeader.entriesNumber - 1; j++)
     {
-        DataEntry entry = getDataEntry(i, originalLeaf);
-        void *key = NULL;
-
-        if (attribute.type == TypeInt)
-            key = &(entry.integer);
-        else if (attribute.type == TypeReal)
-            key = &(entry.real);
-        else
-            key = (char*)originalLeaf + entry.varcharOffset;
-        
-        lastSize = getKeyLengthLeaf(attribute, key);
-        size += lastSize;
-        if (size >= PAGE_SIZE / 2)
-        {
+        size += getLeafSlotLength(attribute, j, originalLeaf);
+        int distance = abs(2 * size - used);
+        if (best >= 0 && 2 * size - used > IX_SPLIT_SLACK * used)
             break;
-        }
-    }
-    // i is now middle key
-    DataEntry middleEntry = getDataEntry(i, originalLeaf);
-    childEntry.key = malloc(lastSize);
-    if (childEntry.key == NULL)
-        return IX_MALLOC_FAILED;
-    childEntry.childPage = newPageNum;
-    int keySize = attribute.type == TypeVarChar ? lastSize - sizeof(DataEntry) : INT_SIZE;
-    if (attribute.type == TypeVarChar)
-        memcpy(childEntry.key, (char*)originalLeaf + middleEntry.varcharOffset, keySize);
-    else
-        memcpy(childEntry.key, &(middleEntry.integer), keySize);
-
-    void *moving_key = malloc (attribute.length + 4);
-    for (int j = 1; j < originalHeader.entriesNumber - i; j++)
-    {
-        // Grab data entry after the middle entry. We then delete it and the rest are shifted over
-        DataEntry entry = getDataEntry(i + 1, originalLeaf);
-        RID moving_rid = entry.rid;
-        if (attribute.type == TypeVarChar)
-        {
-            int32_t len;
-            memcpy(&len, (char*)originalLeaf + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-            memcpy(moving_key, &len, VARCHAR_LENGTH_SIZE);
-            memcpy((char*)moving_key + VARCHAR_LENGTH_SIZE, (char*)originalLeaf + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-        }
-        else
+        if (2 * size < used && distance > IX_SPLIT_SLACK * used)
+            continue;
+        int length = getSeparatorLength(attribute, j, originalLeaf);
+        if (best < 0 || length < bestLength || (length == bestLength && distance < bestDistance))
         {
-            memcpy(moving_key, &(entry.integer), INT_SIZE);
+            best = j;
+            bestLength = length;
+            bestDistance = distance;
         }
-        // Insert into new leaf, delete from old
-        insertIntoLeaf(attribute, moving_key, moving_rid, newLeaf);
-        deleteEntryFromLeaf(attribute, moving_key, moving_rid, originalLeaf);
     }
-    free(moving_key);
-
-    // Still need to: Write back both (append new leaf)
-    // Add new record to correct page
-    if (compareLeafSlot(attribute, ins_key, originalLeaf, i) < 0)
+    if (i < 0)
+        i = best >= 0 ? best : max(0, originalHeader.entriesNumber - 2);
+    // i is now middle slot, its last entry is the largest one left in the original leaf
+    childEntry.rid = getLastRid(i, originalLeaf);
+
+    // Move every slot after the middle one to the new leaf under the same prefix, then each leaf
+    // gets the prefix of its own keys
+    char left[VARCHAR_LENGTH_SIZE + PAGE_SIZE], right[VARCHAR_LENGTH_SIZE + PAGE_SIZE], separator[VARCHAR_LENGTH_SIZE + PAGE_SIZE];
+    if (originalHeader.prefixLength > 0)
     {
-        if (insertIntoLeaf(attribute, ins_key, ins_rid, originalLeaf))
-        {
-            free(newLeaf);
-            return -1;
-        }
+        getLeafKey(attribute, 0, originalLeaf, left);
+        setLeafPrefix(attribute, left, originalHeader.prefixLength, newLeaf);
     }
+    while (getLeafHeader(originalLeaf).entriesNumber > i + 1)
+        moveLeafSlot(attribute, i + 1, originalLeaf, getLeafHeader(newLeaf).entriesNumber, newLeaf);
+    compressLeaf(attribute, originalLeaf);
+    compressLeaf(attribute, newLeaf);
+
+    // The separator is the shortest key between the two leaves
+    getLeafKey(attribute, i, originalLeaf, left);
+    if (getLeafHeader(newLeaf).entriesNumber > 0)
+        getLeafKey(attribute, 0, newLeaf, right);
     else
-    {
-        if (insertIntoLeaf(attribute, ins_key, ins_rid, newLeaf))
-        {
-            free(newLeaf);
-            return -1;
-        }
-    }
-
-    if(fileHandle.writePage(pageID, originalLeaf))
+        getLeafKey(attribute, i, originalLeaf, right);
+    int separatorLength = getSeparator(attribute, left, right, separator);
+    childEntry.key = malloc(separatorLength);
+    if (childEntry.key == NULL)
     {
         free(newLeaf);
-        return IX_WRITE_FAILED;
+        return IX_MALLOC_FAILED;
     }
-    if(fileHandle.appendPage(newLeaf))
+    memcpy(childEntry.key, separator, separatorLength);
+
+    // Add new record to correct page
+    int cmp = compareKeys(attribute, ins_key, childEntry.key);
+    if (cmp == 0)
+        cmp = compare(ins_rid, childEntry.rid);
+    if (insertIntoLeaf(attribute, ins_key, ins_rid, cmp <= 0 ? originalLeaf : newLeaf))
     {
         free(newLeaf);
-        return IX_APPEND_FAILED;
+        free(childEntry.key);
+        childEntry.key = NULL;
+        return IX_INSERT_LEAF_FAILED;
     }
+
+    // Write the new leaf first, the original needs its page number
+    PageNum newPageNum;
+    RC rc = writeNewPage(fileHandle, newLeaf, newPageNum);
     free(newLeaf);
+    if (rc)
+        return rc;
+    childEntry.childPage = newPageNum;
+
+    originalHeader = getLeafHeader(originalLeaf);
+    originalHeader.next = newPageNum;
+    setLeafHeader(originalHeader, originalLeaf);
+    if(fileHandle.writePage(pageID, originalLeaf))
+        return IX_WRITE_FAILED;
+
+    // The leaf after the new one points back to it
+    if (newHeader.next != 0)
+        return setLeafPrev(fileHandle, newHeader.next, newPageNum);
     return SUCCESS;
 }
 
 RC IndexManager::insertIntoInternal(const Attribute attribute, ChildEntry entry, void *pageData)
+{
+    int i = searchSlot(attribute, entry.key, entry.rid, pageData, false);
+    return insertIntoInternal(attribute, entry, i, pageData);
+}
+
+RC IndexManager::insertIntoInternal(const Attribute attribute, ChildEntry entry, const int i, void *pageData)
 {
     InternalHeader header = getInternalHeader(pageData);
     int len = getKeyLengthInternal(attribute, entry.key);
@@ -343,13 +363,6 @@ RC IndexManager::insertIntoInternal(const Attribute attribute, ChildEntry entry,
     if (getFreeSpaceInternal(pageData) < len)
         return IX_NO_FREE_SPACE;
 
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
-    {
-        if (compareSlot(attribute, entry.key, pageData, i) <= 0)
-            break;
-    }
-
     // i is slot number where new entry will go
     // i is slot number to move
     int start_offset = getOffsetOfInternalSlot(i);
@@ -358,6 +371,7 @@ RC IndexManager::insertIntoInternal(const Attribute attribute, ChildEntry entry,
     memmove((char*)pageData + start_offset + sizeof(IndexEntry), (char*)pageData + start_offset, end_offset - start_offset);
 
     IndexEntry newEntry;
+    newEntry.rid = entry.rid;
     newEntry.childPage = entry.childPage;
     if (attribute.type == TypeInt)
         memcpy(&newEntry.integer, entry.key, INT_SIZE);
@@ -377,47 +391,339 @@ RC IndexManager::insertIntoInternal(const Attribute attribute, ChildEntry entry,
     return SUCCESS;
 }
 
+// Posting lists store each rid as its difference to the previous one: the difference of the
+// page numbers, then the slot number, itself as a difference when both are on the same page.
+// Both are varints of 7 bits a byte, so rids close to each other take two bytes.
+static int putVarint(uint32_t value, char *out)
+{
+    int len = 0;
+    for (; value >= 0x80; value >>= 7)
+        out[len++] = (char) (value | 0x80);
+    out[len++] = (char) value;
+    return len;
+}
+
+static int getVarint(const char *in, uint32_t &value)
+{
+    int len = 0;
+    unsigned char byte;
+    value = 0;
+    do
+    {
+        byte = in[len];
+        value |= (uint32_t) (byte & 0x7f) << (7 * len);
+        len++;
+    } while (byte & 0x80);
+    return len;
+}
+
+static int encodeRid(const RID &rid, const RID &prev, char *out)
+{
+    int len = putVarint(rid.pageNum - prev.pageNum, out);
+    return len + putVarint(rid.pageNum == prev.pageNum ? rid.slotNum - prev.slotNum : rid.slotNum, out + len);
+}
+
+static int getRidLength(const RID &rid, const RID &prev)
+{
+    char buffer[IX_MAX_RID_BYTES];
+    return encodeRid(rid, prev, buffer);
+}
+
+// Encodes count sorted rids into out, returning the bytes written
+static int encodePosting(const RID *rids, const size_t count, char *out)
+{
+    RID prev = {0, 0};
+    int len = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        len += encodeRid(rids[i], prev, out + len);
+        prev = rids[i];
+    }
+    return len;
+}
+
+static void decodePosting(const char *in, const int length, vector<RID> &rids)
+{
+    RID rid = {0, 0};
+    int offset = 0;
+    while (offset < length)
+    {
+        uint32_t pageDelta, slot;
+        offset += getVarint(in + offset, pageDelta);
+        offset += getVarint(in + offset, slot);
+        rid.slotNum = pageDelta == 0 ? rid.slotNum + slot : slot;
+        rid.pageNum += pageDelta;
+        rids.push_back(rid);
+    }
+}
+
+static bool ridLess(const RID &rid, const RID &other)
+{
+    return rid.pageNum < other.pageNum || (rid.pageNum == other.pageNum && rid.slotNum < other.slotNum);
+}
+
+// Number of leading characters two strings have in common
+static int getCommonLength(const char *chars, const int length, const char *other, const int otherLength)
+{
+    int len = 0;
+    while (len < length && len < otherLength && chars[len] == other[len])
+        len++;
+    return len;
+}
+
 RC IndexManager::insertIntoLeaf(const Attribute attribute, const void *key, const RID &rid, void *pageData)
 {
     LeafHeader header = getLeafHeader(pageData);
 
-    int32_t key_len = getKeyLengthLeaf(attribute, key);
-    if (getFreeSpaceLeaf(pageData) < key_len)
+    // The rid goes to the slot of key whose list covers it, or the first one when it is smaller than them all
+    int i = searchLeafSlot(attribute, key, rid, pageData, true);
+    int slotNum = -1;
+    if (i > 0 && compareLeafSlot(attribute, key, pageData, i - 1) == 0)
+        slotNum = i - 1;
+    else if (i < header.entriesNumber && compareLeafSlot(attribute, key, pageData, i) == 0)
+        slotNum = i;
+
+    char posting[IX_POSTING_MAX_BYTES + IX_MAX_RID_BYTES];
+    if (slotNum < 0)
+        return insertLeafSlot(attribute, key, posting, encodePosting(&rid, 1, posting), i, pageData);
+
+    vector<RID> rids;
+    getPosting(slotNum, pageData, rids);
+    rids.insert(upper_bound(rids.begin(), rids.end(), rid, ridLess), rid);
+    int len = encodePosting(rids.data(), rids.size(), posting);
+    if (len <= IX_POSTING_MAX_BYTES)
+        return setPosting(attribute, slotNum, posting, len, pageData);
+
+    // The list is too long, the upper half of it moves to a new slot of the key
+    char upper[IX_POSTING_MAX_BYTES];
+    size_t half = rids.size() / 2;
+    int lowerLen = encodePosting(rids.data(), half, posting);
+    int upperLen = encodePosting(rids.data() + half, rids.size() - half, upper);
+    if (getFreeSpaceLeaf(pageData) + getDataEntry(slotNum, pageData).postingLength
+            < lowerLen + getLeafInsertLength(attribute, key, upperLen, pageData))
         return IX_NO_FREE_SPACE;
+    setPosting(attribute, slotNum, posting, lowerLen, pageData);
+    return insertLeafSlot(attribute, key, upper, upperLen, slotNum + 1, pageData);
+}
 
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
+RC IndexManager::insertLeafSlot(const Attribute &attr, const void *key, const void *posting, const uint16_t postingLength,
+        const int slotNum, void *pageData)
+{
+    if (getFreeSpaceLeaf(pageData) < getLeafInsertLength(attr, key, postingLength, pageData))
+        return IX_NO_FREE_SPACE;
+    if (attr.type == TypeVarChar)
     {
-        if (compareLeafSlot(attribute, key, pageData, i) < 0)
-            break;
+        int shared = getSharedPrefixLength(key, pageData);
+        if (shared < getLeafHeader(pageData).prefixLength)
+            setLeafPrefix(attr, key, shared, pageData);
     }
 
-    // i is slot number to move
-    int start_offset = getOffsetOfLeafSlot(i);
+    LeafHeader header = getLeafHeader(pageData);
+
+    // Shift every slot starting at slotNum to the right to make room for a new dataEntry
+    int start_offset = getOffsetOfLeafSlot(slotNum);
     int end_offset = getOffsetOfLeafSlot(header.entriesNumber);
-    // Shift everything starting at start_offset to the right to make room for a new dataEntry
     memmove((char*)pageData + start_offset + sizeof(DataEntry), (char*)pageData + start_offset, end_offset - start_offset);
 
     DataEntry newEntry;
-    newEntry.rid = rid;
-    if (attribute.type == TypeInt)
+    if (attr.type == TypeInt)
         memcpy(&(newEntry.integer), key, INT_SIZE);
-    else if (attribute.type == TypeReal)
+    else if (attr.type == TypeReal)
         memcpy(&(newEntry.real), key, REAL_SIZE);
     else
     {
+        // Only the part of key after the prefix is stored
         int32_t len;
         memcpy(&len, key, VARCHAR_LENGTH_SIZE);
+        len -= header.prefixLength;
         newEntry.varcharOffset = header.freeSpaceOffset - (len + VARCHAR_LENGTH_SIZE);
-        memcpy((char*)pageData + newEntry.varcharOffset, key, len + VARCHAR_LENGTH_SIZE);
+        memcpy((char*)pageData + newEntry.varcharOffset, &len, VARCHAR_LENGTH_SIZE);
+        memcpy((char*)pageData + newEntry.varcharOffset + VARCHAR_LENGTH_SIZE,
+                (const char*)key + VARCHAR_LENGTH_SIZE + header.prefixLength, len);
         header.freeSpaceOffset = newEntry.varcharOffset;
     }
+    header.freeSpaceOffset -= postingLength;
+    memcpy((char*)pageData + header.freeSpaceOffset, posting, postingLength);
+    newEntry.postingOffset = header.freeSpaceOffset;
+    newEntry.postingLength = postingLength;
     header.entriesNumber += 1;
     setLeafHeader(header, pageData);
-    setDataEntry(newEntry, i, pageData);
+    setDataEntry(newEntry, slotNum, pageData);
+    return SUCCESS;
+}
+
+RC IndexManager::setPosting(const Attribute &attr, const int slotNum, const void *posting, const uint16_t postingLength, void *pageData)
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    if (getFreeSpaceLeaf(pageData) + entry.postingLength < postingLength)
+        return IX_NO_FREE_SPACE;
+
+    freeLeafSpace(attr, entry.postingOffset, entry.postingLength, pageData);
+    LeafHeader header = getLeafHeader(pageData);
+    header.freeSpaceOffset -= postingLength;
+    memcpy((char*)pageData + header.freeSpaceOffset, posting, postingLength);
+    setLeafHeader(header, pageData);
+
+    // Our key may have moved
+    entry = getDataEntry(slotNum, pageData);
+    entry.postingOffset = header.freeSpaceOffset;
+    entry.postingLength = postingLength;
+    setDataEntry(entry, slotNum, pageData);
     return SUCCESS;
 }
 
+RC IndexManager::moveLeafSlot(const Attribute &attr, const int slotNum, void *from, const int toSlot, void *to)
+{
+    DataEntry entry = getDataEntry(slotNum, from);
+    char key[VARCHAR_LENGTH_SIZE + PAGE_SIZE];
+    getLeafKey(attr, slotNum, from, key);
+    RC rc = insertLeafSlot(attr, key, (char*)from + entry.postingOffset, entry.postingLength, toSlot, to);
+    if (rc == SUCCESS)
+        deleteLeafSlot(attr, slotNum, from);
+    return rc;
+}
+
+int IndexManager::getLeafSlotLength(const Attribute &attr, const int slotNum, const void *pageData) const
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    int len = sizeof(DataEntry) + entry.postingLength;
+    if (attr.type == TypeVarChar)
+    {
+        int32_t varcharLen;
+        memcpy(&varcharLen, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+        len += VARCHAR_LENGTH_SIZE + varcharLen;
+    }
+    return len;
+}
+
+int IndexManager::getLeafInsertLength(const Attribute &attr, const void *key, const int postingLength, const void *pageData) const
+{
+    int len = sizeof(DataEntry) + postingLength;
+    if (attr.type != TypeVarChar)
+        return len;
+
+    // When key cuts the prefix short, the keys already there get back what it loses
+    LeafHeader header = getLeafHeader(pageData);
+    int32_t keyLength;
+    memcpy(&keyLength, key, VARCHAR_LENGTH_SIZE);
+    int shared = getSharedPrefixLength(key, pageData);
+    return len + VARCHAR_LENGTH_SIZE + keyLength - shared + (header.prefixLength - shared) * (header.entriesNumber - 1);
+}
+
+int IndexManager::getSharedPrefixLength(const void *key, const void *pageData) const
+{
+    int32_t prefixLength = getLeafHeader(pageData).prefixLength;
+    int32_t keyLength;
+    memcpy(&keyLength, key, VARCHAR_LENGTH_SIZE);
+    return getCommonLength((const char*)key + VARCHAR_LENGTH_SIZE, keyLength, (const char*)pageData + PAGE_SIZE - prefixLength, prefixLength);
+}
+
+void IndexManager::setLeafPrefix(const Attribute &attr, const void *key, const int prefixLength, void *pageData)
+{
+    void *old = malloc(PAGE_SIZE);
+    void *slotKey = malloc(VARCHAR_LENGTH_SIZE + PAGE_SIZE);
+    memcpy(old, pageData, PAGE_SIZE);
+
+    // The prefix goes at the end of the page, where freeing space never moves it
+    LeafHeader header = getLeafHeader(old);
+    header.entriesNumber = 0;
+    header.prefixLength = prefixLength;
+    header.freeSpaceOffset = PAGE_SIZE - prefixLength;
+    setLeafHeader(header, pageData);
+    memcpy((char*)pageData + header.freeSpaceOffset, (const char*)key + VARCHAR_LENGTH_SIZE, prefixLength);
+
+    // Then the slots again, each one with the rest of its key
+    for (int i = 0; i < getLeafHeader(old).entriesNumber; i++)
+    {
+        DataEntry entry = getDataEntry(i, old);
+        getLeafKey(attr, i, old, slotKey);
+        insertLeafSlot(attr, slotKey, (char*)old + entry.postingOffset, entry.postingLength, i, pageData);
+    }
+    free(slotKey);
+    free(old);
+}
+
+void IndexManager::compressLeaf(const Attribute &attr, void *pageData)
+{
+    LeafHeader header = getLeafHeader(pageData);
+    if (attr.type != TypeVarChar || header.entriesNumber == 0)
+        return;
+
+    // Keys are sorted, what the first and last ones share every key does
+    char *first = (char*) malloc(VARCHAR_LENGTH_SIZE + PAGE_SIZE);
+    char *last = (char*) malloc(VARCHAR_LENGTH_SIZE + PAGE_SIZE);
+    getLeafKey(attr, 0, pageData, first);
+    getLeafKey(attr, header.entriesNumber - 1, pageData, last);
+    int32_t firstLength, lastLength;
+    memcpy(&firstLength, first, VARCHAR_LENGTH_SIZE);
+    memcpy(&lastLength, last, VARCHAR_LENGTH_SIZE);
+    int prefixLength = getCommonLength(first + VARCHAR_LENGTH_SIZE, firstLength, last + VARCHAR_LENGTH_SIZE, lastLength);
+    if (prefixLength != header.prefixLength)
+        setLeafPrefix(attr, first, prefixLength, pageData);
+    free(first);
+    free(last);
+}
+
+int IndexManager::getSeparator(const Attribute &attr, const void *left, const void *right, void *separator) const
+{
+    if (attr.type != TypeVarChar)
+    {
+        memcpy(separator, left, INT_SIZE);
+        return INT_SIZE;
+    }
+
+    // The characters right shares with left and one more are enough, unless that is all of right
+    int32_t leftLength, rightLength;
+    memcpy(&leftLength, left, VARCHAR_LENGTH_SIZE);
+    memcpy(&rightLength, right, VARCHAR_LENGTH_SIZE);
+    const char *rightChars = (const char*)right + VARCHAR_LENGTH_SIZE;
+    int32_t len = getCommonLength((const char*)left + VARCHAR_LENGTH_SIZE, leftLength, rightChars, rightLength) + 1;
+    if (len < rightLength && compareKeys(attr, left, right) < 0)
+    {
+        memcpy(separator, &len, VARCHAR_LENGTH_SIZE);
+        memcpy((char*)separator + VARCHAR_LENGTH_SIZE, rightChars, len);
+        return VARCHAR_LENGTH_SIZE + len;
+    }
+    memcpy(separator, left, VARCHAR_LENGTH_SIZE + leftLength);
+    return VARCHAR_LENGTH_SIZE + leftLength;
+}
+
+int IndexManager::getSeparatorLength(const Attribute &attr, const int slotNum, const void *pageData) const
+{
+    if (attr.type != TypeVarChar)
+        return INT_SIZE;
+    char left[VARCHAR_LENGTH_SIZE + PAGE_SIZE], right[VARCHAR_LENGTH_SIZE + PAGE_SIZE], separator[VARCHAR_LENGTH_SIZE + PAGE_SIZE];
+    getLeafKey(attr, slotNum, pageData, left);
+    getLeafKey(attr, slotNum + 1, pageData, right);
+    return getSeparator(attr, left, right, separator);
+}
+
+void IndexManager::getPosting(const int slotNum, const void *pageData, vector<RID> &rids) const
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    rids.clear();
+    decodePosting((const char*)pageData + entry.postingOffset, entry.postingLength, rids);
+}
+
+RID IndexManager::getFirstRid(const int slotNum, const void *pageData) const
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    const char *posting = (const char*)pageData + entry.postingOffset;
+    RID rid;
+    uint32_t pageNum;
+    int len = getVarint(posting, pageNum);
+    getVarint(posting + len, rid.slotNum);
+    rid.pageNum = pageNum;
+    return rid;
+}
+
+RID IndexManager::getLastRid(const int slotNum, const void *pageData) const
+{
+    vector<RID> rids;
+    getPosting(slotNum, pageData, rids);
+    return rids.back();
+}
+
 int IndexManager::getOffsetOfLeafSlot(int slotNum) const
 {
     return sizeof(NodeType) + sizeof(LeafHeader) + slotNum * sizeof(DataEntry);
@@ -432,14 +738,16 @@ RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attrib
 {
     InternalHeader originalHeader = getInternalHeader(original);
 
-    int32_t newPageNum = fileHandle.getNumberOfPages();
-
+    // The middle key moves up. Near the middle of the used space, the shortest key wins.
+    int usable = PAGE_SIZE - sizeof(NodeType) - sizeof(InternalHeader);
+    int used = usable - getFreeSpaceInternal(original);
     int size = 0;
-    int i;
+    int i = -1;
     int lastSize = 0;
-    for (i = 0; i < originalHeader.entriesNumber; i++)
+    int bestDistance = 0;
+    for (int j = 0; j < originalHeader.entriesNumber; j++)
     {
-        IndexEntry entry = getIndexEntry(i, original);
+        IndexEntry entry = getIndexEntry(j, original);
         void *key;
 
         if (attribute.type == TypeInt)
@@ -449,13 +757,22 @@ RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attrib
         else
             key = (char*)original + entry.varcharOffset;
         
-        lastSize = getKeyLengthInternal(attribute, key);
-        size += lastSize;
-        if (size >= PAGE_SIZE / 2)
-        {
+        int keySize = getKeyLengthInternal(attribute, key);
+        size += keySize;
+        int distance = abs(2 * size - used);
+        if (i >= 0 && 2 * size - used > IX_SPLIT_SLACK * used)
             break;
+        if (2 * size < used && distance > IX_SPLIT_SLACK * used)
+            continue;
+        if (i < 0 || keySize < lastSize || (keySize == lastSize && distance < bestDistance))
+        {
+            i = j;
+            lastSize = keySize;
+            bestDistance = distance;
         }
     }
+    if (i < 0)
+        i = originalHeader.entriesNumber - 1;
     // i is now middle key
     IndexEntry middleEntry = getIndexEntry(i, original);
 
@@ -468,45 +785,34 @@ RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attrib
     newHeader.leftChildPage = middleEntry.childPage;
     setInternalHeader(newHeader, newIntern);
 
-    // Get size of middle key, and store middle key for later
-    int keySize = attribute.type == TypeVarChar ? lastSize - sizeof(IndexEntry) : INT_SIZE;
-    void *middleKey = malloc(keySize);
-    if (attribute.type == TypeVarChar)
-        memcpy(middleKey, (char*)original + middleEntry.varcharOffset, keySize);
-    else
-        memcpy(middleKey, &(middleEntry.integer), INT_SIZE);
+    // Store middle key for later
+    void *middleKey = malloc(lastSize);
+    getInternalKey(attribute, i, original, middleKey);
+
+    // If new key is less than middle key, it goes in original node, else in new node.
+    // Decide now, the middle entry's varchar is gone once it is deleted below.
+    bool toOriginal = compareSlot(attribute, childEntry.key, childEntry.rid, original, i) < 0;
 
     // Create storage for shifting keys from one page to the other
-    void *moving_key = malloc (attribute.length + 4);
+    void *moving_key = malloc(PAGE_SIZE);
     // Repeatedly insert an entry from one page into the other, then delete the entry from the original page
     for (int j = 1; j < originalHeader.entriesNumber - i; j++)
     {
         // Grab data entry after the middle entry. We then delete it and the rest are shifted over
         IndexEntry entry = getIndexEntry(i + 1, original);
-        int32_t moving_pagenum = entry.childPage;
-        if (attribute.type == TypeVarChar)
-        {
-            int32_t len;
-            memcpy(&len, (char*)original + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-            memcpy(moving_key, &len, VARCHAR_LENGTH_SIZE);
-            memcpy((char*)moving_key + VARCHAR_LENGTH_SIZE,(char*)original + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-        }
-        else
-        {
-            memcpy(moving_key, &(entry.integer), INT_SIZE);
-        }
+        getInternalKey(attribute, i + 1, original, moving_key);
         ChildEntry tmp;
         tmp.key = moving_key;
-        tmp.childPage = moving_pagenum;
+        tmp.rid = entry.rid;
+        tmp.childPage = entry.childPage;
         insertIntoInternal(attribute, tmp, newIntern);
-        deleteEntryFromInternal(attribute, moving_key, original);
+        deleteInternalSlot(attribute, i + 1, original);
     }
     free(moving_key);
     // Delete middle entry
-    deleteEntryFromInternal(attribute, middleKey, original);
+    deleteInternalSlot(attribute, i, original);
 
-    // If new key is less than middle key, put it in original node, else put it in new node
-    if (compareSlot(attribute, childEntry.key, original, i) < 0)
+    if (toOriginal)
     {
         if (insertIntoInternal(attribute, childEntry, original))
         {
@@ -528,16 +834,16 @@ RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attrib
         free(newIntern);
         return IX_WRITE_FAILED;
     }
-    if(fileHandle.appendPage(newIntern))
-    {
-        free(newIntern);
-        return IX_APPEND_FAILED;
-    }
+    PageNum newPageNum;
+    RC rc = writeNewPage(fileHandle, newIntern, newPageNum);
     free(newIntern);
+    if (rc)
+        return rc;
 
     // Take the key of middle entry and allow it to propogate up
     free(childEntry.key);
     childEntry.key = middleKey;
+    childEntry.rid = middleEntry.rid;
     childEntry.childPage = newPageNum;
 
     // Check if we're root, then handle that case if we are
@@ -559,111 +865,989 @@ RC IndexManager::splitInternal(IXFileHandle &fileHandle, const Attribute &attrib
         insertIntoInternal(attribute, childEntry, newRoot);
 
         // Update metadata page
-        int newRootPage = fileHandle.getNumberOfPages();
-        if(fileHandle.appendPage(newRoot))
-            return IX_APPEND_FAILED;
-        MetaHeader metahead;
-        metahead.rootPage = newRootPage;
-        setMetaData(metahead, newRoot);
-        if(fileHandle.writePage(0, newRoot))
-            return IX_WRITE_FAILED;
-        // Free memory
+        PageNum newRootPage;
+        rc = writeNewPage(fileHandle, newRoot, newRootPage);
         free(newRoot);
+        if (rc == SUCCESS)
+            rc = setRootPageNum(fileHandle, newRootPage);
+        // Free memory
         free(childEntry.key);
         childEntry.key = NULL;
-
+        return rc;
     }
 
     return SUCCESS;
 }
 
-int IndexManager::findEntryPage(IXFileHandle &ixfileHandle, const Attribute &attr, const void *key, const RID &rid, void *pageData)
-{    
-
-    bool keyFound = false;
-
-    while (true){
-
-        LeafHeader header = getLeafHeader(pageData);
-        int i;
-        for (i = 0; i < header.entriesNumber; i++) 
-        {
-            // Find a slot whose key and rid are equal to the given key and rid
-            if(compareLeafSlot(attr, key, pageData, i) == 0)
-            {
-                keyFound = true;    // flag to indicate we have seen first instance of key
-                DataEntry entry = getDataEntry(i, pageData);
-                if (entry.rid.pageNum == rid.pageNum && entry.rid.slotNum == rid.slotNum)
-                {
-                    return SUCCESS;
-                }
-            } else if (keyFound){
-                // we have previously seen the key, so this current key entry must be larger
-                // the entry we are looking for cannot exist, return an error
-                return IX_RECORD_DN_EXIST;
-            }
-        }
-
-        // if we have not found our entry here, and have not found a key value larger,
-        //  it may be due to multiple pages with the same key
-        // so, we try the next page
-        if (header.next == 0){
-            // there are no more pages, so the entry cannot exist
-            return IX_RECORD_DN_EXIST;
-        } else {
-            // we load the next page, and try again
-            int nextLeafPage = header.next;
-            ixfileHandle.readPage(nextLeafPage, pageData);
-        }
-    }
-    return IX_RECORD_DN_EXIST;
-}
-
 RC IndexManager::deleteEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid)
 {
-    int32_t leafPage;
-    RC rc = find(ixfileHandle, attribute, key, leafPage);   // finds leftmost leaf page on which entry should be
-    if (rc){
+    int32_t rootPage;
+    RC rc = getRootPageNum(ixfileHandle, rootPage);
+    if (rc)
         return rc;
-    }
 
-    void *pageData = malloc(PAGE_SIZE);   
-    if (ixfileHandle.readPage(leafPage, pageData))
+    bool underflow = false;
+    rc = erase(attribute, key, rid, ixfileHandle, rootPage, underflow);
+    if (rc || !underflow)
+        return rc;
+    // Merges below may have left the root with a single child
+    return collapseRoot(ixfileHandle, rootPage);
+}
+
+RC IndexManager::erase(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, bool &underflow)
+{
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    if (fetchNode(fileHandle, pageID, pageData))
     {
         free(pageData);
         return IX_READ_FAILED;
     }
 
-    // confirm that this page contains the correct entry
-    // in most cases leafPage will be the same value that find() returned
-    // in the case of one key spanning multiple pages, it may not be
-    rc = findEntryPage(ixfileHandle, attribute, key, rid, pageData);
-    if (rc) {
-        free(pageData);
-        return rc;
+    RC rc;
+    underflow = false;
+    if (getNodetype(pageData) == IX_TYPE_LEAF)
+    {
+        rc = deleteEntryFromLeaf(attribute, key, rid, pageData);
+        if (rc == SUCCESS && fileHandle.writePage(pageID, pageData))
+            rc = IX_WRITE_FAILED;
+        underflow = rc == SUCCESS && isUnderflow(pageData);
+    }
+    else
+    {
+        // The rid picks the one child the entry can be in
+        int childNum = searchSlot(attribute, key, rid, pageData, false);
+        bool childUnderflow = false;
+        rc = erase(attribute, key, rid, fileHandle, getChildPage(childNum, pageData), childUnderflow);
+        bool changed = false;
+        if (rc == SUCCESS && childUnderflow)
+            rc = rebalance(fileHandle, attribute, pageID, pageData, childNum, changed);
+        underflow = changed && isUnderflow(pageData);
     }
+    free(pageData);
+    return rc;
+}
+
+RC IndexManager::rebalance(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, void *pageData, const int childNum, bool &changed)
+{
+    changed = false;
+    InternalHeader header = getInternalHeader(pageData);
+    // The only child of an empty root has no sibling to turn to
+    if (header.entriesNumber == 0)
+        return SUCCESS;
 
-    // Delete it from pageData
-    rc = deleteEntryFromLeaf(attribute, key, rid, pageData);
+    // Pair the child with its right sibling, or its left one if it is the last child.
+    // slotNum is the slot separating the two.
+    int slotNum = childNum < header.entriesNumber ? childNum : childNum - 1;
+    int32_t leftPage = getChildPage(slotNum, pageData);
+    int32_t rightPage = getChildPage(slotNum + 1, pageData);
+
+    void *left = malloc(PAGE_SIZE);
+    void *right = malloc(PAGE_SIZE);
+    RC rc = SUCCESS;
+    if (left == NULL || right == NULL)
+        rc = IX_MALLOC_FAILED;
+    else if (fileHandle.readPage(leftPage, left) || fileHandle.readPage(rightPage, right))
+        rc = IX_READ_FAILED;
     if (rc)
     {
-        free(pageData);
+        free(left);
+        free(right);
         return rc;
     }
 
-    rc = ixfileHandle.writePage(leafPage, pageData);
-    free(pageData);
+    bool leaf = getNodetype(left) == IX_TYPE_LEAF;
+    if (leaf ? mergeLeaves(attribute, left, right) : mergeInternals(attribute, pageData, slotNum, left, right))
+    {
+        // The right node and its separator are gone
+        deleteInternalSlot(attribute, slotNum, pageData);
+        int32_t next = getLeafHeader(left).next;
+        if (fileHandle.writePage(leftPage, left) || fileHandle.writePage(pageID, pageData))
+            rc = IX_WRITE_FAILED;
+        if (rc == SUCCESS && leaf && next != 0)
+            rc = setLeafPrev(fileHandle, next, leftPage);
+        if (rc == SUCCESS)
+            rc = freePage(fileHandle, rightPage);
+        changed = true;
+    }
+    else if (leaf ? redistributeLeaves(attribute, pageData, slotNum, left, right)
+            : redistributeInternals(attribute, pageData, slotNum, left, right))
+    {
+        if (fileHandle.writePage(leftPage, left) || fileHandle.writePage(rightPage, right)
+                || fileHandle.writePage(pageID, pageData))
+            rc = IX_WRITE_FAILED;
+        changed = true;
+    }
+
+    free(left);
+    free(right);
     return rc;
 }
 
-
-RC IndexManager::scan(IXFileHandle &ixfileHandle,
-        const Attribute &attribute,
-        const void      *lowKey,
-        const void      *highKey,
-        bool			lowKeyInclusive,
-        bool        	highKeyInclusive,
-        IX_ScanIterator &ix_ScanIterator)
+bool IndexManager::mergeLeaves(const Attribute &attribute, void *left, void *right)
+{
+    // The merged leaf may need a shorter prefix than either of them, so it is put together on the side
+    void *merged = malloc(PAGE_SIZE);
+    memcpy(merged, left, PAGE_SIZE);
+    LeafHeader rightHeader = getLeafHeader(right);
+    for (int i = 0; i < rightHeader.entriesNumber; i++)
+    {
+        DataEntry entry = getDataEntry(i, right);
+        char key[VARCHAR_LENGTH_SIZE + PAGE_SIZE];
+        getLeafKey(attribute, i, right, key);
+        if (insertLeafSlot(attribute, key, (char*)right + entry.postingOffset, entry.postingLength,
+                getLeafHeader(merged).entriesNumber, merged))
+        {
+            free(merged);
+            return false;
+        }
+    }
+    compressLeaf(attribute, merged);
+
+    LeafHeader mergedHeader = getLeafHeader(merged);
+    mergedHeader.next = rightHeader.next;
+    setLeafHeader(mergedHeader, merged);
+    memcpy(left, merged, PAGE_SIZE);
+    free(merged);
+    return true;
+}
+
+bool IndexManager::redistributeLeaves(const Attribute &attribute, void *parent, const int slotNum, void *left, void *right)
+{
+    int usable = PAGE_SIZE - sizeof(NodeType) - sizeof(LeafHeader);
+    int usedLeft = usable - getFreeSpaceLeaf(left);
+    int usedRight = usable - getFreeSpaceLeaf(right);
+    bool moved = false;
+    bool fromRight = usedLeft < usedRight;
+
+    // Move slots one at a time from the fuller leaf, as long as it stays the fuller one.
+    // A slot the other leaf has no room for under its prefix stays.
+    while (true)
+    {
+        if (fromRight)
+        {
+            int len = getLeafSlotLength(attribute, 0, right);
+            if (usedLeft + len > usedRight - len)
+                break;
+            if (moveLeafSlot(attribute, 0, right, getLeafHeader(left).entriesNumber, left))
+                break;
+        }
+        else
+        {
+            int last = getLeafHeader(left).entriesNumber - 1;
+            int len = getLeafSlotLength(attribute, last, left);
+            if (usedRight + len > usedLeft - len)
+                break;
+            if (moveLeafSlot(attribute, last, left, 0, right))
+                break;
+        }
+        usedLeft = usable - getFreeSpaceLeaf(left);
+        usedRight = usable - getFreeSpaceLeaf(right);
+        moved = true;
+    }
+
+    // The shortest key between the leaves is the new separator
+    if (moved)
+    {
+        compressLeaf(attribute, left);
+        compressLeaf(attribute, right);
+        char *key = (char*) malloc(3 * (VARCHAR_LENGTH_SIZE + PAGE_SIZE));
+        char *first = key + VARCHAR_LENGTH_SIZE + PAGE_SIZE;
+        char *separator = first + VARCHAR_LENGTH_SIZE + PAGE_SIZE;
+        int last = getLeafHeader(left).entriesNumber - 1;
+        getLeafKey(attribute, last, left, key);
+        getLeafKey(attribute, 0, right, first);
+        getSeparator(attribute, key, first, separator);
+        moved = replaceInternalKey(attribute, slotNum, separator, getLastRid(last, left), parent) == SUCCESS;
+        free(key);
+    }
+    return moved;
+}
+
+bool IndexManager::mergeInternals(const Attribute &attribute, void *parent, const int slotNum, void *left, void *right)
+{
+    // The separator comes down between the two, pointing at the right node's left child
+    void *key = malloc(PAGE_SIZE);
+    getInternalKey(attribute, slotNum, parent, key);
+    int usable = PAGE_SIZE - sizeof(NodeType) - sizeof(InternalHeader);
+    if (getFreeSpaceInternal(left) < usable - getFreeSpaceInternal(right) + getKeyLengthInternal(attribute, key))
+    {
+        free(key);
+        return false;
+    }
+
+    InternalHeader rightHeader = getInternalHeader(right);
+    ChildEntry entry;
+    entry.key = key;
+    entry.rid = getIndexEntry(slotNum, parent).rid;
+    entry.childPage = rightHeader.leftChildPage;
+    insertIntoInternal(attribute, entry, getInternalHeader(left).entriesNumber, left);
+    for (int i = 0; i < rightHeader.entriesNumber; i++)
+    {
+        IndexEntry moving = getIndexEntry(i, right);
+        getInternalKey(attribute, i, right, key);
+        entry.rid = moving.rid;
+        entry.childPage = moving.childPage;
+        insertIntoInternal(attribute, entry, getInternalHeader(left).entriesNumber, left);
+    }
+    free(key);
+    return true;
+}
+
+bool IndexManager::redistributeInternals(const Attribute &attribute, void *parent, const int slotNum, void *left, void *right)
+{
+    int usable = PAGE_SIZE - sizeof(NodeType) - sizeof(InternalHeader);
+    void *separator = malloc(PAGE_SIZE);
+    void *key = malloc(PAGE_SIZE);
+    bool moved = false;
+
+    // Rotate entries through the parent one at a time, from the fuller node as long as it stays the fuller one
+    while (true)
+    {
+        int usedLeft = usable - getFreeSpaceInternal(left);
+        int usedRight = usable - getFreeSpaceInternal(right);
+        getInternalKey(attribute, slotNum, parent, separator);
+        int separatorLen = getKeyLengthInternal(attribute, separator);
+        RID separatorRid = getIndexEntry(slotNum, parent).rid;
+        InternalHeader rightHeader = getInternalHeader(right);
+        ChildEntry down;
+        down.key = separator;
+        down.rid = separatorRid;
+        down.childPage = rightHeader.leftChildPage;
+
+        if (usedLeft < usedRight)
+        {
+            // The separator goes to the end of the left node, the first key of the right one goes up
+            IndexEntry first = getIndexEntry(0, right);
+            getInternalKey(attribute, 0, right, key);
+            int len = getKeyLengthInternal(attribute, key);
+            if (usedLeft + separatorLen > usedRight - len || getFreeSpaceInternal(left) < separatorLen
+                    || replaceInternalKey(attribute, slotNum, key, first.rid, parent))
+                break;
+            insertIntoInternal(attribute, down, getInternalHeader(left).entriesNumber, left);
+            deleteInternalSlot(attribute, 0, right);
+            rightHeader = getInternalHeader(right);
+            rightHeader.leftChildPage = first.childPage;
+            setInternalHeader(rightHeader, right);
+        }
+        else
+        {
+            // The separator goes to the front of the right node, the last key of the left one goes up
+            int lastSlot = getInternalHeader(left).entriesNumber - 1;
+            IndexEntry last = getIndexEntry(lastSlot, left);
+            getInternalKey(attribute, lastSlot, left, key);
+            int len = getKeyLengthInternal(attribute, key);
+            if (usedRight + separatorLen > usedLeft - len || getFreeSpaceInternal(right) < separatorLen
+                    || replaceInternalKey(attribute, slotNum, key, last.rid, parent))
+                break;
+            insertIntoInternal(attribute, down, 0, right);
+            rightHeader = getInternalHeader(right);
+            rightHeader.leftChildPage = last.childPage;
+            setInternalHeader(rightHeader, right);
+            deleteInternalSlot(attribute, lastSlot, left);
+        }
+        moved = true;
+    }
+    free(separator);
+    free(key);
+    return moved;
+}
+
+RC IndexManager::replaceInternalKey(const Attribute &attribute, const int slotNum, const void *key, const RID &rid, void *pageData)
+{
+    IndexEntry old = getIndexEntry(slotNum, pageData);
+    int oldLen = sizeof(IndexEntry);
+    if (attribute.type == TypeVarChar)
+        oldLen = getKeyLengthInternal(attribute, (char*)pageData + old.varcharOffset);
+    if (getFreeSpaceInternal(pageData) + oldLen < getKeyLengthInternal(attribute, key))
+        return IX_NO_FREE_SPACE;
+
+    ChildEntry entry;
+    entry.key = (void*) key;
+    entry.rid = rid;
+    entry.childPage = old.childPage;
+    deleteInternalSlot(attribute, slotNum, pageData);
+    return insertIntoInternal(attribute, entry, slotNum, pageData);
+}
+
+RC IndexManager::collapseRoot(IXFileHandle &fileHandle, int32_t rootPage)
+{
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    RC rc = SUCCESS;
+    while (rc == SUCCESS)
+    {
+        if (fileHandle.readPage(rootPage, pageData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        InternalHeader header = getInternalHeader(pageData);
+        if (header.entriesNumber > 0)
+            break;
+        // The root stays internal, so a lone leaf keeps its empty parent
+        int32_t child = header.leftChildPage;
+        if (fileHandle.readPage(child, pageData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        if (getNodetype(pageData) == IX_TYPE_LEAF)
+            break;
+        rc = setRootPageNum(fileHandle, child);
+        if (rc == SUCCESS)
+            rc = freePage(fileHandle, rootPage);
+        rootPage = child;
+    }
+    free(pageData);
+    return rc;
+}
+
+bool IndexManager::isUnderflow(void *pageData) const
+{
+    if (getNodetype(pageData) == IX_TYPE_LEAF)
+    {
+        int usable = PAGE_SIZE - sizeof(NodeType) - sizeof(LeafHeader);
+        return usable - getFreeSpaceLeaf(pageData) < IX_MIN_FILL_FACTOR * usable;
+    }
+    int usable = PAGE_SIZE - sizeof(NodeType) - sizeof(InternalHeader);
+    return usable - getFreeSpaceInternal(pageData) < IX_MIN_FILL_FACTOR * usable;
+}
+
+RC IndexManager::writeNewPage(IXFileHandle &fileHandle, const void *pageData, PageNum &pageNum)
+{
+    void *metaPage = malloc(PAGE_SIZE);
+    if (metaPage == NULL)
+        return IX_MALLOC_FAILED;
+    if (fileHandle.readPage(0, metaPage))
+    {
+        free(metaPage);
+        return IX_READ_FAILED;
+    }
+
+    RC rc = SUCCESS;
+    MetaHeader meta = getMetaData(metaPage);
+    if (meta.freePage == 0)
+    {
+        pageNum = fileHandle.getNumberOfPages();
+        if (fileHandle.appendPage(pageData))
+            rc = IX_APPEND_FAILED;
+    }
+    else
+    {
+        // Unlink the first free page, then overwrite it
+        pageNum = meta.freePage;
+        void *freeData = malloc(PAGE_SIZE);
+        if (freeData == NULL)
+            rc = IX_MALLOC_FAILED;
+        else if (fileHandle.readPage(pageNum, freeData))
+            rc = IX_READ_FAILED;
+        else
+        {
+            meta.freePage = getFreePageHeader(freeData).next;
+            setMetaData(meta, metaPage);
+            if (fileHandle.writePage(0, metaPage) || fileHandle.writePage(pageNum, pageData))
+                rc = IX_WRITE_FAILED;
+        }
+        free(freeData);
+    }
+    free(metaPage);
+    return rc;
+}
+
+RC IndexManager::freePage(IXFileHandle &fileHandle, const PageNum pageNum)
+{
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    if (fileHandle.readPage(0, pageData))
+    {
+        free(pageData);
+        return IX_READ_FAILED;
+    }
+
+    // Push the page on the front of the list
+    MetaHeader meta = getMetaData(pageData);
+    FreePageHeader header;
+    header.next = meta.freePage;
+    meta.freePage = pageNum;
+    setMetaData(meta, pageData);
+    RC rc = SUCCESS;
+    if (fileHandle.writePage(0, pageData))
+        rc = IX_WRITE_FAILED;
+
+    memset(pageData, 0, PAGE_SIZE);
+    setNodeType(IX_TYPE_FREE, pageData);
+    setFreePageHeader(header, pageData);
+    if (rc == SUCCESS && fileHandle.writePage(pageNum, pageData))
+        rc = IX_WRITE_FAILED;
+    free(pageData);
+    return rc;
+}
+
+RC IndexManager::setLeafPrev(IXFileHandle &fileHandle, const PageNum pageNum, const PageNum prev)
+{
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+    RC rc = SUCCESS;
+    if (fileHandle.readPage(pageNum, pageData))
+        rc = IX_READ_FAILED;
+    else
+    {
+        LeafHeader header = getLeafHeader(pageData);
+        header.prev = prev;
+        setLeafHeader(header, pageData);
+        if (fileHandle.writePage(pageNum, pageData))
+            rc = IX_WRITE_FAILED;
+    }
+    free(pageData);
+    return rc;
+}
+
+
+// A sorted run spilled to disk while bulk loading. Entries are <rid, key> packed
+// into pages, and each page starts with the number of entries on it.
+struct BulkLoadRun
+{
+    string fileName;
+    FileHandle fileHandle;
+    char *page;
+    PageNum pageNum;
+    uint16_t pageEntries;
+    uint16_t pageSlot;
+    unsigned offset;
+    const char *entry;
+};
+
+static unsigned bulkLoadRunCounter = 0;
+
+static unsigned getBulkEntryLength(const Attribute &attr, const char *entry)
+{
+    unsigned len = sizeof(RID) + INT_SIZE;
+    if (attr.type == TypeVarChar)
+    {
+        int32_t varcharLen;
+        memcpy(&varcharLen, entry + sizeof(RID), VARCHAR_LENGTH_SIZE);
+        len += varcharLen;
+    }
+    return len;
+}
+
+static RC createBulkLoadRun(BulkLoadRun *&run)
+{
+    PagedFileManager *pfm = PagedFileManager::instance();
+    run = new BulkLoadRun();
+    run->fileName = "ix_bulkload_" + to_string(getpid()) + "_" + to_string(bulkLoadRunCounter++);
+    run->page = (char*) malloc(PAGE_SIZE);
+    run->pageNum = 0;
+    run->pageEntries = 0;
+    run->pageSlot = 0;
+    run->offset = sizeof(uint16_t);
+    run->entry = NULL;
+    if (run->page == NULL)
+        return IX_MALLOC_FAILED;
+    if (pfm->createFile(run->fileName) || pfm->openFile(run->fileName, run->fileHandle))
+        return IX_CREATE_FAILED;
+    return SUCCESS;
+}
+
+static void destroyBulkLoadRun(BulkLoadRun *run)
+{
+    PagedFileManager *pfm = PagedFileManager::instance();
+    pfm->closeFile(run->fileHandle);
+    pfm->destroyFile(run->fileName);
+    free(run->page);
+    delete run;
+}
+
+static RC appendToBulkLoadRun(BulkLoadRun *run, const char *entry, unsigned len)
+{
+    if (run->offset + len > PAGE_SIZE)
+    {
+        memcpy(run->page, &run->pageEntries, sizeof(uint16_t));
+        if (run->fileHandle.appendPage(run->page))
+            return IX_APPEND_FAILED;
+        run->pageEntries = 0;
+        run->offset = sizeof(uint16_t);
+    }
+    memcpy(run->page + run->offset, entry, len);
+    run->offset += len;
+    run->pageEntries++;
+    return SUCCESS;
+}
+
+// Write out the last page and get ready to read the run from the start
+static RC rewindBulkLoadRun(BulkLoadRun *run)
+{
+    if (run->pageEntries > 0)
+    {
+        memcpy(run->page, &run->pageEntries, sizeof(uint16_t));
+        if (run->fileHandle.appendPage(run->page))
+            return IX_APPEND_FAILED;
+    }
+    run->pageNum = 0;
+    run->pageEntries = 0;
+    run->pageSlot = 0;
+    run->entry = NULL;
+    return SUCCESS;
+}
+
+// Moves to the next entry of the run. Returns false at the end of the run.
+static bool nextInBulkLoadRun(const Attribute &attr, BulkLoadRun *run)
+{
+    if (run->entry != NULL)
+    {
+        run->offset += getBulkEntryLength(attr, run->entry);
+        run->pageSlot++;
+    }
+    if (run->entry == NULL || run->pageSlot == run->pageEntries)
+    {
+        if (run->pageNum >= run->fileHandle.getNumberOfPages() || run->fileHandle.readPage(run->pageNum, run->page))
+        {
+            run->entry = NULL;
+            return false;
+        }
+        run->pageNum++;
+        memcpy(&run->pageEntries, run->page, sizeof(uint16_t));
+        run->pageSlot = 0;
+        run->offset = sizeof(uint16_t);
+    }
+    run->entry = run->page + run->offset;
+    return true;
+}
+
+RC IndexManager::setBulkLoadBufferSize(unsigned numPages)
+{
+    if (numPages == 0)
+        return IX_BAD_BUFFER_SIZE;
+    _bulk_load_buffer_pages = numPages;
+    return SUCCESS;
+}
+
+RC IndexManager::bulkLoad(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_EntryStream &entries, const double fillFactor)
+{
+    if (fillFactor <= 0 || fillFactor > 1)
+        return IX_BAD_FILL_FACTOR;
+
+    // Only a freshly created index can be bulk loaded: meta page, empty root, empty leaf
+    int32_t rootPage;
+    RC rc = getRootPageNum(ixfileHandle, rootPage);
+    if (rc)
+        return rc;
+    void *leaf = malloc(PAGE_SIZE);
+    if (leaf == NULL)
+        return IX_MALLOC_FAILED;
+    if (ixfileHandle.getNumberOfPages() != 3 || rootPage != 1 || ixfileHandle.readPage(2, leaf)
+            || getLeafHeader(leaf).entriesNumber != 0)
+    {
+        free(leaf);
+        return IX_NOT_EMPTY;
+    }
+
+    vector<PageNum> children;
+    vector<string> keys;
+    children.push_back(2);
+    // Rids of the same key are gathered into posting lists, each one goes to the leaves once it is full
+    // or the key changes
+    string postingKey;
+    vector<RID> posting;
+    int postingLength = 0;
+    function<RC(const char*)> toLeaves = [&](const char *sorted)
+    {
+        const char *key = sorted + sizeof(RID);
+        RID rid;
+        memcpy(&rid, sorted, sizeof(RID));
+        if (!posting.empty())
+        {
+            int len = getRidLength(rid, posting.back());
+            if (compareKeys(attribute, key, postingKey.data()) == 0 && postingLength + len <= IX_POSTING_MAX_BYTES)
+            {
+                posting.push_back(rid);
+                postingLength += len;
+                return SUCCESS;
+            }
+            RC rc = bulkLoadLeaf(ixfileHandle, attribute, fillFactor, postingKey.data(), posting, leaf, children, keys);
+            if (rc)
+                return rc;
+        }
+        postingKey.assign(key, getBulkEntryLength(attribute, sorted) - sizeof(RID));
+        posting.assign(1, rid);
+        postingLength = getRidLength(rid, RID{0, 0});
+        return SUCCESS;
+    };
+
+    // Sort the entries into runs, spilling each run once the buffer is full.
+    // Entries that come sorted go straight to the leaves.
+    vector<BulkLoadRun*> runs;
+    vector<char> buffer;
+    vector<unsigned> offsets;
+    size_t bufferSize = (size_t) _bulk_load_buffer_pages * PAGE_SIZE;
+    char *entry = (char*) malloc(sizeof(RID) + PAGE_SIZE);
+    RID rid;
+    bool sorted = entries.isSorted();
+    while ((rc = entries.getNextEntry(entry + sizeof(RID), rid)) == SUCCESS)
+    {
+        memcpy(entry, &rid, sizeof(RID));
+        if (sorted)
+        {
+            if ((rc = toLeaves(entry)))
+                break;
+            continue;
+        }
+        offsets.push_back(buffer.size());
+        buffer.insert(buffer.end(), entry, entry + getBulkEntryLength(attribute, entry));
+        if (buffer.size() >= bufferSize && (rc = spillBulkLoadRun(attribute, buffer, offsets, runs)))
+            break;
+    }
+    free(entry);
+    if (rc == IX_EOF)
+        rc = SUCCESS;
+
+    // Feed the sorted entries to the leaf level
+    if (rc == SUCCESS && runs.empty())
+    {
+        // Everything fit in memory
+        sort(offsets.begin(), offsets.end(), [&](unsigned a, unsigned b)
+            { return compareBulkEntries(attribute, &buffer[a], &buffer[b]) < 0; });
+        for (size_t i = 0; i < offsets.size() && rc == SUCCESS; i++)
+            rc = toLeaves(&buffer[offsets[i]]);
+    }
+    else if (rc == SUCCESS)
+    {
+        if (!offsets.empty())
+            rc = spillBulkLoadRun(attribute, buffer, offsets, runs);
+        // Merge groups of runs until one pass can merge them all
+        while (rc == SUCCESS && runs.size() > IX_BULK_LOAD_MERGE_FANIN)
+        {
+            vector<BulkLoadRun*> group(runs.begin(), runs.begin() + IX_BULK_LOAD_MERGE_FANIN);
+            runs.erase(runs.begin(), runs.begin() + IX_BULK_LOAD_MERGE_FANIN);
+            BulkLoadRun *merged;
+            rc = createBulkLoadRun(merged);
+            runs.push_back(merged);
+            if (rc == SUCCESS)
+                rc = mergeBulkLoadRuns(attribute, group, [&](const char *sorted)
+                    { return appendToBulkLoadRun(merged, sorted, getBulkEntryLength(attribute, sorted)); });
+            if (rc == SUCCESS)
+                rc = rewindBulkLoadRun(merged);
+            for (size_t i = 0; i < group.size(); i++)
+                destroyBulkLoadRun(group[i]);
+        }
+        if (rc == SUCCESS)
+            rc = mergeBulkLoadRuns(attribute, runs, toLeaves);
+    }
+    for (size_t i = 0; i < runs.size(); i++)
+        destroyBulkLoadRun(runs[i]);
+
+    // Write out the last leaf, then build the internal levels on top of the leaves
+    if (rc == SUCCESS && !posting.empty())
+        rc = bulkLoadLeaf(ixfileHandle, attribute, fillFactor, postingKey.data(), posting, leaf, children, keys);
+    if (rc == SUCCESS)
+        rc = children.back() == 2 ? ixfileHandle.writePage(2, leaf) : ixfileHandle.appendPage(leaf);
+    if (rc == SUCCESS)
+        rc = bulkLoadInternal(ixfileHandle, attribute, fillFactor, children, keys);
+    free(leaf);
+    return rc;
+}
+
+// Streams the entries of an index in order, for rebuild
+class IndexScanStream : public IX_EntryStream {
+    public:
+        IndexScanStream(IX_ScanIterator &iterator) : iterator(iterator) {};
+        RC getNextEntry(void *key, RID &rid) { return iterator.getNextEntry(rid, key); };
+        bool isSorted() const { return true; };
+    private:
+        IX_ScanIterator &iterator;
+};
+
+RC IndexManager::rebuild(IXFileHandle &ixfileHandle, const Attribute &attribute, const double fillFactor)
+{
+    if (fillFactor <= 0 || fillFactor > 1)
+        return IX_BAD_FILL_FACTOR;
+    string fileName = ixfileHandle.fileName;
+    if (fileName.empty())
+        return IX_OPEN_FAILED;
+
+    // Bulk load a new index from a scan of the old one. A rebuild that failed part way leaves its file behind.
+    string rebuiltName = fileName + IX_REBUILD_SUFFIX;
+    destroyFile(rebuiltName);
+    RC rc = createFile(rebuiltName);
+    if (rc)
+        return rc;
+    IXFileHandle rebuilt;
+    rc = openFile(rebuiltName, rebuilt);
+    if (rc)
+    {
+        destroyFile(rebuiltName);
+        return rc;
+    }
+    IX_ScanIterator iterator;
+    rc = scan(ixfileHandle, attribute, NULL, NULL, true, true, iterator);
+    if (rc == SUCCESS)
+    {
+        IndexScanStream entries(iterator);
+        rc = bulkLoad(rebuilt, attribute, entries, fillFactor);
+    }
+    iterator.close();
+    if (closeFile(rebuilt) && rc == SUCCESS)
+        rc = IX_CLOSE_FAILED;
+    if (rc)
+    {
+        destroyFile(rebuiltName);
+        return rc;
+    }
+
+    // Swap the new file in under the old name. The rename is atomic: the index file is either
+    // the old tree or the new one, never missing or half written.
+    rc = closeFile(ixfileHandle);
+    if (rc)
+        return rc;
+    PagedFileManager *pfm = PagedFileManager::instance();
+    if (pfm->renameFile(rebuiltName, fileName))
+    {
+        destroyFile(rebuiltName);
+        rc = IX_RENAME_FAILED;
+    }
+    RC openRc = openFile(fileName, ixfileHandle);
+    return rc ? rc : openRc;
+}
+
+RC IndexManager::getFragmentation(IXFileHandle &ixfileHandle, unsigned &leafCount, unsigned &jumpCount)
+{
+    leafCount = 0;
+    jumpCount = 0;
+    int32_t pageNum;
+    RC rc = getRootPageNum(ixfileHandle, pageNum);
+    if (rc)
+        return rc;
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
+
+    // Go down the left edge to the first leaf, then follow the leaves
+    while (rc == SUCCESS)
+    {
+        if (ixfileHandle.readPage(pageNum, pageData))
+        {
+            rc = IX_READ_FAILED;
+            break;
+        }
+        if (getNodetype(pageData) == IX_TYPE_LEAF)
+        {
+            leafCount++;
+            int32_t next = getLeafHeader(pageData).next;
+            if (next == 0)
+                break;
+            if (next != pageNum + 1)
+                jumpCount++;
+            pageNum = next;
+        }
+        else
+            pageNum = getInternalHeader(pageData).leftChildPage;
+    }
+    free(pageData);
+    return rc;
+}
+
+int IndexManager::compareKeys(const Attribute &attr, const void *key, const void *value) const
+{
+    if (attr.type == TypeInt)
+    {
+        int32_t int_key, int_value;
+        memcpy(&int_key, key, INT_SIZE);
+        memcpy(&int_value, value, INT_SIZE);
+        return compare(int_key, int_value);
+    }
+    else if (attr.type == TypeReal)
+    {
+        float real_key, real_value;
+        memcpy(&real_key, key, REAL_SIZE);
+        memcpy(&real_value, value, REAL_SIZE);
+        return compare(real_key, real_value);
+    }
+    return compare(key, value, 0);
+}
+
+// Orders entries by key, then by rid
+int IndexManager::compareBulkEntries(const Attribute &attr, const char *entry, const char *other) const
+{
+    int cmp = compareKeys(attr, entry + sizeof(RID), other + sizeof(RID));
+    if (cmp != 0)
+        return cmp;
+    RID rid, otherRid;
+    memcpy(&rid, entry, sizeof(RID));
+    memcpy(&otherRid, other, sizeof(RID));
+    return compare(rid, otherRid);
+}
+
+RC IndexManager::spillBulkLoadRun(const Attribute &attr, vector<char> &buffer, vector<unsigned> &offsets, vector<BulkLoadRun*> &runs)
+{
+    sort(offsets.begin(), offsets.end(), [&](unsigned a, unsigned b)
+        { return compareBulkEntries(attr, &buffer[a], &buffer[b]) < 0; });
+
+    BulkLoadRun *run;
+    RC rc = createBulkLoadRun(run);
+    runs.push_back(run);
+    for (size_t i = 0; i < offsets.size() && rc == SUCCESS; i++)
+        rc = appendToBulkLoadRun(run, &buffer[offsets[i]], getBulkEntryLength(attr, &buffer[offsets[i]]));
+    if (rc == SUCCESS)
+        rc = rewindBulkLoadRun(run);
+
+    buffer.clear();
+    offsets.clear();
+    return rc;
+}
+
+RC IndexManager::mergeBulkLoadRuns(const Attribute &attr, vector<BulkLoadRun*> &runs, function<RC(const char*)> sink)
+{
+    // Min-heap of runs ordered by their current entry
+    auto greater = [&](BulkLoadRun *a, BulkLoadRun *b)
+        { return compareBulkEntries(attr, a->entry, b->entry) > 0; };
+    priority_queue<BulkLoadRun*, vector<BulkLoadRun*>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        if (nextInBulkLoadRun(attr, runs[i]))
+            heap.push(runs[i]);
+    }
+
+    while (!heap.empty())
+    {
+        BulkLoadRun *run = heap.top();
+        heap.pop();
+        RC rc = sink(run->entry);
+        if (rc)
+            return rc;
+        if (nextInBulkLoadRun(attr, run))
+            heap.push(run);
+    }
+    return SUCCESS;
+}
+
+RC IndexManager::bulkLoadLeaf(IXFileHandle &ixfileHandle, const Attribute &attr, const double fillFactor, const void *key,
+        const vector<RID> &rids, void *leaf, vector<PageNum> &children, vector<string> &keys)
+{
+    char posting[IX_POSTING_MAX_BYTES + IX_MAX_RID_BYTES];
+    int postingLength = encodePosting(rids.data(), rids.size(), posting);
+
+    LeafHeader header = getLeafHeader(leaf);
+    int len = getLeafInsertLength(attr, key, postingLength, leaf);
+    int usable = PAGE_SIZE - sizeof(NodeType) - sizeof(LeafHeader);
+    int used = usable - getFreeSpaceLeaf(leaf);
+    if (header.entriesNumber > 0 && (used + len > fillFactor * usable || getFreeSpaceLeaf(leaf) < len))
+    {
+        // The leaf is full: link it to the next one and write it, leaves are laid out in order
+        PageNum pageNum = children.back();
+        header.next = pageNum + 1;
+        setLeafHeader(header, leaf);
+        RC rc = pageNum == 2 ? ixfileHandle.writePage(pageNum, leaf) : ixfileHandle.appendPage(leaf);
+        if (rc)
+            return rc;
+
+        // The shortest key between its largest entry and the next one separates it from the next leaf
+        char last[VARCHAR_LENGTH_SIZE + PAGE_SIZE], separatorKey[VARCHAR_LENGTH_SIZE + PAGE_SIZE];
+        RID lastRid = getLastRid(header.entriesNumber - 1, leaf);
+        getLeafKey(attr, header.entriesNumber - 1, leaf, last);
+        string separator((char*)&lastRid, sizeof(RID));
+        separator.append(separatorKey, getSeparator(attr, last, key, separatorKey));
+        keys.push_back(separator);
+        children.push_back(pageNum + 1);
+
+        memset(leaf, 0, PAGE_SIZE);
+        setNodeType(IX_TYPE_LEAF, leaf);
+        header.next = 0;
+        header.prev = pageNum;
+        header.entriesNumber = 0;
+        header.freeSpaceOffset = PAGE_SIZE;
+        header.prefixLength = 0;
+        setLeafHeader(header, leaf);
+    }
+    // A leaf starts with all of its first key as the prefix, each key after it keeps what it shares
+    if (attr.type == TypeVarChar && header.entriesNumber == 0)
+    {
+        int32_t keyLength;
+        memcpy(&keyLength, key, VARCHAR_LENGTH_SIZE);
+        setLeafPrefix(attr, key, keyLength, leaf);
+    }
+    return insertLeafSlot(attr, key, posting, postingLength, header.entriesNumber, leaf);
+}
+
+RC IndexManager::bulkLoadInternal(IXFileHandle &ixfileHandle, const Attribute &attr, const double fillFactor,
+        vector<PageNum> &children, vector<string> &keys)
+{
+    void *node = malloc(PAGE_SIZE);
+    if (node == NULL)
+        return IX_MALLOC_FAILED;
+    int usable = PAGE_SIZE - sizeof(NodeType) - sizeof(InternalHeader);
+    RC rc = SUCCESS;
+
+    // Build one level at a time until a level fits in a single node, which becomes the root
+    while (true)
+    {
+        vector<PageNum> parentChildren;
+        vector<string> parentKeys;
+
+        memset(node, 0, PAGE_SIZE);
+        setNodeType(IX_TYPE_INTERNAL, node);
+        InternalHeader header;
+        header.entriesNumber = 0;
+        header.freeSpaceOffset = PAGE_SIZE;
+        header.leftChildPage = children[0];
+        setInternalHeader(header, node);
+
+        for (size_t i = 1; i < children.size() && rc == SUCCESS; i++)
+        {
+            ChildEntry entry;
+            memcpy(&entry.rid, keys[i - 1].data(), sizeof(RID));
+            entry.key = (void*) (keys[i - 1].data() + sizeof(RID));
+            entry.childPage = children[i];
+            int len = getKeyLengthInternal(attr, entry.key);
+            int used = usable - getFreeSpaceInternal(node);
+            if (getInternalHeader(node).entriesNumber == 0 || (used + len <= fillFactor * usable && getFreeSpaceInternal(node) >= len))
+            {
+                rc = insertIntoInternal(attr, entry, node);
+                continue;
+            }
+
+            // The node is full, the key moves up to separate it from the next node
+            parentChildren.push_back(ixfileHandle.getNumberOfPages());
+            parentKeys.push_back(keys[i - 1]);
+            rc = ixfileHandle.appendPage(node);
+
+            memset(node, 0, PAGE_SIZE);
+            setNodeType(IX_TYPE_INTERNAL, node);
+            header.leftChildPage = children[i];
+            setInternalHeader(header, node);
+        }
+        if (rc)
+            break;
+
+        // A single node is the root, which always lives on page 1
+        if (parentChildren.empty())
+        {
+            rc = ixfileHandle.writePage(1, node);
+            break;
+        }
+        parentChildren.push_back(ixfileHandle.getNumberOfPages());
+        rc = ixfileHandle.appendPage(node);
+        if (rc)
+            break;
+        children.swap(parentChildren);
+        keys.swap(parentKeys);
+    }
+
+    free(node);
+    return rc;
+}
+
+RC IndexManager::scan(IXFileHandle &ixfileHandle,
+        const Attribute &attribute,
+        const void      *lowKey,
+        const void      *highKey,
+        bool			lowKeyInclusive,
+        bool        	highKeyInclusive,
+        IX_ScanIterator &ix_ScanIterator)
 {
     return ix_ScanIterator.initialize(ixfileHandle, attribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive);
 }
@@ -732,81 +1916,44 @@ void IndexManager::printInternalNode(IXFileHandle &ixfileHandle, void *pageData,
 void IndexManager::printLeafNode(void *pageData, const Attribute &attr) const
 {
     LeafHeader header = getLeafHeader(pageData);
-    void *key = NULL;
-    if (attr.type != TypeVarChar)
-        key = malloc (INT_SIZE);
-    bool first = true;
+    void *key = malloc(PAGE_SIZE);
+    vector<RID> rids;
     vector<RID> key_rids;
 
     cout << "\"keys\":[";
-
-    for (int i = 0; i <= header.entriesNumber; i++)
+    for (int i = 0; i < header.entriesNumber; i++)
     {
-        DataEntry entry = getDataEntry(i, pageData);
-        if (first && i < header.entriesNumber)
-        {
-            key_rids.clear();
-            first = false;
-            if (attr.type == TypeInt)
-                memcpy(key, &(entry.integer), INT_SIZE);
-            else if (attr.type == TypeReal)
-                memcpy(key, &(entry.real), REAL_SIZE);
-            else
-            {
-                // Deal with reading in varchar
-                int len;
-                memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-                free(key);
-                key = malloc(len + VARCHAR_LENGTH_SIZE + 1);
-                memcpy(key, &len, VARCHAR_LENGTH_SIZE);
-                memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-                memset((char*)key + VARCHAR_LENGTH_SIZE + len, 0, 1);
-            }
-        }
-        if ( i < header.entriesNumber && compareLeafSlot(attr, key, pageData, i) == 0)
+        getPosting(i, pageData, rids);
+        key_rids.insert(key_rids.end(), rids.begin(), rids.end());
+        // Every slot of a key prints as one
+        getLeafKey(attr, i, pageData, key);
+        if (i + 1 < header.entriesNumber && compareLeafSlot(attr, key, pageData, i + 1) == 0)
+            continue;
+
+        cout << "\"";
+        if (attr.type == TypeInt)
+            cout << "" << *(int*)key;
+        else if (attr.type == TypeReal)
+            cout << "" << *(float*)key;
+        else
         {
-            key_rids.push_back(entry.rid);
+            int len;
+            memcpy(&len, key, VARCHAR_LENGTH_SIZE);
+            cout << string((char*)key + VARCHAR_LENGTH_SIZE, len);
         }
-        else if (i != 0)
+
+        cout << ":[";
+        for (unsigned j = 0; j < key_rids.size(); j++)
         {
-            cout << "\"";
-            if (attr.type == TypeInt)
-            {
-                cout << "" << *(int*)key;
-                memcpy(key, &(entry.integer), INT_SIZE);
-            }
-            else if (attr.type == TypeReal)
+            if (j != 0)
             {
-                cout << "" << *(float*)key;
-                memcpy(key, &(entry.real), REAL_SIZE);
+                cout << ",";
             }
-            else
-            {
-                cout << (char*)key + 4;
-
-                int len;
-                memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-                free(key);
-                key = malloc(len + VARCHAR_LENGTH_SIZE + 1);
-                memcpy(key, &len, VARCHAR_LENGTH_SIZE);
-                memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
-                memset((char*)key + VARCHAR_LENGTH_SIZE + len, 0, 1);
-            }
-            
-            cout << ":[";
-            for (unsigned j = 0; j < key_rids.size(); j++)
-            {
-                if (j != 0)
-                {
-                    cout << ",";
-                }
-                cout << "(" << key_rids[j].pageNum << "," << key_rids[j].slotNum << ")";
-            }
-            cout << "]\"";
-            if (i < header.entriesNumber) cout << ",";
-            key_rids.clear();
-            key_rids.push_back(entry.rid);
+            cout << "(" << key_rids[j].pageNum << "," << key_rids[j].slotNum << ")";
         }
+        cout << "]\"";
+        if (i + 1 < header.entriesNumber) cout << ",";
+        key_rids.clear();
     }
     cout << "]";
     free (key);
@@ -833,6 +1980,7 @@ void IndexManager::printInternalSlot(const Attribute &attr, const int32_t slotNu
 }
 
 IX_ScanIterator::IX_ScanIterator()
+: page(NULL), ridIndex(0)
 {
 }
 
@@ -850,105 +1998,170 @@ RC IX_ScanIterator::initialize(IXFileHandle &fh, Attribute attribute, const void
     lowKeyInclusive = lowInc;
     highKeyInclusive = highInc;
 
-    // Initialize our storage
-    page = malloc(PAGE_SIZE);
+    // Find the starting entry
+    hasLast = false;
+    page = NULL;
+    return resume();
+}
+
+RC IX_ScanIterator::resume()
+{
+    IndexManager *im = IndexManager::instance();
+    rids.clear();
+    ridIndex = 0;
+    // Usually the entry after the last one returned is still on this leaf.
+    // Slots from the one that may hold the last entry on are read again, nextSlot skips what was returned.
+    if (page != NULL && hasLast && im->getNodetype(page) == IX_TYPE_LEAF)
+    {
+        LeafHeader header = im->getLeafHeader(page);
+        if (header.entriesNumber > 0
+                && im->compareLeafSlot(attr, lastKey.data(), lastRid, page, 0) >= 0
+                && im->compareLeafSlot(attr, lastKey.data(), lastRid, page, header.entriesNumber - 1) < 0)
+        {
+            slotNum = im->searchLeafSlot(attr, lastKey.data(), lastRid, page, true) - 1;
+            entriesSeen = header.entriesNumber;
+            return SUCCESS;
+        }
+    }
+
+    // Otherwise it was split off or merged away, or freed, so search the tree again
+    if (page != NULL)
+        fileHandle->unpinPage(pageNum);
+    page = NULL;
+    int32_t leafPageNum;
+    RC rc = hasLast ? im->find(*fileHandle, attr, lastKey.data(), leafPageNum, &lastRid)
+        : im->find(*fileHandle, attr, lowKey, leafPageNum);
+    if (rc)
+        return rc;
+    page = fileHandle->pinPage(leafPageNum);
     if (page == NULL)
-        return IX_MALLOC_FAILED;
-    // Initialize starting slot number
-    slotNum = 0;
+        return IX_READ_FAILED;
+    pageNum = leafPageNum;
+
+    if (hasLast)
+        slotNum = max(0, im->searchLeafSlot(attr, lastKey.data(), lastRid, page, true) - 1);
+    else
+        slotNum = (lowKey == NULL ? 0 : im->searchLeafSlot(attr, lowKey, page, !lowKeyInclusive));
+    entriesSeen = im->getLeafHeader(page).entriesNumber;
+    return SUCCESS;
+}
 
-    // Find the starting page
+RC IX_ScanIterator::nextSlot()
+{
     IndexManager *im = IndexManager::instance();
-    int32_t startPageNum;
-    RC rc = im->find(*fileHandle, attr, lowKey, startPageNum);
-    if (rc)
-    {
-        free(page);
-        return rc;
-    }
-    rc = fileHandle->readPage(startPageNum, page);
-    if (rc)
+    // The leaf is shared with writers, if it changed since we read the last slot
+    // we continue right after the last entry we returned
+    if (im->getNodetype(page) != IX_TYPE_LEAF || im->getLeafHeader(page).entriesNumber != entriesSeen
+            || (hasLast && slotNum > 0 && im->compareLeafSlot(attr, lastKey.data(), page, slotNum - 1) != 0))
     {
-        free(page);
-        return rc;
+        RC rc = resume();
+        if (rc)
+            return rc;
     }
 
-    // Find the starting entry
-    LeafHeader header = im->getLeafHeader(page);
-    int i = 0;
-    for (i = 0; i < header.entriesNumber; i++)
+    while (true)
     {
-        int cmp = (low == NULL ? -1 : im->compareLeafSlot(attr, lowKey, page, i));
+        LeafHeader header = im->getLeafHeader(page);
+        // If we have run off the end of the page, jump to the next one
+        if (slotNum >= header.entriesNumber)
+        {
+            // If there is no next page, return EOF
+            if (header.next == 0)
+                return IX_EOF;
+            fileHandle->unpinPage(pageNum);
+            pageNum = header.next;
+            page = fileHandle->pinPage(pageNum);
+            if (page == NULL)
+                return IX_READ_FAILED;
+            slotNum = 0;
+            entriesSeen = im->getLeafHeader(page).entriesNumber;
+            continue;
+        }
+        // If highkey is null, always carry on
+        // Otherwise, carry on only if highkey is greater than the current key
+        int cmp = highKey == NULL ? 1 : im->compareLeafSlot(attr, highKey, page, slotNum);
+        if (cmp == 0 && !highKeyInclusive)
+            return IX_EOF;
         if (cmp < 0)
-            break;
-        if (cmp == 0 && lowKeyInclusive)
-            break;
-        if (cmp > 0)
+            return IX_EOF;
+
+        // An excluded low key can run on past the leaf the search started in
+        if (!hasLast && lowKey != NULL && !lowKeyInclusive && im->compareLeafSlot(attr, lowKey, page, slotNum) == 0)
+        {
+            slotNum++;
+            continue;
+        }
+
+        // Skip the entries up to the last one returned
+        int last = hasLast ? im->compareLeafSlot(attr, lastKey.data(), page, slotNum) : -1;
+        slotNum++;
+        if (last > 0)
+            continue;
+        im->getPosting(slotNum - 1, page, rids);
+        ridIndex = last == 0 ? upper_bound(rids.begin(), rids.end(), lastRid, ridLess) - rids.begin() : 0;
+        if (ridIndex == rids.size())
             continue;
+
+        DataEntry entry = im->getDataEntry(slotNum - 1, page);
+        if (attr.type == TypeVarChar)
+        {
+            int32_t len;
+            memcpy(&len, (const char*)page + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+            lastKey.resize(VARCHAR_LENGTH_SIZE + header.prefixLength + len);
+            im->getLeafKey(attr, slotNum - 1, page, &lastKey[0]);
+        }
+        else
+            lastKey.assign((const char*)&entry.integer, INT_SIZE);
+        return SUCCESS;
     }
-    slotNum = i;
-    return SUCCESS;
 }
 
 RC IX_ScanIterator::getNextEntry(RID &rid, void *key)
 {
-    IndexManager *im = IndexManager::instance();
-    LeafHeader header = im->getLeafHeader(page);
-    // If we have run off the end of the page, jump to the next one
-    if (slotNum >= header.entriesNumber)
-    {
-        // If there is no next page, return EOF
-        if (header.next == 0)
-            return IX_EOF;
-        slotNum = 0;
-        fileHandle->readPage(header.next, page);
-        return getNextEntry(rid, key);
-    }
-    // If highkey is null, always carry on
-    // Otherwise, carry on only if highkey is greater than the current key
-    int cmp = highKey == NULL ? 1 : im->compareLeafSlot(attr, highKey, page, slotNum);
-    if (cmp == 0 && !highKeyInclusive)
-        return IX_EOF;
-    if (cmp < 0)
+    if (page == NULL)
         return IX_EOF;
-
-    // Grab the data entry, grab its rid
-    DataEntry entry = im->getDataEntry(slotNum, page);
-    rid.pageNum = entry.rid.pageNum;
-    rid.slotNum = entry.rid.slotNum;
-    // grab its key
-    if (attr.type == TypeInt)
-        memcpy(key, &(entry.integer), INT_SIZE);
-    else if (attr.type == TypeReal)
-        memcpy(key, &(entry.real), REAL_SIZE);
-    else
+    // Go on with the posting list we are in, or the next one
+    if (ridIndex == rids.size())
     {
-        int len;
-        memcpy(&len, (char*)page + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
-        memcpy(key, &len, VARCHAR_LENGTH_SIZE);
-        memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)page + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
+        RC rc = nextSlot();
+        if (rc)
+            return rc;
     }
-    // increment slotNum for the next call to getNextEntry
-    slotNum++;
+    rid = rids[ridIndex++];
+    memcpy(key, lastKey.data(), lastKey.size());
+    lastRid = rid;
+    hasLast = true;
     return SUCCESS;
 }
 
 RC IX_ScanIterator::close()
 {
-    free(page);
+    // Release the leaf we are holding
+    if (page != NULL)
+        fileHandle->unpinPage(pageNum);
+    page = NULL;
+    rids.clear();
+    ridIndex = 0;
     return SUCCESS;
 }
 
 
+unordered_map<unsigned, unsigned> IXFileHandle::treeVersions;
+
 IXFileHandle::IXFileHandle()
 {
     ixReadPageCounter = 0;
     ixWritePageCounter = 0;
     ixAppendPageCounter = 0;
+    rootPage = -1;
+    height = -1;
+    cacheFileId = UINT_MAX;
+    cacheVersion = 0;
 }
 
 IXFileHandle::~IXFileHandle()
 {
+    clearCache();
 }
 
 RC IXFileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount)
@@ -959,15 +2172,34 @@ RC IXFileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePa
     return SUCCESS;
 }
 
+RC IXFileHandle::collectBufferCounterValues(unsigned &hitCount, unsigned &missCount)
+{
+    return fh.collectBufferCounterValues(hitCount, missCount);
+}
+
 RC IXFileHandle::readPage(PageNum pageNum, void *data)
 {
     ixReadPageCounter++;
     return fh.readPage(pageNum, data);
 }
 
+const void *IXFileHandle::pinPage(PageNum pageNum)
+{
+    ixReadPageCounter++;
+    return fh.pinPage(pageNum);
+}
+
+RC IXFileHandle::unpinPage(PageNum pageNum)
+{
+    return fh.unpinPage(pageNum);
+}
+
 RC IXFileHandle::writePage(PageNum pageNum, const void *data)
 {
     ixWritePageCounter++;
+    // Leaves are never cached, anything else may change the shape of the tree above them
+    if (pageNum == 0 || *(const NodeType*)data != IX_TYPE_LEAF)
+        treeVersions[fh.getFileId()]++;
     return fh.writePage(pageNum, data);
 }
 
@@ -982,6 +2214,44 @@ unsigned IXFileHandle::getNumberOfPages()
     return fh.getNumberOfPages();
 }
 
+// Drops the cache if the tree changed since it was filled, or the handle now refers to another file
+void IXFileHandle::syncCache()
+{
+    unsigned fileId = fh.getFileId();
+    unsigned version = treeVersions[fileId];
+    if (fileId == cacheFileId && version == cacheVersion)
+        return;
+    clearCache();
+    cacheFileId = fileId;
+    cacheVersion = version;
+}
+
+void IXFileHandle::clearCache()
+{
+    for (auto it = nodes.begin(); it != nodes.end(); ++it)
+        free(it->second);
+    nodes.clear();
+    rootPage = -1;
+    height = -1;
+}
+
+const void *IXFileHandle::getCachedNode(PageNum pageNum)
+{
+    auto it = nodes.find(pageNum);
+    return it == nodes.end() ? NULL : it->second;
+}
+
+void IXFileHandle::cacheNode(PageNum pageNum, const void *data)
+{
+    if (nodes.size() >= IX_CACHED_NODES || nodes.count(pageNum))
+        return;
+    void *copy = malloc(PAGE_SIZE);
+    if (copy == NULL)
+        return;
+    memcpy(copy, data, PAGE_SIZE);
+    nodes[pageNum] = copy;
+}
+
 // Private helpers -----------------------
 
 void IndexManager::setMetaData(const MetaHeader header, void *pageData)
@@ -1068,8 +2338,60 @@ DataEntry IndexManager::getDataEntry(const int slotNum, const void *pageData) co
     return entry;
 }
 
+void IndexManager::setFreePageHeader(const FreePageHeader header, void *pageData)
+{
+    const unsigned offset = sizeof(NodeType);
+    memcpy((char*)pageData + offset, &header, sizeof(FreePageHeader));
+}
+
+FreePageHeader IndexManager::getFreePageHeader(const void *pageData) const
+{
+    const unsigned offset = sizeof(NodeType);
+    FreePageHeader header;
+    memcpy(&header, (char*)pageData + offset, sizeof(FreePageHeader));
+    return header;
+}
+
+void IndexManager::getInternalKey(const Attribute attr, const int slotNum, const void *pageData, void *key) const
+{
+    IndexEntry entry = getIndexEntry(slotNum, pageData);
+    if (attr.type == TypeVarChar)
+    {
+        int32_t len;
+        memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+        memcpy(key, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE + len);
+    }
+    else
+        memcpy(key, &(entry.integer), INT_SIZE);
+}
+
+void IndexManager::getLeafKey(const Attribute attr, const int slotNum, const void *pageData, void *key) const
+{
+    DataEntry entry = getDataEntry(slotNum, pageData);
+    if (attr.type == TypeVarChar)
+    {
+        // The prefix of the leaf, then the rest of the key
+        int32_t prefixLength = getLeafHeader(pageData).prefixLength;
+        int32_t len;
+        memcpy(&len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+        int32_t keyLength = prefixLength + len;
+        memcpy(key, &keyLength, VARCHAR_LENGTH_SIZE);
+        memcpy((char*)key + VARCHAR_LENGTH_SIZE, (char*)pageData + PAGE_SIZE - prefixLength, prefixLength);
+        memcpy((char*)key + VARCHAR_LENGTH_SIZE + prefixLength, (char*)pageData + entry.varcharOffset + VARCHAR_LENGTH_SIZE, len);
+    }
+    else
+        memcpy(key, &(entry.integer), INT_SIZE);
+}
+
 RC IndexManager::getRootPageNum(IXFileHandle &fileHandle, int32_t &result) const
 {
+    fileHandle.syncCache();
+    if (fileHandle.rootPage >= 0)
+    {
+        result = fileHandle.rootPage;
+        return SUCCESS;
+    }
+
     void *metaPage = malloc(PAGE_SIZE);
     if (metaPage == NULL)
         return IX_MALLOC_FAILED;
@@ -1083,69 +2405,123 @@ RC IndexManager::getRootPageNum(IXFileHandle &fileHandle, int32_t &result) const
     MetaHeader header = getMetaData(metaPage);
     free(metaPage);
     result = header.rootPage;
+    fileHandle.rootPage = result;
     return SUCCESS;
 }
 
-RC IndexManager::find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum)
+RC IndexManager::setRootPageNum(IXFileHandle &fileHandle, const int32_t rootPage)
+{
+    void *metaPage = malloc(PAGE_SIZE);
+    if (metaPage == NULL)
+        return IX_MALLOC_FAILED;
+    if (fileHandle.readPage(0, metaPage))
+    {
+        free(metaPage);
+        return IX_READ_FAILED;
+    }
+
+    MetaHeader header = getMetaData(metaPage);
+    header.rootPage = rootPage;
+    setMetaData(header, metaPage);
+    RC rc = fileHandle.writePage(0, metaPage);
+    free(metaPage);
+    return rc ? IX_WRITE_FAILED : SUCCESS;
+}
+
+RC IndexManager::find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum, const RID *rid)
 {
     int32_t rootPageNum;
     RC rc = getRootPageNum(handle, rootPageNum);
     if (rc)
         return rc;
-    return treeSearch(handle, attr, key, rootPageNum, resultPageNum);
+    return treeSearch(handle, attr, key, rootPageNum, resultPageNum, rid);
 }
 
-RC IndexManager::treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t currPageNum, int32_t &resultPageNum)
+RC IndexManager::treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t currPageNum, int32_t &resultPageNum,
+        const RID *rid)
 {
     void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return IX_MALLOC_FAILED;
 
-    if (handle.readPage(currPageNum, pageData))
+    // Descents from the root know the height of the tree once one of them reached a leaf,
+    // and stop at the leaf's page number without reading it
+    handle.syncCache();
+    bool fromRoot = currPageNum == handle.rootPage;
+    int32_t pageNum = currPageNum;
+    for (int level = 0; ; level++)
     {
-        free (pageData);
-        return IX_READ_FAILED;
-    }
+        if (fromRoot && level == handle.height)
+            break;
 
-    // Found our leaf!
-    if (getNodetype(pageData) == IX_TYPE_LEAF)
-    {
-        resultPageNum = currPageNum;
-        free(pageData);
-        return SUCCESS;
-    }
+        const void *node;
+        RC rc = readNode(handle, pageNum, level, pageData, node);
+        if (rc)
+        {
+            free(pageData);
+            return rc;
+        }
 
-    int32_t nextChildPage = getNextChildPage(attr, key, pageData);
+        // Found our leaf!
+        if (getNodetype(node) == IX_TYPE_LEAF)
+        {
+            if (fromRoot)
+                handle.height = level;
+            break;
+        }
+        pageNum = getNextChildPage(attr, key, node, rid);
+    }
 
+    resultPageNum = pageNum;
     free(pageData);
-    return treeSearch(handle, attr, key, nextChildPage, resultPageNum);
+    return SUCCESS;
 }
 
-int32_t IndexManager::getNextChildPage(const Attribute attr, const void *key, void *pageData)
+// Points node at the cached copy of a page, or reads it into buffer, caching it if it is an internal node
+// of one of the top levels
+RC IndexManager::readNode(IXFileHandle &handle, const PageNum pageNum, const int level, void *buffer, const void *&node)
 {
-    InternalHeader header = getInternalHeader(pageData);
-    if (key == NULL)
-        return header.leftChildPage;
+    handle.syncCache();
+    node = handle.getCachedNode(pageNum);
+    if (node != NULL)
+        return SUCCESS;
+    if (handle.readPage(pageNum, buffer))
+        return IX_READ_FAILED;
+    if (level < IX_CACHED_LEVELS && getNodetype(buffer) == IX_TYPE_INTERNAL)
+        handle.cacheNode(pageNum, buffer);
+    node = buffer;
+    return SUCCESS;
+}
 
-    int i = 0;
-    for (i = 0; i < header.entriesNumber; i++)
-    {
-        // If key < slot key we have, then the previous entry holds the path
-        if (compareSlot(attr, key, pageData, i) <= 0)
-            break;
-    }
-    int32_t result;
-    // Special case where key is less than all entries in this node
-    if (i == 0)
-    {
-        result = header.leftChildPage;
-    }
-    // Usual case where we grab the child to the right of the largest entry less than key
-    // This also works if key is larger than all entries
-    else
+// Reads a page into pageData, copying it from the cache of the handle when it is there
+RC IndexManager::fetchNode(IXFileHandle &handle, const PageNum pageNum, void *pageData)
+{
+    handle.syncCache();
+    const void *node = handle.getCachedNode(pageNum);
+    if (node != NULL)
     {
-        IndexEntry entry = getIndexEntry(i - 1, pageData);
-        result = entry.childPage;
+        memcpy(pageData, node, PAGE_SIZE);
+        return SUCCESS;
     }
-    return result;
+    return handle.readPage(pageNum, pageData);
+}
+
+int32_t IndexManager::getNextChildPage(const Attribute attr, const void *key, const void *pageData, const RID *rid)
+{
+    if (key == NULL)
+        return getInternalHeader(pageData).leftChildPage;
+
+    // If key <= slot key we have, then the previous entry holds the path.
+    // Without a rid this is the leftmost path that may hold key.
+    int i = rid == NULL ? searchSlot(attr, key, pageData, false) : searchSlot(attr, key, *rid, pageData, false);
+    return getChildPage(i, pageData);
+}
+
+int32_t IndexManager::getChildPage(const int childNum, const void *pageData) const
+{
+    if (childNum == 0)
+        return getInternalHeader(pageData).leftChildPage;
+    return getIndexEntry(childNum - 1, pageData).childPage;
 }
 
 int IndexManager::compareSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const
@@ -1165,20 +2541,7 @@ int IndexManager::compareSlot(const Attribute attr, const void *key, const void
     }
     else
     {
-        int32_t key_size;
-        memcpy(&key_size, key, VARCHAR_LENGTH_SIZE);
-        char key_text[key_size + 1];
-        key_text[key_size] = '\0';
-        memcpy(key_text, (char*) key + VARCHAR_LENGTH_SIZE, key_size);
-
-        int32_t value_offset = entry.varcharOffset;
-        int32_t value_size;
-        memcpy(&value_size, (char*)pageData + value_offset, VARCHAR_LENGTH_SIZE);
-        char value_text[value_size + 1];
-        value_text[value_size] = '\0';
-        memcpy(value_text, (char*)pageData + value_offset + VARCHAR_LENGTH_SIZE, value_size);
-
-        return compare(key_text, value_text);
+        return compare(key, pageData, entry.varcharOffset);
     }
     return 0;
 }
@@ -1200,24 +2563,27 @@ int IndexManager::compareLeafSlot(const Attribute attr, const void *key, const v
     }
     else
     {
-        int32_t key_size;
-        memcpy(&key_size, key, VARCHAR_LENGTH_SIZE);
-        char key_text[key_size + 1];
-        key_text[key_size] = '\0';
-        memcpy(key_text, (char*) key + VARCHAR_LENGTH_SIZE, key_size);
-
-        int32_t value_offset = entry.varcharOffset;
-        int32_t value_size;
-        memcpy(&value_size, (char*)pageData + value_offset, VARCHAR_LENGTH_SIZE);
-        char value_text[value_size + 1];
-        value_text[value_size] = '\0';
-        memcpy(value_text, (char*)pageData + value_offset + VARCHAR_LENGTH_SIZE, value_size);
-
-        return compare(key_text, value_text);
+        return compareLeafKey(key, pageData, entry.varcharOffset);
     }
     return 0; // suppress warnings
 }
 
+int IndexManager::compareSlot(const Attribute attr, const void *key, const RID &rid, const void *pageData, const int slotNum) const
+{
+    int cmp = compareSlot(attr, key, pageData, slotNum);
+    if (cmp != 0)
+        return cmp;
+    return compare(rid, getIndexEntry(slotNum, pageData).rid);
+}
+
+int IndexManager::compareLeafSlot(const Attribute attr, const void *key, const RID &rid, const void *pageData, const int slotNum) const
+{
+    int cmp = compareLeafSlot(attr, key, pageData, slotNum);
+    if (cmp != 0)
+        return cmp;
+    return compare(rid, getFirstRid(slotNum, pageData));
+}
+
 int IndexManager::compare(const int key, const int value) const
 {
     if (key == value)
@@ -1245,23 +2611,122 @@ int IndexManager::compare(const char *key, const char *value) const
     return strcmp(key, value);
 }
 
-// Get size needed to insert key into page
-int IndexManager::getKeyLengthInternal(const Attribute attr, const void *key) const
+int IndexManager::compare(const RID &rid, const RID &value) const
 {
-    int size = sizeof(IndexEntry);
-    if (attr.type == TypeVarChar)
+    if (rid.pageNum != value.pageNum)
+        return rid.pageNum < value.pageNum ? -1 : 1;
+    if (rid.slotNum != value.slotNum)
+        return rid.slotNum < value.slotNum ? -1 : 1;
+    return 0;
+}
+
+// Same order as strcmp on the null terminated strings
+int IndexManager::compare(const void *key, const void *pageData, const int32_t valueOffset) const
+{
+    int32_t key_size;
+    int32_t value_size;
+    memcpy(&key_size, key, VARCHAR_LENGTH_SIZE);
+    memcpy(&value_size, (const char*)pageData + valueOffset, VARCHAR_LENGTH_SIZE);
+
+    int cmp = memcmp((const char*) key + VARCHAR_LENGTH_SIZE, (const char*)pageData + valueOffset + VARCHAR_LENGTH_SIZE,
+            min(key_size, value_size));
+    if (cmp != 0)
+        return cmp;
+    return compare(key_size, value_size);
+}
+
+int IndexManager::compareLeafKey(const void *key, const void *pageData, const int32_t valueOffset) const
+{
+    int32_t prefixLength = getLeafHeader(pageData).prefixLength;
+    int32_t key_size;
+    memcpy(&key_size, key, VARCHAR_LENGTH_SIZE);
+    const char *chars = (const char*) key + VARCHAR_LENGTH_SIZE;
+
+    // Against the prefix first, a key shorter than the prefix is smaller than every key of the leaf
+    int cmp = memcmp(chars, (const char*)pageData + PAGE_SIZE - prefixLength, min(key_size, prefixLength));
+    if (cmp != 0)
+        return cmp;
+    if (key_size < prefixLength)
+        return -1;
+
+    int32_t value_size;
+    memcpy(&value_size, (const char*)pageData + valueOffset, VARCHAR_LENGTH_SIZE);
+    cmp = memcmp(chars + prefixLength, (const char*)pageData + valueOffset + VARCHAR_LENGTH_SIZE,
+            min(key_size - prefixLength, value_size));
+    if (cmp != 0)
+        return cmp;
+    return compare(key_size - prefixLength, value_size);
+}
+
+int IndexManager::searchSlot(const Attribute attr, const void *key, const void *pageData, const bool strict) const
+{
+    // Entries are sorted, so key <= slot (or key < slot) holds for a suffix of them
+    int low = 0;
+    int high = getInternalHeader(pageData).entriesNumber;
+    while (low < high)
     {
-        int32_t key_len;
-        memcpy(&key_len, key, VARCHAR_LENGTH_SIZE);
-        size += VARCHAR_LENGTH_SIZE;
-        size += key_len;
+        int mid = low + (high - low) / 2;
+        int cmp = compareSlot(attr, key, pageData, mid);
+        if (cmp < 0 || (cmp == 0 && !strict))
+            high = mid;
+        else
+            low = mid + 1;
     }
-    return size;
+    return low;
+}
+
+int IndexManager::searchLeafSlot(const Attribute attr, const void *key, const void *pageData, const bool strict) const
+{
+    int low = 0;
+    int high = getLeafHeader(pageData).entriesNumber;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        int cmp = compareLeafSlot(attr, key, pageData, mid);
+        if (cmp < 0 || (cmp == 0 && !strict))
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+int IndexManager::searchSlot(const Attribute attr, const void *key, const RID &rid, const void *pageData, const bool strict) const
+{
+    int low = 0;
+    int high = getInternalHeader(pageData).entriesNumber;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        int cmp = compareSlot(attr, key, rid, pageData, mid);
+        if (cmp < 0 || (cmp == 0 && !strict))
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
 }
 
-int IndexManager::getKeyLengthLeaf(const Attribute attr, const void *key) const
+int IndexManager::searchLeafSlot(const Attribute attr, const void *key, const RID &rid, const void *pageData, const bool strict) const
+{
+    int low = 0;
+    int high = getLeafHeader(pageData).entriesNumber;
+    while (low < high)
+    {
+        int mid = low + (high - low) / 2;
+        int cmp = compareLeafSlot(attr, key, rid, pageData, mid);
+        if (cmp < 0 || (cmp == 0 && !strict))
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+// Get size needed to insert key into page
+int IndexManager::getKeyLengthInternal(const Attribute attr, const void *key) const
 {
-    int size = sizeof(DataEntry);
+    int size = sizeof(IndexEntry);
     if (attr.type == TypeVarChar)
     {
         int32_t key_len;
@@ -1286,83 +2751,77 @@ int IndexManager::getFreeSpaceLeaf(void *pageData) const
 
 RC IndexManager::deleteEntryFromLeaf(const Attribute attr, const void *key, const RID &rid, void *pageData) 
 {
-    LeafHeader header = getLeafHeader(pageData);
-    int i;
-    for (i = 0; i < header.entriesNumber; i++) 
-    {
-        // Find a slot whose key and rid are equal to the given key and rid
-        if(compareLeafSlot(attr, key, pageData, i) == 0)
-        {
-            DataEntry entry = getDataEntry(i, pageData);
-            if (entry.rid.pageNum == rid.pageNum && entry.rid.slotNum == rid.slotNum)
-            {
-                break;
-            }
-        }
-    }
+    // Find the slot of key whose list covers rid, error out if there is none or rid is not in it
+    int slotNum = searchLeafSlot(attr, key, rid, pageData, true) - 1;
+    if (slotNum < 0 || compareLeafSlot(attr, key, pageData, slotNum) != 0)
+        return IX_RECORD_DN_EXIST;
+    vector<RID> rids;
+    getPosting(slotNum, pageData, rids);
+    vector<RID>::iterator it = lower_bound(rids.begin(), rids.end(), rid, ridLess);
+    if (it == rids.end() || compare(*it, rid) != 0)
+        return IX_RECORD_DN_EXIST;
 
-    // If we failed to find one, error out
-    if (i == header.entriesNumber)
+    rids.erase(it);
+    if (rids.empty())
     {
-        return IX_RECORD_DN_EXIST;
+        deleteLeafSlot(attr, slotNum, pageData);
+        return SUCCESS;
     }
+    // A shorter list never takes more bytes
+    char posting[IX_POSTING_MAX_BYTES];
+    return setPosting(attr, slotNum, posting, encodePosting(rids.data(), rids.size(), posting), pageData);
+}
 
-    DataEntry entry = getDataEntry(i, pageData);
+void IndexManager::deleteLeafSlot(const Attribute attr, const int slotNum, void *pageData)
+{
+    LeafHeader header = getLeafHeader(pageData);
+    DataEntry entry = getDataEntry(slotNum, pageData);
     // Get position where deleted entry starts
     // Then get position where entries end. Move all entries to the left, overwriting the entry being deleted.
-    unsigned slotStartOffset = getOffsetOfLeafSlot(i);
+    unsigned slotStartOffset = getOffsetOfLeafSlot(slotNum);
     unsigned slotEndOffset = getOffsetOfLeafSlot(header.entriesNumber);
     memmove((char*)pageData + slotStartOffset, (char*)pageData + slotStartOffset + sizeof(DataEntry), slotEndOffset - slotStartOffset - sizeof(DataEntry));
 
     header.entriesNumber -= 1;
+    setLeafHeader(header, pageData);
 
-    // Now, if we're a varchar, we need to move all of the varchars over as well
+    // The posting list is always allocated after the varchar, below it, so releasing it first leaves the varchar in place
+    freeLeafSpace(attr, entry.postingOffset, entry.postingLength, pageData);
     if (attr.type == TypeVarChar)
     {
-        int32_t varcharOffset = entry.varcharOffset;
         int32_t varchar_len;
-        memcpy(&varchar_len, (char*)pageData + varcharOffset, VARCHAR_LENGTH_SIZE);
-        int32_t entryLen = varchar_len + VARCHAR_LENGTH_SIZE;
-
-        // Take everything from the start of the free space to the start of the varchar being deleted, and move it over the deleted varchar
-        memmove((char*)pageData + header.freeSpaceOffset + entryLen, (char*)pageData + header.freeSpaceOffset, varcharOffset - header.freeSpaceOffset);
-        header.freeSpaceOffset += entryLen;
-        // Update all of the slots that are moved over
-        for (i = 0; i < header.entriesNumber; i++)
-        {
-            entry = getDataEntry(i, pageData);
-            if (entry.varcharOffset < varcharOffset)
-                entry.varcharOffset += entryLen;
-            setDataEntry(entry, i, pageData);
-        }
+        memcpy(&varchar_len, (char*)pageData + entry.varcharOffset, VARCHAR_LENGTH_SIZE);
+        freeLeafSpace(attr, entry.varcharOffset, varchar_len + VARCHAR_LENGTH_SIZE, pageData);
     }
-    setLeafHeader(header, pageData);
-    return SUCCESS;
 }
 
-RC IndexManager::deleteEntryFromInternal(const Attribute attr, const void *key, void *pageData) 
+void IndexManager::freeLeafSpace(const Attribute &attr, const int32_t offset, const int32_t length, void *pageData)
 {
-    InternalHeader header = getInternalHeader(pageData);
+    LeafHeader header = getLeafHeader(pageData);
+    // Take everything from the start of the free space to offset, and move it over the bytes released
+    memmove((char*)pageData + header.freeSpaceOffset + length, (char*)pageData + header.freeSpaceOffset, offset - header.freeSpaceOffset);
+    header.freeSpaceOffset += length;
+    setLeafHeader(header, pageData);
 
-    int i;
-    for (i = 0; i < header.entriesNumber; i++)
-    {
-        // Scan through until we find a matching key
-        if(compareSlot(attr, key, pageData, i) == 0)
-        {
-            break;
-        }
-    }
-    if (i == header.entriesNumber)
+    // Update all of the slots whose varchar or posting list moved
+    for (int i = 0; i < header.entriesNumber; i++)
     {
-        // error out if no match
-        return IX_RECORD_DN_EXIST;
+        DataEntry entry = getDataEntry(i, pageData);
+        if (entry.postingOffset < offset)
+            entry.postingOffset += length;
+        if (attr.type == TypeVarChar && entry.varcharOffset < offset)
+            entry.varcharOffset += length;
+        setDataEntry(entry, i, pageData);
     }
+}
 
-    IndexEntry entry = getIndexEntry(i, pageData);
+void IndexManager::deleteInternalSlot(const Attribute attr, const int slotNum, void *pageData)
+{
+    InternalHeader header = getInternalHeader(pageData);
+    IndexEntry entry = getIndexEntry(slotNum, pageData);
 
     // Get positions where deleted entry starts and end
-    unsigned slotStartOffset = getOffsetOfInternalSlot(i);
+    unsigned slotStartOffset = getOffsetOfInternalSlot(slotNum);
     unsigned slotEndOffset = getOffsetOfInternalSlot(header.entriesNumber);
 
     // Move entries over, overwriting the slot being deleted
@@ -1382,7 +2841,7 @@ RC IndexManager::deleteEntryFromInternal(const Attribute attr, const void *key,
         memmove((char*)pageData + header.freeSpaceOffset + entryLen, (char*)pageData + header.freeSpaceOffset, varcharOffset - header.freeSpaceOffset);
         header.freeSpaceOffset += entryLen;
         // Update all of the slots that are moved over
-        for (i = 0; i < header.entriesNumber; i++)
+        for (int i = 0; i < header.entriesNumber; i++)
         {
             entry = getIndexEntry(i, pageData);
             if (entry.varcharOffset < varcharOffset)
@@ -1391,5 +2850,4 @@ RC IndexManager::deleteEntryFromInternal(const Attribute attr, const void *key,
         }
     }
     setInternalHeader(header, pageData);
-    return SUCCESS;
 }
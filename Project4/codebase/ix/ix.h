@@ -3,12 +3,15 @@
 
 #include <vector>
 #include <string>
+#include <functional>
+#include <unordered_map>
 
 #include "../rbf/rbfm.h"
 #include "../rbf/pfm.h"
 
 #define IX_TYPE_LEAF     0
 #define IX_TYPE_INTERNAL 1
+#define IX_TYPE_FREE     2
 
 # define IX_EOF (-1)  // end of the index scan
 #define IX_CREATE_FAILED          1
@@ -24,24 +27,53 @@
 #define IX_INSERT_INTERNAL_FAILED 11
 #define IX_WRITE_FAILED           12
 #define IX_NO_FREE_SPACE          13
+#define IX_NOT_EMPTY              14
+#define IX_BAD_FILL_FACTOR        15
+#define IX_BAD_BUFFER_SIZE        16
+#define IX_RENAME_FAILED          17
+
+// Bulk loading sorts in memory up to this many pages of entries before spilling a run,
+// and merges at most IX_BULK_LOAD_MERGE_FANIN runs at once
+#define IX_BULK_LOAD_BUFFER_PAGES 256
+#define IX_BULK_LOAD_MERGE_FANIN  64
+#define IX_DEFAULT_FILL_FACTOR    0.9
+// A node left less full than this by a delete borrows from or merges with a sibling
+#define IX_MIN_FILL_FACTOR        0.35
+// rebuild writes the new tree next to the index, in a file named after it with this suffix
+#define IX_REBUILD_SUFFIX         ".rebuild"
+// A posting list that grows past this many bytes is split in two slots of its key
+#define IX_POSTING_MAX_BYTES      (PAGE_SIZE / 8)
+// Most bytes a rid takes in a posting list
+#define IX_MAX_RID_BYTES          10
+// IXFileHandle keeps the internal nodes of this many levels below the root in memory, up to IX_CACHED_NODES of them
+#define IX_CACHED_LEVELS          3
+#define IX_CACHED_NODES           1024
+// A split may move off the middle of a node by this fraction of its used space, to push up a shorter key
+#define IX_SPLIT_SLACK            0.2
 
 
 // Headers and data types
 
-// First byte of each Node gives the type of the node. 0 for leaf, non-zero for internal
+// First byte of each Node gives the type of the node. 0 for leaf, 1 for internal, 2 for a free page
 typedef char NodeType;
 
 // Leaf nodes contain pointers to prev and next nodes in linked list of leafs
 // Also contain number of keys within and pointer to free space
 // 0 is always meta node, so a 0 value for next/prev is like NULL
+// VarChar leaves store the prefix all of their keys share once, in the last prefixLength bytes
+// of the page, and only the rest of each key in its slot
 typedef struct LeafHeader
 {
 	uint32_t next;
 	uint32_t prev;
 	uint16_t entriesNumber;
 	uint16_t freeSpaceOffset;
+	uint16_t prefixLength;
 } LeafHeader;
 
+// Each slot of a leaf holds a key and the posting list of its entries: their rids, sorted and
+// delta-encoded (see encodePosting). A key with more rids than fit in IX_POSTING_MAX_BYTES has
+// several slots, ordered by their first rid, which may spread over several leaves.
 typedef struct DataEntry
 {
 	union
@@ -50,10 +82,13 @@ typedef struct DataEntry
 		float real;
 		int32_t varcharOffset;
 	};
-	RID rid;
+	uint16_t postingOffset;
+	uint16_t postingLength;
 } DataEntry;
 
 // each entry has offset to key and link to child
+// The rid of the entry the key came from breaks ties between equal keys, so every
+// <key, rid> in the leaves has exactly one path down from the root
 typedef struct IndexEntry
 {
 	union
@@ -62,6 +97,7 @@ typedef struct IndexEntry
         float real;
         int32_t varcharOffset;
     };
+	RID rid;
 	uint32_t childPage;
 } IndexEntry;
 
@@ -77,18 +113,38 @@ typedef struct InternalHeader
 typedef struct ChildEntry
 {
     void *key;
+    RID rid;
     uint32_t childPage;
 } ChildEntry;
 
 // Header for metadata page, page 0
-// Contains pointer to root node so that root node can be moved when split
+// Contains pointer to root node so that root node can be moved when split,
+// and the first page of the list of pages freed by merges, 0 if there is none
 typedef struct MetaHeader
 {
 	uint32_t rootPage;
+	uint32_t freePage;
 } MetaHeader;
 
+// Free pages hold the next page of the free list after their node type
+typedef struct FreePageHeader
+{
+	uint32_t next;
+} FreePageHeader;
+
 class IX_ScanIterator;
 class IXFileHandle;
+struct BulkLoadRun;
+
+// A source of <key, rid> pairs for IndexManager::bulkLoad, in any order.
+// getNextEntry returns IX_EOF once every pair has been returned.
+// Streams that return the pairs ordered by key, then rid, say so with isSorted and are not sorted again.
+class IX_EntryStream {
+    public:
+        virtual ~IX_EntryStream() {};
+        virtual RC getNextEntry(void *key, RID &rid) = 0;
+        virtual bool isSorted() const { return false; };
+};
 
 class IndexManager {
 
@@ -122,6 +178,23 @@ class IndexManager {
                 bool highKeyInclusive,
                 IX_ScanIterator &ix_ScanIterator);
 
+        // Build an empty index from a stream of <key, rid> pairs. The pairs are sorted, externally if
+        // they do not fit in memory, and written bottom up as leaves and internal levels filled to fillFactor.
+        RC bulkLoad(IXFileHandle &ixfileHandle, const Attribute &attribute, IX_EntryStream &entries,
+                const double fillFactor = IX_DEFAULT_FILL_FACTOR);
+
+        // Number of pages of entries bulkLoad sorts in memory at once
+        RC setBulkLoadBufferSize(unsigned numPages);
+
+        // Rewrite the index into a new file with its leaves laid out in key order and nodes filled to fillFactor,
+        // then replace the index file with it. ixfileHandle is reopened on the new file, and must be the only
+        // handle open on the index.
+        RC rebuild(IXFileHandle &ixfileHandle, const Attribute &attribute, const double fillFactor = IX_DEFAULT_FILL_FACTOR);
+
+        // Walk the leaves in key order, counting them and the hops to a next leaf that is not the following
+        // page of the file. Every such hop is a seek for a scan, rebuild brings the count back to 0.
+        RC getFragmentation(IXFileHandle &ixfileHandle, unsigned &leafCount, unsigned &jumpCount);
+
         // Print the B+ tree in pre-order (in a JSON record format)
         void printBtree(IXFileHandle &ixfileHandle, const Attribute &attribute) const;
         friend class IX_ScanIterator;
@@ -132,13 +205,56 @@ class IndexManager {
 
     private:
         static IndexManager *_index_manager;
+        unsigned _bulk_load_buffer_pages;
+
+        // Helpers for bulkLoad. Entries are sorted and spilled as <rid, key>.
+        int compareKeys(const Attribute &attr, const void *key, const void *value) const;
+        int compareBulkEntries(const Attribute &attr, const char *entry, const char *other) const;
+        RC spillBulkLoadRun(const Attribute &attr, vector<char> &buffer, vector<unsigned> &offsets, vector<BulkLoadRun*> &runs);
+        RC mergeBulkLoadRuns(const Attribute &attr, vector<BulkLoadRun*> &runs, function<RC(const char*)> sink);
+        // Packs the sorted rids of a key into leaves starting at page 2, returning the leaves and the <rid, key> separating them
+        RC bulkLoadLeaf(IXFileHandle &ixfileHandle, const Attribute &attr, const double fillFactor, const void *key,
+                const vector<RID> &rids, void *leaf, vector<PageNum> &children, vector<string> &keys);
+        RC bulkLoadInternal(IXFileHandle &ixfileHandle, const Attribute &attr, const double fillFactor,
+                vector<PageNum> &children, vector<string> &keys);
 
         // Utility function for insertEntry
         RC insert(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, ChildEntry &childEntry);
         // Inserts ChildEntry <key, pageNum> into internal node. Returns an error if there's not enough space
         RC insertIntoInternal(const Attribute attribute, ChildEntry entry, void *pageData);
-        // Inserts <key, rid> into the given leaf node. Returns an error if there's not enough free space
+        RC insertIntoInternal(const Attribute attribute, ChildEntry entry, const int slotNum, void *pageData);
+        // Inserts <key, rid> into the given leaf node, adding rid to a posting list of key if it has one.
+        // Returns an error if there's not enough free space
         RC insertIntoLeaf(const Attribute attribute, const void *key, const RID &rid, void *pageData);
+        // Inserts a slot with key and an encoded posting list at slotNum, shortening the prefix of the leaf if key
+        // does not start with it. Returns an error if there's not enough free space
+        RC insertLeafSlot(const Attribute &attr, const void *key, const void *posting, const uint16_t postingLength,
+                const int slotNum, void *pageData);
+        // Replaces the posting list of a slot. Returns an error if there's not enough free space
+        RC setPosting(const Attribute &attr, const int slotNum, const void *posting, const uint16_t postingLength, void *pageData);
+        // Moves a slot with its key and posting list to slot toSlot of another leaf
+        RC moveLeafSlot(const Attribute &attr, const int slotNum, void *from, const int toSlot, void *to);
+        // Space a slot takes in its leaf, key and posting list included
+        int getLeafSlotLength(const Attribute &attr, const int slotNum, const void *pageData) const;
+        // Space the leaf loses by taking a slot of key with a posting list of postingLength bytes
+        int getLeafInsertLength(const Attribute &attr, const void *key, const int postingLength, const void *pageData) const;
+        // Length of the start of the leaf prefix that key shares
+        int getSharedPrefixLength(const void *key, const void *pageData) const;
+        // Rewrites a leaf around the first prefixLength bytes of key as its prefix, every key of the leaf must start with them
+        void setLeafPrefix(const Attribute &attr, const void *key, const int prefixLength, void *pageData);
+        // Makes the prefix of a leaf the longest one its keys share
+        void compressLeaf(const Attribute &attr, void *pageData);
+        // Writes the shortest key above left and below right to separator, or left itself when there is none
+        // or the keys are not varchars. Returns its length.
+        int getSeparator(const Attribute &attr, const void *left, const void *right, void *separator) const;
+        // Length of the separator getSeparator gives between two slots of a leaf
+        int getSeparatorLength(const Attribute &attr, const int slotNum, const void *pageData) const;
+        // Releases bytes of the variable length part of a leaf, moving what was allocated after them
+        void freeLeafSpace(const Attribute &attr, const int32_t offset, const int32_t length, void *pageData);
+        // Decodes the posting list of a slot
+        void getPosting(const int slotNum, const void *pageData, vector<RID> &rids) const;
+        RID getFirstRid(const int slotNum, const void *pageData) const;
+        RID getLastRid(const int slotNum, const void *pageData) const;
 
         // Gets offset to a leaf slot with the given slot number
         int getOffsetOfLeafSlot(int slotNum) const;
@@ -150,7 +266,27 @@ class IndexManager {
         // Handles splitting an internal node, including the case where the root needs to be split
         RC splitInternal(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, void *original, ChildEntry &childEntry);
 
-        int findEntryPage(IXFileHandle &ixfileHandle, const Attribute &attr, const void *key, const RID &rid, void *pageData);
+        // Utility function for deleteEntry. Sets underflow if the node was changed and is left less than IX_MIN_FILL_FACTOR full.
+        RC erase(const Attribute &attribute, const void *key, const RID &rid, IXFileHandle &fileHandle, int32_t pageID, bool &underflow);
+        // Fixes an underflowing child of the internal node in pageData by borrowing from or merging with a sibling.
+        // Sets changed if pageData was changed and written.
+        RC rebalance(IXFileHandle &fileHandle, const Attribute &attribute, const int32_t pageID, void *pageData, const int childNum, bool &changed);
+        // Each of these returns whether it moved anything. Merges move everything from right into left.
+        bool mergeLeaves(const Attribute &attribute, void *left, void *right);
+        bool redistributeLeaves(const Attribute &attribute, void *parent, const int slotNum, void *left, void *right);
+        bool mergeInternals(const Attribute &attribute, void *parent, const int slotNum, void *left, void *right);
+        bool redistributeInternals(const Attribute &attribute, void *parent, const int slotNum, void *left, void *right);
+        // Replaces the key of an internal slot, keeping its child. Returns an error if there's not enough space
+        RC replaceInternalKey(const Attribute &attribute, const int slotNum, const void *key, const RID &rid, void *pageData);
+        // Makes the child of an empty root the root, as long as it is an internal node
+        RC collapseRoot(IXFileHandle &fileHandle, int32_t rootPage);
+        bool isUnderflow(void *pageData) const;
+
+        // Writes a new node to a page taken off the free list, or to a new page at the end of the file
+        RC writeNewPage(IXFileHandle &fileHandle, const void *pageData, PageNum &pageNum);
+        // Puts a page no longer part of the tree on the free list
+        RC freePage(IXFileHandle &fileHandle, const PageNum pageNum);
+        RC setLeafPrev(IXFileHandle &fileHandle, const PageNum pageNum, const PageNum prev);
 
         // Helper functions for printBtree
         void printBtree_rec(IXFileHandle &ixfileHandle, string prefix, const int32_t currPage, const Attribute &attr) const;
@@ -171,29 +307,53 @@ class IndexManager {
         IndexEntry getIndexEntry(const int slotNum, const void *pageData) const;
         void setDataEntry(const DataEntry entry, const int slotNum, void *pageData);
         DataEntry getDataEntry(const int slotNum, const void *pageData) const;
+        void setFreePageHeader(const FreePageHeader header, void *pageData);
+        FreePageHeader getFreePageHeader(const void *pageData) const;
+        // Copies the key at slotNum out of a node, varchars with their length
+        void getInternalKey(const Attribute attr, const int slotNum, const void *pageData, void *key) const;
+        void getLeafKey(const Attribute attr, const int slotNum, const void *pageData, void *key) const;
+        // Child 0 is the left child, child i is the child of slot i - 1
+        int32_t getChildPage(const int childNum, const void *pageData) const;
 
         RC getRootPageNum(IXFileHandle &fileHandle, int32_t &result) const;
+        RC setRootPageNum(IXFileHandle &fileHandle, const int32_t rootPage);
 
-        // Finds the leaf page that would contain key
-        RC find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum);
+        // Finds the leaf page that would contain key, the first one that may when there is no rid
+        RC find(IXFileHandle &handle, const Attribute attr, const void *key, int32_t &resultPageNum, const RID *rid = NULL);
         // Finds the leaf page that would contain key, starting at currPageNum. Utility function for find.
-        RC treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t currPageNum, int32_t &resultPageNum);
+        RC treeSearch(IXFileHandle &handle, const Attribute attr, const void *key, const int32_t currPageNum, int32_t &resultPageNum,
+                const RID *rid = NULL);
         // Given an attribute, key, and internal node, returns the pagenumber of the childPage who would contain key
-        int32_t getNextChildPage(const Attribute attr, const void *key, void *pageData);
+        int32_t getNextChildPage(const Attribute attr, const void *key, const void *pageData, const RID *rid = NULL);
+        RC readNode(IXFileHandle &handle, const PageNum pageNum, const int level, void *buffer, const void *&node);
+        RC fetchNode(IXFileHandle &handle, const PageNum pageNum, void *pageData);
 
         // Compares key to the value in pageDat at slotNum. For internal nodes.
         int compareSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const;
         // Compares key to the value in pageData at slotNum. For leaf nodes.
         int compareLeafSlot(const Attribute attr, const void *key, const void *pageData, const int slotNum) const;
+        // Same, ties between equal keys broken by rid. Leaf slots compare by their first rid.
+        int compareSlot(const Attribute attr, const void *key, const RID &rid, const void *pageData, const int slotNum) const;
+        int compareLeafSlot(const Attribute attr, const void *key, const RID &rid, const void *pageData, const int slotNum) const;
+        // Binary search for the first slot whose key is >= key, or > key when strict.
+        // Returns entriesNumber if every slot is smaller.
+        int searchSlot(const Attribute attr, const void *key, const void *pageData, const bool strict) const;
+        int searchLeafSlot(const Attribute attr, const void *key, const void *pageData, const bool strict) const;
+        // Same for <key, rid>
+        int searchSlot(const Attribute attr, const void *key, const RID &rid, const void *pageData, const bool strict) const;
+        int searchLeafSlot(const Attribute attr, const void *key, const RID &rid, const void *pageData, const bool strict) const;
         // Returns -1, 0, or 1 if key is less than, equal to, or greater than value
         int compare(const int key, const int value) const;
         int compare(const float key, const float value) const;
         int compare(const char *key, const char *value) const;
+        int compare(const RID &rid, const RID &value) const;
+        // Compares two varchars given by their length and characters, without copying them
+        int compare(const void *key, const void *pageData, const int32_t valueOffset) const;
+        // Same for a varchar of a leaf, which goes after the prefix of the leaf
+        int compareLeafKey(const void *key, const void *pageData, const int32_t valueOffset) const;
 
         // Returns the amount of space requried to store this key in an internal node
         int getKeyLengthInternal(const Attribute attr, const void *key) const;
-        // Returns the amount of space required to store this key in a leaf
-        int getKeyLengthLeaf(const Attribute attr, const void *key) const;
         // Returns the amount of free space in the internal node
         int getFreeSpaceInternal(void *pageData) const;
         // Returns the amount of free space in the leaf
@@ -201,8 +361,9 @@ class IndexManager {
 
         // Deletes an entry with key key and rid rid from leaf given by pageData
         RC deleteEntryFromLeaf(const Attribute attr, const void *key, const RID &rid, void *pageData);
-        // Deletes key key from the Internal node given by pageData
-        RC deleteEntryFromInternal(const Attribute attr, const void *key, void *pageData);
+        // Deletes the slot slotNum and its key from the node given by pageData
+        void deleteLeafSlot(const Attribute attr, const int slotNum, void *pageData);
+        void deleteInternalSlot(const Attribute attr, const int slotNum, void *pageData);
 };
 
 class IXFileHandle {
@@ -220,18 +381,44 @@ class IXFileHandle {
     // Destructor
     ~IXFileHandle();
 
+    // Owns the cached nodes
+    IXFileHandle(const IXFileHandle&) = delete;
+    IXFileHandle &operator=(const IXFileHandle&) = delete;
+
 	// Put the current counter values of associated PF FileHandles into variables
 	RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount);
+	// Buffer pool hits and misses of the underlying FileHandle
+	RC collectBufferCounterValues(unsigned &hitCount, unsigned &missCount);
     unsigned getNumberOfPages();
 
 	// Added these
 	RC readPage(PageNum pageNum, void *data);
     RC writePage(PageNum pageNum, const void *data);
     RC appendPage(const void *data);
+    // Read-only access to a page without copying it, counted as a read
+    const void *pinPage(PageNum pageNum);
+    RC unpinPage(PageNum pageNum);
 
     friend class IndexManager;
 	private:
         FileHandle fh;
+        // Name the index was opened with, so rebuild can replace it
+        string fileName;
+
+        // Root page number and copies of the upper internal nodes, so lookups only read their leaf.
+        // Writing an internal node or the meta page through any handle bumps the version of the tree,
+        // and a handle whose cache is older than that drops it.
+        int32_t rootPage;                       // -1 until read
+        int height;                             // Levels of internal nodes above the leaves, -1 until known
+        unordered_map<PageNum, void*> nodes;
+        unsigned cacheFileId;
+        unsigned cacheVersion;
+        static unordered_map<unsigned, unsigned> treeVersions;
+
+        void syncCache();
+        void clearCache();
+        const void *getCachedNode(PageNum pageNum);
+        void cacheNode(PageNum pageNum, const void *data);
 
 	};
 
@@ -260,10 +447,25 @@ class IX_ScanIterator {
         bool highKeyInclusive;
 
 
-        void *page;
+        // Current leaf, pinned rather than copied, and the next slot to read from it
+        const void *page;
+        PageNum pageNum;
         int slotNum;
+        // Entries on the leaf and the last entry returned, to find our place again
+        // if the leaf changes under us
+        uint16_t entriesSeen;
+        string lastKey;
+        RID lastRid;
+        bool hasLast;
+        // Posting list of the slot we are returning, whose key is lastKey
+        vector<RID> rids;
+        size_t ridIndex;
 
         RC initialize(IXFileHandle &, Attribute, const void*, const void*, bool, bool);
+        // Moves to the slot holding the first entry after the last one returned, or to the start of the range
+        RC resume();
+        // Decodes the next slot of the range with entries that were not returned yet
+        RC nextSlot();
 };
 
 #endif
@@ -6,9 +6,126 @@
 const int fail = -1;
 #endif
 
+#include <vector>
+
 #include "ix.h"
 #include "../rbf/test_util.h"
 
+// Prepares the key and rid of the i-th entry of a test index
+typedef void (*EntryGenerator)(const Attribute &attr, int i, void *key, RID &rid);
+
+// Entry i of a test index has rid <i / 100, i % 100>, like the records of a table
+void prepareRid(int i, RID &rid)
+{
+    rid.pageNum = i / 100;
+    rid.slotNum = i % 100;
+}
+
+int entryOf(const RID &rid)
+{
+    return rid.pageNum * 100 + rid.slotNum;
+}
+
+// i-th entry of a scrambled order over count entries
+int scrambled(int i, int count)
+{
+    return (int) (((long long) i * 7919) % count);
+}
+
+int keyLength(const Attribute &attr, const void *key)
+{
+    if (attr.type != TypeVarChar)
+        return sizeof(int);
+    int len;
+    memcpy(&len, key, sizeof(int));
+    return sizeof(int) + len;
+}
+
+// Order of the index on keys
+int compareKeys(const Attribute &attr, const void *key, const void *other)
+{
+    if (attr.type == TypeInt)
+    {
+        int a, b;
+        memcpy(&a, key, sizeof(int));
+        memcpy(&b, other, sizeof(int));
+        return a < b ? -1 : a > b;
+    }
+    if (attr.type == TypeReal)
+    {
+        float a, b;
+        memcpy(&a, key, sizeof(float));
+        memcpy(&b, other, sizeof(float));
+        return a < b ? -1 : a > b;
+    }
+    int len = keyLength(attr, key) - sizeof(int);
+    int otherLen = keyLength(attr, other) - sizeof(int);
+    int cmp = memcmp((char *) key + sizeof(int), (char *) other + sizeof(int), min(len, otherLen));
+    if (cmp == 0)
+        cmp = len < otherLen ? -1 : len > otherLen;
+    return cmp;
+}
+
+// Order of the index on entries: by key, then by rid
+int compareEntries(const Attribute &attr, const void *key, const RID &rid, const void *other, const RID &otherRid)
+{
+    int cmp = compareKeys(attr, key, other);
+    if (cmp != 0)
+        return cmp;
+    return entryOf(rid) < entryOf(otherRid) ? -1 : entryOf(rid) > entryOf(otherRid);
+}
+
+// Whether a key is between low and high, NULL for no bound
+bool inRange(const Attribute &attr, const void *key, const void *low, const void *high, bool lowInclusive, bool highInclusive)
+{
+    int lowCmp = low == NULL ? 1 : compareKeys(attr, key, low);
+    int highCmp = high == NULL ? -1 : compareKeys(attr, key, high);
+    return (lowCmp > 0 || (lowCmp == 0 && lowInclusive)) && (highCmp < 0 || (highCmp == 0 && highInclusive));
+}
+
+// Scans the keys between low and high, NULL for no bound. Checks the scan returns exactly the live entries
+// in range, by key then by rid, with the keys prepareEntry gives them. Returns the pages read.
+unsigned checkScan(IXFileHandle &ixfileHandle, const Attribute &attribute, EntryGenerator prepareEntry, const vector<bool> &live,
+        const void *low = NULL, const void *high = NULL, bool lowInclusive = true, bool highInclusive = true)
+{
+    unsigned readsBefore, reads, writes, appends;
+    ixfileHandle.collectCounterValues(readsBefore, writes, appends);
+
+    IX_ScanIterator ix_ScanIterator;
+    RC rc = IndexManager::instance()->scan(ixfileHandle, attribute, low, high, lowInclusive, highInclusive, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    char key[PAGE_SIZE], prevKey[PAGE_SIZE], expected[PAGE_SIZE];
+    RID rid, prevRid, expectedRid;
+    int count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success)
+    {
+        int e = entryOf(rid);
+        assert(e >= 0 && e < (int) live.size() && live[e] && "Deleted entries should be gone.");
+        prepareEntry(attribute, e, expected, expectedRid);
+        assert(memcmp(key, expected, keyLength(attribute, expected)) == 0 && "The key should belong to its rid.");
+        assert(inRange(attribute, key, low, high, lowInclusive, highInclusive) && "The scan should respect its bounds.");
+        assert((count == 0 || compareEntries(attribute, prevKey, prevRid, key, rid) < 0)
+                && "Entries should come back by key, then by rid.");
+        memcpy(prevKey, key, keyLength(attribute, key));
+        prevRid = rid;
+        count++;
+    }
+    ix_ScanIterator.close();
+
+    int expectedCount = 0;
+    for (unsigned i = 0; i < live.size(); i++)
+    {
+        if (!live[i])
+            continue;
+        prepareEntry(attribute, i, expected, expectedRid);
+        expectedCount += inRange(attribute, expected, low, high, lowInclusive, highInclusive);
+    }
+    assert(count == expectedCount && "Every live entry in range should be scanned.");
+
+    ixfileHandle.collectCounterValues(reads, writes, appends);
+    return reads - readsBefore;
+}
+
 #endif
 
 
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <sys/time.h>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+// Measures point lookups on a large int index and a large varchar index.
+// Every lookup is a scan with lowKey == highKey, both inclusive.
+
+IndexManager *indexManager;
+
+const int numKeys = 1000000;
+const int numLookups = 100000;
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// Varchar keys are the decimal key padded to a fixed width, so they sort like the ints
+static void prepareKey(const Attribute &attr, int i, void *key)
+{
+    if (attr.type == TypeInt)
+    {
+        memcpy(key, &i, sizeof(int));
+        return;
+    }
+    char text[32];
+    int len = snprintf(text, sizeof(text), "key-%012d", i);
+    memcpy(key, &len, sizeof(int));
+    memcpy((char *) key + sizeof(int), text, len);
+}
+
+static int benchmark(const string &indexFileName, const Attribute &attr)
+{
+    RC rc;
+    remove(indexFileName.c_str());
+    rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    IXFileHandle ixfileHandle;
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // Insert the keys in a random order
+    vector<int> keys(numKeys);
+    for (int i = 0; i < numKeys; i++)
+        keys[i] = i;
+    srand(1234);
+    random_shuffle(keys.begin(), keys.end());
+
+    char key[PAGE_SIZE];
+    RID rid;
+    double start = now();
+    for (int i = 0; i < numKeys; i++)
+    {
+        prepareKey(attr, keys[i], key);
+        rid.pageNum = keys[i];
+        rid.slotNum = keys[i] % PAGE_SIZE;
+        rc = indexManager->insertEntry(ixfileHandle, attr, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    double built = now();
+
+    unsigned readBefore, readAfter, writePageCount, appendPageCount;
+    ixfileHandle.collectCounterValues(readBefore, writePageCount, appendPageCount);
+
+    char returnedKey[PAGE_SIZE];
+    double lookupStart = now();
+    for (int i = 0; i < numLookups; i++)
+    {
+        int k = keys[(i * 7919) % numKeys];
+        prepareKey(attr, k, key);
+        IX_ScanIterator ix_ScanIterator;
+        rc = indexManager->scan(ixfileHandle, attr, key, key, true, true, ix_ScanIterator);
+        assert(rc == success && "indexManager::scan() should not fail.");
+        rc = ix_ScanIterator.getNextEntry(rid, returnedKey);
+        assert(rc == success && rid.pageNum == (unsigned) k && "The key should be found.");
+        assert(ix_ScanIterator.getNextEntry(rid, returnedKey) == IX_EOF && "The key should be unique.");
+        ix_ScanIterator.close();
+    }
+    double done = now();
+    ixfileHandle.collectCounterValues(readAfter, writePageCount, appendPageCount);
+
+    cout << (attr.type == TypeInt ? "int" : "varchar") << " index, " << numKeys << " keys, "
+         << ixfileHandle.getNumberOfPages() << " pages" << endl;
+    cout << "  build: " << built - start << " s" << endl;
+    cout << "  point lookup: " << (done - lookupStart) * 1000000 / numLookups << " us, "
+         << (double) (readAfter - readBefore) / numLookups << " page reads" << endl;
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    indexManager = IndexManager::instance();
+
+    Attribute attr;
+    attr.name = "key";
+    attr.type = TypeInt;
+    attr.length = 4;
+    benchmark("bench1_int_idx", attr);
+
+    attr.type = TypeVarChar;
+    attr.length = 20;
+    benchmark("bench1_varchar_idx", attr);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <dirent.h>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+// Returns keys 0 .. numKeys-1, each twice, in a scrambled order
+class TestEntryStream : public IX_EntryStream {
+    public:
+        TestEntryStream(const Attribute &attr, int numKeys) : attr(attr), numKeys(numKeys), next(0) {};
+        RC getNextEntry(void *key, RID &rid)
+        {
+            if (next == 2 * numKeys)
+                return IX_EOF;
+            int k = (int) (((long long) next * 7919) % numKeys);
+            rid.pageNum = k;
+            rid.slotNum = next < numKeys ? 2 : 1;
+            next++;
+            prepareKey(k, key);
+            return SUCCESS;
+        }
+        void prepareKey(int k, void *key)
+        {
+            if (attr.type == TypeInt)
+            {
+                memcpy(key, &k, sizeof(int));
+                return;
+            }
+            char text[32];
+            int len = sprintf(text, "%08d", k);
+            memcpy(key, &len, sizeof(int));
+            memcpy((char *) key + sizeof(int), text, len);
+        }
+    private:
+        Attribute attr;
+        int numKeys;
+        int next;
+};
+
+// Number of files left behind by the external sort
+static int countSortFiles()
+{
+    int count = 0;
+    DIR *dir = opendir(".");
+    struct dirent *file;
+    while ((file = readdir(dir)) != NULL)
+    {
+        if (strncmp(file->d_name, "ix_bulkload_", strlen("ix_bulkload_")) == 0)
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+static unsigned bulkLoad(const string &indexFileName, const Attribute &attribute, int numKeys, double fillFactor)
+{
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    IXFileHandle ixfileHandle;
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    TestEntryStream entries(attribute, numKeys);
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, entries, fillFactor);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+    assert(countSortFiles() == 0 && "Sorted runs should be removed.");
+    unsigned numPages = ixfileHandle.getNumberOfPages();
+
+    // The whole index comes back in order, duplicates ordered by rid
+    IX_ScanIterator ix_ScanIterator;
+    rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    char key[PAGE_SIZE], expected[PAGE_SIZE];
+    RID rid;
+    int count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success)
+    {
+        int k = count / 2;
+        entries.prepareKey(k, expected);
+        assert(memcmp(key, expected, attribute.type == TypeInt ? sizeof(int) : sizeof(int) + 8) == 0 && "Keys should come back in order.");
+        assert(rid.pageNum == (unsigned) k && rid.slotNum == (unsigned) (count % 2 + 1) && "Duplicates should come back by rid.");
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == 2 * numKeys && "Every entry should be in the index.");
+
+    // Point lookups go through the internal levels
+    for (int k = 0; k < numKeys; k += 997)
+    {
+        entries.prepareKey(k, key);
+        rc = indexManager->scan(ixfileHandle, attribute, key, key, true, true, ix_ScanIterator);
+        assert(rc == success && "indexManager::scan() should not fail.");
+        int found = 0;
+        while (ix_ScanIterator.getNextEntry(rid, expected) == success)
+        {
+            assert(rid.pageNum == (unsigned) k && "The lookup should return the key.");
+            found++;
+        }
+        ix_ScanIterator.close();
+        assert(found == 2 && "The lookup should return both entries.");
+    }
+
+    // Inserting into a packed tree splits as usual
+    for (int k = 0; k < numKeys; k += 13)
+    {
+        entries.prepareKey(k, key);
+        rid.pageNum = k;
+        rid.slotNum = 3;
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    count = 0;
+    while (ix_ScanIterator.getNextEntry(rid, key) == success)
+        count++;
+    ix_ScanIterator.close();
+    assert(count == 2 * numKeys + (numKeys + 12) / 13 && "Inserted entries should be found.");
+
+    // Bulk loading a non empty index fails
+    TestEntryStream more(attribute, 10);
+    rc = indexManager->bulkLoad(ixfileHandle, attribute, more, fillFactor);
+    assert(rc == IX_NOT_EMPTY && "Bulk loading a non empty index should fail.");
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return numPages;
+}
+
+int testCase_16(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Bulk Load with the entries sorted in memory **
+    // 2. Bulk Load with the entries sorted externally, with more runs than one merge pass takes **
+    // 3. Fill factor of Bulk Load **
+    // 4. Scan, lookups and inserts on a bulk loaded index
+    cerr << endl << "***** In IX Test Case 16 *****" << endl;
+
+    const int numKeys = 30000;
+
+    unsigned packed = bulkLoad(indexFileName, attribute, numKeys, 1.0);
+    unsigned half = bulkLoad(indexFileName, attribute, numKeys, 0.5);
+    cerr << "pages with fill factor 1.0: " << packed << ", 0.5: " << half << endl;
+    assert(half > packed * 3 / 2 && "A lower fill factor should leave room in the pages.");
+
+    RC rc = indexManager->setBulkLoadBufferSize(1);
+    assert(rc == success && "indexManager::setBulkLoadBufferSize() should not fail.");
+    bulkLoad(indexFileName, attribute, numKeys, IX_DEFAULT_FILL_FACTOR);
+    rc = indexManager->setBulkLoadBufferSize(IX_BULK_LOAD_BUFFER_PAGES);
+    assert(rc == success && "indexManager::setBulkLoadBufferSize() should not fail.");
+
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attr;
+    attr.length = 4;
+    attr.name = "age";
+    attr.type = TypeInt;
+    RC result = testCase_16("age_idx", attr);
+
+    attr.length = 20;
+    attr.name = "name";
+    attr.type = TypeVarChar;
+    if (result == success)
+        result = testCase_16("name_idx", attr);
+
+    if (result == success) {
+        cerr << "***** IX Test Case 16 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 16 failed. *****" << endl;
+        return fail;
+    }
+}
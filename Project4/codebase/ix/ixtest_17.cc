@@ -0,0 +1,149 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <vector>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+const int numEntries = 20000;
+const int numKeys = 2000;
+
+// Entry i has key i % numKeys. VarChar keys vary in length.
+static void prepareEntry(const Attribute &attr, int i, void *key, RID &rid)
+{
+    int k = i % numKeys;
+    prepareRid(i, rid);
+    if (attr.type == TypeInt)
+    {
+        memcpy(key, &k, sizeof(int));
+        return;
+    }
+    char text[64];
+    int len = sprintf(text, "%0*d", 8 + k % 40, k);
+    memcpy(key, &len, sizeof(int));
+    memcpy((char *) key + sizeof(int), text, len);
+}
+
+int testCase_17(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Delete Entry with merges and redistribution between siblings **
+    // 2. Root collapse once the tree empties **
+    // 3. Reuse of the pages freed by merges **
+    // 4. Delete Entry during a scan
+    cerr << endl << "***** In IX Test Case 17 *****" << endl;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    IXFileHandle ixfileHandle;
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    char key[PAGE_SIZE];
+    RID rid;
+    vector<bool> live(numEntries, true);
+    for (int i = 0; i < numEntries; i++)
+    {
+        prepareEntry(attribute, scrambled(i, numEntries), key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    unsigned fullPages = ixfileHandle.getNumberOfPages();
+    unsigned fullReads = checkScan(ixfileHandle, attribute, prepareEntry, live);
+
+    // Deleting nine entries in ten shrinks the tree
+    for (int i = 0; i < numEntries; i++)
+    {
+        int e = scrambled(i, numEntries);
+        if (e % 10 == 0)
+            continue;
+        prepareEntry(attribute, e, key, rid);
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        live[e] = false;
+    }
+    prepareEntry(attribute, 1, key, rid);
+    rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+    assert(rc != success && "Deleting a deleted entry should fail.");
+    unsigned sparseReads = checkScan(ixfileHandle, attribute, prepareEntry, live);
+    cerr << "pages read by a full scan: " << fullReads << " before deletes, " << sparseReads << " after" << endl;
+    assert(sparseReads * 3 < fullReads && "Leaves emptied by deletes should be merged.");
+
+    // Putting half of them back takes pages off the free list instead of growing the file
+    for (int i = 0; i < numEntries; i++)
+    {
+        int e = scrambled(i, numEntries);
+        if (live[e] || e % 2 != 0)
+            continue;
+        prepareEntry(attribute, e, key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+        live[e] = true;
+    }
+    checkScan(ixfileHandle, attribute, prepareEntry, live);
+    cerr << "pages in the file: " << fullPages << " before deletes, " << ixfileHandle.getNumberOfPages() << " after reinserting" << endl;
+    assert(ixfileHandle.getNumberOfPages() == fullPages && "Freed pages should be reused.");
+
+    // Deleting every entry returned by a scan returns each of them once
+    IX_ScanIterator ix_ScanIterator;
+    rc = indexManager->scan(ixfileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    int count = 0, expectedCount = 0;
+    for (int i = 0; i < numEntries; i++)
+        expectedCount += live[i];
+    while (ix_ScanIterator.getNextEntry(rid, key) == success)
+    {
+        assert(entryOf(rid) < numEntries && live[entryOf(rid)] && "An entry should be returned once.");
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        live[entryOf(rid)] = false;
+        count++;
+    }
+    ix_ScanIterator.close();
+    assert(count == expectedCount && "Every entry should be returned.");
+
+    // The empty tree is back to a root and a single leaf: the scan reads the meta page,
+    // the root, and the leaf once to find it and once to scan it
+    unsigned emptyReads = checkScan(ixfileHandle, attribute, prepareEntry, live);
+    assert(emptyReads <= 4 && "The root should collapse once the tree is empty.");
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attr;
+    attr.length = 4;
+    attr.name = "age";
+    attr.type = TypeInt;
+    RC result = testCase_17("age_idx", attr);
+
+    attr.length = 50;
+    attr.name = "name";
+    attr.type = TypeVarChar;
+    if (result == success)
+        result = testCase_17("name_idx", attr);
+
+    if (result == success) {
+        cerr << "***** IX Test Case 17 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 17 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -0,0 +1,142 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <vector>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+const int numEntries = 30000;
+
+// Entry i has key i / 3, so every key is there three times
+static void prepareEntry(const Attribute &attr, int i, void *key, RID &rid)
+{
+    int k = i / 3;
+    prepareRid(i, rid);
+    if (attr.type == TypeInt)
+    {
+        memcpy(key, &k, sizeof(int));
+        return;
+    }
+    char text[32];
+    int len = sprintf(text, "%08d", k);
+    memcpy(key, &len, sizeof(int));
+    memcpy((char *) key + sizeof(int), text, len);
+}
+
+int testCase_18(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Rebuild of a fragmented index **
+    // 2. Fragmentation of the leaf level **
+    // 3. Inserts, deletes and scans through the handle after a rebuild
+    cerr << endl << "***** In IX Test Case 18 *****" << endl;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    IXFileHandle ixfileHandle;
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // Inserts in a scrambled order split leaves all over the tree, each new leaf at the end of the file
+    char key[PAGE_SIZE];
+    RID rid;
+    vector<bool> live(numEntries, true);
+    for (int i = 0; i < numEntries; i++)
+    {
+        prepareEntry(attribute, scrambled(i, numEntries), key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    unsigned leaves, jumps;
+    rc = indexManager->getFragmentation(ixfileHandle, leaves, jumps);
+    assert(rc == success && "indexManager::getFragmentation() should not fail.");
+    unsigned pages = ixfileHandle.getNumberOfPages();
+    cerr << "before rebuild: " << pages << " pages, " << leaves << " leaves, " << jumps << " jumps" << endl;
+    assert(jumps > leaves / 2 && "Leaves split in a scrambled order should be out of order.");
+
+    rc = indexManager->rebuild(ixfileHandle, attribute, 1.0);
+    assert(rc == success && "indexManager::rebuild() should not fail.");
+    FILE *rebuiltFile = fopen((indexFileName + IX_REBUILD_SUFFIX).c_str(), "r");
+    assert(rebuiltFile == NULL && "The rebuilt file should replace the index.");
+
+    unsigned packedLeaves;
+    rc = indexManager->getFragmentation(ixfileHandle, packedLeaves, jumps);
+    assert(rc == success && "indexManager::getFragmentation() should not fail.");
+    cerr << "after rebuild: " << ixfileHandle.getNumberOfPages() << " pages, " << packedLeaves << " leaves, " << jumps << " jumps" << endl;
+    assert(jumps == 0 && "Leaves should be laid out in key order.");
+    assert(packedLeaves < leaves && ixfileHandle.getNumberOfPages() < pages && "Leaves should be packed to the fill factor.");
+    checkScan(ixfileHandle, attribute, prepareEntry, live);
+
+    // The handle works on the rebuilt index
+    for (int i = 0; i < numEntries; i += 2)
+    {
+        prepareEntry(attribute, i, key, rid);
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        live[i] = false;
+    }
+    for (int i = 0; i < numEntries; i += 4)
+    {
+        prepareEntry(attribute, i, key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+        live[i] = true;
+    }
+    checkScan(ixfileHandle, attribute, prepareEntry, live);
+
+    // And again, after closing and reopening it
+    rc = indexManager->rebuild(ixfileHandle, attribute);
+    assert(rc == success && "indexManager::rebuild() should not fail.");
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    rc = indexManager->getFragmentation(ixfileHandle, leaves, jumps);
+    assert(rc == success && jumps == 0 && "Leaves should be laid out in key order.");
+    checkScan(ixfileHandle, attribute, prepareEntry, live);
+
+    // A bad fill factor leaves the index as it is
+    rc = indexManager->rebuild(ixfileHandle, attribute, 0);
+    assert(rc == IX_BAD_FILL_FACTOR && "A fill factor of 0 should fail.");
+    checkScan(ixfileHandle, attribute, prepareEntry, live);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attr;
+    attr.length = 4;
+    attr.name = "age";
+    attr.type = TypeInt;
+    RC result = testCase_18("age_idx", attr);
+
+    attr.length = 20;
+    attr.name = "name";
+    attr.type = TypeVarChar;
+    if (result == success)
+        result = testCase_18("name_idx", attr);
+
+    if (result == success) {
+        cerr << "***** IX Test Case 18 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 18 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -0,0 +1,155 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <vector>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+const int numEntries = 20000;
+
+// Entry i has key i. VarChar keys are long enough to give the tree three levels.
+static void prepareEntry(const Attribute &attr, int i, void *key, RID &rid)
+{
+    prepareRid(i, rid);
+    if (attr.type == TypeInt)
+    {
+        memcpy(key, &i, sizeof(int));
+        return;
+    }
+    char text[64];
+    int len = sprintf(text, "%040d", i);
+    memcpy(key, &len, sizeof(int));
+    memcpy((char *) key + sizeof(int), text, len);
+}
+
+// Looks entry i up with an equality scan, returns whether it is there
+static bool lookup(IXFileHandle &ixfileHandle, const Attribute &attribute, int i)
+{
+    char key[PAGE_SIZE], returnedKey[PAGE_SIZE];
+    RID rid, returnedRid;
+    prepareEntry(attribute, i, key, rid);
+    IX_ScanIterator ix_ScanIterator;
+    RC rc = indexManager->scan(ixfileHandle, attribute, key, key, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    bool found = ix_ScanIterator.getNextEntry(returnedRid, returnedKey) == success;
+    assert((!found || entryOf(returnedRid) == i) && "The lookup should return the entry of the key.");
+    assert(ix_ScanIterator.getNextEntry(returnedRid, returnedKey) == IX_EOF && "Keys should be unique.");
+    ix_ScanIterator.close();
+    return found;
+}
+
+// Checks every entry through the handle. Returns the pages read per lookup.
+static double checkLookups(IXFileHandle &ixfileHandle, const Attribute &attribute, const vector<bool> &live)
+{
+    unsigned readsBefore, reads, writes, appends;
+    ixfileHandle.collectCounterValues(readsBefore, writes, appends);
+    for (int i = 0; i < numEntries; i++)
+        assert(lookup(ixfileHandle, attribute, i) == live[i] && "A lookup should see every insert and delete.");
+    ixfileHandle.collectCounterValues(reads, writes, appends);
+    return (double) (reads - readsBefore) / numEntries;
+}
+
+int testCase_19(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Point lookups with the root and upper levels cached in the handle **
+    // 2. Lookups through a second handle while the first one splits, merges and collapses the tree **
+    cerr << endl << "***** In IX Test Case 19 *****" << endl;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    IXFileHandle writer, reader;
+    rc = indexManager->openFile(indexFileName, writer);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, reader);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // The reader caches the tree while it is a single leaf, then again after each batch of
+    // inserts splits leaves, internal nodes and the root
+    char key[PAGE_SIZE];
+    RID rid;
+    vector<bool> live(numEntries, false);
+    checkLookups(reader, attribute, live);
+    for (int batch = 0; batch < 4; batch++)
+    {
+        for (int i = batch * numEntries / 4; i < (batch + 1) * numEntries / 4; i++)
+        {
+            int e = scrambled(i, numEntries);
+            prepareEntry(attribute, e, key, rid);
+            rc = indexManager->insertEntry(writer, attribute, key, rid);
+            assert(rc == success && "indexManager::insertEntry() should not fail.");
+            live[e] = true;
+        }
+        checkLookups(reader, attribute, live);
+    }
+
+    // Once the upper levels are cached a lookup only reads its leaf
+    double readsPerLookup = checkLookups(reader, attribute, live);
+    cerr << "pages read per lookup: " << readsPerLookup << endl;
+    assert(readsPerLookup < 1.1 && "A lookup should only read its leaf.");
+
+    // Deletes shrink the tree back to a single leaf under the reader
+    for (int batch = 0; batch < 4; batch++)
+    {
+        for (int i = batch * numEntries / 4; i < (batch + 1) * numEntries / 4; i++)
+        {
+            int e = scrambled(i, numEntries);
+            if (batch == 3 && e % 100 == 0)
+                continue;
+            prepareEntry(attribute, e, key, rid);
+            rc = indexManager->deleteEntry(writer, attribute, key, rid);
+            assert(rc == success && "indexManager::deleteEntry() should not fail.");
+            live[e] = false;
+        }
+        checkLookups(reader, attribute, live);
+    }
+
+    // A reopened handle starts without a cache
+    rc = indexManager->closeFile(reader);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->openFile(indexFileName, reader);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    checkLookups(reader, attribute, live);
+
+    rc = indexManager->closeFile(reader);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->closeFile(writer);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attr;
+    attr.length = 4;
+    attr.name = "age";
+    attr.type = TypeInt;
+    RC result = testCase_19("age_idx", attr);
+
+    attr.length = 50;
+    attr.name = "name";
+    attr.type = TypeVarChar;
+    if (result == success)
+        result = testCase_19("name_idx", attr);
+
+    if (result == success) {
+        cerr << "***** IX Test Case 19 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 19 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -0,0 +1,154 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <vector>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+const int numEntries = 30000;
+const int numKeys = 12;
+
+// Entry i has key i % numKeys, like a status column of a table
+static void prepareEntry(const Attribute &attr, int i, void *key, RID &rid)
+{
+    int k = i % numKeys;
+    prepareRid(i, rid);
+    if (attr.type == TypeInt)
+    {
+        memcpy(key, &k, sizeof(int));
+        return;
+    }
+    char text[64];
+    int len = sprintf(text, "status-%024d", k);
+    memcpy(key, &len, sizeof(int));
+    memcpy((char *) key + sizeof(int), text, len);
+}
+
+int testCase_20(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Insert Entry of many rids per key, in any order **
+    // 2. Equality scans of a key with many rids **
+    // 3. Delete Entry of one <key, rid> among many **
+    // 4. Rebuild of an index with few keys
+    cerr << endl << "***** In IX Test Case 20 *****" << endl;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    IXFileHandle ixfileHandle;
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    char key[PAGE_SIZE];
+    RID rid;
+    vector<bool> live(numEntries, true);
+    for (int i = 0; i < numEntries; i++)
+    {
+        prepareEntry(attribute, scrambled(i, numEntries), key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    checkScan(ixfileHandle, attribute, prepareEntry, live);
+
+    // Each key is stored once per leaf, the rids take a few bytes each
+    unsigned pages = ixfileHandle.getNumberOfPages();
+    unsigned unpacked = numEntries * (keyLength(attribute, key) + sizeof(RID)) / PAGE_SIZE;
+    cerr << "pages in the file: " << pages << ", the entries alone take " << unpacked << endl;
+    assert(pages < unpacked && "Keys should not be repeated for every rid.");
+
+    // An equality scan only reads the leaves of its key
+    unsigned leafCount, jumpCount;
+    rc = indexManager->getFragmentation(ixfileHandle, leafCount, jumpCount);
+    assert(rc == success && "indexManager::getFragmentation() should not fail.");
+    for (int k = 0; k < numKeys; k++)
+    {
+        // Entry k has key k
+        prepareEntry(attribute, k, key, rid);
+        unsigned reads = checkScan(ixfileHandle, attribute, prepareEntry, live, key, key);
+        assert(reads <= leafCount / numKeys + 4 && "An equality scan should read the leaves of its key.");
+    }
+
+    // Deleting every third entry, each from the middle of a posting list
+    for (int i = 0; i < numEntries; i++)
+    {
+        int e = scrambled(i, numEntries);
+        if (e % 3 != 0)
+            continue;
+        prepareEntry(attribute, e, key, rid);
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        live[e] = false;
+    }
+    prepareEntry(attribute, 3, key, rid);
+    rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+    assert(rc != success && "Deleting a deleted entry should fail.");
+    prepareEntry(attribute, 4, key, rid);
+    rid.slotNum = 100;
+    rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+    assert(rc != success && "Deleting a rid the key does not have should fail.");
+    checkScan(ixfileHandle, attribute, prepareEntry, live);
+    prepareEntry(attribute, 5, key, rid);
+    checkScan(ixfileHandle, attribute, prepareEntry, live, key, key);
+
+    // Rebuilding packs the posting lists into as few leaves as they fit in
+    rc = indexManager->rebuild(ixfileHandle, attribute, 1.0);
+    assert(rc == success && "indexManager::rebuild() should not fail.");
+    checkScan(ixfileHandle, attribute, prepareEntry, live);
+    cerr << "pages in the file: " << ixfileHandle.getNumberOfPages() << " after deletes and a rebuild" << endl;
+    assert(ixfileHandle.getNumberOfPages() < pages && "A rebuilt index should be smaller.");
+
+    // Entries still go in and out of the rebuilt posting lists
+    for (int i = 0; i < numEntries; i++)
+    {
+        prepareEntry(attribute, i, key, rid);
+        if (live[i])
+            rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        else
+            rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() and deleteEntry() should not fail.");
+        live[i] = !live[i];
+    }
+    checkScan(ixfileHandle, attribute, prepareEntry, live);
+    prepareEntry(attribute, 0, key, rid);
+    checkScan(ixfileHandle, attribute, prepareEntry, live, key, key);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attr;
+    attr.length = 4;
+    attr.name = "age";
+    attr.type = TypeInt;
+    RC result = testCase_20("age_idx", attr);
+
+    attr.length = 50;
+    attr.name = "name";
+    attr.type = TypeVarChar;
+    if (result == success)
+        result = testCase_20("name_idx", attr);
+
+    if (result == success) {
+        cerr << "***** IX Test Case 20 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 20 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -0,0 +1,176 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <vector>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+const int numEntries = 20000;
+const int numOutsiders = 2000;
+const int numHosts = 4;
+
+static const char *hosts[numHosts] = { "https://www.example.com/", "https://shop.example.com/",
+        "https://docs.example.org/", "http://mirror.example.net/" };
+static const char *path = "/reviews?sort=most-helpful&page=1&per_page=50&lang=en-US";
+
+// The first numEntries entries have URL keys: the keys of a leaf share a long prefix,
+// and the digits that tell two keys apart come well before their end. The rest have short keys
+// that share nothing with them.
+static void prepareEntry(const Attribute &attr, int i, void *key, RID &rid)
+{
+    prepareRid(i, rid);
+    char text[128];
+    int len;
+    if (i < numEntries)
+        len = sprintf(text, "%sproducts/%06d%s", hosts[i % numHosts], i / numHosts, path);
+    else
+        len = sprintf(text, "%c%d", 'a' + i % 26, i);
+    memcpy(key, &len, sizeof(int));
+    memcpy((char *) key + sizeof(int), text, len);
+}
+
+static void prepareKey(const char *text, void *key)
+{
+    int len = strlen(text);
+    memcpy(key, &len, sizeof(int));
+    memcpy((char *) key + sizeof(int), text, len);
+}
+
+static void checkScans(IXFileHandle &ixfileHandle, const Attribute &attribute, const vector<bool> &live)
+{
+    // Bounds that are prefixes of many keys, and ones that fall between the hosts
+    char low[PAGE_SIZE], high[PAGE_SIZE];
+    checkScan(ixfileHandle, attribute, prepareEntry, live);
+    prepareKey("https://shop.example.com/products/0012", low);
+    prepareKey("https://shop.example.com/products/0013", high);
+    checkScan(ixfileHandle, attribute, prepareEntry, live, low, high);
+    prepareKey("https://docs", low);
+    prepareKey("https://shop.example.com/products/00", high);
+    checkScan(ixfileHandle, attribute, prepareEntry, live, low, high);
+    prepareKey("h", low);
+    prepareKey("https://", high);
+    checkScan(ixfileHandle, attribute, prepareEntry, live, low, high);
+}
+
+int testCase_21(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Insert Entry of long keys sharing long prefixes **
+    // 2. Scans of leaves storing the shared prefix once, and of truncated separators **
+    // 3. Insert Entry and Delete Entry of keys that do not share the prefix of their leaf **
+    // 4. Rebuild of a prefix compressed index
+    cerr << endl << "***** In IX Test Case 21 *****" << endl;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    IXFileHandle ixfileHandle;
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    char key[PAGE_SIZE];
+    RID rid;
+    vector<bool> live(numEntries + numOutsiders, false);
+    for (int i = 0; i < numEntries; i++)
+    {
+        int e = scrambled(i, numEntries);
+        prepareEntry(attribute, e, key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+        live[e] = true;
+    }
+    checkScans(ixfileHandle, attribute, live);
+
+    // Leaves only hold what follows their prefix
+    unsigned pages = ixfileHandle.getNumberOfPages();
+    prepareEntry(attribute, 0, key, rid);
+    unsigned unpacked = numEntries * (keyLength(attribute, key) + sizeof(RID)) / PAGE_SIZE;
+    cerr << "pages in the file: " << pages << ", the entries alone take " << unpacked << endl;
+    assert(pages < unpacked && "Leaves should store the prefix of their keys once.");
+
+    // Separators stop after the digits, so an internal node has more children than full keys would fit in a page.
+    // Every page but the meta page and the leaves is an internal node.
+    unsigned leafCount, jumpCount;
+    rc = indexManager->getFragmentation(ixfileHandle, leafCount, jumpCount);
+    assert(rc == success && "indexManager::getFragmentation() should not fail.");
+    unsigned internalCount = pages - 1 - leafCount;
+    unsigned fullFanout = PAGE_SIZE / (sizeof(IndexEntry) + keyLength(attribute, key));
+    cerr << "children per internal node: " << leafCount / internalCount << ", " << fullFanout << " with full keys" << endl;
+    assert(leafCount > internalCount * fullFanout && "Separators should be truncated.");
+
+    // Keys sharing nothing with their leaves cut the prefixes short
+    for (int i = 0; i < numOutsiders; i++)
+    {
+        int e = numEntries + scrambled(i, numOutsiders);
+        prepareEntry(attribute, e, key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+        live[e] = true;
+    }
+    checkScans(ixfileHandle, attribute, live);
+
+    // Deleting nine URLs in ten merges leaves of different prefixes
+    for (int i = 0; i < numEntries; i++)
+    {
+        int e = scrambled(i, numEntries);
+        if (e % 10 == 0)
+            continue;
+        prepareEntry(attribute, e, key, rid);
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        live[e] = false;
+    }
+    checkScans(ixfileHandle, attribute, live);
+
+    // Rebuilding compresses the bulk loaded leaves too
+    rc = indexManager->rebuild(ixfileHandle, attribute, 1.0);
+    assert(rc == success && "indexManager::rebuild() should not fail.");
+    checkScans(ixfileHandle, attribute, live);
+    cerr << "pages in the file: " << ixfileHandle.getNumberOfPages() << " after deletes and a rebuild" << endl;
+
+    // And the rebuilt leaves take the URLs back
+    for (int i = 0; i < numEntries; i++)
+    {
+        int e = scrambled(i, numEntries);
+        if (live[e])
+            continue;
+        prepareEntry(attribute, e, key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+        live[e] = true;
+    }
+    checkScans(ixfileHandle, attribute, live);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attr;
+    attr.length = 100;
+    attr.name = "url";
+    attr.type = TypeVarChar;
+    RC result = testCase_21("url_idx", attr);
+
+    if (result == success) {
+        cerr << "***** IX Test Case 21 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 21 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -0,0 +1,129 @@
+#include <iostream>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <vector>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+IndexManager *indexManager;
+
+const int numEntries = 30000;
+const int numKeys = 3;
+const int firstKey = 4;
+
+// Entry i has key firstKey + i % numKeys, so every key runs over many leaves
+static void prepareKey(const Attribute &attr, int k, void *key)
+{
+    if (attr.type == TypeInt)
+    {
+        memcpy(key, &k, sizeof(int));
+        return;
+    }
+    char text[64];
+    int len = sprintf(text, "key-%016d", k);
+    memcpy(key, &len, sizeof(int));
+    memcpy((char *) key + sizeof(int), text, len);
+}
+
+static void prepareEntry(const Attribute &attr, int i, void *key, RID &rid)
+{
+    prepareKey(attr, firstKey + i % numKeys, key);
+    prepareRid(i, rid);
+}
+
+static void checkScans(IXFileHandle &ixfileHandle, const Attribute &attribute, const vector<bool> &live)
+{
+    // Every bound on the key runs, and bounds between them
+    char low[PAGE_SIZE], high[PAGE_SIZE];
+    for (int l = firstKey - 1; l <= firstKey + numKeys; l++)
+        for (int h = l; h <= firstKey + numKeys; h++)
+        {
+            prepareKey(attribute, l, low);
+            prepareKey(attribute, h, high);
+            for (int inclusive = 0; inclusive < 4; inclusive++)
+                checkScan(ixfileHandle, attribute, prepareEntry, live, low, high, inclusive & 1, inclusive & 2);
+        }
+    for (int k = firstKey; k < firstKey + numKeys; k++)
+    {
+        prepareKey(attribute, k, low);
+        checkScan(ixfileHandle, attribute, prepareEntry, live, low, NULL, false, true);
+        checkScan(ixfileHandle, attribute, prepareEntry, live, NULL, low, true, false);
+    }
+}
+
+int testCase_22(const string &indexFileName, const Attribute &attribute)
+{
+    // Functions tested
+    // 1. Scans with an exclusive low key whose entries run over many leaves **
+    // 2. Scans with an exclusive high key whose entries run over many leaves
+    // 3. The same scans after deletes
+    cerr << endl << "***** In IX Test Case 22 *****" << endl;
+
+    remove(indexFileName.c_str());
+    RC rc = indexManager->createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    IXFileHandle ixfileHandle;
+    rc = indexManager->openFile(indexFileName, ixfileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    char key[PAGE_SIZE];
+    RID rid;
+    vector<bool> live(numEntries, true);
+    for (int i = 0; i < numEntries; i++)
+    {
+        prepareEntry(attribute, scrambled(i, numEntries), key, rid);
+        rc = indexManager->insertEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    checkScans(ixfileHandle, attribute, live);
+
+    // Deletes leave some leaves holding a single key
+    for (int i = 0; i < numEntries; i++)
+    {
+        int e = scrambled(i, numEntries);
+        if (e % 5 == 0)
+            continue;
+        prepareEntry(attribute, e, key, rid);
+        rc = indexManager->deleteEntry(ixfileHandle, attribute, key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+        live[e] = false;
+    }
+    checkScans(ixfileHandle, attribute, live);
+
+    rc = indexManager->closeFile(ixfileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+    rc = indexManager->destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+    return success;
+}
+
+int main()
+{
+    // Global Initialization
+    indexManager = IndexManager::instance();
+
+    Attribute attr;
+    attr.length = 4;
+    attr.name = "age";
+    attr.type = TypeInt;
+    RC result = testCase_22("age_idx", attr);
+
+    attr.length = 50;
+    attr.name = "name";
+    attr.type = TypeVarChar;
+    if (result == success)
+        result = testCase_22("name_idx", attr);
+
+    if (result == success) {
+        cerr << "***** IX Test Case 22 finished. The result will be examined. *****" << endl;
+        return success;
+    } else {
+        cerr << "***** [FAIL] IX Test Case 22 failed. *****" << endl;
+        return fail;
+    }
+}
@@ -3,31 +3,251 @@
 #include <string>
 #include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <unistd.h>
 
 #include "qe.h"
 
-Filter::Filter(Iterator* input, const Condition &condition) : iter(input), cond(condition) {
-    // Iterator is just an iterator over some tuples, cannot use regular rbfm scan to do stuff, must
-    // use this scan iterator since it may have some kinds of other conditions we are unaware of
-    // Must use condition to re-implement a getNextTuple() function
-    // Iterator class may either be an index scan or table scan, doesnt really matter
-    /*iter = input;
-    cond.lhsAttr = condition.lhsAttr;
-    cond.op = condition.op;
-    cond.bRhsIsAttr = condition.bRhsIsAttr;
-    if(cond.bRhsIsAttr) {
-        cond.rhsAttr = condition.rhsAttr;
+// Tuple layout helpers shared by the join operators. Tuples use the null indicator format of insertTuple.
+
+static int getTupleNullIndicatorSize(int fieldCount)
+{
+    return int(ceil((double) fieldCount / CHAR_BIT));
+}
+
+static bool tupleFieldIsNull(const void *data, int i)
+{
+    int indicatorIndex = i / CHAR_BIT;
+    int indicatorMask  = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
+    return (((const char*) data)[indicatorIndex] & indicatorMask) != 0;
+}
+
+static unsigned getFieldLength(const Attribute &attr, const void *field)
+{
+    if (attr.type != TypeVarChar)
+        return INT_SIZE;
+    uint32_t varcharSize;
+    memcpy(&varcharSize, field, VARCHAR_LENGTH_SIZE);
+    return VARCHAR_LENGTH_SIZE + varcharSize;
+}
+
+// Offset of field index in the tuple, or of the end of the tuple when index is the number of fields
+static unsigned getFieldOffset(const vector<Attribute> &attrs, const void *data, unsigned index)
+{
+    unsigned offset = getTupleNullIndicatorSize(attrs.size());
+    for (unsigned i = 0; i < index; i++)
+    {
+        if (!tupleFieldIsNull(data, i))
+            offset += getFieldLength(attrs[i], (const char*) data + offset);
     }
-    else {
-        cond.rhsValue = condition.rhsValue;
-    }*/
+    return offset;
+}
+
+static unsigned getTupleLength(const vector<Attribute> &attrs, const void *data)
+{
+    return getFieldOffset(attrs, data, attrs.size());
+}
+
+// The join key of a tuple as bytes that are equal exactly when the keys are equal
+static void getJoinKey(const vector<Attribute> &attrs, const void *data, unsigned index, string &key)
+{
+    const char *field = (const char*) data + getFieldOffset(attrs, data, index);
+    if (attrs[index].type == TypeReal)
+    {
+        float real;
+        memcpy(&real, field, REAL_SIZE);
+        if (real == 0)
+            real = 0;
+        key.assign((const char*) &real, REAL_SIZE);
+        return;
+    }
+    key.assign(field, getFieldLength(attrs[index], field));
+}
+
+static int compareFields(AttrType type, const void *field, const void *other)
+{
+    if (type == TypeInt)
+    {
+        int32_t a, b;
+        memcpy(&a, field, INT_SIZE);
+        memcpy(&b, other, INT_SIZE);
+        return a < b ? -1 : (a > b ? 1 : 0);
+    }
+    if (type == TypeReal)
+    {
+        float a, b;
+        memcpy(&a, field, REAL_SIZE);
+        memcpy(&b, other, REAL_SIZE);
+        return a < b ? -1 : (a > b ? 1 : 0);
+    }
+    uint32_t aSize, bSize;
+    memcpy(&aSize, field, VARCHAR_LENGTH_SIZE);
+    memcpy(&bSize, other, VARCHAR_LENGTH_SIZE);
+    int cmp = memcmp((const char*) field + VARCHAR_LENGTH_SIZE, (const char*) other + VARCHAR_LENGTH_SIZE, min(aSize, bSize));
+    if (cmp != 0)
+        return cmp;
+    return aSize < bSize ? -1 : (aSize > bSize ? 1 : 0);
+}
+
+static bool satisfiesCondition(CompOp op, int cmp)
+{
+    switch (op)
+    {
+        case EQ_OP: return cmp == 0;
+        case LT_OP: return cmp <  0;
+        case GT_OP: return cmp >  0;
+        case LE_OP: return cmp <= 0;
+        case GE_OP: return cmp >= 0;
+        case NE_OP: return cmp != 0;
+        case NO_OP: return true;
+        default: return false;
+    }
+}
+
+// Concatenates a left and a right tuple under a single null indicator
+static RC joinTuples(const vector<Attribute> &leftAttrs, const void *leftData,
+        const vector<Attribute> &rightAttrs, const void *rightData, void *data)
+{
+    int leftIndicatorSize = getTupleNullIndicatorSize(leftAttrs.size());
+    int rightIndicatorSize = getTupleNullIndicatorSize(rightAttrs.size());
+    int indicatorSize = getTupleNullIndicatorSize(leftAttrs.size() + rightAttrs.size());
+    unsigned leftSize = getTupleLength(leftAttrs, leftData) - leftIndicatorSize;
+    unsigned rightSize = getTupleLength(rightAttrs, rightData) - rightIndicatorSize;
+    if (indicatorSize + leftSize + rightSize > PAGE_SIZE)
+        return JOIN_RSLT_TOO_BIG;
+
+    char *nullIndicator = (char*) data;
+    memcpy(nullIndicator, leftData, leftIndicatorSize);
+    memset(nullIndicator + leftIndicatorSize, 0, indicatorSize - leftIndicatorSize);
+    for (unsigned i = 0; i < rightAttrs.size(); i++)
+    {
+        if (!tupleFieldIsNull(rightData, i))
+            continue;
+        int j = leftAttrs.size() + i;
+        nullIndicator[j / CHAR_BIT] |= 1 << (CHAR_BIT - 1 - (j % CHAR_BIT));
+    }
+
+    memcpy((char*) data + indicatorSize, (const char*) leftData + leftIndicatorSize, leftSize);
+    memcpy((char*) data + indicatorSize + leftSize, (const char*) rightData + rightIndicatorSize, rightSize);
+    return SUCCESS;
+}
+
+// Finds the join attributes of a condition, false if either side does not have its attribute
+static bool findJoinAttributes(const Condition &cond, const vector<Attribute> &leftAttrs, const vector<Attribute> &rightAttrs,
+        int &leftIndex, int &rightIndex)
+{
+    leftIndex = rightIndex = -1;
+    for (unsigned i = 0; i < leftAttrs.size(); i++)
+    {
+        if (leftAttrs[i].name == cond.lhsAttr)
+            leftIndex = i;
+    }
+    for (unsigned i = 0; i < rightAttrs.size(); i++)
+    {
+        if (cond.bRhsIsAttr && rightAttrs[i].name == cond.rhsAttr)
+            rightIndex = i;
+    }
+    return leftIndex >= 0 && rightIndex >= 0 && leftAttrs[leftIndex].type == rightAttrs[rightIndex].type;
+}
+
+// Locates every field of a tuple, offsets are -1 for null fields
+static void getFieldOffsets(const vector<Attribute> &attrs, const void *data, int *offsets)
+{
+    int offset = getTupleNullIndicatorSize(attrs.size());
+    for (unsigned i = 0; i < attrs.size(); i++)
+    {
+        if (tupleFieldIsNull(data, i))
+        {
+            offsets[i] = -1;
+            continue;
+        }
+        offsets[i] = offset;
+        offset += getFieldLength(attrs[i], (const char*) data + offset);
+    }
+}
+
+TupleBatch::TupleBatch(const unsigned capacity) : capacity(capacity), rows(0) {
+    tuple_offsets.assign(capacity + 1, 0);
+}
+
+void TupleBatch::reset(const vector<Attribute> &attrs) {
+    if (this->attrs.size() != attrs.size())
+        column_offsets.assign(attrs.size(), vector<int>(capacity));
+    this->attrs = attrs;
+    rows = 0;
+    selection.clear();
+}
+
+void *TupleBatch::reserveTuple() {
+    size_t end = tuple_offsets[rows];
+    if (data.size() < end + PAGE_SIZE)
+        data.resize(max(end + PAGE_SIZE, 2 * data.size()));
+    return &data[end];
+}
+
+void TupleBatch::commitTuple() {
+    const char *tuple = &data[tuple_offsets[rows]];
+    int offset = getTupleNullIndicatorSize(attrs.size());
+    for (unsigned i = 0; i < attrs.size(); i++)
+    {
+        if (tupleFieldIsNull(tuple, i))
+        {
+            column_offsets[i][rows] = -1;
+            continue;
+        }
+        column_offsets[i][rows] = tuple_offsets[rows] + offset;
+        offset += getFieldLength(attrs[i], tuple + offset);
+    }
+    tuple_offsets[rows + 1] = tuple_offsets[rows] + offset;
+    selection.push_back(rows);
+    rows++;
+}
+
+void TupleBatch::appendTuple(const void *tuple) {
+    memcpy(reserveTuple(), tuple, ::getTupleLength(attrs, tuple));
+    commitTuple();
+}
+
+const char *TupleBatch::getField(unsigned row, unsigned column) const {
+    int offset = column_offsets[column][row];
+    return offset < 0 ? NULL : &data[offset];
+}
+
+// Fills a batch from an operator that makes one tuple at a time, writing each one in place
+template <class NextTuple>
+static RC fillBatch(TupleBatch &batch, const vector<Attribute> &attrs, NextTuple next)
+{
+    batch.reset(attrs);
+    while (!batch.isFull())
+    {
+        RC rc = next(batch.reserveTuple());
+        if (rc == QE_EOF)
+            break;
+        if (rc)
+            return rc;
+        batch.commitTuple();
+    }
+    return batch.size() ? SUCCESS : QE_EOF;
+}
+
+RC Iterator::getNextBatch(TupleBatch &batch) {
+    vector<Attribute> attrs;
+    getAttributes(attrs);
+    return fillBatch(batch, attrs, [this](void *data) { return getNextTuple(data); });
+}
+
+Filter::Filter(Iterator* input, const Condition &condition) : iter(input), cond(condition) {
+    // The input attributes and a buffer for its tuples are set up once for the whole scan
+    iter->getAttributes(input_attrs);
+    tuple = malloc(PAGE_SIZE);
+    field_offsets.resize(input_attrs.size());
+    pushed = false;
+    error = SUCCESS;
 
-    vector<Attribute> attributes;
-    iter->getAttributes(attributes);
     bool found_attr = false;
     int i;
-    for (i = 0; i < (int) attributes.size(); i += 1) {
-        if (attributes[i].name.compare(cond.lhsAttr) == 0) {
+    for (i = 0; i < (int) input_attrs.size(); i += 1) {
+        if (input_attrs[i].name.compare(cond.lhsAttr) == 0) {
             found_attr = true;
             break;
         }
@@ -36,31 +256,44 @@ Filter::Filter(Iterator* input, const Condition &condition) : iter(input), cond(
     if (!found_attr) {
         //attribute to compare against does not exist in our attrs, so fail
         error = FILTER_ATTR_NT_EXIST;
+        return;
     }
-    else {
-        compare_attr_index = i;
-        compare_attr = attributes[i];
-    }
+    compare_attr_index = i;
+    compare_attr = input_attrs[i];
 
-    if (cond.bRhsIsAttr || cond.rhsValue.type != attributes[i].type) {
+    if (cond.bRhsIsAttr || cond.rhsValue.type != compare_attr.type) {
         error = FILTER_BAD_COND;
+        return;
     }
 
-    error = SUCCESS;
+    // Rows are best dropped where they are read
+    pushed = iter->pushCondition(cond);
 }
 
-Filter::~Filter() {}
-
-int Filter::getNullIndicatorSize(int fieldCount) 
-{
-    return int(ceil((double) fieldCount / CHAR_BIT));
+Filter::~Filter() {
+    free(tuple);
 }
 
-bool Filter::fieldIsNull(char *nullIndicator, int i)
-{
-    int indicatorIndex = i / CHAR_BIT;
-    int indicatorMask  = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
-    return (nullIndicator[indicatorIndex] & indicatorMask) != 0;
+// Whether a field satisfies the condition, a null field never does
+bool Filter::matches(const char *field) {
+    if (field == NULL)
+        return cond.op == NO_OP;
+    if (compare_attr.type == TypeInt) {
+        int32_t recordInt;
+        memcpy(&recordInt, field, INT_SIZE);
+        return checkScanCondition(recordInt, cond.op, cond.rhsValue.data);
+    }
+    if (compare_attr.type == TypeReal) {
+        float recordReal;
+        memcpy(&recordReal, field, REAL_SIZE);
+        return checkScanCondition(recordReal, cond.op, cond.rhsValue.data);
+    }
+    uint32_t varcharSize;
+    memcpy(&varcharSize, field, VARCHAR_LENGTH_SIZE);
+    char recordString[varcharSize + 1];
+    memcpy(recordString, field + VARCHAR_LENGTH_SIZE, varcharSize);
+    recordString[varcharSize] = '\0';
+    return checkScanCondition(recordString, cond.op, cond.rhsValue.data);
 }
 
 RC Filter::getNextTuple(void* data) {
@@ -69,152 +302,93 @@ RC Filter::getNextTuple(void* data) {
     if (error)
         return error;
 
+    if (pushed)
+        return iter->getNextTuple(data);
+
     // get the next tuple out of the iterator and do the comparison
-    void* cur_data = calloc(PAGE_SIZE, 1);
     RC rc;
-    vector<Attribute> attributes;
-    iter->getAttributes(attributes);
-    bool valid = false;
-    while ((rc = iter->getNextTuple(cur_data)) == SUCCESS) {
-        // TODO keep going until we have data that is valid for the 
-        // new condition we are applying
-        
-        // int i;
-        // bool found_attr = false;
-        // for (i = 0; i < attributes.size(); i += 1) {
-        //     if (attributes[i].name.compare(cond.lhsAttr) == 0) {
-        //         found_attr = true;
-        //         break;
-        //     }
-        // }
-        // if (!found_attr) {
-        //     //attribute to compare against does not exist in our attrs, so fail
-        //     return FILTER_ATTR_NT_EXIST;
-        // }
-        // if (cond.bRhsIsAttr || cond.rhsValue.type != attributes[i].type) {
-        //     return FILTER_BAD_COND;
-        // }
-        int nullIndicatorSize = getNullIndicatorSize(attributes.size());
-        char nullIndicator[nullIndicatorSize];
-        memset(nullIndicator, 0, nullIndicatorSize);
-        memcpy(nullIndicator, (char*) cur_data, nullIndicatorSize);
-
-        // Offset into *data. Start just after null indicator
-        unsigned recordSize = nullIndicatorSize;
-        // Running count of size. Initialize to size of header
-        // unsigned size = sizeof (RecordLength) + (recordDescriptor.size()) * sizeof(ColumnOffset) + nullIndicatorSize;
-        // count up size of the record (amount of bytes to copy into *data)
-        // when we reach the index of the attribute to be compared, do the comparison
-        for (unsigned i = 0; i < attributes.size(); i += 1)
-        {
-            if (i == (unsigned) compare_attr_index) {
-                //then offset of the record is already what we need it to be
-                if (compare_attr.type == TypeInt) {
-                    int32_t recordInt;
-                    memcpy(&recordInt, (char*)cur_data + recordSize, INT_SIZE);
-                    /* cerr << "cond.rhsValue: " << *(int *)cond.rhsValue.data << endl; */
-                    valid = checkScanCondition(recordInt, cond.op, cond.rhsValue.data);
-                    /* cerr << "int case set the valid flag to: " << valid << endl; */
-                }
-                else if (compare_attr.type == TypeReal) {
-                    float recordReal;
-                    memcpy(&recordReal, (char*)cur_data + recordSize, REAL_SIZE);
-                    valid = checkScanCondition(recordReal, cond.op, cond.rhsValue.data);
-                    /* cerr << "float case set the valid flag to: " << valid << endl; */
-                }
-                else {
-                    // varchar case
-                    uint32_t varcharSize;
-                    memcpy(&varcharSize, (char*)cur_data + recordSize, VARCHAR_LENGTH_SIZE);
-                    char recordString[varcharSize + 1];
-                    memcpy(recordString, (char*)cur_data + recordSize + VARCHAR_LENGTH_SIZE, varcharSize);
-                    recordString[varcharSize] = '\0';
-                    // TODO: Verify we want to pass a pointer to the rhsValue.
-                    valid = checkScanCondition(recordString, cond.op, cond.rhsValue.data);
-                    /* cerr << "varchar case set the valid flag to: " << valid << endl; */
-                }
-            }
-            // Skip null fields
-            if (fieldIsNull(nullIndicator, i)) {
-                /* cerr << "found null field." << endl; */
-                continue;
-            }
-          
-            switch (attributes[i].type)
-            {
-                case TypeInt:
-                    // size += INT_SIZE;
-                    recordSize += INT_SIZE;
-                break;
-                case TypeReal:
-                    // size += REAL_SIZE;
-                    recordSize += REAL_SIZE;
-                break;
-                case TypeVarChar:
-                    uint32_t varcharSize;
-                    // We have to get the size of the VarChar field by reading the integer that precedes the string value itself
-                    memcpy(&varcharSize, (char*) cur_data + recordSize, VARCHAR_LENGTH_SIZE);
-                    // size += varcharSize;
-                    recordSize += varcharSize + VARCHAR_LENGTH_SIZE;
-                break;
-            }
-        }
-
-        if (valid) {
-            /* cerr << "found a valid tuple!" << endl; */
-            memcpy(data, cur_data, recordSize);
-            valid = false;
-            free(cur_data);
+    while ((rc = iter->getNextTuple(tuple)) == SUCCESS) {
+        getFieldOffsets(input_attrs, tuple, &field_offsets[0]);
+        int offset = field_offsets[compare_attr_index];
+        if (matches(offset < 0 ? NULL : (char*) tuple + offset)) {
+            memcpy(data, tuple, getTupleLength(input_attrs, tuple));
             return SUCCESS;
         }
     }
+    return rc;
+}
 
-    if (rc == QE_EOF) {
-        free(cur_data);
-        return QE_EOF;
-    }
-    else {
-        free(cur_data);
-        return rc;
+// The input batch is passed on with only the matching tuples selected
+RC Filter::getNextBatch(TupleBatch &batch) {
+    if (iter == NULL)
+        return FILTER_NT_INIT;
+    if (error)
+        return error;
+    if (pushed)
+        return iter->getNextBatch(batch);
+
+    RC rc;
+    while ((rc = iter->getNextBatch(batch)) == SUCCESS) {
+        unsigned kept = 0;
+        for (unsigned i = 0; i < batch.size(); i++) {
+            unsigned row = batch.selection[i];
+            if (matches(batch.getField(row, compare_attr_index)))
+                batch.selection[kept++] = row;
+        }
+        batch.selection.resize(kept);
+        if (kept > 0)
+            return SUCCESS;
     }
+    return rc;
+}
+
+// Once the input checks our condition, we have nothing left to do and pass anything on
+bool Filter::pushCondition(const Condition &cond) {
+    return !error && pushed && iter->pushCondition(cond);
+}
+
+bool Filter::pushProjection(const vector<string> &attrNames) {
+    if (error || !pushed || !iter->pushProjection(attrNames))
+        return false;
+    iter->getAttributes(input_attrs);
+    return true;
 }
 
 void Filter::getAttributes(vector<Attribute> &attrs) const {
-    // im not sure which attributes im getting
-    // its either those of the table that im iterating over
-    // or its the attributes that im returning when i return each tuple
-    iter->getAttributes(attrs);
+    // A filter returns the tuples of its input unchanged
+    attrs = input_attrs;
 }
 
 Project::Project(Iterator* input, const vector<string> &attrNames) {
     //iterator is just an iterator over some tuples, cannot use regular rbfm scan to do stuff, must
     //  use this scan iterator since it may have some kinds of other conditions we are unaware of
-    // must use condition to re-implement a getNextTuple() function
     // iterator class may either be an index scan or table scan, doesnt really matter
     iter = input;
     names.clear();
     for (unsigned i = 0; i < attrNames.size(); i++)
         names.push_back(attrNames[i]);
 
-    vector<Attribute> attrs;
-    input->getAttributes(attrs);
-    if(attrNames.size() > attrs.size()) {
+    // The input attributes and a buffer for its tuples are set up once for the whole scan
+    input->getAttributes(input_attrs);
+    tuple = malloc(PAGE_SIZE);
+    field_offsets.resize(input_attrs.size());
+    pushed = false;
+    if(attrNames.size() > input_attrs.size()) {
         error = PRJCT_BAD_ATTR_COND;
         return;
     }
   
     for (unsigned i = 0; i < attrNames.size(); i += 1) {
-        for (unsigned j = 0; j < attrs.size(); j += 1) {
-            if (attrNames[i].compare(attrs[j].name) == 0) {
+        for (unsigned j = 0; j < input_attrs.size(); j += 1) {
+            if (attrNames[i].compare(input_attrs[j].name) == 0) {
                 // the names match
-                Attribute attr;
-                attr.name = attrs[j].name;
-                attr.type = attrs[j].type;
-                attr.length = attrs[j].length;
-                projection_attributes.push_back(attr);
+                projection_attributes.push_back(input_attrs[j]);
+                projection_indexes.push_back(j);
+                break;
             }
         }
     }
+    fields.resize(projection_attributes.size());
   
     if (projection_attributes.size() != attrNames.size()) {
         // then not all attributes found a name that matched, 
@@ -222,131 +396,101 @@ Project::Project(Iterator* input, const vector<string> &attrNames) {
         error = PRJCT_BAD_ATTR_COND;
     } else {
         error = SUCCESS;
+        // Fields are best dropped where they are read
+        pushed = iter->pushProjection(names);
     }
 }
 
+Project::~Project() {
+    free(tuple);
+}
+
 RC Project::getNextTuple(void* data) {
     if (iter == NULL) {
-        /* cerr << "Project::getNextTuple: Not init!" << endl; */
         return PRJCT_NT_INIT;
     }
     if (error) {
-        /* cerr << "Project::getNextTuple: error Initializing." << endl; */
         return error;
     }
-    
-    //get the next tuple out of the iterator and do the comparison
-    void* cur_data = calloc(PAGE_SIZE, 1);
-    RC rc;
-    vector<Attribute> attrs;
-    iter->getAttributes(attrs);
-    while ((rc = iter->getNextTuple(cur_data)) == SUCCESS) {
-        // retrieve the tuple
-        // let us assume we can return the data in the exact order it was given to us, and we only need to cut out data
-        int given_null_size = getNullIndicatorSize(attrs.size());
-        int our_null_size = getNullIndicatorSize(projection_attributes.size());
-        char* nullIndicator = (char*)calloc(given_null_size, 1);
-        memcpy(nullIndicator, cur_data, given_null_size);
-        char* nulls = (char*)calloc(our_null_size, 1);
-        int output_offset = our_null_size;
-        int nulls_index = 0;
-        if (given_null_size != our_null_size) {
-            // if the null size of the attributes of the vector are not the same as the null size of the 
-            // TODO:
-            cerr << "getNextTuple: NotImplemented." << endl;
-        }
-        else {
-            // int offset = 0;
-            // // memcpy(data, cur_data, our_null_size);  // we cant do this, we have to adjust no matter what
-            // offset += given_null_size;
-            // output_offset = given_null_size;
-            //time to add all of our data into the buffer
-            for (unsigned i = 0; i < projection_attributes.size(); i += 1) {
-                int cur_field = 0;
-                int offset = given_null_size;
-                while(projection_attributes[i].name.compare(attrs[cur_field].name) != 0) {
-                    attrs[cur_field];
-                    if (fieldIsNull(nullIndicator, cur_field))
-                        continue;
-
-                    switch (attrs[cur_field].type)
-                    {
-                        case TypeInt:
-                            offset += INT_SIZE;
-                            break;
-                        case TypeReal:
-                            offset += REAL_SIZE;
-                            break;
-                        case TypeVarChar:
-                            uint32_t varcharSize;
-                            // We have to get the size of the VarChar field by reading the integer that precedes the string value itself
-                            memcpy(&varcharSize, (char*) data + offset, VARCHAR_LENGTH_SIZE);
-                            // size += varcharSize;
-                            offset += varcharSize + VARCHAR_LENGTH_SIZE;
-                            break;
-                    }
-                    
-                    cur_field += 1;
-                }
-                // we are now at a field we need
-                if (fieldIsNull(nullIndicator, cur_field)) {
-                    // if the field we want is null, then we have to write a null val into OUR nulls indicator
-                    setFieldToNull(nulls, nulls_index);
-                    //since we call continue, we need to increment this right here immediately
-                    nulls_index += 1;
-                    continue;
-                }
-
-                if (cur_field >= projection_attributes.size())
-                    cur_field = projection_attributes.size() - 1;
-                switch (projection_attributes[cur_field].type)
-                {
-                    case TypeInt:
-                        memcpy((char*)data + output_offset, (char*)cur_data + offset, INT_SIZE);
-                        offset += INT_SIZE;
-                        output_offset += INT_SIZE;
-                    break;
-                    case TypeReal:
-                        memcpy((char*)data + output_offset, (char*)cur_data + offset, REAL_SIZE);
-                        offset += REAL_SIZE;
-                        output_offset += REAL_SIZE;
-                    break;
-                    case TypeVarChar:
-                        uint32_t varcharSize;
-                        // We have to get the size of the VarChar field by reading the integer that precedes the string value itself
-                        memcpy(&varcharSize, (char*)cur_data + offset, VARCHAR_LENGTH_SIZE);
-                        memcpy((char*)data + output_offset, &varcharSize, VARCHAR_LENGTH_SIZE);
-                        // size += varcharSize;
-                        offset += VARCHAR_LENGTH_SIZE;
-                        output_offset += VARCHAR_LENGTH_SIZE;
-                        memcpy((char*)data + output_offset, (char*)cur_data + offset, varcharSize);
-                        offset += varcharSize;
-                        output_offset += varcharSize;
-                    break;
-                }
-                cur_field += 1;
-                // if we do in fact write a value in, we do not want to mark this part of our null bits as null, so increment
-                nulls_index += 1;
-            }
+    if (pushed) {
+        return iter->getNextTuple(data);
+    }
+
+    RC rc = iter->getNextTuple(tuple);
+    if (rc)
+        return rc;
+
+    getFieldOffsets(input_attrs, tuple, &field_offsets[0]);
+    for (unsigned i = 0; i < projection_indexes.size(); i++) {
+        int offset = field_offsets[projection_indexes[i]];
+        fields[i] = offset < 0 ? NULL : (char*) tuple + offset;
+    }
+    writeProjection(data);
+    return SUCCESS;
+}
+
+// Every selected input tuple is projected straight into the batch
+RC Project::getNextBatch(TupleBatch &batch) {
+    if (iter == NULL) {
+        return PRJCT_NT_INIT;
+    }
+    if (error) {
+        return error;
+    }
+    if (pushed) {
+        return iter->getNextBatch(batch);
+    }
+
+    if (input_batch.getCapacity() != batch.getCapacity())
+        input_batch = TupleBatch(batch.getCapacity());
+    RC rc = iter->getNextBatch(input_batch);
+    if (rc)
+        return rc;
+
+    batch.reset(projection_attributes);
+    for (unsigned i = 0; i < input_batch.size(); i++) {
+        unsigned row = input_batch.selection[i];
+        for (unsigned j = 0; j < projection_indexes.size(); j++)
+            fields[j] = input_batch.getField(row, projection_indexes[j]);
+        writeProjection(batch.reserveTuple());
+        batch.commitTuple();
+    }
+    return SUCCESS;
+}
+
+// Writes a tuple of the projected fields, NULL fields are null
+void Project::writeProjection(void *data) {
+    int nullIndicatorSize = getNullIndicatorSize(projection_attributes.size());
+    char *nullIndicator = (char*) data;
+    memset(nullIndicator, 0, nullIndicatorSize);
+    unsigned offset = nullIndicatorSize;
+    for (unsigned i = 0; i < projection_attributes.size(); i++) {
+        if (fields[i] == NULL) {
+            setFieldToNull(nullIndicator, i);
+            continue;
         }
-        memcpy(data, nulls, our_null_size);
-        free(nulls);
-        free(cur_data);
-        free(nullIndicator);
-        return SUCCESS;
+        unsigned length = getFieldLength(projection_attributes[i], fields[i]);
+        memcpy((char*) data + offset, fields[i], length);
+        offset += length;
     }
+}
 
-    free(cur_data);
-    return rc;
+// Once the input projects for us, a condition or a narrower projection can go further down
+bool Project::pushCondition(const Condition &cond) {
+    return !error && pushed && iter->pushCondition(cond);
+}
+
+bool Project::pushProjection(const vector<string> &attrNames) {
+    if (error || !pushed || !iter->pushProjection(attrNames))
+        return false;
+    iter->getAttributes(projection_attributes);
+    return true;
 }
 
 void Project::getAttributes(vector<Attribute> &attrs) const {
-    // im not sure which attributes im getting
-    // its either those of the table that im iterating over
-    // or its the attributes that im returning when i return each tuple
     // I am assuming that the attributes I return here are the attributes that MY PROJECTION returns, 
     // NOT what I GET when I call getNextTuple() on the underlying iterator
-    iter->getAttributes(attrs);
+    attrs = projection_attributes;
 }
 // ... the rest of your implementations go here
 
@@ -355,13 +499,6 @@ int Project::getNullIndicatorSize(int fieldCount)
     return int(ceil((double) fieldCount / CHAR_BIT));
 }
 
-bool Project::fieldIsNull(char *nullIndicator, int i)
-{
-    int indicatorIndex = i / CHAR_BIT;
-    int indicatorMask  = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
-    return (nullIndicator[indicatorIndex] & indicatorMask) != 0;
-}
-
 RC Project::setFieldToNull(char *nullIndicator, int i) {
     int indicatorIndex = i / CHAR_BIT;
     uint8_t mask = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
@@ -379,11 +516,14 @@ INLJoin::INLJoin(Iterator *leftIn,           // Iterator of input R
     right = rightIn;
     cond = condition; 
     leftIn->getAttributes(left_attrs);
-    right_attrs = rightIn->attrs;
+    rightIn->getAttributes(right_attrs);
     newLeft = true;
+    // Buffers are allocated once, the join itself does not allocate
     outer_page_data = malloc(PAGE_SIZE);
-    right_attr_comp_index = NULL;
-    left_attr_comp_index = NULL;
+    inner_page_data = malloc(PAGE_SIZE);
+    probe_key = malloc(PAGE_SIZE);
+    right_attr_comp_index = 0;
+    left_attr_comp_index = 0;
     //check to make sure that the two conditional attrs for inner and outer are both ,
     // as well as record the indexes of each of these attrs
     bool attr_exists = false;
@@ -395,11 +535,12 @@ INLJoin::INLJoin(Iterator *leftIn,           // Iterator of input R
         }
     }
 
-    if (!attr_exists) {
+    if (!attr_exists || !cond.bRhsIsAttr) {
         error = JOIN_BAD_COND;
         return;
     }
 
+    attr_exists = false;
     for (unsigned i = 0; i < right_attrs.size(); i += 1) {
         if (right_attrs[i].name.compare(cond.rhsAttr) == 0) {
             attr_exists = true;
@@ -408,7 +549,7 @@ INLJoin::INLJoin(Iterator *leftIn,           // Iterator of input R
         }
     }
 
-    if (!attr_exists) {
+    if (!attr_exists || left_attrs[left_attr_comp_index].type != right_attrs[right_attr_comp_index].type) {
         error  = JOIN_BAD_COND;
         return;
     }
@@ -424,214 +565,106 @@ INLJoin::INLJoin(Iterator *leftIn,           // Iterator of input R
     error = SUCCESS;
 }
 
+INLJoin::~INLJoin() {
+    free(outer_page_data);
+    free(inner_page_data);
+    free(probe_key);
+}
+
 RC INLJoin::getNextTuple(void *data) {
     if (error)
         return error;
-    // start looping through left, loop through all of right, check condition
-    // for each condition, concat the two and return it
-    RC outer_rc;
-    RC inner_rc;
-    // set up getting the first tuple from left iter
-    void* inner_page_data = malloc(PAGE_SIZE);
-    // we do not want to get a new tuple from left each time we call get next tuple, only when we reach EOF of inner loop
-    if (newLeft) {
-        outer_rc = left->getNextTuple(outer_page_data);
-        if (outer_rc == QE_EOF) {
-            free(inner_page_data);
-            return outer_rc;
-        }
-
-        if (outer_rc) {
-            free(inner_page_data);
-            return outer_rc;
-        }
-    }
-
-    while ((inner_rc = right->getNextTuple(inner_page_data)) == SUCCESS) {
-        // do comparison
-        // getAttributeFromRecord(inner_page_data, 0, right_attr_comp_index, right_attrs[right_attr_comp_index].type, right_data);
-        int right_comp_attr_offset = getAttributeOffset(inner_page_data, false);
-        int left_comp_attr_offset = getAttributeOffset(outer_page_data, true);
-      
-        // get left data
-        void* left_comp_data = NULL;
-        switch (left_attrs[left_attr_comp_index].type)
-        {
-            case TypeInt:
-                left_comp_data = malloc(INT_SIZE);
-                memcpy(left_comp_data, (char*)outer_page_data + left_comp_attr_offset, INT_SIZE);
-                break;
-            case TypeReal:
-                left_comp_data = malloc(REAL_SIZE);
-                memcpy(left_comp_data, (char*)outer_page_data + left_comp_attr_offset, REAL_SIZE);
-                break;
-            case TypeVarChar:
-                uint32_t varcharSize;
-                // We have to get the size of the VarChar field by reading the integer that precedes the string value itself
-                memcpy(&varcharSize, (char*)outer_page_data + left_comp_attr_offset, VARCHAR_LENGTH_SIZE);
-                left_comp_data = malloc(VARCHAR_LENGTH_SIZE + varcharSize);
-                memcpy(left_comp_data, &varcharSize, VARCHAR_LENGTH_SIZE);
-                memcpy(left_comp_data, (char*)outer_page_data + left_comp_attr_offset + VARCHAR_LENGTH_SIZE, varcharSize);
-                break;
-            default:
-                cerr << "getNextTuple: Invalid attribute type." << endl;
+    // For each outer tuple, probe the index with its join key and return every match
+    RC rc;
+    while (true) {
+        if (newLeft) {
+            rc = left->getNextTuple(outer_page_data);
+            if (rc)
+                return rc;
+            // A null key joins with nothing
+            if (fieldIsNull((char*) outer_page_data, left_attr_comp_index))
+                continue;
+            rc = probe();
+            if (rc)
+                return rc;
+            newLeft = false;
         }
 
-        // get right data
-        void* right_comp_data = NULL;
-        switch (left_attrs[left_attr_comp_index].type)
-        {
-            case TypeInt:
-                right_comp_data = malloc(INT_SIZE);
-                memcpy(right_comp_data, (char*)inner_page_data + right_comp_attr_offset, INT_SIZE);
-                break;
-            case TypeReal:
-                right_comp_data = malloc(REAL_SIZE);
-                memcpy(right_comp_data, (char*)inner_page_data + right_comp_attr_offset, REAL_SIZE);
-                break;
-            case TypeVarChar:
-                uint32_t varcharSize;
-                // We have to get the size of the VarChar field by reading the integer that precedes the string value itself
-                memcpy(&varcharSize, (char*)inner_page_data + right_comp_attr_offset, VARCHAR_LENGTH_SIZE);
-                right_comp_data = malloc(VARCHAR_LENGTH_SIZE + varcharSize);
-                memcpy(right_comp_data, &varcharSize, VARCHAR_LENGTH_SIZE);
-                memcpy(right_comp_data, (char*)inner_page_data + right_comp_attr_offset + VARCHAR_LENGTH_SIZE, varcharSize);
-                break;
-            default:
-                cerr << "getNextTuple: Invalid attribute type." << endl;
+        rc = right->getNextTuple(inner_page_data);
+        if (rc == QE_EOF) {
+            newLeft = true;
+            continue;
         }
+        if (rc)
+            return rc;
 
-        // do comparison
-        bool equal = false;
-        switch (left_attrs[left_attr_comp_index].type)
-        {
-            case TypeInt:
-                if (*((int*)right_comp_data) == *((int*)left_comp_data))
-                    equal = true;
-                break;
-            case TypeReal:
-                if (*((float*)right_comp_data) == *((float*)left_comp_data))
-                    equal = true;
-                break;
-            case TypeVarChar:
-                uint32_t lVarcharSize;
-                uint32_t rVarcharSize;
-                // We have to get the size of the VarChar field by reading the integer that precedes the string value itself
-                memcpy(&lVarcharSize, left_comp_data, VARCHAR_LENGTH_SIZE);
-                memcpy(&rVarcharSize, right_comp_data, VARCHAR_LENGTH_SIZE);
-
-                char* left_string = (char*)malloc(lVarcharSize + 1);
-                char* right_string = (char*)malloc(rVarcharSize + 1);
-
-                memcpy(left_string, (char*)left_comp_data + VARCHAR_LENGTH_SIZE, lVarcharSize);
-                memcpy(right_string, (char*)right_comp_data + VARCHAR_LENGTH_SIZE, rVarcharSize);
-
-                left_string[lVarcharSize] = '\0';
-                right_string[rVarcharSize] = '\0';
-
-                if (strcmp(left_string, right_string)) {
-                    equal = true;
-                }
-
-                free(left_string);
-                free(right_string);
-                // right_comp_data = malloc(VARCHAR_LENGTH_SIZE + varcharSize);
-                // memcpy(right_comp_data, &varcharSize, VARCHAR_LENGTH_SIZE);
-                // memcpy(right_comp_data, (char*)inner_page_data + right_comp_attr_offset + VARCHAR_LENGTH_SIZE, varcharSize);
-                break;
-        }
-      
-        if (!equal) {
-            free(right_comp_data);
-            free(left_comp_data);
+        // NE_OP scans the whole index, skip the entries equal to the key
+        if (cond.op == NE_OP && probeKeyMatches(right->key))
             continue;
-        }
 
-        // if comparison is true
-        // need to get the length of the left side, move it into the data param
-        // then need to set offset, and then move the right side data in after 
-        // that offset, but only the length of the data otherwise we might write
-        // past the buffer of *data. We should add the lengths to ensure <4096
-        unsigned inner_size = getRecordSize(right->attrs, inner_page_data);
-        vector<Attribute> left_attrs;
-        left->getAttributes(left_attrs);
-        unsigned outer_size = getRecordSize(left_attrs, outer_page_data);
-        if ((inner_size + outer_size) >= 4096)
-            return JOIN_RSLT_TOO_BIG;
-
-        memcpy(data, outer_page_data, outer_size);
-        memcpy((char*)data + outer_size, inner_page_data, inner_size);
-        free(right_comp_data);
-        free(left_comp_data);
-        return SUCCESS;
+        return joinTuples(data);
     }
+}
 
-    if (inner_rc == QE_EOF) {
-        right->setIterator(NULL, NULL, true, true);
-        outer_rc = left->getNextTuple(outer_page_data); // can either do this OR can set newLeft = true
-        if (outer_rc == QE_EOF) {
-            free(inner_page_data);
-            return outer_rc;
-        }
+// Restarts the index scan on the range of inner keys that satisfy the condition for the current outer tuple
+RC INLJoin::probe() {
+    int offset = getAttributeOffset(outer_page_data, true);
+    unsigned length = INT_SIZE;
+    if (left_attrs[left_attr_comp_index].type == TypeVarChar) {
+        uint32_t varcharSize;
+        memcpy(&varcharSize, (char*) outer_page_data + offset, VARCHAR_LENGTH_SIZE);
+        length = VARCHAR_LENGTH_SIZE + varcharSize;
+    }
+    memcpy(probe_key, (char*) outer_page_data + offset, length);
+
+    // The condition reads left OP right, so the key bounds the inner range from the opposite side
+    switch (cond.op) {
+        case EQ_OP: right->setIterator(probe_key, probe_key, true, true); break;
+        case LT_OP: right->setIterator(probe_key, NULL, false, true); break;
+        case LE_OP: right->setIterator(probe_key, NULL, true, true); break;
+        case GT_OP: right->setIterator(NULL, probe_key, true, false); break;
+        case GE_OP: right->setIterator(NULL, probe_key, true, true); break;
+        case NE_OP:
+        case NO_OP: right->setIterator(NULL, NULL, true, true); break;
+        default: return JOIN_BAD_COND;
+    }
+    return SUCCESS;
+}
 
-        if (outer_rc) {
-            free(inner_page_data);
-            return outer_rc;
-        }
+bool INLJoin::probeKeyMatches(const void *key) {
+    switch (left_attrs[left_attr_comp_index].type) {
+        case TypeInt:
+            return memcmp(key, probe_key, INT_SIZE) == 0;
+        case TypeReal:
+            float keyReal, probeReal;
+            memcpy(&keyReal, key, REAL_SIZE);
+            memcpy(&probeReal, probe_key, REAL_SIZE);
+            return keyReal == probeReal;
+        case TypeVarChar:
+            uint32_t varcharSize;
+            memcpy(&varcharSize, probe_key, VARCHAR_LENGTH_SIZE);
+            return memcmp(key, probe_key, VARCHAR_LENGTH_SIZE + varcharSize) == 0;
     }
+    return false;
+}
 
-    free(inner_page_data);
-    return getNextTuple(data);
+// Concatenates the outer and inner tuples under a single null indicator
+RC INLJoin::joinTuples(void *data) {
+    return ::joinTuples(left_attrs, outer_page_data, right_attrs, inner_page_data, data);
 }
 
 void INLJoin::getAttributes(vector<Attribute> &attrs) const {
     attrs = total_attrs;
 }
 
-int INLJoin::getNullIndicatorSize(int fieldCount) 
-{
-    return int(ceil((double) fieldCount / CHAR_BIT));
+// Joined tuples are written straight into the batch
+RC INLJoin::getNextBatch(TupleBatch &batch) {
+    return fillBatch(batch, total_attrs, [this](void *data) { return INLJoin::getNextTuple(data); });
 }
 
-unsigned INLJoin::getRecordSize(const vector<Attribute> &recordDescriptor, const void *data) 
+int INLJoin::getNullIndicatorSize(int fieldCount) 
 {
-    // Read in the null indicator
-    int nullIndicatorSize = getNullIndicatorSize(recordDescriptor.size());
-    char nullIndicator[nullIndicatorSize];
-    memset(nullIndicator, 0, nullIndicatorSize);
-    memcpy(nullIndicator, (char*) data, nullIndicatorSize);
-
-    // Offset into *data. Start just after null indicator
-    unsigned offset = nullIndicatorSize;
-    // Running count of size. Initialize to size of header
-    unsigned size = sizeof (RecordLength) + (recordDescriptor.size()) * sizeof(ColumnOffset) + nullIndicatorSize;
-    for (unsigned i = 0; i < (unsigned) recordDescriptor.size(); i++)
-    {
-        // Skip null fields
-        if (fieldIsNull(nullIndicator, i))
-            continue;
-
-        switch (recordDescriptor[i].type)
-        {
-            case TypeInt:
-                size += INT_SIZE;
-                offset += INT_SIZE;
-                break;
-            case TypeReal:
-                size += REAL_SIZE;
-                offset += REAL_SIZE;
-                break;
-            case TypeVarChar:
-                uint32_t varcharSize;
-                // We have to get the size of the VarChar field by reading the integer that precedes the string value itself
-                memcpy(&varcharSize, (char*) data + offset, VARCHAR_LENGTH_SIZE);
-                size += varcharSize;
-                offset += varcharSize + VARCHAR_LENGTH_SIZE;
-                break;
-        }
-    }
-
-    return offset;
+    return int(ceil((double) fieldCount / CHAR_BIT));
 }
 
 int INLJoin::getAttributeOffset(void* data, bool left) {
@@ -642,15 +675,13 @@ int INLJoin::getAttributeOffset(void* data, bool left) {
         attr_index = left_attr_comp_index;
         int nullIndicatorSize = getNullIndicatorSize(left_attrs.size());
         offset += nullIndicatorSize;
-        nullIndicator = (char*)calloc(nullIndicatorSize, 1);
-        memcpy(nullIndicator, data, nullIndicatorSize);
+        nullIndicator = (char*)data;
     }
     else {
         attr_index = right_attr_comp_index;
         int nullIndicatorSize = getNullIndicatorSize(right_attrs.size());
         offset += nullIndicatorSize;
-        nullIndicator = (char*)calloc(nullIndicatorSize, 1);
-        memcpy(nullIndicator, data, nullIndicatorSize);
+        nullIndicator = (char*)data;
     }
 
     if (left) {
@@ -838,3 +869,1192 @@ bool Filter::checkScanCondition(char *recordString, CompOp compOp, const void *v
 //         default: return false;
 //     }
 // }
+
+BNLJoin::BNLJoin(Iterator *leftIn,            // Iterator of input R
+        TableScan *rightIn,           // TableScan Iterator of input S
+        const Condition &condition,   // Join condition
+        const unsigned numPages) {    // # of pages that can be loaded into memory
+
+    left = leftIn;
+    right = rightIn;
+    cond = condition;
+    leftIn->getAttributes(left_attrs);
+    rightIn->getAttributes(right_attrs);
+    total_attrs = left_attrs;
+    total_attrs.insert(total_attrs.end(), right_attrs.begin(), right_attrs.end());
+
+    block_size = (size_t) numPages * PAGE_SIZE;
+    block.reserve(block_size);
+    left_tuple = malloc(PAGE_SIZE);
+    right_tuple = malloc(PAGE_SIZE);
+    has_pending = false;
+    left_done = false;
+    block_loaded = false;
+    first_block = true;
+    next_match = 0;
+
+    if (numPages == 0)
+        error = JOIN_BAD_BLOCK_SIZE;
+    else if (!findJoinAttributes(cond, left_attrs, right_attrs, left_attr_comp_index, right_attr_comp_index))
+        error = JOIN_BAD_COND;
+    else
+        error = SUCCESS;
+}
+
+BNLJoin::~BNLJoin() {
+    free(left_tuple);
+    free(right_tuple);
+}
+
+RC BNLJoin::getNextTuple(void *data) {
+    if (error)
+        return error;
+    RC rc;
+    while (true) {
+        // Emit the block tuples that match the current right tuple
+        if (next_match < matches.size()) {
+            unsigned offset = matches[next_match++];
+            return joinTuples(left_attrs, &block[offset], right_attrs, right_tuple, data);
+        }
+
+        if (!block_loaded) {
+            rc = loadBlock();
+            if (rc)
+                return rc;
+        }
+
+        rc = right->getNextTuple(right_tuple);
+        if (rc == QE_EOF) {
+            // The right side has seen the whole block, move on to the next one
+            block_loaded = false;
+            continue;
+        }
+        if (rc)
+            return rc;
+        findMatches();
+    }
+}
+
+// Fills the block with as many left tuples as fit and restarts the right side on it
+RC BNLJoin::loadBlock() {
+    block.clear();
+    block_table.clear();
+    block_tuples.clear();
+    matches.clear();
+    next_match = 0;
+
+    string key;
+    while (!left_done) {
+        if (!has_pending) {
+            RC rc = left->getNextTuple(left_tuple);
+            if (rc == QE_EOF) {
+                left_done = true;
+                break;
+            }
+            if (rc)
+                return rc;
+            // A null key joins with nothing
+            if (tupleFieldIsNull(left_tuple, left_attr_comp_index))
+                continue;
+            has_pending = true;
+        }
+
+        unsigned length = getTupleLength(left_attrs, left_tuple);
+        if (!block.empty() && block.size() + length > block_size)
+            break;
+        unsigned offset = block.size();
+        block.insert(block.end(), (char*) left_tuple, (char*) left_tuple + length);
+        has_pending = false;
+        if (cond.op == EQ_OP) {
+            getJoinKey(left_attrs, left_tuple, left_attr_comp_index, key);
+            block_table.insert(make_pair(key, offset));
+        }
+        else
+            block_tuples.push_back(offset);
+    }
+    if (block.empty())
+        return QE_EOF;
+
+    if (!first_block)
+        right->setIterator();
+    first_block = false;
+    block_loaded = true;
+    return SUCCESS;
+}
+
+void BNLJoin::findMatches() {
+    matches.clear();
+    next_match = 0;
+    if (tupleFieldIsNull(right_tuple, right_attr_comp_index))
+        return;
+
+    if (cond.op == EQ_OP) {
+        string key;
+        getJoinKey(right_attrs, right_tuple, right_attr_comp_index, key);
+        auto range = block_table.equal_range(key);
+        for (auto it = range.first; it != range.second; it++)
+            matches.push_back(it->second);
+        return;
+    }
+
+    // Other comparisons have to look at every tuple of the block
+    const char *rightField = (char*) right_tuple + getFieldOffset(right_attrs, right_tuple, right_attr_comp_index);
+    AttrType type = left_attrs[left_attr_comp_index].type;
+    for (unsigned i = 0; i < block_tuples.size(); i++) {
+        const char *leftTuple = &block[block_tuples[i]];
+        const char *leftField = leftTuple + getFieldOffset(left_attrs, leftTuple, left_attr_comp_index);
+        if (satisfiesCondition(cond.op, compareFields(type, leftField, rightField)))
+            matches.push_back(block_tuples[i]);
+    }
+}
+
+void BNLJoin::getAttributes(vector<Attribute> &attrs) const {
+    attrs = total_attrs;
+}
+
+// Joined tuples are written straight into the batch
+RC BNLJoin::getNextBatch(TupleBatch &batch) {
+    return fillBatch(batch, total_attrs, [this](void *data) { return BNLJoin::getNextTuple(data); });
+}
+
+// Spreads the join key over the partitions, differently at every level so a partition can be split again
+static unsigned hashJoinKey(const string &key, unsigned level, unsigned numPartitions)
+{
+    unsigned long long h = hash<string>()(key) ^ (0x9e3779b97f4a7c15ULL * (level + 1));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h % numPartitions;
+}
+
+// Distinguishes the partition files of every GHJoin in the process
+static unsigned ghjoinInstances = 0;
+
+GHJoin::GHJoin(Iterator *leftIn,               // Iterator of input R
+        Iterator *rightIn,               // Iterator of input S
+        const Condition &condition,      // Join condition (CompOp is always EQ)
+        const unsigned numPartitions,    // Number of partitions for each relation
+        const unsigned numPages) {       // Memory for building one partition
+
+    left = leftIn;
+    right = rightIn;
+    cond = condition;
+    leftIn->getAttributes(left_attrs);
+    rightIn->getAttributes(right_attrs);
+    total_attrs = left_attrs;
+    total_attrs.insert(total_attrs.end(), right_attrs.begin(), right_attrs.end());
+    for (unsigned i = 0; i < left_attrs.size(); i++)
+        left_names.push_back(left_attrs[i].name);
+    for (unsigned i = 0; i < right_attrs.size(); i++)
+        right_names.push_back(right_attrs[i].name);
+
+    num_partitions = numPartitions;
+    budget = (size_t) numPages * PAGE_SIZE;
+    partitioned = false;
+    probing = false;
+    build_left = true;
+    instance = ghjoinInstances++;
+    next_file = 0;
+    probe_tuple = malloc(PAGE_SIZE);
+    next_match = 0;
+
+    if (numPartitions < 2)
+        error = JOIN_BAD_PARTITIONS;
+    else if (numPages == 0)
+        error = JOIN_BAD_BLOCK_SIZE;
+    else if (cond.op != EQ_OP || !findJoinAttributes(cond, left_attrs, right_attrs, left_attr_comp_index, right_attr_comp_index))
+        error = JOIN_BAD_COND;
+    else
+        error = SUCCESS;
+}
+
+GHJoin::~GHJoin() {
+    if (probing)
+        finishPartition();
+    // Partitions that were never joined
+    while (!temp_files.empty()) {
+        string fileName = *temp_files.begin();
+        destroyTempFile(fileName);
+    }
+    free(probe_tuple);
+}
+
+RC GHJoin::getNextTuple(void *data) {
+    if (error)
+        return error;
+    RC rc;
+    if (!partitioned) {
+        partitioned = true;
+        rc = addPartitions([&](void *tuple) { return left->getNextTuple(tuple); },
+                [&](void *tuple) { return right->getNextTuple(tuple); }, 0);
+        if (rc)
+            return error = rc;
+    }
+
+    RID rid;
+    while (true) {
+        if (next_match < matches.size()) {
+            const char *tuple = &table_tuples[matches[next_match++]];
+            if (build_left)
+                return joinTuples(left_attrs, tuple, right_attrs, probe_tuple, data);
+            return joinTuples(left_attrs, probe_tuple, right_attrs, tuple, data);
+        }
+
+        if (!probing) {
+            rc = nextPartition();
+            if (rc)
+                return rc;
+            continue;
+        }
+
+        rc = probe_iter.getNextRecord(rid, probe_tuple);
+        if (rc == RBFM_EOF) {
+            finishPartition();
+            continue;
+        }
+        if (rc)
+            return rc;
+
+        // Partition files hold no null keys
+        string key;
+        if (build_left)
+            getJoinKey(right_attrs, probe_tuple, right_attr_comp_index, key);
+        else
+            getJoinKey(left_attrs, probe_tuple, left_attr_comp_index, key);
+        matches.clear();
+        next_match = 0;
+        auto range = table.equal_range(key);
+        for (auto it = range.first; it != range.second; it++)
+            matches.push_back(it->second);
+    }
+}
+
+void GHJoin::getAttributes(vector<Attribute> &attrs) const {
+    attrs = total_attrs;
+}
+
+// Joined tuples are written straight into the batch
+RC GHJoin::getNextBatch(TupleBatch &batch) {
+    return fillBatch(batch, total_attrs, [this](void *data) { return GHJoin::getNextTuple(data); });
+}
+
+// Writes the tuples of one input into numPartitions new partition files
+RC GHJoin::partitionInput(function<RC(void*)> next, bool leftSide, unsigned level,
+        vector<string> &files, vector<size_t> &bytes) {
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    const vector<Attribute> &attrs = leftSide ? left_attrs : right_attrs;
+    int keyIndex = leftSide ? left_attr_comp_index : right_attr_comp_index;
+
+    RC rc = SUCCESS;
+    vector<FileHandle*> handles;
+    files.clear();
+    bytes.assign(num_partitions, 0);
+    for (unsigned i = 0; i < num_partitions && rc == SUCCESS; i++) {
+        string fileName = "ghjoin_" + to_string(getpid()) + "_" + to_string(instance) + "_" + to_string(next_file++);
+        rc = rbfm->createFile(fileName);
+        if (rc)
+            break;
+        temp_files.insert(fileName);
+        files.push_back(fileName);
+        handles.push_back(new FileHandle());
+        rc = rbfm->openFile(fileName, *handles.back());
+    }
+
+    void *tuple = malloc(PAGE_SIZE);
+    string key;
+    RID rid;
+    while (rc == SUCCESS && (rc = next(tuple)) == SUCCESS) {
+        // A null key joins with nothing
+        if (tupleFieldIsNull(tuple, keyIndex))
+            continue;
+        getJoinKey(attrs, tuple, keyIndex, key);
+        unsigned i = hashJoinKey(key, level, num_partitions);
+        rc = rbfm->insertRecord(*handles[i], attrs, tuple, rid);
+        bytes[i] += getTupleLength(attrs, tuple);
+    }
+    if (rc == QE_EOF)
+        rc = SUCCESS;
+    free(tuple);
+
+    for (unsigned i = 0; i < handles.size(); i++) {
+        rbfm->closeFile(*handles[i]);
+        delete handles[i];
+    }
+    return rc;
+}
+
+RC GHJoin::addPartitions(function<RC(void*)> nextLeft, function<RC(void*)> nextRight, unsigned level) {
+    vector<string> leftFiles, rightFiles;
+    vector<size_t> leftBytes, rightBytes;
+    RC rc = partitionInput(nextLeft, true, level, leftFiles, leftBytes);
+    if (rc == SUCCESS)
+        rc = partitionInput(nextRight, false, level, rightFiles, rightBytes);
+    if (rc)
+        return rc;
+    for (unsigned i = 0; i < num_partitions; i++) {
+        Partition partition;
+        partition.leftFile = leftFiles[i];
+        partition.rightFile = rightFiles[i];
+        partition.leftBytes = leftBytes[i];
+        partition.rightBytes = rightBytes[i];
+        partition.level = level;
+        partitions.push_back(partition);
+    }
+    return SUCCESS;
+}
+
+// Splits a partition pair whose smaller side does not fit in memory
+RC GHJoin::repartition(const Partition &partition) {
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    FileHandle leftHandle, rightHandle;
+    RBFM_ScanIterator leftIter, rightIter;
+    RID rid;
+    RC rc = rbfm->openFile(partition.leftFile, leftHandle);
+    if (rc == SUCCESS)
+        rc = rbfm->openFile(partition.rightFile, rightHandle);
+    if (rc == SUCCESS)
+        rc = rbfm->scan(leftHandle, left_attrs, "", NO_OP, NULL, left_names, leftIter);
+    if (rc == SUCCESS)
+        rc = rbfm->scan(rightHandle, right_attrs, "", NO_OP, NULL, right_names, rightIter);
+    if (rc == SUCCESS)
+        rc = addPartitions([&](void *tuple) { return leftIter.getNextRecord(rid, tuple); },
+                [&](void *tuple) { return rightIter.getNextRecord(rid, tuple); }, partition.level + 1);
+    leftIter.close();
+    rightIter.close();
+    rbfm->closeFile(leftHandle);
+    rbfm->closeFile(rightHandle);
+    return rc;
+}
+
+// Loads the smaller side of a partition pair into memory and starts scanning the other side
+RC GHJoin::buildPartition(const Partition &partition) {
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    build_left = partition.leftBytes <= partition.rightBytes;
+    const vector<Attribute> &attrs = build_left ? left_attrs : right_attrs;
+    int keyIndex = build_left ? left_attr_comp_index : right_attr_comp_index;
+
+    table_tuples.clear();
+    table.clear();
+    table_tuples.reserve(build_left ? partition.leftBytes : partition.rightBytes);
+    FileHandle buildHandle;
+    RBFM_ScanIterator buildIter;
+    RC rc = rbfm->openFile(build_left ? partition.leftFile : partition.rightFile, buildHandle);
+    if (rc)
+        return rc;
+    rc = rbfm->scan(buildHandle, attrs, "", NO_OP, NULL, build_left ? left_names : right_names, buildIter);
+    RID rid;
+    string key;
+    while (rc == SUCCESS && (rc = buildIter.getNextRecord(rid, probe_tuple)) == SUCCESS) {
+        unsigned offset = table_tuples.size();
+        table_tuples.insert(table_tuples.end(), (char*) probe_tuple, (char*) probe_tuple + getTupleLength(attrs, probe_tuple));
+        getJoinKey(attrs, probe_tuple, keyIndex, key);
+        table.insert(make_pair(key, offset));
+    }
+    buildIter.close();
+    rbfm->closeFile(buildHandle);
+    if (rc != RBFM_EOF)
+        return rc;
+
+    current = partition;
+    rc = rbfm->openFile(build_left ? partition.rightFile : partition.leftFile, probe_handle);
+    if (rc)
+        return rc;
+    rc = rbfm->scan(probe_handle, build_left ? right_attrs : left_attrs, "", NO_OP, NULL,
+            build_left ? right_names : left_names, probe_iter);
+    if (rc) {
+        rbfm->closeFile(probe_handle);
+        return rc;
+    }
+    probing = true;
+    return SUCCESS;
+}
+
+// Moves on to the next partition pair, splitting the ones that are too large
+RC GHJoin::nextPartition() {
+    while (!partitions.empty()) {
+        Partition partition = partitions.back();
+        partitions.pop_back();
+
+        RC rc = SUCCESS;
+        if (partition.leftBytes == 0 || partition.rightBytes == 0)
+            ;
+        // A partition of a single key cannot be split, past the depth limit it is built as it is
+        else if (min(partition.leftBytes, partition.rightBytes) > budget && partition.level < GHJOIN_MAX_DEPTH)
+            rc = repartition(partition);
+        else
+            return buildPartition(partition);
+
+        destroyTempFile(partition.leftFile);
+        destroyTempFile(partition.rightFile);
+        if (rc)
+            return rc;
+    }
+    return QE_EOF;
+}
+
+void GHJoin::finishPartition() {
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    probe_iter.close();
+    rbfm->closeFile(probe_handle);
+    probing = false;
+    matches.clear();
+    next_match = 0;
+    table.clear();
+    table_tuples.clear();
+    destroyTempFile(current.leftFile);
+    destroyTempFile(current.rightFile);
+}
+
+void GHJoin::destroyTempFile(const string &fileName) {
+    RecordBasedFileManager::instance()->destroyFile(fileName);
+    temp_files.erase(fileName);
+}
+
+// Distinguishes the spill files of every Aggregate in the process
+static unsigned aggregateInstances = 0;
+
+static const char *aggregateOpNames[] = { "MIN", "MAX", "COUNT", "SUM", "AVG" };
+
+Aggregate::Aggregate(Iterator *input, Attribute aggAttr, AggregateOp op) {
+    init(input, aggAttr, op);
+    grouped = false;
+    max_groups = 1;
+    group_index = -1;
+}
+
+Aggregate::Aggregate(Iterator *input, Attribute aggAttr, Attribute groupAttr, AggregateOp op, const unsigned maxGroups) {
+    init(input, aggAttr, op);
+    grouped = true;
+    group_attr = groupAttr;
+    max_groups = maxGroups;
+    group_index = -1;
+    for (unsigned i = 0; i < input_attrs.size(); i++) {
+        if (input_attrs[i].name == groupAttr.name)
+            group_index = i;
+    }
+    if (error == SUCCESS && group_index < 0)
+        error = AGG_BAD_ATTR;
+    if (error == SUCCESS && maxGroups == 0)
+        error = AGG_BAD_BUDGET;
+
+    // Spilled tuples keep only the group and the aggregated value
+    if (error)
+        return;
+    spill_attrs.push_back(input_attrs[group_index]);
+    spill_attrs.push_back(input_attrs[agg_index]);
+    spill_attrs[0].name = "group";
+    spill_attrs[1].name = "value";
+    spill_names.push_back("group");
+    spill_names.push_back("value");
+}
+
+void Aggregate::init(Iterator *input, const Attribute &aggAttr, AggregateOp op) {
+    this->input = input;
+    agg_attr = aggAttr;
+    this->op = op;
+    input->getAttributes(input_attrs);
+    started = false;
+    instance = aggregateInstances++;
+    next_file = 0;
+
+    agg_index = -1;
+    for (unsigned i = 0; i < input_attrs.size(); i++) {
+        if (input_attrs[i].name == aggAttr.name)
+            agg_index = i;
+    }
+    // Only COUNT makes sense for a varchar
+    if (agg_index < 0 || (input_attrs[agg_index].type == TypeVarChar && op != COUNT))
+        error = AGG_BAD_ATTR;
+    else
+        error = SUCCESS;
+}
+
+Aggregate::~Aggregate() {
+    while (!temp_files.empty()) {
+        string fileName = *temp_files.begin();
+        destroyTempFile(fileName);
+    }
+}
+
+RC Aggregate::getNextTuple(void *data) {
+    if (error)
+        return error;
+    RC rc;
+
+    // A scalar aggregate is one pass and one tuple
+    if (!grouped) {
+        if (started)
+            return QE_EOF;
+        started = true;
+        AggregateState state = { 0, 0, 0, 0 };
+        void *tuple = malloc(PAGE_SIZE);
+        while ((rc = input->getNextTuple(tuple)) == SUCCESS)
+            update(state, input_attrs, tuple, agg_index);
+        free(tuple);
+        if (rc != QE_EOF)
+            return rc;
+        *(unsigned char*) data = 0;
+        writeResult(state, (unsigned char*) data, 0, (char*) data + 1);
+        return SUCCESS;
+    }
+
+    if (!started) {
+        started = true;
+        rc = aggregatePass([&](void *tuple) { return input->getNextTuple(tuple); }, input_attrs, group_index, agg_index, 0);
+        if (rc)
+            return error = rc;
+    }
+
+    while (true) {
+        if (next_group != groups.end()) {
+            // The key is a flag byte followed by the group value
+            const string &key = next_group->first;
+            unsigned char *nullIndicator = (unsigned char*) data;
+            *nullIndicator = 0;
+            unsigned offset = 1;
+            if (key[0] == 0)
+                *nullIndicator |= 1 << 7;
+            else {
+                memcpy((char*) data + offset, key.data() + 1, key.size() - 1);
+                offset += key.size() - 1;
+            }
+            writeResult(next_group->second, nullIndicator, 1, (char*) data + offset);
+            next_group++;
+            return SUCCESS;
+        }
+
+        // Then the groups that did not fit, one spill file at a time
+        if (spills.empty())
+            return QE_EOF;
+        Spill spill = spills.back();
+        spills.pop_back();
+
+        RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+        FileHandle fileHandle;
+        RBFM_ScanIterator iter;
+        RID rid;
+        rc = rbfm->openFile(spill.fileName, fileHandle);
+        if (rc == SUCCESS)
+            rc = rbfm->scan(fileHandle, spill_attrs, "", NO_OP, NULL, spill_names, iter);
+        if (rc == SUCCESS)
+            rc = aggregatePass([&](void *tuple) { return iter.getNextRecord(rid, tuple); }, spill_attrs, 0, 1, spill.level + 1);
+        iter.close();
+        rbfm->closeFile(fileHandle);
+        destroyTempFile(spill.fileName);
+        if (rc)
+            return error = rc;
+    }
+}
+
+// Aggregates the tuples of groups that fit in memory, the tuples of the other groups are spilled
+RC Aggregate::aggregatePass(function<RC(void*)> next, const vector<Attribute> &attrs, int groupIndex, int aggIndex, unsigned level) {
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    groups.clear();
+    vector<FileHandle*> handles;
+    void *tuple = malloc(PAGE_SIZE);
+    void *spilled = malloc(PAGE_SIZE);
+    string key;
+    RID rid;
+    RC rc;
+    while ((rc = next(tuple)) == SUCCESS) {
+        // Nulls form one group
+        key.assign(1, 0);
+        if (!tupleFieldIsNull(tuple, groupIndex)) {
+            string value;
+            getJoinKey(attrs, tuple, groupIndex, value);
+            key.assign(1, 1);
+            key += value;
+        }
+
+        auto it = groups.find(key);
+        if (it == groups.end() && (groups.size() < max_groups || level >= AGG_MAX_DEPTH)) {
+            AggregateState state = { 0, 0, 0, 0 };
+            it = groups.insert(make_pair(key, state)).first;
+        }
+        if (it != groups.end()) {
+            update(it->second, attrs, tuple, aggIndex);
+            continue;
+        }
+
+        // The group does not fit, keep the tuple for a later pass
+        if (handles.empty()) {
+            for (unsigned i = 0; i < AGG_SPILL_PARTITIONS && rc == SUCCESS; i++) {
+                Spill spill;
+                spill.fileName = "aggregate_" + to_string(getpid()) + "_" + to_string(instance) + "_" + to_string(next_file++);
+                spill.level = level;
+                rc = rbfm->createFile(spill.fileName);
+                if (rc)
+                    break;
+                temp_files.insert(spill.fileName);
+                spills.push_back(spill);
+                handles.push_back(new FileHandle());
+                rc = rbfm->openFile(spill.fileName, *handles.back());
+            }
+            if (rc)
+                break;
+        }
+        unsigned char *nullIndicator = (unsigned char*) spilled;
+        *nullIndicator = 0;
+        unsigned offset = 1;
+        if (key[0] == 0)
+            *nullIndicator |= 1 << 7;
+        else {
+            const char *field = (char*) tuple + getFieldOffset(attrs, tuple, groupIndex);
+            unsigned length = getFieldLength(attrs[groupIndex], field);
+            memcpy((char*) spilled + offset, field, length);
+            offset += length;
+        }
+        if (tupleFieldIsNull(tuple, aggIndex))
+            *nullIndicator |= 1 << 6;
+        else {
+            const char *field = (char*) tuple + getFieldOffset(attrs, tuple, aggIndex);
+            memcpy((char*) spilled + offset, field, getFieldLength(attrs[aggIndex], field));
+        }
+        rc = rbfm->insertRecord(*handles[hashJoinKey(key, level, AGG_SPILL_PARTITIONS)], spill_attrs, spilled, rid);
+        if (rc)
+            break;
+    }
+    free(tuple);
+    free(spilled);
+    for (unsigned i = 0; i < handles.size(); i++) {
+        rbfm->closeFile(*handles[i]);
+        delete handles[i];
+    }
+
+    next_group = groups.begin();
+    return rc == QE_EOF ? SUCCESS : rc;
+}
+
+void Aggregate::update(AggregateState &state, const vector<Attribute> &attrs, const void *tuple, int aggIndex) {
+    // Null values are not aggregated
+    if (tupleFieldIsNull(tuple, aggIndex))
+        return;
+    double value = 0;
+    const char *field = (const char*) tuple + getFieldOffset(attrs, tuple, aggIndex);
+    if (attrs[aggIndex].type == TypeInt) {
+        int32_t intValue;
+        memcpy(&intValue, field, INT_SIZE);
+        value = intValue;
+    }
+    else if (attrs[aggIndex].type == TypeReal) {
+        float realValue;
+        memcpy(&realValue, field, REAL_SIZE);
+        value = realValue;
+    }
+
+    if (state.count == 0 || value < state.min)
+        state.min = value;
+    if (state.count == 0 || value > state.max)
+        state.max = value;
+    state.sum += value;
+    state.count++;
+}
+
+// Writes the aggregate as a float, an aggregate over no values other than COUNT is null
+unsigned Aggregate::writeResult(const AggregateState &state, unsigned char *nullIndicator, int field, void *data) {
+    if (state.count == 0 && op != COUNT) {
+        *nullIndicator |= 1 << (CHAR_BIT - 1 - field);
+        return 0;
+    }
+    float result = 0;
+    switch (op) {
+        case MIN: result = state.min; break;
+        case MAX: result = state.max; break;
+        case COUNT: result = state.count; break;
+        case SUM: result = state.sum; break;
+        case AVG: result = state.sum / state.count; break;
+    }
+    memcpy(data, &result, REAL_SIZE);
+    return REAL_SIZE;
+}
+
+void Aggregate::getAttributes(vector<Attribute> &attrs) const {
+    attrs.clear();
+    // A group attribute missing from the input is reported as given
+    if (grouped)
+        attrs.push_back(group_index >= 0 ? input_attrs[group_index] : group_attr);
+    Attribute attr;
+    attr.name = string(aggregateOpNames[op]) + "(" + agg_attr.name + ")";
+    attr.type = TypeReal;
+    attr.length = REAL_SIZE;
+    attrs.push_back(attr);
+}
+
+void Aggregate::destroyTempFile(const string &fileName) {
+    RecordBasedFileManager::instance()->destroyFile(fileName);
+    temp_files.erase(fileName);
+}
+
+// Distinguishes the run files of every Sort in the process
+static unsigned sortInstances = 0;
+
+Sort::Sort(Iterator *input, const vector<SortAttribute> &sortAttrs, const unsigned numPages) {
+    this->input = input;
+    input->getAttributes(attrs);
+    for (unsigned i = 0; i < attrs.size(); i++)
+        attr_names.push_back(attrs[i].name);
+    budget = (size_t) numPages * PAGE_SIZE;
+    // One page for each run being merged, and one for the output
+    fan_in = numPages > 2 ? numPages - 1 : 2;
+    started = false;
+    in_memory = true;
+    next_offset = 0;
+    instance = sortInstances++;
+    next_file = 0;
+
+    error = numPages == 0 || sortAttrs.empty() ? SORT_BAD_BUDGET : SUCCESS;
+    for (unsigned i = 0; i < sortAttrs.size(); i++) {
+        int index = -1;
+        for (unsigned j = 0; j < attrs.size(); j++) {
+            if (attrs[j].name == sortAttrs[i].name)
+                index = j;
+        }
+        if (index < 0)
+            error = SORT_BAD_ATTR;
+        sort_indexes.push_back(index);
+        sort_orders.push_back(sortAttrs[i].order);
+    }
+}
+
+Sort::~Sort() {
+    closeRuns();
+    while (!temp_files.empty()) {
+        string fileName = *temp_files.begin();
+        destroyTempFile(fileName);
+    }
+}
+
+RC Sort::getNextTuple(void *data) {
+    if (error)
+        return error;
+    if (!started) {
+        started = true;
+        RC rc = sortRuns();
+        if (rc)
+            return error = rc;
+    }
+
+    if (in_memory) {
+        if (next_offset == offsets.size())
+            return QE_EOF;
+        const char *tuple = &buffer[offsets[next_offset++]];
+        memcpy(data, tuple, getTupleLength(attrs, tuple));
+        return SUCCESS;
+    }
+
+    int winner = tree[0];
+    if (runs[winner].done)
+        return QE_EOF;
+    memcpy(data, runs[winner].tuple, getTupleLength(attrs, runs[winner].tuple));
+    RC rc = advanceRun(winner);
+    if (rc)
+        return error = rc;
+    replay(winner);
+    return SUCCESS;
+}
+
+void Sort::getAttributes(vector<Attribute> &attrs) const {
+    attrs = this->attrs;
+}
+
+int Sort::compareTuples(const void *tuple, const void *other) const {
+    for (unsigned i = 0; i < sort_indexes.size(); i++) {
+        int index = sort_indexes[i];
+        bool null = tupleFieldIsNull(tuple, index);
+        bool otherNull = tupleFieldIsNull(other, index);
+        int cmp;
+        if (null || otherNull)
+            cmp = null == otherNull ? 0 : (null ? -1 : 1);
+        else
+            cmp = compareFields(attrs[index].type, (const char*) tuple + getFieldOffset(attrs, tuple, index),
+                    (const char*) other + getFieldOffset(attrs, other, index));
+        if (cmp != 0)
+            return sort_orders[i] == ASCENDING ? cmp : -cmp;
+    }
+    return 0;
+}
+
+// Reads the whole input into sorted runs, and merges the runs down to one merge pass
+RC Sort::sortRuns() {
+    vector<string> files;
+    void *tuple = malloc(PAGE_SIZE);
+    RC rc;
+    while ((rc = input->getNextTuple(tuple)) == SUCCESS) {
+        unsigned length = getTupleLength(attrs, tuple);
+        if (!offsets.empty() && buffer.size() + (offsets.size() + 1) * sizeof(unsigned) + length > budget) {
+            rc = spillRun(files);
+            if (rc)
+                break;
+        }
+        offsets.push_back(buffer.size());
+        buffer.insert(buffer.end(), (char*) tuple, (char*) tuple + length);
+    }
+    free(tuple);
+    if (rc != QE_EOF)
+        return rc;
+
+    // Everything fit, the disk is never touched
+    if (files.empty()) {
+        stable_sort(offsets.begin(), offsets.end(), [&](unsigned a, unsigned b)
+            { return compareTuples(&buffer[a], &buffer[b]) < 0; });
+        return SUCCESS;
+    }
+
+    in_memory = false;
+    rc = spillRun(files);
+    vector<char>().swap(buffer);
+    vector<unsigned>().swap(offsets);
+
+    // Merge neighbouring runs so equal tuples keep their input order
+    while (rc == SUCCESS && files.size() > fan_in) {
+        vector<string> merged;
+        for (unsigned from = 0; from < files.size() && rc == SUCCESS; from += fan_in) {
+            unsigned to = min((unsigned) files.size(), from + fan_in);
+            merged.push_back(newTempFile());
+            rc = mergeRuns(files, from, to, merged.back());
+        }
+        for (unsigned i = 0; i < files.size(); i++)
+            destroyTempFile(files[i]);
+        files.swap(merged);
+    }
+    if (rc == SUCCESS)
+        rc = openRuns(files, 0, files.size());
+    return rc;
+}
+
+// Sorts the buffered tuples and writes them out as a run
+RC Sort::spillRun(vector<string> &files) {
+    stable_sort(offsets.begin(), offsets.end(), [&](unsigned a, unsigned b)
+        { return compareTuples(&buffer[a], &buffer[b]) < 0; });
+
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    string fileName = newTempFile();
+    FileHandle fileHandle;
+    RC rc = rbfm->openFile(fileName, fileHandle);
+    RID rid;
+    for (unsigned i = 0; i < offsets.size() && rc == SUCCESS; i++)
+        rc = rbfm->appendRecord(fileHandle, attrs, &buffer[offsets[i]], rid);
+    rbfm->closeFile(fileHandle);
+    files.push_back(fileName);
+
+    buffer.clear();
+    offsets.clear();
+    return rc;
+}
+
+RC Sort::mergeRuns(const vector<string> &files, unsigned from, unsigned to, const string &output) {
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    FileHandle fileHandle;
+    RC rc = rbfm->openFile(output, fileHandle);
+    if (rc == SUCCESS)
+        rc = openRuns(files, from, to);
+    RID rid;
+    while (rc == SUCCESS && !runs[tree[0]].done) {
+        int winner = tree[0];
+        rc = rbfm->appendRecord(fileHandle, attrs, runs[winner].tuple, rid);
+        if (rc == SUCCESS)
+            rc = advanceRun(winner);
+        replay(winner);
+    }
+    closeRuns();
+    rbfm->closeFile(fileHandle);
+    return rc;
+}
+
+RC Sort::openRuns(const vector<string> &files, unsigned from, unsigned to) {
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    closeRuns();
+    for (unsigned i = from; i < to; i++) {
+        Run run;
+        run.fileName = files[i];
+        run.fileHandle = new FileHandle();
+        run.iter = new RBFM_ScanIterator();
+        run.tuple = malloc(PAGE_SIZE);
+        run.done = false;
+        runs.push_back(run);
+        RC rc = rbfm->openFile(run.fileName, *run.fileHandle);
+        if (rc == SUCCESS)
+            rc = rbfm->scan(*run.fileHandle, attrs, "", NO_OP, NULL, attr_names, *run.iter);
+        if (rc == SUCCESS)
+            rc = advanceRun(runs.size() - 1);
+        if (rc)
+            return rc;
+    }
+    tree.assign(runs.size(), -1);
+    tree[0] = buildTree(1);
+    return SUCCESS;
+}
+
+void Sort::closeRuns() {
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    for (unsigned i = 0; i < runs.size(); i++) {
+        runs[i].iter->close();
+        rbfm->closeFile(*runs[i].fileHandle);
+        delete runs[i].iter;
+        delete runs[i].fileHandle;
+        free(runs[i].tuple);
+    }
+    runs.clear();
+}
+
+RC Sort::advanceRun(int run) {
+    RID rid;
+    RC rc = runs[run].iter->getNextRecord(rid, runs[run].tuple);
+    if (rc == RBFM_EOF) {
+        runs[run].done = true;
+        return SUCCESS;
+    }
+    return rc;
+}
+
+// Finished runs come last, equal tuples come from the earlier run first
+bool Sort::runLess(int run, int other) const {
+    if (runs[run].done || runs[other].done)
+        return !runs[run].done || (runs[other].done && run < other);
+    int cmp = compareTuples(runs[run].tuple, runs[other].tuple);
+    return cmp != 0 ? cmp < 0 : run < other;
+}
+
+// Node i of the loser tree has children 2i and 2i + 1, runs are the leaves from runs.size() on
+int Sort::buildTree(unsigned node) {
+    if (node >= runs.size())
+        return node - runs.size();
+    int winner = buildTree(2 * node);
+    int other = buildTree(2 * node + 1);
+    if (runLess(other, winner))
+        swap(winner, other);
+    tree[node] = other;
+    return winner;
+}
+
+// Plays the new tuple of run against the losers on its path to the root
+void Sort::replay(int run) {
+    int winner = run;
+    for (unsigned node = (run + runs.size()) / 2; node > 0; node /= 2) {
+        if (runLess(tree[node], winner))
+            swap(tree[node], winner);
+    }
+    tree[0] = winner;
+}
+
+string Sort::newTempFile() {
+    string fileName = "sort_" + to_string(getpid()) + "_" + to_string(instance) + "_" + to_string(next_file++);
+    RecordBasedFileManager::instance()->createFile(fileName);
+    temp_files.insert(fileName);
+    return fileName;
+}
+
+void Sort::destroyTempFile(const string &fileName) {
+    RecordBasedFileManager::instance()->destroyFile(fileName);
+    temp_files.erase(fileName);
+}
+
+// Distinguishes the spill files of every SMJoin in the process
+static unsigned smjoinInstances = 0;
+
+SMJoin::SMJoin(Iterator *leftIn, Iterator *rightIn, const Condition &condition, const unsigned numPages) {
+    left = leftIn;
+    right = rightIn;
+    cond = condition;
+    leftIn->getAttributes(left_attrs);
+    rightIn->getAttributes(right_attrs);
+    total_attrs = left_attrs;
+    total_attrs.insert(total_attrs.end(), right_attrs.begin(), right_attrs.end());
+    for (unsigned i = 0; i < right_attrs.size(); i++)
+        right_names.push_back(right_attrs[i].name);
+
+    budget = (size_t) numPages * PAGE_SIZE;
+    started = false;
+    left_done = right_done = false;
+    in_run = false;
+    run_pos = 0;
+    run_spilled = false;
+    replaying_spill = false;
+    left_tuple = malloc(PAGE_SIZE);
+    right_tuple = malloc(PAGE_SIZE);
+    spill_tuple = malloc(PAGE_SIZE);
+    instance = smjoinInstances++;
+    spill_file = "smjoin_" + to_string(getpid()) + "_" + to_string(instance);
+
+    if (numPages == 0)
+        error = JOIN_BAD_BLOCK_SIZE;
+    else if (cond.op != EQ_OP || !findJoinAttributes(cond, left_attrs, right_attrs, left_attr_comp_index, right_attr_comp_index))
+        error = JOIN_BAD_COND;
+    else
+        error = SUCCESS;
+}
+
+SMJoin::~SMJoin() {
+    clearRun();
+    free(left_tuple);
+    free(right_tuple);
+    free(spill_tuple);
+}
+
+RC SMJoin::getNextTuple(void *data) {
+    if (error)
+        return error;
+    RC rc;
+    if (!started) {
+        started = true;
+        if ((rc = advance(true)) || (rc = advance(false)))
+            return error = rc;
+    }
+
+    while (true) {
+        if (in_run) {
+            const void *inner;
+            rc = nextRunTuple(inner);
+            if (rc == SUCCESS)
+                return joinTuples(left_attrs, left_tuple, right_attrs, inner, data);
+            if (rc != QE_EOF)
+                return error = rc;
+
+            // The run is done for this left tuple, the next one may have the same key
+            if ((rc = advance(true)))
+                return error = rc;
+            // Compared as keys, not bytes, so -0.0 and 0.0 stay in the same run
+            AttrType type = left_attrs[left_attr_comp_index].type;
+            if (!left_done && compareFields(type, left_key.data(), run_key.data()) == 0) {
+                if ((rc = startReplay()))
+                    return error = rc;
+                continue;
+            }
+            in_run = false;
+            clearRun();
+            continue;
+        }
+
+        if (left_done || right_done)
+            return QE_EOF;
+
+        // Move the input with the smaller key forward until the keys meet
+        AttrType type = left_attrs[left_attr_comp_index].type;
+        int cmp = compareFields(type, left_key.data(), right_key.data());
+        if (cmp != 0) {
+            if ((rc = advance(cmp < 0)))
+                return error = rc;
+            continue;
+        }
+
+        if ((rc = collectRun()) || (rc = startReplay()))
+            return error = rc;
+        in_run = true;
+    }
+}
+
+void SMJoin::getAttributes(vector<Attribute> &attrs) const {
+    attrs = total_attrs;
+}
+
+// Joined tuples are written straight into the batch
+RC SMJoin::getNextBatch(TupleBatch &batch) {
+    return fillBatch(batch, total_attrs, [this](void *data) { return SMJoin::getNextTuple(data); });
+}
+
+// Reads the next tuple with a non null key from one input, and checks that the keys do not go down
+RC SMJoin::advance(bool leftSide) {
+    Iterator *input = leftSide ? left : right;
+    void *tuple = leftSide ? left_tuple : right_tuple;
+    const vector<Attribute> &attrs = leftSide ? left_attrs : right_attrs;
+    int keyIndex = leftSide ? left_attr_comp_index : right_attr_comp_index;
+    string &key = leftSide ? left_key : right_key;
+    bool &done = leftSide ? left_done : right_done;
+
+    while (true) {
+        RC rc = input->getNextTuple(tuple);
+        if (rc == QE_EOF) {
+            done = true;
+            return SUCCESS;
+        }
+        if (rc)
+            return rc;
+        if (tupleFieldIsNull(tuple, keyIndex))
+            continue;
+
+        const char *field = (char*) tuple + getFieldOffset(attrs, tuple, keyIndex);
+        unsigned length = getFieldLength(attrs[keyIndex], field);
+        if (!key.empty() && compareFields(attrs[keyIndex].type, field, key.data()) < 0)
+            return JOIN_NOT_SORTED;
+        key.assign(field, length);
+        return SUCCESS;
+    }
+}
+
+// Buffers every right tuple with the current key, the tuples past the budget go to a spill file
+RC SMJoin::collectRun() {
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    clearRun();
+    run_key = right_key;
+    RC rc = SUCCESS;
+    RID rid;
+    AttrType type = right_attrs[right_attr_comp_index].type;
+    while (!right_done && compareFields(type, right_key.data(), run_key.data()) == 0) {
+        unsigned length = getTupleLength(right_attrs, right_tuple);
+        if (!run_spilled && run_buffer.size() + length > budget && !run_buffer.empty()) {
+            run_spilled = true;
+            rc = rbfm->createFile(spill_file);
+            if (rc == SUCCESS)
+                rc = rbfm->openFile(spill_file, spill_handle);
+            if (rc)
+                return rc;
+        }
+        if (run_spilled)
+            rc = rbfm->appendRecord(spill_handle, right_attrs, right_tuple, rid);
+        else {
+            run_offsets.push_back(run_buffer.size());
+            run_buffer.insert(run_buffer.end(), (char*) right_tuple, (char*) right_tuple + length);
+        }
+        if (rc || (rc = advance(false)))
+            return rc;
+    }
+    return SUCCESS;
+}
+
+RC SMJoin::startReplay() {
+    run_pos = 0;
+    if (replaying_spill) {
+        spill_iter.close();
+        replaying_spill = false;
+    }
+    return SUCCESS;
+}
+
+// The buffered tuples first, then the spilled ones
+RC SMJoin::nextRunTuple(const void *&tuple) {
+    if (run_pos < run_offsets.size()) {
+        tuple = &run_buffer[run_offsets[run_pos++]];
+        return SUCCESS;
+    }
+    if (!run_spilled)
+        return QE_EOF;
+
+    RC rc;
+    if (!replaying_spill) {
+        rc = RecordBasedFileManager::instance()->scan(spill_handle, right_attrs, "", NO_OP, NULL, right_names, spill_iter);
+        if (rc)
+            return rc;
+        replaying_spill = true;
+    }
+    RID rid;
+    rc = spill_iter.getNextRecord(rid, spill_tuple);
+    if (rc == RBFM_EOF)
+        return QE_EOF;
+    tuple = spill_tuple;
+    return rc;
+}
+
+void SMJoin::clearRun() {
+    run_buffer.clear();
+    run_offsets.clear();
+    run_pos = 0;
+    if (replaying_spill)
+        spill_iter.close();
+    replaying_spill = false;
+    if (run_spilled) {
+        RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+        rbfm->closeFile(spill_handle);
+        rbfm->destroyFile(spill_file);
+    }
+    run_spilled = false;
+}
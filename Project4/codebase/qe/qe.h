@@ -5,6 +5,9 @@
 #include <cstring>
 #include <string>
 #include <cmath>
+#include <unordered_map>
+#include <functional>
+#include <set>
 
 #include "../rbf/rbfm.h"
 #include "../rm/rm.h"
@@ -19,11 +22,33 @@
 #define PRJCT_BAD_ATTR_COND -6
 #define PRJCT_NT_INIT -7
 #define JOIN_BAD_COND -8
+#define JOIN_BAD_BLOCK_SIZE -9
+#define JOIN_BAD_PARTITIONS -10
+#define AGG_BAD_ATTR -11
+#define AGG_BAD_BUDGET -12
+#define SORT_BAD_ATTR -13
+#define SORT_BAD_BUDGET -14
+#define JOIN_NOT_SORTED -15
+
+#define GHJOIN_DEFAULT_PAGES 100   // memory for one partition of the build side
+#define GHJOIN_MAX_DEPTH 4         // partitions are split at most this many times
+
+#define AGG_DEFAULT_MAX_GROUPS 65536   // groups kept in memory before new groups spill to disk
+#define AGG_SPILL_PARTITIONS 8         // files the spilled groups are spread over
+#define AGG_MAX_DEPTH 4                // spilled groups are spilled again at most this many times
+
+#define SORT_DEFAULT_PAGES 100   // memory for sorting runs, and one page per run when merging
+
+#define SMJOIN_DEFAULT_PAGES 10  // memory for a run of equal inner keys before it spills to disk
+
+#define QE_BATCH_SIZE 1024   // tuples moved by one getNextBatch call
 
 using namespace std;
 
 typedef enum{ MIN=0, MAX, COUNT, SUM, AVG } AggregateOp;
 
+typedef enum{ ASCENDING=0, DESCENDING } SortOrder;
+
 // The following functions use the following
 // format for the passed data.
 //    For INT and REAL: use 4 bytes
@@ -43,13 +68,67 @@ struct Condition {
     Value   rhsValue;       // right-hand side value if bRhsIsAttr = FALSE
 };
 
+// Nulls sort before every value
+struct SortAttribute {
+    string    name;         // attribute to sort on, as rel.attr
+    SortOrder order;        // direction of the sort
+};
+
 bool compare();
 
+class TupleBatch {
+    // Tuples in the format of getNextTuple, stored back to back. The fields of a tuple are
+    // located once when it is added, and an operator that drops tuples only shrinks the
+    // selection instead of copying the ones it keeps.
+    public:
+        TupleBatch(const unsigned capacity = QE_BATCH_SIZE);
+
+        // Empties the batch for tuples with the given attributes
+        void reset(const vector<Attribute> &attrs);
+
+        // Space for the next tuple, at least PAGE_SIZE bytes. commitTuple adds what was written there.
+        // Adding a tuple may move the others, so pointers into the batch only last until then.
+        void *reserveTuple();
+        void commitTuple();
+        void appendTuple(const void *tuple);
+
+        unsigned getCapacity() const { return capacity; }
+        unsigned getNumRows() const { return rows; }           // tuples stored, selected or not
+        bool isFull() const { return rows == capacity; }
+        unsigned size() const { return selection.size(); }     // tuples selected
+
+        const char *getTuple(unsigned row) const { return &data[tuple_offsets[row]]; }
+        unsigned getTupleLength(unsigned row) const { return tuple_offsets[row + 1] - tuple_offsets[row]; }
+        // A field of a tuple, NULL when the field is null
+        const char *getField(unsigned row, unsigned column) const;
+
+        // Rows of the tuples that are part of the batch, in order
+        vector<unsigned> selection;
+
+    private:
+        unsigned capacity;
+        unsigned rows;
+        vector<Attribute> attrs;
+        vector<char> data;
+        vector<unsigned> tuple_offsets;         // start of every tuple in data, and the end of the last one
+        vector<vector<int> > column_offsets;    // per column, offset of the field in data or -1 when it is null
+};
+
+
 class Iterator {
     // All the relational operators and access methods are iterators.
     public:
         virtual RC getNextTuple(void *data) = 0;
         virtual void getAttributes(vector<Attribute> &attrs) const = 0;
+        // Fills the batch with up to its capacity of tuples, QE_EOF when there are none left.
+        // By default the tuples come one at a time from getNextTuple.
+        virtual RC getNextBatch(TupleBatch &batch);
+
+        // Plan rewrite hooks. Filter and Project offer their condition or attribute list to their
+        // input when they are built; an input that takes it over returns true, and from then on
+        // returns only the tuples or fields asked for, so the operator above passes them through.
+        virtual bool pushCondition(const Condition &cond) { return false; };
+        virtual bool pushProjection(const vector<string> &attrNames) { return false; };
         virtual ~Iterator() {};
     /* protected: */
     /*     vector<Attribute> attrs; */
@@ -63,14 +142,20 @@ class TableScan : public Iterator
         RelationManager &rm;
         RM_ScanIterator *iter;
         string tableName;
+        string relationName;
         vector<Attribute> attrs;
         vector<string> attrNames;
         RID rid;
 
+        // Conditions pushed down into the scan, with a copy of their values
+        vector<ScanPredicate> predicates;
+        vector<vector<char> > predicateValues;
+
         TableScan(RelationManager &rm, const string &tableName, const char *alias = NULL):rm(rm)
         {
         	//Set members
         	this->tableName = tableName;
+        	relationName = tableName;
 
             // Get Attributes from RM
             rm.getAttributes(tableName, attrs);
@@ -97,7 +182,66 @@ class TableScan : public Iterator
             iter->close();
             delete iter;
             iter = new RM_ScanIterator();
-            rm.scan(tableName, "", NO_OP, NULL, attrNames, *iter);
+            for (unsigned i = 0; i < predicates.size(); i++)
+                predicates[i].value = &predicateValues[i][0];
+            rm.scan(relationName, predicates, attrNames, *iter);
+        };
+
+        // The scan checks a condition on one of its attributes against a value, along with
+        // the ones it already has, the scan restarts
+        bool pushCondition(const Condition &cond)
+        {
+            if (cond.bRhsIsAttr || cond.op == NO_OP)
+                return false;
+            int index = findAttribute(cond.lhsAttr);
+            if (index < 0 || attrs[index].type != cond.rhsValue.type)
+                return false;
+
+            uint32_t length = INT_SIZE;
+            if (cond.rhsValue.type == TypeVarChar)
+            {
+                memcpy(&length, cond.rhsValue.data, VARCHAR_LENGTH_SIZE);
+                length += VARCHAR_LENGTH_SIZE;
+            }
+            const char *value = (const char *) cond.rhsValue.data;
+            predicateValues.push_back(vector<char>(value, value + length));
+            ScanPredicate predicate = {attrs[index].name, cond.op, NULL};
+            predicates.push_back(predicate);
+            setIterator();
+            return true;
+        };
+
+        // The scan only reads the given attributes, in that order, the scan restarts
+        bool pushProjection(const vector<string> &names)
+        {
+            vector<Attribute> projected;
+            for (unsigned i = 0; i < names.size(); i++)
+            {
+                int index = findAttribute(names[i]);
+                if (index < 0)
+                    return false;
+                projected.push_back(attrs[index]);
+            }
+
+            attrs = projected;
+            attrNames.clear();
+            for (unsigned i = 0; i < attrs.size(); i++)
+                attrNames.push_back(attrs[i].name);
+            setIterator();
+            return true;
+        };
+
+        // Index in attrs of an attribute named rel.attr, -1 when the scan does not return it
+        int findAttribute(const string &name) const
+        {
+            if (name.compare(0, tableName.size() + 1, tableName + ".") != 0)
+                return -1;
+            for (unsigned i = 0; i < attrs.size(); i++)
+            {
+                if (name.compare(tableName.size() + 1, string::npos, attrs[i].name) == 0)
+                    return i;
+            }
+            return -1;
         };
 
         RC getNextTuple(void *data)
@@ -105,6 +249,22 @@ class TableScan : public Iterator
             return iter->getNextTuple(rid, data);
         };
 
+        // The scan writes every tuple straight into the batch
+        RC getNextBatch(TupleBatch &batch)
+        {
+            batch.reset(attrs);
+            while (!batch.isFull())
+            {
+                RC rc = iter->getNextTuple(rid, batch.reserveTuple());
+                if (rc == RM_EOF)
+                    break;
+                if (rc)
+                    return rc;
+                batch.commitTuple();
+            }
+            return batch.size() ? SUCCESS : QE_EOF;
+        };
+
         void getAttributes(vector<Attribute> &attrs) const
         {
             attrs.clear();
@@ -165,11 +325,8 @@ class IndexScan : public Iterator
                          bool lowKeyInclusive,
                          bool highKeyInclusive)
         {
-            iter->close();
-            delete iter;
-            iter = new RM_IndexScanIterator();
-            rm.indexScan(tableName, attrName, lowKey, highKey, lowKeyInclusive,
-                           highKeyInclusive, *iter);
+            // The index stays open, only the range changes
+            iter->reset(lowKey, highKey, lowKeyInclusive, highKeyInclusive);
         };
 
         RC getNextTuple(void *data)
@@ -182,6 +339,24 @@ class IndexScan : public Iterator
             return rc;
         };
 
+        // The tuples are read straight into the batch
+        RC getNextBatch(TupleBatch &batch)
+        {
+            batch.reset(attrs);
+            while (!batch.isFull())
+            {
+                RC rc = iter->getNextEntry(rid, key);
+                if (rc == IX_EOF)
+                    break;
+                if (rc == 0)
+                    rc = rm.readTuple(tableName.c_str(), rid, batch.reserveTuple());
+                if (rc)
+                    return rc;
+                batch.commitTuple();
+            }
+            return batch.size() ? SUCCESS : QE_EOF;
+        };
+
         void getAttributes(vector<Attribute> &attrs) const
         {
             attrs.clear();
@@ -215,16 +390,22 @@ class Filter : public Iterator {
         ~Filter();//{};
 
         RC getNextTuple(void *data);// {return QE_EOF;};
+        RC getNextBatch(TupleBatch &batch);
+        bool pushCondition(const Condition &cond);
+        bool pushProjection(const vector<string> &attrNames);
         // For attribute in vector<Attribute>, name it as rel.attr
         void getAttributes(vector<Attribute> &attrs) const; //{};
     private:
         Iterator* iter = NULL;
         const Condition cond;
+        bool pushed;        // the input checks the condition
+        vector<Attribute> input_attrs;
         Attribute compare_attr;
         int compare_attr_index;
+        void* tuple;
+        vector<int> field_offsets;
         RC error;
-        int getNullIndicatorSize(int fieldCount);
-        bool fieldIsNull(char *nullIndicator, int i);
+        bool matches(const char *field);
         bool checkScanCondition(int recordInt, CompOp compOp, const void *value);
         bool checkScanCondition(float recordReal, CompOp compOp, const void *value);
         bool checkScanCondition(char *recordString, CompOp compOp, const void *value);
@@ -236,20 +417,32 @@ class Project : public Iterator {
     public:
         Project(Iterator *input,                    // Iterator of input R
               const vector<string> &attrNames);//{};   // vector containing attribute names
-        ~Project(){};
+        ~Project();
 
         RC getNextTuple(void *data);// {return QE_EOF;};
+        RC getNextBatch(TupleBatch &batch);
+        bool pushCondition(const Condition &cond);
+        bool pushProjection(const vector<string> &attrNames);
         // For attribute in vector<Attribute>, name it as rel.attr
         void getAttributes(vector<Attribute> &attrs) const; //{};
     private:
         Iterator* iter = NULL;
         vector<string> names;
+        bool pushed;        // the input returns the projected fields
+        vector<Attribute> input_attrs;
         vector<Attribute> projection_attributes;
+        vector<unsigned> projection_indexes;    // input field of every projected field
         RC error;
 
+        // The input tuple being projected and its fields
+        void* tuple;
+        vector<int> field_offsets;
+        vector<const char*> fields;
+        TupleBatch input_batch;
+
         int getNullIndicatorSize(int fieldCount);
-        bool fieldIsNull(char *nullIndicator, int i);
         RC setFieldToNull(char *nullIndicator, int i);
+        void writeProjection(void *data);
 };
 
 
@@ -260,9 +453,10 @@ class INLJoin : public Iterator {
                IndexScan *rightIn,          // IndexScan Iterator of input S
                const Condition &condition   // Join condition
         );//{};
-        ~INLJoin(){};
+        ~INLJoin();
 
         RC getNextTuple(void *data);//{return QE_EOF;};
+        RC getNextBatch(TupleBatch &batch);
         // For attribute in vector<Attribute>, name it as rel.attr
         void getAttributes(vector<Attribute> &attrs) const; //{};
 
@@ -274,14 +468,329 @@ class INLJoin : public Iterator {
         Condition cond;
         bool newLeft;
         void* outer_page_data;
+        void* inner_page_data;
+        void* probe_key;
         int left_attr_comp_index;
         int right_attr_comp_index;
         vector<Attribute> total_attrs;
         RC error;
         int getNullIndicatorSize(int fieldCount);
-        unsigned getRecordSize(const vector<Attribute> &recordDescriptor, const void *data);
         int getAttributeOffset(void* data, bool left);
         bool fieldIsNull(char *nullIndicator, int i);
+        RC probe();
+        bool probeKeyMatches(const void *key);
+        RC joinTuples(void *data);
+};
+
+
+class BNLJoin : public Iterator {
+    // Block nested-loop join operator
+    public:
+        BNLJoin(Iterator *leftIn,            // Iterator of input R
+               TableScan *rightIn,           // TableScan Iterator of input S
+               const Condition &condition,   // Join condition
+               const unsigned numPages       // # of pages that can be loaded into memory,
+                                             //   i.e., memory block size (decided by the optimizer)
+        );
+        ~BNLJoin();
+
+        RC getNextTuple(void *data);
+        RC getNextBatch(TupleBatch &batch);
+        // For attribute in vector<Attribute>, name it as rel.attr
+        void getAttributes(vector<Attribute> &attrs) const;
+
+    private:
+        Iterator* left;
+        TableScan* right;
+        vector<Attribute> left_attrs;
+        vector<Attribute> right_attrs;
+        vector<Attribute> total_attrs;
+        Condition cond;
+        int left_attr_comp_index;
+        int right_attr_comp_index;
+        RC error;
+
+        // The block of left tuples, hashed on the join key for EQ_OP
+        size_t block_size;
+        vector<char> block;
+        unordered_multimap<string, unsigned> block_table;
+        vector<unsigned> block_tuples;
+        bool block_loaded;
+        bool first_block;
+
+        // The left tuple that did not fit in the previous block
+        void* left_tuple;
+        bool has_pending;
+        bool left_done;
+
+        // Offsets in the block of the tuples matching the current right tuple
+        void* right_tuple;
+        vector<unsigned> matches;
+        size_t next_match;
+
+        RC loadBlock();
+        void findMatches();
+};
+
+
+class GHJoin : public Iterator {
+    // Grace hash join operator
+    public:
+        GHJoin(Iterator *leftIn,               // Iterator of input R
+               Iterator *rightIn,               // Iterator of input S
+               const Condition &condition,      // Join condition (CompOp is always EQ)
+               const unsigned numPartitions,    // Number of partitions for each relation (decided by the optimizer)
+               const unsigned numPages = GHJOIN_DEFAULT_PAGES  // Memory for building one partition
+        );
+        ~GHJoin();
+
+        RC getNextTuple(void *data);
+        RC getNextBatch(TupleBatch &batch);
+        // For attribute in vector<Attribute>, name it as rel.attr
+        void getAttributes(vector<Attribute> &attrs) const;
+
+    private:
+        // A pair of partition files that still has to be joined
+        struct Partition {
+            string leftFile;
+            string rightFile;
+            size_t leftBytes;
+            size_t rightBytes;
+            unsigned level;
+        };
+
+        Iterator* left;
+        Iterator* right;
+        vector<Attribute> left_attrs;
+        vector<Attribute> right_attrs;
+        vector<Attribute> total_attrs;
+        vector<string> left_names;
+        vector<string> right_names;
+        Condition cond;
+        int left_attr_comp_index;
+        int right_attr_comp_index;
+        unsigned num_partitions;
+        size_t budget;
+        RC error;
+
+        bool partitioned;
+        vector<Partition> partitions;
+        set<string> temp_files;
+        unsigned instance;
+        unsigned next_file;
+
+        // The in memory side of the current partition pair, hashed on the join key
+        bool build_left;
+        vector<char> table_tuples;
+        unordered_multimap<string, unsigned> table;
+
+        // The scan over the other side of the current partition pair
+        bool probing;
+        Partition current;
+        FileHandle probe_handle;
+        RBFM_ScanIterator probe_iter;
+        void* probe_tuple;
+        vector<unsigned> matches;
+        size_t next_match;
+
+        RC partitionInput(function<RC(void*)> next, bool leftSide, unsigned level,
+                vector<string> &files, vector<size_t> &bytes);
+        RC addPartitions(function<RC(void*)> nextLeft, function<RC(void*)> nextRight, unsigned level);
+        RC repartition(const Partition &partition);
+        RC buildPartition(const Partition &partition);
+        RC nextPartition();
+        void finishPartition();
+        void destroyTempFile(const string &fileName);
+};
+
+
+class Aggregate : public Iterator {
+    // Aggregation operator
+    public:
+        // Basic aggregation
+        Aggregate(Iterator *input,          // Iterator of input R
+                  Attribute aggAttr,        // The attribute over which we are computing an aggregate
+                  AggregateOp op            // Aggregate operation
+        );
+
+        // Group-based hash aggregation
+        Aggregate(Iterator *input,             // Iterator of input R
+                  Attribute aggAttr,           // The attribute over which we are computing an aggregate
+                  Attribute groupAttr,         // The attribute over which we are grouping the tuples
+                  AggregateOp op,              // Aggregate operation
+                  const unsigned maxGroups = AGG_DEFAULT_MAX_GROUPS  // Groups kept in memory
+        );
+        ~Aggregate();
+
+        // Aggregates are returned as TypeReal, groups first with their group value
+        RC getNextTuple(void *data);
+        // Please name the output attribute as aggregateOp(aggAttr)
+        // E.g. Relation=rel, attribute=attr, aggregateOp=MAX
+        // output attrname = "MAX(rel.attr)"
+        void getAttributes(vector<Attribute> &attrs) const;
+
+    private:
+        // Running aggregate of one group
+        struct AggregateState {
+            double min;
+            double max;
+            double sum;
+            unsigned count;
+        };
+
+        // Spilled <group, value> tuples, aggregated after the groups in memory
+        struct Spill {
+            string fileName;
+            unsigned level;
+        };
+
+        Iterator* input;
+        Attribute agg_attr;
+        Attribute group_attr;
+        AggregateOp op;
+        bool grouped;
+        unsigned max_groups;
+        vector<Attribute> input_attrs;
+        vector<Attribute> spill_attrs;
+        vector<string> spill_names;
+        int agg_index;
+        int group_index;
+        RC error;
+
+        bool started;
+        unordered_map<string, AggregateState> groups;
+        unordered_map<string, AggregateState>::iterator next_group;
+        vector<Spill> spills;
+        set<string> temp_files;
+        unsigned instance;
+        unsigned next_file;
+
+        void init(Iterator *input, const Attribute &aggAttr, AggregateOp op);
+        RC aggregatePass(function<RC(void*)> next, const vector<Attribute> &attrs, int groupIndex, int aggIndex, unsigned level);
+        void update(AggregateState &state, const vector<Attribute> &attrs, const void *tuple, int aggIndex);
+        unsigned writeResult(const AggregateState &state, unsigned char *nullIndicator, int field, void *data);
+        void destroyTempFile(const string &fileName);
+};
+
+
+class Sort : public Iterator {
+    // External merge sort operator
+    public:
+        Sort(Iterator *input,                           // Iterator of input R
+             const vector<SortAttribute> &sortAttrs,    // Attributes to sort on, the first one first
+             const unsigned numPages = SORT_DEFAULT_PAGES  // Memory budget in pages
+        );
+        ~Sort();
+
+        RC getNextTuple(void *data);
+        // For attribute in vector<Attribute>, name it as rel.attr
+        void getAttributes(vector<Attribute> &attrs) const;
+
+    private:
+        // A sorted run in a temporary file, read one tuple at a time while merging
+        struct Run {
+            string fileName;
+            FileHandle* fileHandle;
+            RBFM_ScanIterator* iter;
+            void* tuple;
+            bool done;
+        };
+
+        Iterator* input;
+        vector<Attribute> attrs;
+        vector<string> attr_names;
+        vector<int> sort_indexes;
+        vector<SortOrder> sort_orders;
+        size_t budget;
+        unsigned fan_in;
+        RC error;
+
+        bool started;
+        unsigned instance;
+        unsigned next_file;
+        set<string> temp_files;
+
+        // Tuples sorted in memory: all of them when they fit, otherwise the run being built
+        vector<char> buffer;
+        vector<unsigned> offsets;
+        size_t next_offset;
+        bool in_memory;
+
+        // The runs being merged and the loser tree over them, tree[0] is the winner
+        vector<Run> runs;
+        vector<int> tree;
+
+        int compareTuples(const void *tuple, const void *other) const;
+        RC sortRuns();
+        RC spillRun(vector<string> &files);
+        RC mergeRuns(const vector<string> &files, unsigned from, unsigned to, const string &output);
+        RC openRuns(const vector<string> &files, unsigned from, unsigned to);
+        void closeRuns();
+        RC advanceRun(int run);
+        bool runLess(int run, int other) const;
+        int buildTree(unsigned node);
+        void replay(int run);
+        string newTempFile();
+        void destroyTempFile(const string &fileName);
+};
+
+
+class SMJoin : public Iterator {
+    // Sort-merge join operator, both inputs come in ascending order of the join attribute
+    public:
+        SMJoin(Iterator *leftIn,               // Iterator of input R, sorted on the join attribute
+               Iterator *rightIn,               // Iterator of input S, sorted on the join attribute
+               const Condition &condition,      // Join condition (CompOp is always EQ)
+               const unsigned numPages = SMJOIN_DEFAULT_PAGES  // Memory for a run of equal right keys
+        );
+        ~SMJoin();
+
+        RC getNextTuple(void *data);
+        RC getNextBatch(TupleBatch &batch);
+        // For attribute in vector<Attribute>, name it as rel.attr
+        void getAttributes(vector<Attribute> &attrs) const;
+
+    private:
+        Iterator* left;
+        Iterator* right;
+        vector<Attribute> left_attrs;
+        vector<Attribute> right_attrs;
+        vector<Attribute> total_attrs;
+        vector<string> right_names;
+        Condition cond;
+        int left_attr_comp_index;
+        int right_attr_comp_index;
+        size_t budget;
+        RC error;
+
+        // Current tuple of each input, and its key to check the order
+        bool started;
+        void* left_tuple;
+        void* right_tuple;
+        bool left_done;
+        bool right_done;
+        string left_key;
+        string right_key;
+
+        // The right tuples sharing the key of the current left tuple, replayed for every such left tuple
+        bool in_run;
+        string run_key;
+        vector<char> run_buffer;
+        vector<unsigned> run_offsets;
+        size_t run_pos;
+        bool run_spilled;
+        bool replaying_spill;
+        string spill_file;
+        FileHandle spill_handle;
+        RBFM_ScanIterator spill_iter;
+        void* spill_tuple;
+        unsigned instance;
+
+        RC advance(bool leftSide);
+        RC collectRun();
+        RC startReplay();
+        RC nextRunTuple(const void *&tuple);
+        void clearRun();
 };
 
 
@@ -0,0 +1,131 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "qe_test_util.h"
+
+// Runs left JOIN right ON left.attr op right.attr, checks every result, returns the number of results
+int joinOn(const string &attrName, CompOp op, unsigned &pageAccesses) {
+	TableScan *leftIn = new TableScan(*rm, "left");
+	IndexScan *rightIn = new IndexScan(*rm, "right", attrName);
+
+	Condition cond;
+	cond.lhsAttr = "left." + attrName;
+	cond.op = op;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "right." + attrName;
+
+	BufferManager *bm = PagedFileManager::instance()->getBufferManager();
+	unsigned before = bm->hitCounter + bm->missCounter;
+
+	INLJoin *inlJoin = new INLJoin(leftIn, rightIn, cond);
+	void *data = malloc(bufSize);
+	int count = 0;
+	RC rc;
+	while ((rc = inlJoin->getNextTuple(data)) == success) {
+		// left.A, left.B, left.C, right.B, right.C, right.D under a single null indicator
+		assert(*(unsigned char *) data == 0 && "No field should be null.");
+		int leftB = *(int *) ((char *) data + 1 + sizeof(int));
+		float leftC = *(float *) ((char *) data + 1 + 2 * sizeof(int));
+		int rightB = *(int *) ((char *) data + 1 + 2 * sizeof(int) + sizeof(float));
+		float rightC = *(float *) ((char *) data + 1 + 3 * sizeof(int) + sizeof(float));
+		int rightD = *(int *) ((char *) data + 1 + 3 * sizeof(int) + 2 * sizeof(float));
+		assert(rightB == rightD + 20 && rightC == rightD + 25 && "The inner tuple should be intact.");
+
+		float l = attrName == "B" ? leftB : leftC;
+		float r = attrName == "B" ? rightB : rightC;
+		bool match = false;
+		switch (op) {
+			case EQ_OP: match = l == r; break;
+			case LT_OP: match = l < r; break;
+			case LE_OP: match = l <= r; break;
+			case GT_OP: match = l > r; break;
+			case GE_OP: match = l >= r; break;
+			case NE_OP: match = l != r; break;
+			default: break;
+		}
+		assert(match && "A returned tuple does not satisfy the join condition.");
+		count++;
+	}
+	assert(rc == QE_EOF && "INLJoin::getNextTuple() should end with QE_EOF.");
+	pageAccesses = bm->hitCounter + bm->missCounter - before;
+
+	delete inlJoin;
+	delete leftIn;
+	delete rightIn;
+	free(data);
+	return count;
+}
+
+// Counts the pairs of left.B in [10, 109] and right.B in [20, 119] that satisfy op
+int expectedCount(CompOp op) {
+	int count = 0;
+	for (int l = 10; l < 10 + tupleCount; l++) {
+		for (int r = 20; r < 20 + tupleCount; r++) {
+			switch (op) {
+				case EQ_OP: count += l == r; break;
+				case LT_OP: count += l < r; break;
+				case LE_OP: count += l <= r; break;
+				case GT_OP: count += l > r; break;
+				case GE_OP: count += l >= r; break;
+				case NE_OP: count += l != r; break;
+				default: break;
+			}
+		}
+	}
+	return count;
+}
+
+int testCase_11() {
+	// Optional
+	// 1. INLJoin -- equality probes on TypeInt and TypeReal attributes
+	// 2. INLJoin -- range probes for the other comparison operators
+	// SELECT * FROM left, right WHERE left.B op right.B
+	cerr << endl << "***** In QE Test Case 11 *****" << endl;
+
+	unsigned pageAccesses;
+	int count = joinOn("B", EQ_OP, pageAccesses);
+	cerr << "left.B = right.B: " << count << " tuples, " << pageAccesses << " page accesses" << endl;
+	if (count != expectedCount(EQ_OP)) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		return fail;
+	}
+	// One descent per outer tuple, not a scan of the whole index
+	if (pageAccesses > (unsigned) tupleCount * 10) {
+		cerr << "***** The join should probe the index. *****" << endl;
+		return fail;
+	}
+
+	count = joinOn("C", EQ_OP, pageAccesses);
+	if (count != 75) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		return fail;
+	}
+
+	CompOp ops[] = { LT_OP, LE_OP, GT_OP, GE_OP, NE_OP };
+	for (unsigned i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+		count = joinOn("B", ops[i], pageAccesses);
+		cerr << "op " << ops[i] << ": " << count << " tuples" << endl;
+		if (count != expectedCount(ops[i])) {
+			cerr << "***** The number of returned tuple is not correct. *****" << endl;
+			return fail;
+		}
+	}
+	return success;
+}
+
+int main() {
+
+	if (testCase_11() != success) {
+		cerr << "***** [FAIL] QE Test Case 11 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 11 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
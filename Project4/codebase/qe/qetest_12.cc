@@ -0,0 +1,158 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "qe_test_util.h"
+
+// A table scan that counts the pages it reads, a page is read each time the scan moves onto it
+class CountingTableScan : public TableScan {
+	public:
+		CountingTableScan(RelationManager &rm, const string &tableName) : TableScan(rm, tableName), pageReads(0), lastPage(-1) {};
+
+		RC getNextTuple(void *data) {
+			RC rc = TableScan::getNextTuple(data);
+			if (rc == success && (int) rid.pageNum != lastPage) {
+				pageReads++;
+				lastPage = rid.pageNum;
+			}
+			if (rc == QE_EOF)
+				lastPage = -1;
+			return rc;
+		};
+
+		unsigned pageReads;
+	private:
+		int lastPage;
+};
+
+int testCase_12() {
+	// Optional
+	// 1. BNLJoin -- on TypeInt Attribute, with several blocks
+	// 2. BNLJoin -- with a condition other than EQ_OP
+	// SELECT * FROM largeleft, largeright WHERE largeleft.B = largeright.B
+	cerr << endl << "***** In QE Test Case 12 *****" << endl;
+
+	RC rc = success;
+	const unsigned numPages = 40;
+
+	// The number of pages of largeright
+	CountingTableScan *rightIn = new CountingTableScan(*rm, "largeright");
+	void *data = malloc(PAGE_SIZE);
+	while (rightIn->getNextTuple(data) == success);
+	unsigned rightPages = rightIn->pageReads;
+	rightIn->pageReads = 0;
+	rightIn->setIterator();
+
+	// Left tuples all have the same size: the null indicator and three fields
+	TableScan *leftIn = new TableScan(*rm, "largeleft");
+	unsigned leftTupleSize = 1 + 3 * sizeof(int);
+	unsigned tuplesPerBlock = numPages * PAGE_SIZE / leftTupleSize;
+	unsigned numBlocks = (largeTupleCount + tuplesPerBlock - 1) / tuplesPerBlock;
+
+	Condition cond;
+	cond.lhsAttr = "largeleft.B";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "largeright.B";
+
+	int expectedResultCnt = largeTupleCount - 10; // 20~50009  left.B: [10,50009], right.B: [20,50019]
+	int actualResultCnt = 0;
+
+	BNLJoin *bnlJoin = new BNLJoin(leftIn, rightIn, cond, numPages);
+	while ((rc = bnlJoin->getNextTuple(data)) == success) {
+		// largeleft.A, largeleft.B, largeleft.C, largeright.B, largeright.C, largeright.D
+		if (*(unsigned char *) data != 0) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+		int leftB = *(int *) ((char *) data + 1 + sizeof(int));
+		int rightB = *(int *) ((char *) data + 1 + 2 * sizeof(int) + sizeof(float));
+		int rightD = *(int *) ((char *) data + 1 + 3 * sizeof(int) + 2 * sizeof(float));
+		if (leftB != rightB || rightD != rightB - 20) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+		actualResultCnt++;
+	}
+	if (rc != QE_EOF) {
+		cerr << "***** BNLJoin::getNextTuple() failed. *****" << endl;
+		goto clean_up;
+	}
+	rc = success;
+
+	cerr << "blocks " << numBlocks << ", right pages " << rightPages << ", right page reads " << rightIn->pageReads << endl;
+	if (expectedResultCnt != actualResultCnt) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+		goto clean_up;
+	}
+	// The right side is read once per block
+	if (rightIn->pageReads != numBlocks * rightPages) {
+		cerr << "***** The right side should be read once per block. *****" << endl;
+		rc = fail;
+		goto clean_up;
+	}
+
+	// SELECT * FROM left, right WHERE left.B < right.B
+	delete bnlJoin;
+	delete leftIn;
+	delete rightIn;
+	leftIn = new TableScan(*rm, "left");
+	rightIn = new CountingTableScan(*rm, "right");
+	cond.lhsAttr = "left.B";
+	cond.op = LT_OP;
+	cond.rhsAttr = "right.B";
+	bnlJoin = new BNLJoin(leftIn, rightIn, cond, 1);
+	actualResultCnt = 0;
+	while (bnlJoin->getNextTuple(data) == success) {
+		int leftB = *(int *) ((char *) data + 1 + sizeof(int));
+		int rightB = *(int *) ((char *) data + 1 + 2 * sizeof(int) + sizeof(float));
+		if (leftB >= rightB) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			rc = fail;
+			goto clean_up;
+		}
+		actualResultCnt++;
+	}
+	expectedResultCnt = 5905; // left.B: [10,109], right.B: [20,119]
+	if (expectedResultCnt != actualResultCnt) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+
+clean_up:
+	delete bnlJoin;
+	delete leftIn;
+	delete rightIn;
+	free(data);
+	return rc;
+}
+
+int main() {
+	// Tables created: largeleft, largeright
+	// Indexes created: none
+
+	rm->deleteTable("largeleft");
+	rm->deleteTable("largeright");
+	if (createLargeLeftTable() != success || populateLargeLeftTable() != success
+			|| createLargeRightTable() != success || populateLargeRightTable() != success) {
+		cerr << "***** Creating the large tables failed. *****" << endl;
+		cerr << "***** [FAIL] QE Test Case 12 failed. *****" << endl;
+		return fail;
+	}
+
+	if (testCase_12() != success) {
+		cerr << "***** [FAIL] QE Test Case 12 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 12 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
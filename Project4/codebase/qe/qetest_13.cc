@@ -0,0 +1,153 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+
+#include "qe_test_util.h"
+
+// Number of partition files in the current directory
+int countPartitionFiles() {
+	int count = 0;
+	DIR *dir = opendir(".");
+	struct dirent *file;
+	while ((file = readdir(dir)) != NULL) {
+		if (strncmp(file->d_name, "ghjoin_", strlen("ghjoin_")) == 0)
+			count++;
+	}
+	closedir(dir);
+	return count;
+}
+
+// SELECT * FROM largeleft, largeright WHERE largeleft.B = largeright.B
+int joinLarge(unsigned numPartitions, unsigned numPages) {
+	TableScan *leftIn = new TableScan(*rm, "largeleft");
+	TableScan *rightIn = new TableScan(*rm, "largeright");
+
+	Condition cond;
+	cond.lhsAttr = "largeleft.B";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "largeright.B";
+
+	GHJoin *ghJoin = new GHJoin(leftIn, rightIn, cond, numPartitions, numPages);
+	void *data = malloc(PAGE_SIZE);
+	int count = 0;
+	RC rc;
+	while ((rc = ghJoin->getNextTuple(data)) == success) {
+		// largeleft.A, largeleft.B, largeleft.C, largeright.B, largeright.C, largeright.D
+		int leftB = *(int *) ((char *) data + 1 + sizeof(int));
+		int rightB = *(int *) ((char *) data + 1 + 2 * sizeof(int) + sizeof(float));
+		int rightD = *(int *) ((char *) data + 1 + 3 * sizeof(int) + 2 * sizeof(float));
+		if (*(unsigned char *) data != 0 || leftB != rightB || rightD != rightB - 20) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			count = -1;
+			break;
+		}
+		count++;
+	}
+	if (count >= 0 && rc != QE_EOF)
+		count = -1;
+
+	delete ghJoin;
+	delete leftIn;
+	delete rightIn;
+	free(data);
+	return count;
+}
+
+int testCase_13() {
+	// Optional
+	// 1. GHJoin -- on TypeInt Attribute, partitions fit in memory
+	// 2. GHJoin -- partitions that have to be split again
+	// 3. GHJoin -- partition files are removed, also when the join is not read to the end
+	cerr << endl << "***** In QE Test Case 13 *****" << endl;
+
+	int expectedResultCnt = largeTupleCount - 10; // 20~50009  left.B: [10,50009], right.B: [20,50019]
+
+	// 10 partitions of about 65KB each fit in 100 pages
+	int count = joinLarge(10, 100);
+	cerr << "10 partitions, 100 pages: " << count << " tuples" << endl;
+	if (count != expectedResultCnt || countPartitionFiles() != 0) {
+		cerr << "***** The join without repartitioning is not correct. *****" << endl;
+		return fail;
+	}
+
+	// With 2 pages every partition is split once more
+	count = joinLarge(10, 2);
+	cerr << "10 partitions, 2 pages: " << count << " tuples" << endl;
+	if (count != expectedResultCnt || countPartitionFiles() != 0) {
+		cerr << "***** The join with repartitioning is not correct. *****" << endl;
+		return fail;
+	}
+
+	// With 2 partitions and a single page the depth limit is reached
+	count = joinLarge(2, 1);
+	cerr << "2 partitions, 1 page: " << count << " tuples" << endl;
+	if (count != expectedResultCnt || countPartitionFiles() != 0) {
+		cerr << "***** The join past the depth limit is not correct. *****" << endl;
+		return fail;
+	}
+
+	// Stopping early still removes every partition
+	TableScan *leftIn = new TableScan(*rm, "largeleft");
+	TableScan *rightIn = new TableScan(*rm, "largeright");
+	Condition cond;
+	cond.lhsAttr = "largeleft.B";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "largeright.B";
+	GHJoin *ghJoin = new GHJoin(leftIn, rightIn, cond, 10, 2);
+	void *data = malloc(PAGE_SIZE);
+	for (int i = 0; i < 10; i++) {
+		if (ghJoin->getNextTuple(data) != success) {
+			cerr << "***** GHJoin::getNextTuple() should not fail. *****" << endl;
+			return fail;
+		}
+	}
+	bool filesLeft = countPartitionFiles() > 0;
+	delete ghJoin;
+	delete leftIn;
+	delete rightIn;
+	free(data);
+	if (!filesLeft || countPartitionFiles() != 0) {
+		cerr << "***** Partition files should be removed when the join is deleted. *****" << endl;
+		return fail;
+	}
+
+	// Only equi-joins are supported
+	leftIn = new TableScan(*rm, "left");
+	rightIn = new TableScan(*rm, "right");
+	cond.lhsAttr = "left.B";
+	cond.op = LT_OP;
+	cond.rhsAttr = "right.B";
+	ghJoin = new GHJoin(leftIn, rightIn, cond, 10);
+	data = malloc(PAGE_SIZE);
+	RC rc = ghJoin->getNextTuple(data);
+	delete ghJoin;
+	delete leftIn;
+	delete rightIn;
+	free(data);
+	if (rc != JOIN_BAD_COND) {
+		cerr << "***** A join condition other than EQ_OP should be refused. *****" << endl;
+		return fail;
+	}
+	return success;
+}
+
+int main() {
+	// Tables created: none
+	// Indexes created: none
+
+	if (testCase_13() != success) {
+		cerr << "***** [FAIL] QE Test Case 13 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 13 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
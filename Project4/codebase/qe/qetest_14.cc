@@ -0,0 +1,162 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+#include <map>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+
+#include "qe_test_util.h"
+
+// Number of spill files in the current directory
+int countSpillFiles() {
+	int count = 0;
+	DIR *dir = opendir(".");
+	struct dirent *file;
+	while ((file = readdir(dir)) != NULL) {
+		if (strncmp(file->d_name, "aggregate_", strlen("aggregate_")) == 0)
+			count++;
+	}
+	closedir(dir);
+	return count;
+}
+
+// SELECT op(left.attr) FROM left
+float scalarAggregate(const string &attrName, AggregateOp op) {
+	TableScan *input = new TableScan(*rm, "left");
+	Attribute aggAttr;
+	aggAttr.name = "left." + attrName;
+	aggAttr.type = attrName == "C" ? TypeReal : TypeInt;
+	aggAttr.length = 4;
+	Aggregate *agg = new Aggregate(input, aggAttr, op);
+
+	void *data = malloc(bufSize);
+	float result = -1;
+	if (agg->getNextTuple(data) == success && *(unsigned char *) data == 0)
+		result = *(float *) ((char *) data + 1);
+	if (agg->getNextTuple(data) != QE_EOF)
+		result = -1;
+	delete agg;
+	delete input;
+	free(data);
+	return result;
+}
+
+int testCase_14() {
+	// Optional
+	// 1. Aggregate -- MIN, MAX, COUNT, SUM and AVG without groups
+	// 2. Aggregate -- group by a TypeVarChar attribute
+	// 3. Aggregate -- group by a TypeReal attribute, with groups spilled to disk
+	// 4. Aggregate -- a group attribute missing from the input
+	cerr << endl << "***** In QE Test Case 14 *****" << endl;
+
+	// left.A: [0,99], left.B: [10,109], left.C: [50.0,149.0]
+	if (scalarAggregate("B", MAX) != 109 || scalarAggregate("C", MIN) != 50 || scalarAggregate("A", SUM) != 4950
+			|| scalarAggregate("B", AVG) != 59.5 || scalarAggregate("C", COUNT) != tupleCount) {
+		cerr << "***** A scalar aggregate is not correct. *****" << endl;
+		return fail;
+	}
+
+	// SELECT leftvarchar.B, SUM(leftvarchar.A) FROM leftvarchar GROUP BY leftvarchar.B
+	// B is a string of (i % 26) + 1 times the same letter, A is i + 20
+	map<string, float> expected;
+	for (int i = 0; i < varcharTupleCount; i++) {
+		int length = (i % 26) + 1;
+		expected[string(length, 96 + length)] += i + 20;
+	}
+	TableScan *input = new TableScan(*rm, "leftvarchar");
+	Attribute aggAttr, groupAttr;
+	aggAttr.name = "leftvarchar.A";
+	aggAttr.type = TypeInt;
+	aggAttr.length = 4;
+	groupAttr.name = "leftvarchar.B";
+	groupAttr.type = TypeVarChar;
+	groupAttr.length = 30;
+	Aggregate *agg = new Aggregate(input, aggAttr, groupAttr, SUM, 4);
+
+	vector<Attribute> attrs;
+	agg->getAttributes(attrs);
+	if (attrs.size() != 2 || attrs[0].name != "leftvarchar.B" || attrs[1].name != "SUM(leftvarchar.A)") {
+		cerr << "***** The output attributes are not correct. *****" << endl;
+		return fail;
+	}
+
+	void *data = malloc(bufSize);
+	map<string, float> actual;
+	while (agg->getNextTuple(data) == success) {
+		int length = *(int *) ((char *) data + 1);
+		string b((char *) data + 1 + sizeof(int), length);
+		if (actual.count(b) != 0) {
+			cerr << "***** A group is returned twice. *****" << endl;
+			return fail;
+		}
+		actual[b] = *(float *) ((char *) data + 1 + sizeof(int) + length);
+	}
+	delete agg;
+	delete input;
+	if (actual != expected || countSpillFiles() != 0) {
+		cerr << "***** Grouping by a varchar is not correct. *****" << endl;
+		return fail;
+	}
+
+	// SELECT largeleft.C, MAX(largeleft.A) FROM largeleft GROUP BY largeleft.C
+	// Every C is its own group, so most groups are spilled, and spilled again
+	input = new TableScan(*rm, "largeleft");
+	aggAttr.name = "largeleft.A";
+	groupAttr.name = "largeleft.C";
+	groupAttr.type = TypeReal;
+	groupAttr.length = 4;
+	agg = new Aggregate(input, aggAttr, groupAttr, MAX, 100);
+	vector<bool> seen(largeTupleCount, false);
+	int numGroups = 0;
+	bool spilled = false;
+	while (agg->getNextTuple(data) == success) {
+		float c = *(float *) ((char *) data + 1);
+		float a = *(float *) ((char *) data + 1 + sizeof(float));
+		int i = (int) a;
+		if (*(unsigned char *) data != 0 || i < 0 || i >= largeTupleCount || seen[i] || c != a + 50) {
+			cerr << "***** A returned group is not correct. *****" << endl;
+			return fail;
+		}
+		seen[i] = true;
+		numGroups++;
+		spilled = spilled || countSpillFiles() > 0;
+	}
+	delete agg;
+	delete input;
+	cerr << "groups: " << numGroups << endl;
+	if (numGroups != largeTupleCount || !spilled || countSpillFiles() != 0) {
+		cerr << "***** Grouping with spilled groups is not correct. *****" << endl;
+		return fail;
+	}
+
+	// A group attribute the input lacks is reported, before and after getNextTuple
+	input = new TableScan(*rm, "largeleft");
+	groupAttr.name = "largeleft.D";
+	agg = new Aggregate(input, aggAttr, groupAttr, MAX, 100);
+	agg->getAttributes(attrs);
+	if (attrs.size() != 2 || attrs[0].name != "largeleft.D" || agg->getNextTuple(data) != AGG_BAD_ATTR) {
+		cerr << "***** A missing group attribute should be an error. *****" << endl;
+		return fail;
+	}
+	delete agg;
+	delete input;
+	free(data);
+	return success;
+}
+
+int main() {
+	// Tables created: none
+	// Indexes created: none
+
+	if (testCase_14() != success) {
+		cerr << "***** [FAIL] QE Test Case 14 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 14 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
@@ -0,0 +1,192 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+
+#include "qe_test_util.h"
+
+// Number of run files in the current directory
+int countRunFiles() {
+	int count = 0;
+	DIR *dir = opendir(".");
+	struct dirent *file;
+	while ((file = readdir(dir)) != NULL) {
+		if (strncmp(file->d_name, "sort_", strlen("sort_")) == 0)
+			count++;
+	}
+	closedir(dir);
+	return count;
+}
+
+// Generates gen.A with many duplicates and every 1000th one null, gen.B a short string, gen.C the position in the input
+class TupleGenerator : public Iterator {
+	public:
+		TupleGenerator(int count) : count(count), next(0) {};
+
+		RC getNextTuple(void *data) {
+			if (next == count)
+				return QE_EOF;
+			unsigned char *nullIndicator = (unsigned char *) data;
+			*nullIndicator = 0;
+			int offset = 1;
+			if (next % 1000 == 999)
+				*nullIndicator |= 1 << 7;
+			else {
+				int a = (int) (((unsigned) next * 2654435761u) % 1000);
+				memcpy((char *) data + offset, &a, sizeof(int));
+				offset += sizeof(int);
+			}
+			int length = next % 5 + 1;
+			memcpy((char *) data + offset, &length, sizeof(int));
+			memset((char *) data + offset + sizeof(int), 'a' + next % 26, length);
+			offset += sizeof(int) + length;
+			memcpy((char *) data + offset, &next, sizeof(int));
+			next++;
+			return success;
+		};
+
+		void getAttributes(vector<Attribute> &attrs) const {
+			attrs.clear();
+			Attribute attr;
+			attr.name = "gen.A";
+			attr.type = TypeInt;
+			attr.length = 4;
+			attrs.push_back(attr);
+			attr.name = "gen.B";
+			attr.type = TypeVarChar;
+			attr.length = 5;
+			attrs.push_back(attr);
+			attr.name = "gen.C";
+			attr.type = TypeInt;
+			attr.length = 4;
+			attrs.push_back(attr);
+		};
+
+	private:
+		int count;
+		int next;
+};
+
+// Reads gen.A (or -1 for null), gen.B and gen.C
+void readTuple(const void *data, int &a, string &b, int &c) {
+	int offset = 1;
+	a = -1;
+	if (!(*(unsigned char *) data & (1 << 7))) {
+		a = *(int *) ((char *) data + offset);
+		offset += sizeof(int);
+	}
+	int length = *(int *) ((char *) data + offset);
+	b.assign((char *) data + offset + sizeof(int), length);
+	offset += sizeof(int) + length;
+	c = *(int *) ((char *) data + offset);
+}
+
+// SELECT * FROM gen ORDER BY gen.A, with equal A in input order
+int sortByA(int count, unsigned numPages, bool expectRuns) {
+	TupleGenerator *input = new TupleGenerator(count);
+	vector<SortAttribute> sortAttrs(1);
+	sortAttrs[0].name = "gen.A";
+	sortAttrs[0].order = ASCENDING;
+	Sort *sort = new Sort(input, sortAttrs, numPages);
+
+	void *data = malloc(PAGE_SIZE);
+	int a, c, lastA = -2, lastC = -1, returned = 0;
+	string b;
+	RC rc = success;
+	while (sort->getNextTuple(data) == success) {
+		readTuple(data, a, b, c);
+		if (a < lastA || (a == lastA && c <= lastC)) {
+			cerr << "***** The tuples are not in order. *****" << endl;
+			rc = fail;
+			break;
+		}
+		if (returned == 0 && (countRunFiles() > 0) != expectRuns) {
+			cerr << "***** Runs should be written only when the input does not fit. *****" << endl;
+			rc = fail;
+			break;
+		}
+		lastA = a;
+		lastC = c;
+		returned++;
+	}
+	delete sort;
+	delete input;
+	free(data);
+	if (rc == success && returned != count) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+	if (countRunFiles() != 0) {
+		cerr << "***** Run files should be removed. *****" << endl;
+		rc = fail;
+	}
+	return rc;
+}
+
+int testCase_15() {
+	// Optional
+	// 1. Sort -- in memory
+	// 2. Sort -- 1M tuples with 100 pages
+	// 3. Sort -- several merge passes
+	// 4. Sort -- on two attributes, one descending
+	cerr << endl << "***** In QE Test Case 15 *****" << endl;
+
+	if (sortByA(10000, 100, false) != success)
+		return fail;
+	cerr << "1M tuples, 100 pages" << endl;
+	if (sortByA(1000000, 100, true) != success)
+		return fail;
+	cerr << "100K tuples, 3 pages" << endl;
+	if (sortByA(100000, 3, true) != success)
+		return fail;
+
+	// SELECT * FROM gen ORDER BY gen.B DESC, gen.A
+	TupleGenerator *input = new TupleGenerator(100000);
+	vector<SortAttribute> sortAttrs(2);
+	sortAttrs[0].name = "gen.B";
+	sortAttrs[0].order = DESCENDING;
+	sortAttrs[1].name = "gen.A";
+	sortAttrs[1].order = ASCENDING;
+	Sort *sort = new Sort(input, sortAttrs, 20);
+	void *data = malloc(PAGE_SIZE);
+	int a, c, lastA = -2, returned = 0;
+	string b, lastB;
+	RC rc = success;
+	while (sort->getNextTuple(data) == success) {
+		readTuple(data, a, b, c);
+		if (returned > 0 && (b > lastB || (b == lastB && a < lastA))) {
+			cerr << "***** The tuples are not in order. *****" << endl;
+			rc = fail;
+			break;
+		}
+		lastA = a;
+		lastB = b;
+		returned++;
+	}
+	delete sort;
+	delete input;
+	free(data);
+	if (rc == success && returned != 100000) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		rc = fail;
+	}
+	return rc;
+}
+
+int main() {
+	// Tables created: none
+	// Indexes created: none
+
+	if (testCase_15() != success) {
+		cerr << "***** [FAIL] QE Test Case 15 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 15 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
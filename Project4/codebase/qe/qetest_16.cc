@@ -0,0 +1,233 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+
+#include "qe_test_util.h"
+
+// Number of spill files in the current directory
+int countSpillFiles() {
+	int count = 0;
+	DIR *dir = opendir(".");
+	struct dirent *file;
+	while ((file = readdir(dir)) != NULL) {
+		if (strncmp(file->d_name, "smjoin_", strlen("smjoin_")) == 0)
+			count++;
+	}
+	closedir(dir);
+	return count;
+}
+
+// Counts the tuples read from an input
+class CountingIterator : public Iterator {
+	public:
+		CountingIterator(Iterator *input) : reads(0), input(input) {};
+		RC getNextTuple(void *data) {
+			reads++;
+			return input->getNextTuple(data);
+		};
+		void getAttributes(vector<Attribute> &attrs) const {
+			input->getAttributes(attrs);
+		};
+		unsigned reads;
+	private:
+		Iterator *input;
+};
+
+// Generates count tuples of rel.K = step * (i / runLength) and rel.V = i
+class RunGenerator : public Iterator {
+	public:
+		RunGenerator(const string &rel, int count, int runLength, int step = 1) : rel(rel), count(count), runLength(runLength), step(step), next(0) {};
+		RC getNextTuple(void *data) {
+			if (next == count)
+				return QE_EOF;
+			*(unsigned char *) data = 0;
+			int k = step * (next / runLength);
+			memcpy((char *) data + 1, &k, sizeof(int));
+			memcpy((char *) data + 1 + sizeof(int), &next, sizeof(int));
+			next++;
+			return success;
+		};
+		void getAttributes(vector<Attribute> &attrs) const {
+			attrs.clear();
+			Attribute attr;
+			attr.name = rel + ".K";
+			attr.type = TypeInt;
+			attr.length = 4;
+			attrs.push_back(attr);
+			attr.name = rel + ".V";
+			attrs.push_back(attr);
+		};
+	private:
+		string rel;
+		int count;
+		int runLength;
+		int step;
+		int next;
+};
+
+// Generates a tuple of rel.K = keys[i] for each key, REAL keys
+class RealGenerator : public Iterator {
+	public:
+		RealGenerator(const string &rel, const vector<float> &keys) : rel(rel), keys(keys), next(0) {};
+		RC getNextTuple(void *data) {
+			if (next == keys.size())
+				return QE_EOF;
+			*(unsigned char *) data = 0;
+			memcpy((char *) data + 1, &keys[next], sizeof(float));
+			next++;
+			return success;
+		};
+		void getAttributes(vector<Attribute> &attrs) const {
+			attrs.clear();
+			Attribute attr;
+			attr.name = rel + ".K";
+			attr.type = TypeReal;
+			attr.length = 4;
+			attrs.push_back(attr);
+		};
+	private:
+		string rel;
+		vector<float> keys;
+		unsigned next;
+};
+
+// Joins REAL keys, returns the number of tuples or -1 on error
+int joinRealKeys(const vector<float> &leftKeys, const vector<float> &rightKeys) {
+	RealGenerator leftGen("l", leftKeys);
+	RealGenerator rightGen("r", rightKeys);
+	Condition cond;
+	cond.lhsAttr = "l.K";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "r.K";
+	SMJoin smJoin(&leftGen, &rightGen, cond);
+	char data[PAGE_SIZE];
+	int count = 0;
+	RC rc;
+	while ((rc = smJoin.getNextTuple(data)) == success)
+		count++;
+	return rc == QE_EOF ? count : -1;
+}
+
+int testCase_16() {
+	// Optional
+	// 1. SMJoin -- on two IndexScans, each input read once
+	// 2. SMJoin -- duplicate keys on both sides, with the inner run spilled
+	// 3. SMJoin -- an input out of order
+	// 4. SMJoin -- REAL keys, -0.0 and 0.0 in the same run
+	cerr << endl << "***** In QE Test Case 16 *****" << endl;
+
+	// SELECT * FROM left, right WHERE left.B = right.B
+	IndexScan *leftIndex = new IndexScan(*rm, "left", "B");
+	IndexScan *rightIndex = new IndexScan(*rm, "right", "B");
+	CountingIterator *leftIn = new CountingIterator(leftIndex);
+	CountingIterator *rightIn = new CountingIterator(rightIndex);
+	Condition cond;
+	cond.lhsAttr = "left.B";
+	cond.op = EQ_OP;
+	cond.bRhsIsAttr = true;
+	cond.rhsAttr = "right.B";
+	SMJoin *smJoin = new SMJoin(leftIn, rightIn, cond);
+
+	void *data = malloc(PAGE_SIZE);
+	int count = 0;
+	RC rc;
+	while ((rc = smJoin->getNextTuple(data)) == success) {
+		// left.A, left.B, left.C, right.B, right.C, right.D
+		int leftB = *(int *) ((char *) data + 1 + sizeof(int));
+		int rightB = *(int *) ((char *) data + 1 + 2 * sizeof(int) + sizeof(float));
+		if (leftB != rightB) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			return fail;
+		}
+		count++;
+	}
+	cerr << "index join: " << count << " tuples, " << leftIn->reads << " left reads, " << rightIn->reads << " right reads" << endl;
+	if (rc != QE_EOF || count != 90) { // 20~109  left.B: [10,109], right.B: [20,119]
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		return fail;
+	}
+	// Neither index is scanned twice, the right one stops after the last left key
+	if (leftIn->reads > (unsigned) tupleCount + 1 || rightIn->reads > (unsigned) tupleCount + 1) {
+		cerr << "***** Each input should be read once. *****" << endl;
+		return fail;
+	}
+	delete smJoin;
+	delete leftIn;
+	delete rightIn;
+	delete leftIndex;
+	delete rightIndex;
+
+	// 2 keys with 500 left tuples and 2000 right tuples each, a run of 2000 right tuples does not fit in a page
+	RunGenerator *leftGen = new RunGenerator("l", 1000, 500);
+	RunGenerator *rightGen = new RunGenerator("r", 4500, 2000);
+	cond.lhsAttr = "l.K";
+	cond.rhsAttr = "r.K";
+	smJoin = new SMJoin(leftGen, rightGen, cond, 1);
+	count = 0;
+	bool spilled = false;
+	vector<int> pairs(2, 0);
+	while ((rc = smJoin->getNextTuple(data)) == success) {
+		int lk = *(int *) ((char *) data + 1);
+		int rk = *(int *) ((char *) data + 1 + 2 * sizeof(int));
+		if (lk != rk || lk > 1) {
+			cerr << "***** A returned value is not correct. *****" << endl;
+			return fail;
+		}
+		pairs[lk]++;
+		spilled = spilled || countSpillFiles() > 0;
+		count++;
+	}
+	delete smJoin;
+	delete leftGen;
+	delete rightGen;
+	cerr << "duplicate runs: " << count << " tuples" << endl;
+	if (rc != QE_EOF || pairs[0] != 500 * 2000 || pairs[1] != 500 * 2000) {
+		cerr << "***** The number of returned tuple is not correct. *****" << endl;
+		return fail;
+	}
+	if (!spilled || countSpillFiles() != 0) {
+		cerr << "***** A large run should spill, and its file should be removed. *****" << endl;
+		return fail;
+	}
+
+	// -0.0 equals 0.0, so both are one run on either side
+	if (joinRealKeys({0.0f, 0.0f}, {-0.0f, 0.0f}) != 4 || joinRealKeys({-0.0f, 0.0f}, {0.0f, -0.0f}) != 4) {
+		cerr << "***** -0.0 and 0.0 should join as one key. *****" << endl;
+		return fail;
+	}
+
+	// Keys going down are refused
+	leftGen = new RunGenerator("l", 10, 1, -1);
+	rightGen = new RunGenerator("r", 10, 1);
+	smJoin = new SMJoin(leftGen, rightGen, cond);
+	while ((rc = smJoin->getNextTuple(data)) == success);
+	delete smJoin;
+	delete leftGen;
+	delete rightGen;
+	free(data);
+	if (rc != JOIN_NOT_SORTED) {
+		cerr << "***** An input out of order should be detected. *****" << endl;
+		return fail;
+	}
+	return success;
+}
+
+int main() {
+	// Tables created: none
+	// Indexes created: none
+
+	if (testCase_16() != success) {
+		cerr << "***** [FAIL] QE Test Case 16 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 16 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
@@ -0,0 +1,262 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "qe_test_util.h"
+
+const int wideFieldCount = 10;
+
+// A table of 10 int columns, c0 = i, c9 = -i, and c9 null for every third tuple
+int createWideTable() {
+	rm->deleteTable("wide");
+	vector<Attribute> attrs;
+	Attribute attr;
+	for (int i = 0; i < wideFieldCount; i++) {
+		attr.name = "c" + to_string(i);
+		attr.type = TypeInt;
+		attr.length = 4;
+		attrs.push_back(attr);
+	}
+	RC rc = rm->createTable("wide", attrs);
+	if (rc != success)
+		return rc;
+
+	char buf[bufSize];
+	RID rid;
+	for (int i = 0; i < tupleCount; i++) {
+		memset(buf, 0, bufSize);
+		int offset = 2;
+		bool nullLast = i % 3 == 0;
+		if (nullLast)
+			buf[1] = 1 << 6;
+		for (int j = 0; j < wideFieldCount; j++) {
+			if (j == wideFieldCount - 1 && nullLast)
+				break;
+			int value = j == 0 ? i : (j == wideFieldCount - 1 ? -i : j);
+			memcpy(buf + offset, &value, sizeof(int));
+			offset += sizeof(int);
+		}
+		rc = rm->insertTuple("wide", buf, rid);
+		if (rc != success)
+			return rc;
+	}
+	return success;
+}
+
+// Reads an iterator to the end one batch at a time, the selected tuples are appended to tuples
+RC readBatches(Iterator *input, unsigned capacity, vector<string> &tuples, unsigned &batches) {
+	TupleBatch batch(capacity);
+	RC rc;
+	batches = 0;
+	while ((rc = input->getNextBatch(batch)) == success) {
+		if (batch.size() == 0 || batch.size() > capacity)
+			return fail;
+		for (unsigned i = 0; i < batch.size(); i++) {
+			unsigned row = batch.selection[i];
+			tuples.push_back(string(batch.getTuple(row), batch.getTupleLength(row)));
+		}
+		batches++;
+	}
+	return rc == QE_EOF ? success : rc;
+}
+
+// Reads an iterator to the end one tuple at a time
+RC readTuples(Iterator *input, vector<string> &tuples) {
+	vector<Attribute> attrs;
+	input->getAttributes(attrs);
+	char data[PAGE_SIZE];
+	RC rc;
+	while ((rc = input->getNextTuple(data)) == success) {
+		unsigned length = getActualByteForNullsIndicator(attrs.size());
+		for (unsigned i = 0; i < attrs.size(); i++) {
+			if (data[i / 8] & (1 << (7 - i % 8)))
+				continue;
+			length += attrs[i].type == TypeVarChar ? 4 + *(int *) (data + length) : 4;
+		}
+		tuples.push_back(string(data, length));
+	}
+	return rc == QE_EOF ? success : rc;
+}
+
+int testCase_17() {
+	// Optional
+	// 1. Batches of TableScan, IndexScan, Filter, Project and the joins -- same tuples as one at a time
+	// 2. Batches smaller than the input, and operators without a batch implementation of their own
+	// 3. Project to fewer null indicator bytes with null fields
+	cerr << endl << "***** In QE Test Case 17 *****" << endl;
+
+	vector<string> expected, actual;
+	unsigned batches;
+
+	// TableScan: every tuple, 1000 of them in 143 batches of 7
+	TableScan *ts = new TableScan(*rm, "leftvarchar");
+	if (readTuples(ts, expected) != success) {
+		cerr << "***** Scanning leftvarchar failed. *****" << endl;
+		return fail;
+	}
+	ts->setIterator();
+	if (readBatches(ts, 7, actual, batches) != success || actual != expected || batches != 143) {
+		cerr << "***** The batches of a TableScan are not correct. *****" << endl;
+		return fail;
+	}
+	delete ts;
+
+	// IndexScan over left.B
+	expected.clear();
+	actual.clear();
+	IndexScan *is = new IndexScan(*rm, "left", "B");
+	readTuples(is, expected);
+	is->setIterator(NULL, NULL, true, true);
+	if (readBatches(is, QE_BATCH_SIZE, actual, batches) != success || actual != expected
+			|| expected.size() != (unsigned) tupleCount || batches != 1) {
+		cerr << "***** The batches of an IndexScan are not correct. *****" << endl;
+		return fail;
+	}
+	delete is;
+
+	// Filter over Filter: 30 <= left.B < 50, the second filter narrows the selection of the first
+	int low = 30, high = 50;
+	Condition lowCond, highCond;
+	lowCond.lhsAttr = "left.B";
+	lowCond.op = GE_OP;
+	lowCond.bRhsIsAttr = false;
+	lowCond.rhsValue.type = TypeInt;
+	lowCond.rhsValue.data = &low;
+	highCond = lowCond;
+	highCond.op = LT_OP;
+	highCond.rhsValue.data = &high;
+	for (int round = 0; round < 2; round++) {
+		ts = new TableScan(*rm, "left");
+		Filter *lowFilter = new Filter(ts, lowCond);
+		Filter *highFilter = new Filter(lowFilter, highCond);
+		if (round == 0) {
+			expected.clear();
+			readTuples(highFilter, expected);
+		} else {
+			actual.clear();
+			if (readBatches(highFilter, 8, actual, batches) != success || actual != expected
+					|| expected.size() != (unsigned) (high - low)) {
+				cerr << "***** The batches of a Filter are not correct. *****" << endl;
+				return fail;
+			}
+		}
+		delete highFilter;
+		delete lowFilter;
+		delete ts;
+	}
+
+	// Project a null field out of 10, to a single null indicator byte
+	if (createWideTable() != success) {
+		cerr << "***** Creating the wide table failed. *****" << endl;
+		return fail;
+	}
+	vector<string> names;
+	names.push_back("wide.c9");
+	names.push_back("wide.c0");
+	for (int round = 0; round < 2; round++) {
+		ts = new TableScan(*rm, "wide");
+		Project *project = new Project(ts, names);
+		vector<string> &tuples = round == 0 ? expected : actual;
+		tuples.clear();
+		RC rc = round == 0 ? readTuples(project, tuples) : readBatches(project, 16, tuples, batches);
+		delete project;
+		delete ts;
+		if (rc != success || tuples.size() != (unsigned) tupleCount) {
+			cerr << "***** Projecting the wide table failed. *****" << endl;
+			return fail;
+		}
+		for (int i = 0; i < tupleCount; i++) {
+			const char *tuple = tuples[i].data();
+			int c9, c0;
+			bool valid;
+			if (i % 3 == 0) {
+				memcpy(&c0, tuple + 1, sizeof(int));
+				valid = tuples[i].size() == 5 && tuple[0] == (char) (1 << 7) && c0 == i;
+			} else {
+				memcpy(&c9, tuple + 1, sizeof(int));
+				memcpy(&c0, tuple + 5, sizeof(int));
+				valid = tuples[i].size() == 9 && tuple[0] == 0 && c9 == -i && c0 == i;
+			}
+			if (!valid) {
+				cerr << "***** The projection of tuple " << i << " is not correct. *****" << endl;
+				return fail;
+			}
+		}
+	}
+	rm->deleteTable("wide");
+
+	// Joins: left.B = right.B, 90 tuples
+	Condition joinCond;
+	joinCond.lhsAttr = "left.B";
+	joinCond.op = EQ_OP;
+	joinCond.bRhsIsAttr = true;
+	joinCond.rhsAttr = "right.B";
+	for (int join = 0; join < 4; join++) {
+		for (int round = 0; round < 2; round++) {
+			TableScan *leftIn = new TableScan(*rm, "left");
+			TableScan *rightScan = new TableScan(*rm, "right");
+			IndexScan *leftIndex = new IndexScan(*rm, "left", "B");
+			IndexScan *rightIndex = new IndexScan(*rm, "right", "B");
+			Iterator *joinIt;
+			if (join == 0)
+				joinIt = new INLJoin(leftIn, rightIndex, joinCond);
+			else if (join == 1)
+				joinIt = new BNLJoin(leftIn, rightScan, joinCond, 5);
+			else if (join == 2)
+				joinIt = new GHJoin(leftIn, rightScan, joinCond, 4);
+			else
+				joinIt = new SMJoin(leftIndex, rightIndex, joinCond);
+			vector<string> &tuples = round == 0 ? expected : actual;
+			tuples.clear();
+			RC rc = round == 0 ? readTuples(joinIt, tuples) : readBatches(joinIt, 10, tuples, batches);
+			delete joinIt;
+			delete leftIn;
+			delete rightScan;
+			delete leftIndex;
+			delete rightIndex;
+			if (rc != success || (round == 1 && (actual != expected || expected.size() != 90 || batches != 9))) {
+				cerr << "***** The batches of join " << join << " are not correct. *****" << endl;
+				return fail;
+			}
+		}
+	}
+
+	// Sort has no batches of its own, its tuples come through getNextTuple
+	vector<SortAttribute> sortAttrs;
+	SortAttribute sortAttr;
+	sortAttr.name = "left.A";
+	sortAttr.order = DESCENDING;
+	sortAttrs.push_back(sortAttr);
+	ts = new TableScan(*rm, "left");
+	Sort *sort = new Sort(ts, sortAttrs);
+	actual.clear();
+	RC rc = readBatches(sort, QE_BATCH_SIZE, actual, batches);
+	delete sort;
+	delete ts;
+	int first = -1;
+	if (!actual.empty())
+		memcpy(&first, actual[0].data() + 1, sizeof(int));
+	if (rc != success || actual.size() != (unsigned) tupleCount || batches != 1 || first != tupleCount - 1) {
+		cerr << "***** The batches of a Sort are not correct. *****" << endl;
+		return fail;
+	}
+	return success;
+}
+
+int main() {
+	// Tables created: none
+	// Indexes created: none
+
+	if (testCase_17() != success) {
+		cerr << "***** [FAIL] QE Test Case 17 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 17 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
@@ -0,0 +1,172 @@
+#include <fstream>
+#include <iostream>
+
+#include <vector>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include "qe_test_util.h"
+
+// Number of tuples left in an iterator
+int countTuples(Iterator *input) {
+	char data[PAGE_SIZE];
+	int count = 0;
+	while (input->getNextTuple(data) == success)
+		count++;
+	return count;
+}
+
+Condition makeCondition(const string &attr, CompOp op, AttrType type, void *value) {
+	Condition cond;
+	cond.lhsAttr = attr;
+	cond.op = op;
+	cond.bRhsIsAttr = false;
+	cond.rhsValue.type = type;
+	cond.rhsValue.data = value;
+	return cond;
+}
+
+int testCase_18() {
+	// Optional
+	// 1. Filter -- the condition is checked by the TableScan below it
+	// 2. Project -- the TableScan below it only reads the projected attributes
+	// 3. Conditions that cannot be pushed down are still checked by the Filter
+	// 4. Several conditions in one scan
+	cerr << endl << "***** In QE Test Case 18 *****" << endl;
+
+	// SELECT * FROM left WHERE left.B < 50: the scan itself only returns 40 tuples
+	int fifty = 50;
+	TableScan *ts = new TableScan(*rm, "left");
+	Filter *filter = new Filter(ts, makeCondition("left.B", LT_OP, TypeInt, &fifty));
+	int count = countTuples(filter);
+	ts->setIterator();
+	int scanned = countTuples(ts);
+	delete filter;
+	delete ts;
+	if (count != 40 || scanned != 40) {
+		cerr << "***** The condition was not pushed into the scan. *****" << endl;
+		return fail;
+	}
+
+	// With an alias: SELECT * FROM left L WHERE L.C >= 100.0
+	float hundred = 100;
+	ts = new TableScan(*rm, "left", "L");
+	filter = new Filter(ts, makeCondition("L.C", GE_OP, TypeReal, &hundred));
+	count = countTuples(filter);
+	if (count != 50 || ts->predicates.size() != 1 || ts->predicates[0].compOp != GE_OP) {
+		cerr << "***** A condition on an alias was not pushed into the scan. *****" << endl;
+		return fail;
+	}
+	delete filter;
+	delete ts;
+
+	// SELECT left.C, left.A FROM left WHERE left.B < 50: two fields read, in the projected order
+	ts = new TableScan(*rm, "left");
+	filter = new Filter(ts, makeCondition("left.B", LT_OP, TypeInt, &fifty));
+	vector<string> names;
+	names.push_back("left.C");
+	names.push_back("left.A");
+	Project *project = new Project(filter, names);
+	vector<Attribute> attrs;
+	project->getAttributes(attrs);
+	if (ts->attrs.size() != 2 || attrs.size() != 2 || attrs[0].name != "left.C") {
+		cerr << "***** The projection was not pushed into the scan. *****" << endl;
+		return fail;
+	}
+	char data[PAGE_SIZE];
+	count = 0;
+	while (project->getNextTuple(data) == success) {
+		float c;
+		int a;
+		memcpy(&c, data + 1, sizeof(float));
+		memcpy(&a, data + 5, sizeof(int));
+		if (data[0] != 0 || c != a + 50 || a < 0 || a >= 40) {
+			cerr << "***** A projected tuple is not correct. *****" << endl;
+			return fail;
+		}
+		count++;
+	}
+	delete project;
+	delete filter;
+	delete ts;
+	if (count != 40) {
+		cerr << "***** The projection returned " << count << " tuples instead of 40. *****" << endl;
+		return fail;
+	}
+
+	// Stacked filters both reach the scan: 30 <= left.B < 50
+	int thirty = 30;
+	ts = new TableScan(*rm, "left");
+	Filter *lowFilter = new Filter(ts, makeCondition("left.B", GE_OP, TypeInt, &thirty));
+	Filter *highFilter = new Filter(lowFilter, makeCondition("left.B", LT_OP, TypeInt, &fifty));
+	count = countTuples(highFilter);
+	unsigned pushed = ts->predicates.size();
+	delete highFilter;
+	delete lowFilter;
+	delete ts;
+	if (count != 20 || pushed != 2) {
+		cerr << "***** Stacked filters returned " << count << " tuples instead of 20. *****" << endl;
+		return fail;
+	}
+
+	// A Filter above a Project reaches the scan through it: SELECT left.B FROM left WHERE left.B > 100
+	int hundredInt = 100;
+	ts = new TableScan(*rm, "left");
+	names.clear();
+	names.push_back("left.B");
+	project = new Project(ts, names);
+	filter = new Filter(project, makeCondition("left.B", GT_OP, TypeInt, &hundredInt));
+	TupleBatch batch;
+	count = 0;
+	if (filter->getNextBatch(batch) == success)
+		count = batch.size();
+	if (count != 9 || ts->predicates.size() != 1 || filter->getNextBatch(batch) != QE_EOF) {
+		cerr << "***** A Filter above a Project was not pushed into the scan. *****" << endl;
+		return fail;
+	}
+	delete filter;
+	delete project;
+	delete ts;
+
+	// A VarChar condition, compared like the Filter does: leftvarchar.B = "ccc" for every 26th tuple
+	char ccc[7];
+	int length = 3;
+	memcpy(ccc, &length, sizeof(int));
+	memcpy(ccc + 4, "ccc", 3);
+	ts = new TableScan(*rm, "leftvarchar");
+	filter = new Filter(ts, makeCondition("leftvarchar.B", EQ_OP, TypeVarChar, ccc));
+	count = countTuples(filter);
+	delete filter;
+	delete ts;
+	if (count != 39) {
+		cerr << "***** A VarChar condition returned " << count << " tuples instead of 39. *****" << endl;
+		return fail;
+	}
+
+	// An IndexScan does not take conditions, the Filter keeps checking them
+	IndexScan *is = new IndexScan(*rm, "left", "B");
+	filter = new Filter(is, makeCondition("left.C", LT_OP, TypeReal, &hundred));
+	count = countTuples(filter);
+	delete filter;
+	delete is;
+	if (count != 50) {
+		cerr << "***** A Filter over an IndexScan returned " << count << " tuples instead of 50. *****" << endl;
+		return fail;
+	}
+	return success;
+}
+
+int main() {
+	// Tables created: none
+	// Indexes created: none
+
+	if (testCase_18() != success) {
+		cerr << "***** [FAIL] QE Test Case 18 failed. *****" << endl;
+		return fail;
+	} else {
+		cerr << "***** QE Test Case 18 finished. The result will be examined. *****" << endl;
+		return success;
+	}
+}
@@ -1,6 +1,11 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -11,7 +16,11 @@ PagedFileManager* PagedFileManager::_pf_manager = NULL;
 PagedFileManager* PagedFileManager::instance()
 {
     if(!_pf_manager)
+    {
         _pf_manager = new PagedFileManager();
+        // Dirty frames of files that were never closed still reach the disk
+        atexit(flushAtExit);
+    }
 
     return _pf_manager;
 }
@@ -19,11 +28,15 @@ PagedFileManager* PagedFileManager::instance()
 
 PagedFileManager::PagedFileManager()
 {
+    _buffer_manager = new BufferManager(BUFFER_POOL_DEFAULT_FRAMES, new ClockPolicy());
+    _next_file_id = 0;
 }
 
 
 PagedFileManager::~PagedFileManager()
 {
+    _buffer_manager->flushAll();
+    delete _buffer_manager;
 }
 
 
@@ -33,19 +46,37 @@ RC PagedFileManager::createFile(const string &fileName)
     if (fileExists(fileName))
         return PFM_FILE_EXISTS;
 
-    // Attempt to open the file for writing
-    FILE *pFile = fopen(fileName.c_str(), "wb");
+    // Attempt to create the file
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
     // Return an error if we fail
-    if (pFile == NULL)
+    if (fd < 0)
         return PFM_OPEN_FAILED;
 
-    fclose (pFile);
+    // If the file was removed behind our back and the inode got reused, don't trust what we cached for it
+    struct stat sb;
+    if (fstat(fd, &sb) == 0)
+    {
+        auto it = _files.find(make_pair(sb.st_dev, sb.st_ino));
+        if (it != _files.end())
+            forgetFile(it->second);
+    }
+
+    close(fd);
     return SUCCESS;
 }
 
 
 RC PagedFileManager::destroyFile(const string &fileName)
 {
+    // Throw away any cached pages of the file
+    struct stat sb;
+    if (stat(fileName.c_str(), &sb) == 0)
+    {
+        auto it = _files.find(make_pair(sb.st_dev, sb.st_ino));
+        if (it != _files.end())
+            forgetFile(it->second);
+    }
+
     // If file cannot be successfully removed, error
     if (remove(fileName.c_str()) != 0)
         return PFM_REMOVE_FAILED;
@@ -54,24 +85,113 @@ RC PagedFileManager::destroyFile(const string &fileName)
 }
 
 
-RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
+RC PagedFileManager::renameFile(const string &fileName, const string &newFileName)
+{
+    if (!fileExists(fileName))
+        return PFM_FILE_DN_EXIST;
+
+    // Throw away any cached pages of the file being replaced. Pages cached for fileName stay valid,
+    // the file keeps its inode.
+    struct stat sb;
+    if (stat(newFileName.c_str(), &sb) == 0)
+    {
+        auto it = _files.find(make_pair(sb.st_dev, sb.st_ino));
+        if (it != _files.end())
+            forgetFile(it->second);
+    }
+
+    if (rename(fileName.c_str(), newFileName.c_str()) != 0)
+        return PFM_RENAME_FAILED;
+
+    return SUCCESS;
+}
+
+
+RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle, bool memoryMapped)
 {
     // If this handle already has an open file, error
-    if (fileHandle.getfd() != NULL)
+    if (fileHandle._file != NULL)
         return PFM_HANDLE_IN_USE;
 
     // If the file doesn't exist, error
     if (!fileExists(fileName.c_str()))
         return PFM_FILE_DN_EXIST;
 
-    // Open the file for reading/writing in binary mode
-    FILE *pFile;
-    pFile = fopen(fileName.c_str(), "rb+");
+    // Open the file for reading/writing
+    int fd = open(fileName.c_str(), O_RDWR);
     // If we fail, error
-    if (pFile == NULL)
+    if (fd < 0)
+        return PFM_OPEN_FAILED;
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0)
+    {
+        close(fd);
         return PFM_OPEN_FAILED;
+    }
+
+    PagedFile *file;
+    auto it = _files.find(make_pair(sb.st_dev, sb.st_ino));
+    if (it == _files.end())
+    {
+        file = new PagedFile;
+        file->id = _next_file_id++;
+        file->dev = sb.st_dev;
+        file->ino = sb.st_ino;
+        file->fd = -1;
+        file->refCount = 0;
+        file->closedSize = -1;
+        file->durability = DURABILITY_NONE;
+        file->unsynced = false;
+        file->map = NULL;
+        file->mapLength = 0;
+        file->mappedCount = 0;
+        _files[make_pair(sb.st_dev, sb.st_ino)] = file;
+    }
+    else
+        file = it->second;
 
-    fileHandle.setfd(pFile);
+    if (file->refCount > 0)
+    {
+        // Someone else already has the file open, share their descriptor.
+        // Appends are written through, so the size on disk is authoritative for the shared page count
+        close(fd);
+        file->numPages = sb.st_size / PAGE_SIZE;
+    }
+    else
+    {
+        // Cached frames are only valid if nobody touched the file since we last closed it
+        if (file->closedSize != sb.st_size
+                || file->closedMtime.tv_sec != sb.st_mtim.tv_sec
+                || file->closedMtime.tv_nsec != sb.st_mtim.tv_nsec)
+        {
+            _buffer_manager->dropFile(file);
+            file->id = _next_file_id++;
+        }
+        file->fd = fd;
+        file->numPages = sb.st_size / PAGE_SIZE;
+    }
+
+    file->refCount++;
+    fileHandle._file = file;
+
+    if (memoryMapped)
+    {
+        if (file->map == NULL)
+        {
+            // Frames written from now on are written through, bring the file up to date first
+            RC rc = _buffer_manager->flushFile(fileHandle);
+            if (rc == SUCCESS)
+                rc = mapFile(file);
+            if (rc)
+            {
+                closeFile(fileHandle);
+                return rc;
+            }
+        }
+        file->mappedCount++;
+        fileHandle._mapped = true;
+    }
 
     return SUCCESS;
 }
@@ -79,18 +199,76 @@ RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
 
 RC PagedFileManager::closeFile(FileHandle &fileHandle)
 {
-    FILE *pFile = fileHandle.getfd();
+    PagedFile *file = fileHandle._file;
 
     // If not an open file, error
-    if (pFile == NULL)
-        return 1;
+    if (file == NULL || file->fd < 0)
+        return PFM_FILE_NOT_OPEN;
+
+    // Once no handle reads from the mapping, writes go back to the pool
+    if (fileHandle._mapped)
+    {
+        fileHandle._mapped = false;
+        if (--file->mappedCount == 0)
+            unmapFile(file);
+    }
 
-    // Flush and close the file
-    fclose(pFile);
+    RC rc = SUCCESS;
+    if (--file->refCount == 0)
+    {
+        // Last handle, write back everything of ours still in the pool
+        rc = _buffer_manager->flushFile(fileHandle);
+        _buffer_manager->releasePins(file);
+        if (file->durability != DURABILITY_NONE && file->unsynced)
+        {
+            if (fdatasync(file->fd) != 0 && rc == SUCCESS)
+                rc = FH_WRITE_FAILED;
+            file->unsynced = false;
+        }
+
+        struct stat sb;
+        if (fstat(file->fd, &sb) == 0)
+        {
+            file->closedSize = sb.st_size;
+            file->closedMtime = sb.st_mtim;
+        }
+        else
+            _buffer_manager->dropFile(file);
+
+        // Close the file
+        close(file->fd);
+        file->fd = -1;
+
+        // File was destroyed while we had it open
+        auto it = _files.find(make_pair(file->dev, file->ino));
+        if (it == _files.end() || it->second != file)
+        {
+            _buffer_manager->dropFile(file);
+            delete file;
+        }
+    }
 
-    fileHandle.setfd(NULL);
+    fileHandle._file = NULL;
 
-    return SUCCESS;
+    return rc;
+}
+
+
+RC PagedFileManager::setBufferPoolSize(unsigned numFrames)
+{
+    return _buffer_manager->resize(numFrames);
+}
+
+
+RC PagedFileManager::setReplacementPolicy(ReplacementPolicy *policy)
+{
+    return _buffer_manager->setPolicy(policy);
+}
+
+
+BufferManager *PagedFileManager::getBufferManager()
+{
+    return _buffer_manager;
 }
 
 // Check if a file already exists
@@ -101,14 +279,461 @@ bool PagedFileManager::fileExists(const string &fileName)
     return stat(fileName.c_str(), &sb) == 0;
 }
 
+// Drop the cached state of a file that no longer exists. Open handles keep it alive until they close.
+void PagedFileManager::forgetFile(PagedFile *file)
+{
+    _buffer_manager->dropFile(file);
+    _files.erase(make_pair(file->dev, file->ino));
+    if (file->refCount == 0)
+        delete file;
+}
+
+
+// Map the whole file and room to grow, read only
+RC PagedFileManager::mapFile(PagedFile *file)
+{
+    size_t length = max((size_t) file->numPages * PAGE_SIZE * 2, (size_t) MMAP_MIN_LENGTH);
+    void *map = mmap(NULL, length, PROT_READ, MAP_SHARED, file->fd, 0);
+    if (map == MAP_FAILED)
+        return PFM_MMAP_FAILED;
+
+    // Pages already handed out from the old mapping must stay readable
+    if (file->map != NULL)
+        file->retiredMaps.push_back(make_pair(file->map, file->mapLength));
+    file->map = (char *) map;
+    file->mapLength = length;
+    return SUCCESS;
+}
+
+
+void PagedFileManager::unmapFile(PagedFile *file)
+{
+    if (file->map == NULL)
+        return;
+    munmap(file->map, file->mapLength);
+    for (auto &retired : file->retiredMaps)
+        munmap(retired.first, retired.second);
+    file->retiredMaps.clear();
+    file->map = NULL;
+    file->mapLength = 0;
+}
+
+
+void PagedFileManager::flushAtExit()
+{
+    if (_pf_manager)
+        _pf_manager->_buffer_manager->flushAll();
+}
+
+
+ClockPolicy::ClockPolicy()
+{
+    hand = 0;
+}
+
+
+void ClockPolicy::reset(unsigned numFrames)
+{
+    referenced.assign(numFrames, false);
+    hand = 0;
+}
+
+
+void ClockPolicy::recordPin(unsigned frame)
+{
+    referenced[frame] = true;
+}
+
+
+void ClockPolicy::recordUnpin(unsigned frame)
+{
+    referenced[frame] = true;
+}
+
+
+void ClockPolicy::recordRemove(unsigned frame)
+{
+    referenced[frame] = false;
+}
+
+
+bool ClockPolicy::pickVictim(const vector<BufferFrame> &frames, unsigned &victim)
+{
+    unsigned numFrames = frames.size();
+    // Two sweeps are enough: the first clears every reference bit it passes
+    for (unsigned i = 0; i < 2 * numFrames; i++)
+    {
+        unsigned frame = hand;
+        hand = (hand + 1) % numFrames;
+
+        if (frames[frame].file == NULL || frames[frame].pinCount > 0)
+            continue;
+        if (referenced[frame])
+        {
+            referenced[frame] = false;
+            continue;
+        }
+        victim = frame;
+        return true;
+    }
+    return false;
+}
+
+
+void LRUPolicy::reset(unsigned numFrames)
+{
+    unpinned.clear();
+    position.assign(numFrames, unpinned.end());
+    queued.assign(numFrames, false);
+}
+
+
+void LRUPolicy::recordPin(unsigned frame)
+{
+    recordRemove(frame);
+}
+
+
+void LRUPolicy::recordUnpin(unsigned frame)
+{
+    recordRemove(frame);
+    position[frame] = unpinned.insert(unpinned.end(), frame);
+    queued[frame] = true;
+}
+
+
+void LRUPolicy::recordRemove(unsigned frame)
+{
+    if (!queued[frame])
+        return;
+    unpinned.erase(position[frame]);
+    queued[frame] = false;
+}
+
+
+bool LRUPolicy::pickVictim(const vector<BufferFrame> &frames, unsigned &victim)
+{
+    for (unsigned frame : unpinned)
+    {
+        if (frames[frame].file != NULL && frames[frame].pinCount == 0)
+        {
+            victim = frame;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+BufferManager::BufferManager(unsigned numFrames, ReplacementPolicy *policy)
+{
+    hitCounter = 0;
+    missCounter = 0;
+    pool = NULL;
+    this->policy = policy;
+    allocateFrames(numFrames);
+}
+
+
+BufferManager::~BufferManager()
+{
+    releaseFrames();
+    delete policy;
+}
+
+
+RC BufferManager::pinPage(FileHandle &fileHandle, PageNum pageNum, bool load, char *&data)
+{
+    auto it = pageTable.find(pageKey(fileHandle._file, pageNum));
+    if (it != pageTable.end())
+    {
+        BufferFrame &frame = frames[it->second];
+        frame.pinCount++;
+        policy->recordPin(it->second);
+        if (load)
+        {
+            hitCounter++;
+            fileHandle.hitCounter++;
+        }
+        data = frame.data;
+        return SUCCESS;
+    }
+
+    unsigned index;
+    RC rc = allocateFrame(fileHandle, index);
+    if (rc)
+        return rc;
+
+    BufferFrame &frame = frames[index];
+    if (load)
+    {
+        missCounter++;
+        fileHandle.missCounter++;
+        rc = fileHandle.readBlock(pageNum, frame.data);
+        if (rc)
+        {
+            freeFrames.push_back(index);
+            return rc;
+        }
+    }
+
+    frame.file = fileHandle._file;
+    frame.pageNum = pageNum;
+    frame.pinCount = 1;
+    frame.dirty = false;
+    pageTable[pageKey(frame.file, pageNum)] = index;
+    policy->recordPin(index);
+
+    data = frame.data;
+    return SUCCESS;
+}
+
+
+RC BufferManager::unpinPage(PagedFile *file, PageNum pageNum, bool dirty)
+{
+    auto it = pageTable.find(pageKey(file, pageNum));
+    if (it == pageTable.end() || frames[it->second].pinCount == 0)
+        return FH_PAGE_NOT_PINNED;
+
+    BufferFrame &frame = frames[it->second];
+    frame.dirty = frame.dirty || dirty;
+    if (--frame.pinCount == 0)
+        policy->recordUnpin(it->second);
+    return SUCCESS;
+}
+
+
+char *BufferManager::lookup(PagedFile *file, PageNum pageNum)
+{
+    auto it = pageTable.find(pageKey(file, pageNum));
+    if (it == pageTable.end())
+        return NULL;
+    return frames[it->second].data;
+}
+
+
+void BufferManager::markDirty(PagedFile *file, PageNum pageNum)
+{
+    auto it = pageTable.find(pageKey(file, pageNum));
+    if (it != pageTable.end())
+        frames[it->second].dirty = true;
+}
+
+
+RC BufferManager::flushFile(FileHandle &fileHandle)
+{
+    RC rc = SUCCESS;
+    for (BufferFrame &frame : frames)
+    {
+        if (frame.file == fileHandle._file && frame.dirty)
+        {
+            RC frc = writeBack(&fileHandle, frame);
+            if (frc)
+                rc = frc;
+        }
+    }
+    return rc;
+}
+
+
+RC BufferManager::flushAll()
+{
+    RC rc = SUCCESS;
+    for (BufferFrame &frame : frames)
+    {
+        if (frame.file != NULL && frame.dirty)
+        {
+            RC frc = writeBack(NULL, frame);
+            if (frc)
+                rc = frc;
+        }
+    }
+    return rc;
+}
+
+
+void BufferManager::releasePins(PagedFile *file)
+{
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        if (frames[i].file != file || frames[i].pinCount == 0)
+            continue;
+        frames[i].pinCount = 0;
+        policy->recordUnpin(i);
+    }
+}
+
+
+void BufferManager::dropFile(PagedFile *file)
+{
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        if (frames[i].file != file)
+            continue;
+        pageTable.erase(pageKey(file, frames[i].pageNum));
+        policy->recordRemove(i);
+        frames[i].file = NULL;
+        frames[i].pinCount = 0;
+        frames[i].dirty = false;
+        freeFrames.push_back(i);
+    }
+}
+
+
+RC BufferManager::resize(unsigned numFrames)
+{
+    if (numFrames == 0)
+        return PFM_NO_FREE_FRAME;
+    for (BufferFrame &frame : frames)
+        if (frame.pinCount > 0)
+            return PFM_PAGES_PINNED;
+
+    RC rc = flushAll();
+    if (rc)
+        return rc;
+    releaseFrames();
+    allocateFrames(numFrames);
+    return SUCCESS;
+}
+
+
+RC BufferManager::setPolicy(ReplacementPolicy *policy)
+{
+    for (BufferFrame &frame : frames)
+        if (frame.pinCount > 0)
+            return PFM_PAGES_PINNED;
+
+    RC rc = flushAll();
+    if (rc)
+        return rc;
+    unsigned numFrames = frames.size();
+    releaseFrames();
+    delete this->policy;
+    this->policy = policy;
+    allocateFrames(numFrames);
+    return SUCCESS;
+}
+
+
+unsigned BufferManager::getNumberOfFrames() const
+{
+    return frames.size();
+}
+
+
+unsigned long long BufferManager::pageKey(const PagedFile *file, PageNum pageNum)
+{
+    return ((unsigned long long) file->id << 32) | pageNum;
+}
+
+// Get an empty frame, evicting a page if there is none
+RC BufferManager::allocateFrame(FileHandle &fileHandle, unsigned &frame)
+{
+    if (!freeFrames.empty())
+    {
+        frame = freeFrames.back();
+        freeFrames.pop_back();
+        return SUCCESS;
+    }
+
+    if (!policy->pickVictim(frames, frame))
+        return PFM_NO_FREE_FRAME;
+
+    BufferFrame &victim = frames[frame];
+    if (victim.dirty)
+    {
+        // Only charge the write to the caller if it is for the caller's file
+        RC rc = writeBack(victim.file == fileHandle._file ? &fileHandle : NULL, victim);
+        if (rc)
+            return rc;
+    }
+
+    pageTable.erase(pageKey(victim.file, victim.pageNum));
+    policy->recordRemove(frame);
+    victim.file = NULL;
+    return SUCCESS;
+}
+
+
+// A mapped file must always be current on disk for the mapping to be, so it never keeps dirty frames
+static bool writesThrough(PagedFile *file)
+{
+    return file->durability == DURABILITY_SYNC_PER_WRITE || file->map != NULL;
+}
+
+
+// Write one page to the file, honoring the file's durability
+static RC writePagedFile(PagedFile *file, PageNum pageNum, const void *data)
+{
+    if (file->fd < 0)
+        return PFM_FILE_NOT_OPEN;
+    if (pwrite(file->fd, data, PAGE_SIZE, (off_t) PAGE_SIZE * pageNum) != PAGE_SIZE)
+        return FH_WRITE_FAILED;
+
+    if (file->durability == DURABILITY_SYNC_PER_WRITE)
+    {
+        if (fdatasync(file->fd) != 0)
+            return FH_WRITE_FAILED;
+    }
+    else
+        file->unsynced = true;
+    return SUCCESS;
+}
+
+
+RC BufferManager::writeBack(FileHandle *fileHandle, BufferFrame &frame)
+{
+    // Files are flushed on their last close, so a dirty frame always has an open descriptor
+    RC rc = writePagedFile(frame.file, frame.pageNum, frame.data);
+    if (rc)
+        return rc;
+
+    frame.dirty = false;
+    if (fileHandle)
+        fileHandle->writePageCounter++;
+    return SUCCESS;
+}
+
+
+void BufferManager::releaseFrames()
+{
+    frames.clear();
+    freeFrames.clear();
+    pageTable.clear();
+    free(pool);
+    pool = NULL;
+}
+
+
+void BufferManager::allocateFrames(unsigned numFrames)
+{
+    pool = (char *) malloc(numFrames * PAGE_SIZE);
+    frames.resize(numFrames);
+    for (unsigned i = 0; i < numFrames; i++)
+    {
+        frames[i].file = NULL;
+        frames[i].pageNum = 0;
+        frames[i].pinCount = 0;
+        frames[i].dirty = false;
+        frames[i].data = pool + i * PAGE_SIZE;
+    }
+    // Hand out low frames first
+    for (unsigned i = numFrames; i > 0; i--)
+        freeFrames.push_back(i - 1);
+    policy->reset(numFrames);
+}
+
 
 FileHandle::FileHandle()
 {
     readPageCounter = 0;
     writePageCounter = 0;
     appendPageCounter = 0;
+    hitCounter = 0;
+    missCounter = 0;
 
-    _fd = NULL;
+    _file = NULL;
+    _mapped = false;
 }
 
 
@@ -119,80 +744,91 @@ FileHandle::~FileHandle()
 
 RC FileHandle::readPage(PageNum pageNum, void *data)
 {
-    if (_fd == NULL)
-        return -1;
-    // If pageNum doesn't exist, error
-    if (getNumberOfPages() < pageNum)
-        return FH_PAGE_DN_EXIST;
-
-    // Try to seek to the specified page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
+    // Memory mapped handles read straight from the mapping
+    if (_mapped)
+    {
+        const void *page = pinPage(pageNum);
+        if (page == NULL)
+            return FH_PAGE_DN_EXIST;
+        memcpy(data, page, PAGE_SIZE);
+        return SUCCESS;
+    }
 
-    // Try to read the specified page
-    if (fread(data, 1, PAGE_SIZE, _fd) != PAGE_SIZE)
-        return FH_READ_FAILED;
+    void *frame;
+    RC rc = pinPage(pageNum, frame);
+    if (rc)
+        return rc;
 
-    readPageCounter++;
-    return SUCCESS;
+    memcpy(data, frame, PAGE_SIZE);
+    return unpinPage(pageNum, false);
 }
 
 
 RC FileHandle::writePage(PageNum pageNum, const void *data)
 {
-    if (_fd == NULL)
+    if (_file == NULL || _file->fd < 0)
         return -1;
     // Check if the page exists
-    if (getNumberOfPages() < pageNum)
+    if (pageNum >= getNumberOfPages())
         return FH_PAGE_DN_EXIST;
 
-    // Seek to the start of the page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
-
-    // Write the page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
+    // If the page is cached, update the frame and write it back later
+    BufferManager *bm = PagedFileManager::instance()->getBufferManager();
+    char *frame = bm->lookup(_file, pageNum);
+    if (frame != NULL)
     {
-        // Immediately commit changes to disk
-        fflush(_fd);
-        writePageCounter++;
-        return SUCCESS;
+        memcpy(frame, data, PAGE_SIZE);
+        // Durable writes go straight through and leave the frame clean
+        if (!writesThrough(_file))
+        {
+            bm->markDirty(_file, pageNum);
+            return SUCCESS;
+        }
     }
-    
-    return FH_WRITE_FAILED;
+
+    // Otherwise write around the pool
+    return writeBlock(pageNum, data);
 }
 
 
 RC FileHandle::appendPage(const void *data)
 {
-    if (_fd == NULL)
+    if (_file == NULL || _file->fd < 0)
         return -1;
-    // Seek to the end of the file
-    if (fseek(_fd, 0, SEEK_END))
-        return FH_SEEK_FAILED;
+    // Write the new page at the end of the file
+    PageNum pageNum = _file->numPages;
+    RC rc = writePagedFile(_file, pageNum, data);
+    if (rc)
+        return rc;
+    _file->numPages++;
+    appendPageCounter++;
+
+    // Grew out of the mapping
+    if (_file->map != NULL && (size_t) _file->numPages * PAGE_SIZE > _file->mapLength)
+    {
+        rc = PagedFileManager::instance()->mapFile(_file);
+        if (rc)
+            return rc;
+    }
 
-    // Write the new page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
+    // Fresh pages are usually read right back, keep a clean copy around if there is room
+    char *frame;
+    BufferManager *bm = PagedFileManager::instance()->getBufferManager();
+    if (bm->pinPage(*this, pageNum, false, frame) == SUCCESS)
     {
-        fflush(_fd);
-        appendPageCounter++;
-        return SUCCESS;
+        memcpy(frame, data, PAGE_SIZE);
+        bm->unpinPage(_file, pageNum, false);
     }
-    return FH_WRITE_FAILED;
+    return SUCCESS;
 }
 
 
 unsigned FileHandle::getNumberOfPages()
 {
-    if (_fd == NULL)
+    if (_file == NULL || _file->fd < 0)
         return 0;
-    // Use stat to get the file size
-    struct stat sb;
-    if (fstat(fileno(_fd), &sb) != 0)
-        // On error, return 0
-        return 0;
-    // Filesize is always PAGE_SIZE * number of pages
-    return sb.st_size / PAGE_SIZE;
+    // Set from the file size on open and bumped by appendPage
+    return _file->numPages;
 }
 
 
@@ -204,12 +840,136 @@ RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePage
     return SUCCESS;
 }
 
-void FileHandle::setfd(FILE *fd)
+
+RC FileHandle::collectBufferCounterValues(unsigned &hitCount, unsigned &missCount)
+{
+    hitCount  = hitCounter;
+    missCount = missCounter;
+    return SUCCESS;
+}
+
+
+unsigned FileHandle::getFileId()
+{
+    if (_file == NULL)
+        return UINT_MAX;
+    return _file->id;
+}
+
+
+RC FileHandle::pinPage(PageNum pageNum, void *&data)
+{
+    if (_file == NULL || _file->fd < 0)
+        return -1;
+    // If pageNum doesn't exist, error
+    if (pageNum >= getNumberOfPages())
+        return FH_PAGE_DN_EXIST;
+
+    char *frame;
+    RC rc = PagedFileManager::instance()->getBufferManager()->pinPage(*this, pageNum, true, frame);
+    if (rc)
+        return rc;
+    data = frame;
+    return SUCCESS;
+}
+
+
+RC FileHandle::unpinPage(PageNum pageNum, bool dirty)
+{
+    if (_file == NULL)
+        return -1;
+
+    BufferManager *bm = PagedFileManager::instance()->getBufferManager();
+    // Durable and memory mapped files write a modified frame through right away instead of leaving it dirty
+    if (dirty && writesThrough(_file))
+    {
+        char *frame = bm->lookup(_file, pageNum);
+        if (frame == NULL)
+            return FH_PAGE_NOT_PINNED;
+        RC rc = writeBlock(pageNum, frame);
+        if (rc)
+            return rc;
+        dirty = false;
+    }
+    return bm->unpinPage(_file, pageNum, dirty);
+}
+
+
+const void *FileHandle::pinPage(PageNum pageNum)
+{
+    if (_file == NULL || _file->fd < 0 || pageNum >= getNumberOfPages())
+        return NULL;
+
+    if (_mapped)
+    {
+        readPageCounter++;
+        return _file->map + (size_t) PAGE_SIZE * pageNum;
+    }
+
+    void *data;
+    if (pinPage(pageNum, data))
+        return NULL;
+    return data;
+}
+
+
+RC FileHandle::unpinPage(PageNum pageNum)
+{
+    if (_file == NULL)
+        return -1;
+    // Pages of memory mapped handles have no frame to unpin
+    if (_mapped)
+        return SUCCESS;
+    return PagedFileManager::instance()->getBufferManager()->unpinPage(_file, pageNum, false);
+}
+
+
+RC FileHandle::setDurability(Durability durability)
+{
+    if (_file == NULL || _file->fd < 0)
+        return PFM_FILE_NOT_OPEN;
+
+    _file->durability = durability;
+    // From now on every write is synced, so make what is already written durable as well
+    if (durability == DURABILITY_SYNC_PER_WRITE)
+    {
+        RC rc = PagedFileManager::instance()->getBufferManager()->flushFile(*this);
+        if (rc)
+            return rc;
+        if (_file->unsynced && fdatasync(_file->fd) != 0)
+            return FH_WRITE_FAILED;
+        _file->unsynced = false;
+    }
+    return SUCCESS;
+}
+
+
+Durability FileHandle::getDurability()
+{
+    if (_file == NULL)
+        return DURABILITY_NONE;
+    return _file->durability;
+}
+
+
+RC FileHandle::readBlock(PageNum pageNum, void *data)
 {
-    _fd = fd;
+    // Try to read the specified page
+    if (pread(_file->fd, data, PAGE_SIZE, (off_t) PAGE_SIZE * pageNum) != PAGE_SIZE)
+        return FH_READ_FAILED;
+
+    readPageCounter++;
+    return SUCCESS;
 }
 
-FILE *FileHandle::getfd()
+
+RC FileHandle::writeBlock(PageNum pageNum, const void *data)
 {
-    return _fd;
-}
\ No newline at end of file
+    // Write the page
+    RC rc = writePagedFile(_file, pageNum, data);
+    if (rc)
+        return rc;
+
+    writePageCounter++;
+    return SUCCESS;
+}
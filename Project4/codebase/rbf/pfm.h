@@ -9,22 +9,174 @@
 #define PFM_HANDLE_IN_USE 4
 #define PFM_FILE_DN_EXIST 5
 #define PFM_FILE_NOT_OPEN 6
+#define PFM_NO_FREE_FRAME 7
+#define PFM_PAGES_PINNED  8
+#define PFM_MMAP_FAILED   9
+#define PFM_RENAME_FAILED 10
 
 #define FH_PAGE_DN_EXIST  1
 #define FH_SEEK_FAILED    2
 #define FH_READ_FAILED    3
 #define FH_WRITE_FAILED   4
+#define FH_PAGE_NOT_PINNED 5
 
 typedef unsigned PageNum;
 typedef int RC;
 typedef char byte;
 
 #define PAGE_SIZE 4096
+
+// Number of page frames in the shared buffer pool unless changed with setBufferPoolSize()
+#define BUFFER_POOL_DEFAULT_FRAMES 256
+
+// Smallest mapping of a memory mapped file. Mappings cover twice the file so appends rarely remap.
+#define MMAP_MIN_LENGTH (1 << 24)
+
 #include <string>
 #include <climits>
+#include <cstdio>
+#include <vector>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <cstddef>
+#include <sys/types.h>
+#include <time.h>
 using namespace std;
 
 class FileHandle;
+class BufferManager;
+
+// How hard the paged file layer works to get page writes onto stable storage. Set per file.
+typedef enum
+{
+    DURABILITY_NONE = 0,        // Leave it to the OS (default, right for bulk loads and temp files)
+    DURABILITY_SYNC_ON_CLOSE,   // fdatasync when the last handle on the file closes it
+    DURABILITY_SYNC_PER_WRITE   // fdatasync after every page written, writes skip the pool's write-back
+} Durability;
+
+// State shared by every FileHandle open on the same file. One PagedFile exists per file (device, inode)
+// for as long as the file exists, so pages cached in the buffer pool survive a close and reopen.
+typedef struct PagedFile
+{
+    unsigned id;            // Never reused, tags the buffer frames of this file. Renewed if the file changes behind our back
+    dev_t dev;
+    ino_t ino;
+    int fd;                 // Shared descriptor, -1 while no handle has the file open
+    unsigned refCount;      // Number of open FileHandles
+    unsigned numPages;      // Page count, kept up to date by appendPage so we don't stat the file on every access
+    Durability durability;
+    bool unsynced;          // Pages were written since the last fdatasync
+    char *map;              // Read only mapping of the file, NULL unless a handle has it open memory mapped
+    unsigned mappedCount;   // Number of open FileHandles reading from the mapping
+    size_t mapLength;
+    vector<pair<char*, size_t> > retiredMaps; // Outgrown mappings, kept until the last close so pinned pointers stay valid
+    off_t closedSize;       // File size and modification time when the last handle closed the file.
+    struct timespec closedMtime; // Used to detect changes made behind our back before trusting cached frames
+} PagedFile;
+
+// One page frame of the buffer pool
+typedef struct BufferFrame
+{
+    PagedFile *file;        // NULL when the frame is free
+    PageNum pageNum;
+    unsigned pinCount;
+    bool dirty;
+    char *data;
+} BufferFrame;
+
+// Decides which unpinned frame gets evicted when the buffer pool needs room.
+// The BufferManager reports every pin, unpin and removal so a policy can keep its own bookkeeping.
+class ReplacementPolicy
+{
+public:
+    virtual ~ReplacementPolicy() {};
+
+    virtual void reset(unsigned numFrames) = 0;                 // Forget everything, the pool now has numFrames frames
+    virtual void recordPin(unsigned frame) = 0;                 // Frame was pinned (hit or freshly loaded)
+    virtual void recordUnpin(unsigned frame) = 0;               // Frame's pin count dropped to zero
+    virtual void recordRemove(unsigned frame) = 0;              // Frame no longer holds a page
+    virtual bool pickVictim(const vector<BufferFrame> &frames, unsigned &victim) = 0; // Choose an unpinned, occupied frame
+};
+
+// Second chance replacement. Default policy.
+class ClockPolicy : public ReplacementPolicy
+{
+public:
+    ClockPolicy();
+
+    void reset(unsigned numFrames);
+    void recordPin(unsigned frame);
+    void recordUnpin(unsigned frame);
+    void recordRemove(unsigned frame);
+    bool pickVictim(const vector<BufferFrame> &frames, unsigned &victim);
+
+private:
+    vector<bool> referenced;
+    unsigned hand;
+};
+
+// Evicts the frame that was unpinned longest ago
+class LRUPolicy : public ReplacementPolicy
+{
+public:
+    void reset(unsigned numFrames);
+    void recordPin(unsigned frame);
+    void recordUnpin(unsigned frame);
+    void recordRemove(unsigned frame);
+    bool pickVictim(const vector<BufferFrame> &frames, unsigned &victim);
+
+private:
+    list<unsigned> unpinned;                    // Least recently unpinned at the front
+    vector<list<unsigned>::iterator> position;
+    vector<bool> queued;
+};
+
+// Fixed-size set of page frames shared by every open file.
+// Physical I/O done on behalf of a FileHandle is charged to that handle's counters.
+class BufferManager
+{
+public:
+    BufferManager(unsigned numFrames, ReplacementPolicy *policy);
+    ~BufferManager();
+
+    // Pin pageNum of file. If load is false and the page isn't cached the frame is not read from disk (caller overwrites it).
+    RC pinPage(FileHandle &fileHandle, PageNum pageNum, bool load, char *&data);
+    RC unpinPage(PagedFile *file, PageNum pageNum, bool dirty);
+    // Returns the frame's data if the page is cached, NULL otherwise. Does not pin.
+    char *lookup(PagedFile *file, PageNum pageNum);
+    void markDirty(PagedFile *file, PageNum pageNum);
+
+    // Write back every dirty frame of file
+    RC flushFile(FileHandle &fileHandle);
+    // Write back every dirty frame
+    RC flushAll();
+    // Discard every frame of file without writing it back
+    void dropFile(PagedFile *file);
+    // Release pins still held on frames of file, e.g. by scan iterators that were never closed
+    void releasePins(PagedFile *file);
+
+    // Changing the size or the policy flushes and empties the pool
+    RC resize(unsigned numFrames);
+    RC setPolicy(ReplacementPolicy *policy);
+    unsigned getNumberOfFrames() const;
+
+    unsigned hitCounter;
+    unsigned missCounter;
+
+private:
+    vector<BufferFrame> frames;
+    vector<unsigned> freeFrames;
+    unordered_map<unsigned long long, unsigned> pageTable;
+    ReplacementPolicy *policy;
+    char *pool;
+
+    static unsigned long long pageKey(const PagedFile *file, PageNum pageNum);
+    RC allocateFrame(FileHandle &fileHandle, unsigned &frame);
+    RC writeBack(FileHandle *fileHandle, BufferFrame &frame);
+    void releaseFrames();
+    void allocateFrames(unsigned numFrames);
+};
 
 class PagedFileManager
 {
@@ -33,18 +185,34 @@ public:
 
     RC createFile    (const string &fileName);                          // Create a new file
     RC destroyFile   (const string &fileName);                          // Destroy a file
-    RC openFile      (const string &fileName, FileHandle &fileHandle);  // Open a file
+    RC renameFile    (const string &fileName, const string &newFileName); // Rename a file, atomically replacing newFileName if it exists
+    RC openFile      (const string &fileName, FileHandle &fileHandle,   // Open a file. A memory mapped handle serves page reads
+                      bool memoryMapped = false);                       // from the mapping, writes to the file go through until it closes
     RC closeFile     (FileHandle &fileHandle);                          // Close a file
 
+    // Buffer pool configuration. Both flush and empty the pool.
+    RC setBufferPoolSize(unsigned numFrames);
+    RC setReplacementPolicy(ReplacementPolicy *policy);                 // Takes ownership of policy
+    BufferManager *getBufferManager();
+
 protected:
     PagedFileManager();                                                 // Constructor
     ~PagedFileManager();                                                // Destructor
 
 private:
     static PagedFileManager *_pf_manager;
+    friend class FileHandle;
+
+    BufferManager *_buffer_manager;
+    map<pair<dev_t, ino_t>, PagedFile*> _files;
+    unsigned _next_file_id;
 
     // Private helper methods
     bool fileExists(const string &fileName);
+    void forgetFile(PagedFile *file);
+    RC mapFile(PagedFile *file);
+    void unmapFile(PagedFile *file);
+    static void flushAtExit();
 };
 
 
@@ -52,10 +220,13 @@ class FileHandle
 {
 public:
     // variables to keep the counter for each operation
+    // read/write/append counters count physical page I/O, hit/miss count buffer pool lookups
     unsigned readPageCounter;
     unsigned writePageCounter;
     unsigned appendPageCounter;
-    
+    unsigned hitCounter;
+    unsigned missCounter;
+
     FileHandle();                                                       // Default constructor
     ~FileHandle();                                                      // Destructor
 
@@ -64,16 +235,36 @@ public:
     RC appendPage(const void *data);                                    // Append a specific page
     unsigned getNumberOfPages();                                        // Get the number of pages in the file
     RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount);  // Put the current counter values into variables
+    RC collectBufferCounterValues(unsigned &hitCount, unsigned &missCount);
+
+    // Durability applies to the file, so to every handle open on it
+    RC setDurability(Durability durability);
+    Durability getDurability();
+
+    // Identifies the contents of the file within this process. Stays the same across close and reopen,
+    // changes if the file was modified behind our back. Lets upper layers key their own per-file caches.
+    unsigned getFileId();
+
+    // Zero-copy access. A pinned page stays in its frame until unpinned, set dirty if the frame was modified.
+    RC pinPage(PageNum pageNum, void *&data);
+    RC unpinPage(PageNum pageNum, bool dirty);
+
+    // Read only zero-copy access, returns NULL on error. Release with unpinPage(pageNum).
+    // Memory mapped handles hand out a pointer into the mapping, others pin a buffer frame.
+    const void *pinPage(PageNum pageNum);
+    RC unpinPage(PageNum pageNum);
 
     // Let PagedFileManager access our private helper methods
     friend class PagedFileManager;
+    friend class BufferManager;
 
 private:
-    FILE *_fd;
+    PagedFile *_file;
+    bool _mapped;           // Opened memory mapped, reads come from the mapping
 
-    // Private helper methods
-    void setfd(FILE *fd);
-    FILE *getfd();
-}; 
+    // Physical page I/O against the shared descriptor
+    RC readBlock(PageNum pageNum, void *data);
+    RC writeBlock(PageNum pageNum, const void *data);
+};
 
 #endif
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <sys/reg.h>
+#include <sys/syscall.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Counts the system calls made by page reads, writes and appends.
+// The work runs in a child traced with ptrace; the child brackets every measured
+// section with getppid() calls, and the parent counts the system calls in between.
+
+const unsigned numPages = 1000;
+const char *sections[] = {
+    "appendPage",
+    "readPage (miss)",
+    "readPage (hit)",
+    "writePage (cached page)",
+    "getNumberOfPages",
+    "appendPage (fdatasync per write)",
+};
+const unsigned numSections = sizeof(sections) / sizeof(sections[0]);
+
+static void marker()
+{
+    syscall(SYS_getppid);
+}
+
+static int runWorkload(PagedFileManager *pfm)
+{
+    string fileName = "bench1";
+    remove(fileName.c_str());
+    if (pfm->createFile(fileName) != success)
+        return -1;
+
+    FileHandle fileHandle;
+    if (pfm->openFile(fileName, fileHandle) != success)
+        return -1;
+
+    void *data = malloc(PAGE_SIZE);
+    memset(data, 'b', PAGE_SIZE);
+
+    marker();
+    for (unsigned i = 0; i < numPages; i++)
+        fileHandle.appendPage(data);
+    marker();
+
+    // The pool holds fewer pages than the file, so a sequential pass always misses
+    pfm->closeFile(fileHandle);
+    pfm->setBufferPoolSize(16);
+    pfm->openFile(fileName, fileHandle);
+
+    marker();
+    for (unsigned i = 0; i < numPages; i++)
+        fileHandle.readPage(i, data);
+    marker();
+
+    marker();
+    for (unsigned i = 0; i < numPages; i++)
+        fileHandle.readPage(numPages - 1, data);
+    marker();
+
+    marker();
+    for (unsigned i = 0; i < numPages; i++)
+        fileHandle.writePage(numPages - 1, data);
+    marker();
+
+    unsigned total = 0;
+    marker();
+    for (unsigned i = 0; i < numPages; i++)
+        total += fileHandle.getNumberOfPages();
+    marker();
+
+    fileHandle.setDurability(DURABILITY_SYNC_PER_WRITE);
+    marker();
+    for (unsigned i = 0; i < numPages; i++)
+        fileHandle.appendPage(data);
+    marker();
+
+    pfm->closeFile(fileHandle);
+    pfm->destroyFile(fileName);
+    free(data);
+    return total == numPages * numPages ? 0 : -1;
+}
+
+int main()
+{
+#if defined(__x86_64__)
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        _exit(runWorkload(pfm) == 0 ? 0 : 1);
+    }
+
+    int status;
+    waitpid(child, &status, 0);
+    ptrace(PTRACE_SETOPTIONS, child, NULL, PTRACE_O_TRACESYSGOOD);
+
+    // Syscall stops alternate between entry and exit, only count entries
+    bool entry = true;
+    bool inSection = false;
+    unsigned section = 0;
+    unsigned counts[numSections] = {0};
+    while (true)
+    {
+        ptrace(PTRACE_SYSCALL, child, NULL, NULL);
+        waitpid(child, &status, 0);
+        if (WIFEXITED(status))
+            break;
+        if (!WIFSTOPPED(status) || WSTOPSIG(status) != (SIGTRAP | 0x80))
+            continue;
+
+        if (entry)
+        {
+            long number = ptrace(PTRACE_PEEKUSER, child, sizeof(long) * ORIG_RAX, NULL);
+            if (number == SYS_getppid)
+            {
+                if (inSection)
+                    section++;
+                inSection = !inSection;
+            }
+            else if (inSection && section < numSections)
+                counts[section]++;
+        }
+        entry = !entry;
+    }
+
+    if (WEXITSTATUS(status) != 0 || section != numSections)
+    {
+        cout << "[FAIL] Benchmark workload failed." << endl;
+        return -1;
+    }
+
+    cout << "System calls per operation over " << numPages << " operations:" << endl;
+    for (unsigned i = 0; i < numSections; i++)
+        cout << "  " << sections[i] << ": " << (double) counts[i] / numPages << endl;
+    return 0;
+#else
+    cout << "Syscall counting is only implemented for x86_64." << endl;
+    return 0;
+#endif
+}
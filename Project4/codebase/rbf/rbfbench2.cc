@@ -0,0 +1,149 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Counts the heap allocations and the time of scans over a file of 1M records.
+// malloc, calloc and realloc are wrapped around the glibc ones, operator new goes through malloc.
+
+const int numRecords = 1000000;
+
+static bool counting = false;
+static unsigned long allocations = 0;
+
+#if defined(__GLIBC__)
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Runs a scan to the end, counting the allocations made by getNextRecord
+static int runScan(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+        const char *section, const vector<ScanPredicate> &predicates, const vector<string> &attributeNames)
+{
+    RBFM_ScanIterator iter;
+    if (rbfm->scan(fileHandle, recordDescriptor, predicates, attributeNames, iter) != success)
+        return -1;
+
+    void *data = malloc(PAGE_SIZE);
+    RID rid;
+    int count = 0;
+    double start = now();
+    allocations = 0;
+    counting = true;
+    while (iter.getNextRecord(rid, data) == success)
+        count++;
+    counting = false;
+    double seconds = now() - start;
+    iter.close();
+    free(data);
+
+    cout << "  " << section << ": " << count << " records, "
+         << (double) allocations / numRecords << " allocations per record, "
+         << numRecords / seconds / 1e6 << "M records scanned per second" << endl;
+    return allocations == 0 ? count : -1;
+}
+
+int main()
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    string fileName = "bench2";
+    remove(fileName.c_str());
+    if (rbfm->createFile(fileName) != success)
+        return -1;
+
+    FileHandle fileHandle;
+    if (rbfm->openFile(fileName, fileHandle, true) != success)
+        return -1;
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    // Age = i % 100, Height = i, Salary = i, EmpName = "emp" followed by i % 10
+    unsigned char nullsIndicator[1] = {0};
+    void *record = malloc(PAGE_SIZE);
+    int recordSize = 0;
+    RID rid;
+    for (int i = 0; i < numRecords; i++)
+    {
+        string name = "emp" + to_string(i % 10);
+        prepareRecord(recordDescriptor.size(), nullsIndicator, name.size(), name, i % 100, i, i, record, &recordSize);
+        if (rbfm->appendRecord(fileHandle, recordDescriptor, record, rid) != success)
+            return -1;
+    }
+    free(record);
+
+    vector<string> allAttributes;
+    for (unsigned i = 0; i < recordDescriptor.size(); i++)
+        allAttributes.push_back(recordDescriptor[i].name);
+    vector<string> someAttributes;
+    someAttributes.push_back("Salary");
+    someAttributes.push_back("EmpName");
+
+    int ageLow = 20, ageHigh = 30;
+    char name[8];
+    int nameLength = 4;
+    memcpy(name, &nameLength, sizeof(int));
+    memcpy(name + sizeof(int), "emp3", nameLength);
+    ScanPredicate ageFrom = {"Age", GE_OP, &ageLow};
+    ScanPredicate ageTo = {"Age", LT_OP, &ageHigh};
+    ScanPredicate nameIs = {"EmpName", EQ_OP, name};
+
+    vector<ScanPredicate> none;
+    vector<ScanPredicate> range;
+    range.push_back(ageFrom);
+    range.push_back(ageTo);
+    vector<ScanPredicate> conjunction = range;
+    conjunction.push_back(nameIs);
+
+    cout << "Scans over " << numRecords << " records:" << endl;
+    bool ok = runScan(rbfm, fileHandle, recordDescriptor, "every attribute", none, allAttributes) == numRecords
+        && runScan(rbfm, fileHandle, recordDescriptor, "20 <= Age < 30", range, someAttributes) == numRecords / 10
+        && runScan(rbfm, fileHandle, recordDescriptor, "20 <= Age < 30 AND EmpName = emp3", conjunction, someAttributes) == numRecords / 100;
+
+    rbfm->closeFile(fileHandle);
+    rbfm->destroyFile(fileName);
+    if (!ok)
+    {
+        cout << "[FAIL] A scan returned the wrong records or allocated memory." << endl;
+        return -1;
+    }
+    return 0;
+}
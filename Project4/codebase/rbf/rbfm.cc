@@ -57,12 +57,19 @@ RC RecordBasedFileManager::createFile(const string &fileName)
 
 RC RecordBasedFileManager::destroyFile(const string &fileName) 
 {
+    // Forget the file's free space map
+    FileHandle handle;
+    if (_pf_manager->openFile(fileName.c_str(), handle) == SUCCESS)
+    {
+        _free_space_maps.erase(handle.getFileId());
+        _pf_manager->closeFile(handle);
+    }
     return _pf_manager->destroyFile(fileName);
 }
 
-RC RecordBasedFileManager::openFile(const string &fileName, FileHandle &fileHandle) 
+RC RecordBasedFileManager::openFile(const string &fileName, FileHandle &fileHandle, bool memoryMapped) 
 {
-    return _pf_manager->openFile(fileName.c_str(), fileHandle);
+    return _pf_manager->openFile(fileName.c_str(), fileHandle, memoryMapped);
 }
 
 RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) 
@@ -72,32 +79,50 @@ RC RecordBasedFileManager::closeFile(FileHandle &fileHandle)
 
 RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid) 
 {
-    // Gets the size of the record.
+    return insertRecord(fileHandle, recordDescriptor, data, rid, false);
+}
+
+RC RecordBasedFileManager::appendRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid)
+{
+    return insertRecord(fileHandle, recordDescriptor, data, rid, true);
+}
+
+RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid, bool append,
+        const RID *home)
+{
+    // Gets the size of the record, and the room it takes with the home RID of a forwarded record.
     unsigned recordSize = getRecordSize(recordDescriptor, data);
+    unsigned recordSpace = recordSize + (home ? sizeof(RID) : 0);
 
-    // Cycles through pages looking for enough free space for the new entry.
+    // Asks the free space map for the first page with enough space (accounting also for the size that will be added to the slot directory).
+    FreeSpaceMap *fsm;
+    if (getFreeSpaceMap(fileHandle, fsm))
+        return RBFM_READ_FAILED;
     void *pageData = malloc(PAGE_SIZE);
     if (pageData == NULL)
         return RBFM_MALLOC_FAILED;
-    bool pageFound = false;
-    unsigned i;
-    unsigned numPages = fileHandle.getNumberOfPages();
-    for (i = 0; i < numPages; i++)
+    PageNum i;
+    bool pageFound;
+    if (append)
+    {
+        // Only the last page comes after every record
+        i = fsm->getNumberOfPages() - 1;
+        pageFound = fsm->getNumberOfPages() > 0 && fsm->getFreeSpace(i) >= sizeof(SlotDirectoryRecordEntry) + recordSpace;
+    }
+    else
+        pageFound = fsm->findPage(sizeof(SlotDirectoryRecordEntry) + recordSpace, i);
+    if (pageFound)
     {
         if (fileHandle.readPage(i, pageData))
-            return RBFM_READ_FAILED;
-
-        // When we find a page with enough space (accounting also for the size that will be added to the slot directory), we stop the loop.
-        if (getPageFreeSpaceSize(pageData) >= sizeof(SlotDirectoryRecordEntry) + recordSize)
         {
-            pageFound = true;
-            break;
+            free(pageData);
+            return RBFM_READ_FAILED;
         }
     }
-
-    // If we can't find a page with enough space, we create a new one
-    if(!pageFound)
+    // If no page has enough space, we create a new one
+    else
     {
+        i = fsm->getNumberOfPages();
         newRecordBasedPage(pageData);
     }
 
@@ -105,16 +130,21 @@ RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Att
 
     // Setting the return RID.
     rid.pageNum = i;
-    rid.slotNum = getOpenSlot(pageData);
+    rid.slotNum = append ? slotHeader.recordEntriesNumber : getOpenSlot(pageData);
 
     // Adding the new record reference in the slot directory.
     SlotDirectoryRecordEntry newRecordEntry;
     newRecordEntry.length = recordSize;
     newRecordEntry.offset = slotHeader.freeSpaceOffset - recordSize;
+    if (home)
+    {
+        newRecordEntry.length |= RBFM_FORWARDED_RECORD;
+        memcpy((char*) pageData + newRecordEntry.offset - sizeof(RID), home, sizeof(RID));
+    }
     setSlotDirectoryRecordEntry(pageData, rid.slotNum, newRecordEntry);
 
     // Updating the slot directory header.
-    slotHeader.freeSpaceOffset = newRecordEntry.offset;
+    slotHeader.freeSpaceOffset = slotHeader.freeSpaceOffset - recordSpace;
     if (rid.slotNum == slotHeader.recordEntriesNumber)
         slotHeader.recordEntriesNumber += 1;
     setSlotDirectoryHeader(pageData, slotHeader);
@@ -133,6 +163,7 @@ RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Att
         if (fileHandle.appendPage(pageData))
             return RBFM_APPEND_FAILED;
     }
+    updateFreeSpaceMap(fileHandle, i, pageData);
 
     free(pageData);
     return SUCCESS;
@@ -223,6 +254,8 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
     
     // Once we've deleted the page(s), write changes to disk
     RC rc = fileHandle.writePage(rid.pageNum, pageData);
+    if (rc == SUCCESS)
+        updateFreeSpaceMap(fileHandle, rid.pageNum, pageData);
     free(pageData);
     return rc;
 }
@@ -232,6 +265,7 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
 // Larger but fits: remove, reorganize, setRecordAtOffset
 // Larger dnf: remove, reorganize, insert into new page and update slot info
 // same: do nothing
+// A forwarded record that has to move again is moved straight from its home, so tombstones never chain
 RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, const RID &rid)
 {
     // Retrieve the specific page
@@ -273,58 +307,92 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
     // Do actual work
     // Gets the size of the updated record
     unsigned recordSize = getRecordSize(recordDescriptor, data);
-    if (recordSize  == recordEntry.length)
+    uint32_t recordLength = getRecordLength(recordEntry);
+    uint32_t forwarded = recordEntry.length & RBFM_FORWARDED_RECORD;
+    if (recordSize == recordLength)
     {
         setRecordAtOffset(pageData, recordEntry.offset, recordDescriptor, data);
         RC rc = fileHandle.writePage(rid.pageNum, pageData);
         free(pageData);
         return rc;
     }
-    else if (recordSize < recordEntry.length)
+    else if (recordSize < recordLength)
     {
         setRecordAtOffset(pageData, recordEntry.offset, recordDescriptor, data);
-        recordEntry.length = recordSize;
+        recordEntry.length = recordSize | forwarded;
         setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
         reorganizePage(pageData);
         RC rc = fileHandle.writePage(rid.pageNum, pageData);
+        if (rc == SUCCESS)
+            updateFreeSpaceMap(fileHandle, rid.pageNum, pageData);
         free(pageData);
         return rc;
     }
-    else if (recordSize > recordEntry.length)
+    else if (recordSize > recordLength)
     {
-        unsigned space = getPageFreeSpaceSize(pageData) + recordEntry.length;
+        unsigned space = getPageFreeSpaceSize(pageData) + recordLength;
         if (recordSize > space)
         {
             // Need to insert then set forward address then reorganize
+            RID home = forwarded ? getHomeRID(pageData, recordEntry) : rid;
             RID newRid;
-            RC rc = insertRecord(fileHandle, recordDescriptor, data, newRid);
+            RC rc = insertRecord(fileHandle, recordDescriptor, data, newRid, false, &home);
             if (rc != SUCCESS)
             {
                 free(pageData);
                 return rc;
             }
-            recordEntry.length = newRid.pageNum;
-            recordEntry.offset = -newRid.slotNum;
-            setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
+            SlotDirectoryRecordEntry forwardEntry;
+            forwardEntry.length = newRid.pageNum;
+            forwardEntry.offset = -newRid.slotNum;
+            if (forwarded)
+            {
+                // Free this copy and point the tombstone at home to the new one
+                markSlotDeleted(pageData, rid.slotNum);
+                reorganizePage(pageData);
+                rc = fileHandle.writePage(rid.pageNum, pageData);
+                if (rc == SUCCESS)
+                    updateFreeSpaceMap(fileHandle, rid.pageNum, pageData);
+                if (rc == SUCCESS)
+                    rc = fileHandle.readPage(home.pageNum, pageData);
+                if (rc != SUCCESS)
+                {
+                    free(pageData);
+                    return rc;
+                }
+                setSlotDirectoryRecordEntry(pageData, home.slotNum, forwardEntry);
+                rc = fileHandle.writePage(home.pageNum, pageData);
+                free(pageData);
+                return rc;
+            }
+            setSlotDirectoryRecordEntry(pageData, rid.slotNum, forwardEntry);
             reorganizePage(pageData);
         }
         else
         {
+            // The home RID of a forwarded record moves along with it
+            RID home;
+            if (forwarded)
+                home = getHomeRID(pageData, recordEntry);
+
             // Need to set header to DEAD and reorganize to consolidate free space
-            recordEntry.length = 0;
-            recordEntry.offset = 0;
-            setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
+            markSlotDeleted(pageData, rid.slotNum);
             reorganizePage(pageData);
 
             // Get updated slotHeader with new free space pointer
             slotHeader = getSlotDirectoryHeader(pageData);
             // Update record length and offset
-            recordEntry.length = recordSize;
+            recordEntry.length = recordSize | forwarded;
             recordEntry.offset = slotHeader.freeSpaceOffset - recordSize;
             setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
 
             // Update header with new free space pointer
             slotHeader.freeSpaceOffset = recordEntry.offset;
+            if (forwarded)
+            {
+                slotHeader.freeSpaceOffset -= sizeof(RID);
+                memcpy((char*) pageData + slotHeader.freeSpaceOffset, &home, sizeof(RID));
+            }
             setSlotDirectoryHeader(pageData, slotHeader);
 
             // Add new record data
@@ -332,6 +400,8 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
         }
     }
     RC rc = fileHandle.writePage(rid.pageNum, pageData);
+    if (rc == SUCCESS)
+        updateFreeSpaceMap(fileHandle, rid.pageNum, pageData);
     free(pageData);
     return rc;
 }
@@ -461,27 +531,55 @@ RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<At
       const vector<string> &attributeNames, // a list of projected attributes
       RBFM_ScanIterator &rbfm_ScanIterator)
 {
-    return rbfm_ScanIterator.scanInit(fileHandle, recordDescriptor, conditionAttribute, compOp, value, attributeNames);
+    vector<ScanPredicate> predicates;
+    if (compOp != NO_OP)
+    {
+        ScanPredicate predicate = {conditionAttribute, compOp, value};
+        predicates.push_back(predicate);
+    }
+    return rbfm_ScanIterator.scanInit(fileHandle, recordDescriptor, predicates, attributeNames);
+}
+
+  RC RecordBasedFileManager::scan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const vector<ScanPredicate> &predicates,
+      const vector<string> &attributeNames, // a list of projected attributes
+      RBFM_ScanIterator &rbfm_ScanIterator)
+{
+    return rbfm_ScanIterator.scanInit(fileHandle, recordDescriptor, predicates, attributeNames);
+}
+
+// Estimated fraction of the records a predicate keeps, System R style
+static double estimateSelectivity(const ScanPredicate &predicate)
+{
+    switch (predicate.compOp)
+    {
+        case EQ_OP: return 0.1;
+        case NE_OP: return 0.9;
+        case NO_OP: return 1;
+        default: return 1.0 / 3;
+    }
 }
 
 RBFM_ScanIterator::RBFM_ScanIterator()
-: currPage(0), currSlot(0), totalPage(0), totalSlot(0)
+: currPage(0), currSlot(0), totalPage(0), totalSlot(0), pageData(NULL)
 {
     rbfm = RecordBasedFileManager::instance();
 }
 
 RC RBFM_ScanIterator::close()
 {
-    free(pageData);
+    // Release the page we are holding
+    if (pageData != NULL)
+        fileHandle.unpinPage(currPage);
+    pageData = NULL;
     return SUCCESS;
 }
 
 // Initialize the scanIterator with all necessary state
 RC RBFM_ScanIterator::scanInit(FileHandle &fh,
         const vector<Attribute> rd,
-        const string &ca, 
-        const CompOp co, 
-        const void *v, 
+        const vector<ScanPredicate> &preds,
         const vector<string> &an)
 {
     // Start at page 0 slot 0
@@ -489,24 +587,56 @@ RC RBFM_ScanIterator::scanInit(FileHandle &fh,
     currSlot = 0;
     totalPage = 0;
     totalSlot = 0;
-    // Keep a buffer to hold the current page
-    pageData = malloc(PAGE_SIZE);
+    pageData = NULL;
 
     // Store the variables passed in to
     fileHandle = fh;
-    conditionAttribute = ca;
     recordDescriptor = rd;
-    compOp = co;
-    value = v;
     attributeNames = an;
 
-    skipList.clear();
+    // Check the predicates that drop the most records first, so most records fail on the first one.
+    // NO_OP predicates always hold and are left out.
+    predicates.clear();
+    predicateIndexes.clear();
+    for (unsigned i = 0; i < preds.size(); i++)
+    {
+        if (preds[i].compOp != NO_OP)
+            predicates.push_back(preds[i]);
+    }
+    stable_sort(predicates.begin(), predicates.end(), [](const ScanPredicate &a, const ScanPredicate &b) {
+        return estimateSelectivity(a) < estimateSelectivity(b);
+    });
+
+    // Find the condition attributes' indexes in the record descriptor
+    for (unsigned i = 0; i < predicates.size(); i++)
+    {
+        auto pred = [&](Attribute a) {return a.name == predicates[i].attribute;};
+        auto iterPos = find_if(recordDescriptor.begin(), recordDescriptor.end(), pred);
+        unsigned attrIndex = distance(recordDescriptor.begin(), iterPos);
+        if (attrIndex == recordDescriptor.size())
+            return RBFM_NO_SUCH_ATTR;
+        predicateIndexes.push_back(attrIndex);
+    }
+
+    // And the projected attributes' indexes, so records are not searched by name
+    projectionIndexes.clear();
+    for (unsigned i = 0; i < attributeNames.size(); i++)
+    {
+        auto pred = [&](Attribute a) {return a.name == attributeNames[i];};
+        auto iterPos = find_if(recordDescriptor.begin(), recordDescriptor.end(), pred);
+        unsigned index = distance(recordDescriptor.begin(), iterPos);
+        if (index == recordDescriptor.size())
+            return RBFM_NO_SUCH_ATTR;
+        projectionIndexes.push_back(index);
+    }
 
     // Get total number of pages
     totalPage = fh.getNumberOfPages();
     if (totalPage > 0)
     {
-        if (fh.readPage(0, pageData))
+        // Pin the page instead of copying it
+        pageData = fileHandle.pinPage(0);
+        if (pageData == NULL)
             return RBFM_READ_FAILED;
     }
     else
@@ -515,18 +645,6 @@ RC RBFM_ScanIterator::scanInit(FileHandle &fh,
     // Get number of slots on first page
     SlotDirectoryHeader header = rbfm->getSlotDirectoryHeader(pageData);
     totalSlot = header.recordEntriesNumber;
-
-    // If we don't need to do any comparisons, we can ignore the condition attribute
-    if (co == NO_OP)
-        return SUCCESS;
-
-    // Else, we need to find the condition attribute's index in the record descriptor
-    auto pred = [&](Attribute a) {return a.name == conditionAttribute;};
-    auto iterPos = find_if(recordDescriptor.begin(), recordDescriptor.end(), pred);
-    attrIndex = distance(recordDescriptor.begin(), iterPos);
-    if (attrIndex == recordDescriptor.size())
-        return RBFM_NO_SUCH_ATTR;
-
     return SUCCESS;
 }
 
@@ -536,77 +654,45 @@ RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data)
     if (rc)
         return rc;
 
-    // If we are not returning any results, we can just set the RID and return
-    if (attributeNames.size() == 0)
+    // A forwarded record is returned here under its home RID, its tombstone was skipped
+    SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
+    if (rbfm->isForwardedRecord(recordEntry))
+        rid = rbfm->getHomeRID(pageData, recordEntry);
+    else
     {
         rid.pageNum = currPage;
-        rid.slotNum = currSlot++;
-        return SUCCESS;
+        rid.slotNum = currSlot;
     }
+    currSlot++;
+
+    // If we are not returning any results, we are done
+    if (attributeNames.size() == 0)
+        return SUCCESS;
 
-    // Prepare null indicator
+    // Copy every projected attribute straight from the page into data
     unsigned nullIndicatorSize = rbfm->getNullIndicatorSize(attributeNames.size());
-    char nullIndicator[nullIndicatorSize];
+    char *nullIndicator = (char*)data;
     memset(nullIndicator, 0, nullIndicatorSize);
-
-    SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
-
-    // Unsure how large each attribute will be, set to size of page to be safe
-    void *buffer = malloc(PAGE_SIZE);
-    if (buffer == NULL)
-        return RBFM_MALLOC_FAILED;
-
-    // Keep track of offset into data
     unsigned dataOffset = nullIndicatorSize;
 
-    for (unsigned i = 0; i < attributeNames.size(); i++)
+    const char *record = (const char*)pageData + recordEntry.offset;
+    for (unsigned i = 0; i < projectionIndexes.size(); i++)
     {
-        // Get index and type of attribute in record
-        auto pred = [&](Attribute a) {return a.name == attributeNames[i];};
-        auto iterPos = find_if(recordDescriptor.begin(), recordDescriptor.end(), pred);
-        unsigned index = distance(recordDescriptor.begin(), iterPos);
-        if (index == recordDescriptor.size())
-            return RBFM_NO_SUCH_ATTR;
-        AttrType type = recordDescriptor[index].type;
-
-        // Read attribute into buffer
-        rbfm->getAttributeFromRecord(pageData, recordEntry.offset, index, type, buffer);
-        // Determine if null
-        char null;
-        memcpy (&null, buffer, 1);
-        if (null)
-        {
-            int indicatorIndex = i / CHAR_BIT;
-            char indicatorMask  = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
-            nullIndicator[indicatorIndex] |= indicatorMask;
-        }
-        // Read from buffer into data
-        else if (type == TypeInt)
+        uint32_t length;
+        const char *field = rbfm->findAttributeInRecord(record, projectionIndexes[i], length);
+        if (field == NULL)
         {
-            memcpy ((char*)data + dataOffset, (char*)buffer + 1, INT_SIZE);
-            dataOffset += INT_SIZE;
-        }
-        else if (type == TypeReal)
-        {
-            memcpy ((char*)data + dataOffset, (char*)buffer + 1, REAL_SIZE);
-            dataOffset += REAL_SIZE;
+            nullIndicator[i / CHAR_BIT] |= 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
+            continue;
         }
-        else if (type == TypeVarChar)
+        if (recordDescriptor[projectionIndexes[i]].type == TypeVarChar)
         {
-            uint32_t varcharSize;
-            memcpy(&varcharSize, (char*)buffer + 1, VARCHAR_LENGTH_SIZE);
-            memcpy((char*)data + dataOffset, &varcharSize, VARCHAR_LENGTH_SIZE);
+            memcpy((char*)data + dataOffset, &length, VARCHAR_LENGTH_SIZE);
             dataOffset += VARCHAR_LENGTH_SIZE;
-            memcpy((char*)data + dataOffset, (char*)buffer + 1 + VARCHAR_LENGTH_SIZE, varcharSize);
-            dataOffset += varcharSize;
         }
+        memcpy((char*)data + dataOffset, field, length);
+        dataOffset += length;
     }
-    // Finally set null indicator of data, clean up and return
-    memcpy((char*)data, nullIndicator, nullIndicatorSize);
-
-    free (buffer);
-    rid.pageNum = currPage;
-    rid.slotNum = currSlot++;
     return SUCCESS;
 }
 
@@ -614,37 +700,42 @@ RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data)
 
 RC RBFM_ScanIterator::getNextSlot()
 {
-    // If we're done with the current page, or we've read the last page
-    if (currSlot >= totalSlot || currPage >= totalPage)
+    while (true)
     {
-        // Reinitialize the current slot and increment page number
-        currSlot = 0;
-        currPage++;
-        // If we're done with last page, return EOF
-        if (currPage >= totalPage)
-            return RBFM_EOF;
-        // Otherwise get next page ready
-        RC rc = getNextPage();
-        if (rc)
-            return rc;
-    }
+        // If we're done with the current page, or we've read the last page
+        if (currSlot >= totalSlot || currPage >= totalPage)
+        {
+            // Reinitialize the current slot and increment page number
+            currSlot = 0;
+            currPage++;
+            // If we're done with last page, return EOF
+            if (currPage >= totalPage)
+                return RBFM_EOF;
+            // Otherwise get next page ready
+            RC rc = getNextPage();
+            if (rc)
+                return rc;
+            continue;
+        }
 
-    // Get slot header, check to see if valid and meets scan condition
-    SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
+        // Get slot header, check to see if valid and meets scan condition.
+        // Tombstones are skipped, their record is returned where it lives now.
+        SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
+        if (rbfm->getSlotStatus(recordEntry) == VALID
+                && checkScanCondition((const char*)pageData + recordEntry.offset))
+            return SUCCESS;
 
-    if (rbfm->getSlotStatus(recordEntry) != VALID || !checkScanCondition())
-    {
         // If not, try next slot
         currSlot++;
-        return getNextSlot();
     }
-    return SUCCESS;
 }
 
 RC RBFM_ScanIterator::getNextPage()
 {
-    // Read in page
-    if (fileHandle.readPage(currPage, pageData))
+    // Swap the pinned page for the next one
+    fileHandle.unpinPage(currPage - 1);
+    pageData = fileHandle.pinPage(currPage);
+    if (pageData == NULL)
         return RBFM_READ_FAILED;
 
     // Update slot total
@@ -653,51 +744,46 @@ RC RBFM_ScanIterator::getNextPage()
     return SUCCESS;
 }
 
-bool RBFM_ScanIterator::checkScanCondition()
+// A record is returned when it satisfies every predicate, we stop at the first one it fails
+// without reading the attributes of the others
+bool RBFM_ScanIterator::checkScanCondition(const char *record)
 {
-    if (compOp == NO_OP) return true;
-    if (value == NULL) return false;
-    Attribute attr = recordDescriptor[attrIndex];
-    // Allocate enough memory to hold attribute and 1 byte null indicator
-    void *data = malloc(1 + attr.length);
-    // Get record entry to get offset
-    SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
-    // Grab the given attribute and store it in data
-    rbfm->getAttributeFromRecord(pageData, recordEntry.offset, attrIndex, attr.type, data);
-
-    char null;
-    memcpy(&null, data, 1);
-
-    bool result = false;
-    if (null)
-    {
-        result = false;
-    }
-    // Checkscan condition on record data and scan value
-    else if (attr.type == TypeInt)
-    {
-        int32_t recordInt;
-        memcpy(&recordInt, (char*)data + 1, INT_SIZE);
-        result = checkScanCondition(recordInt, compOp, value);
-    }
-    else if (attr.type == TypeReal)
+    for (unsigned i = 0; i < predicates.size(); i++)
     {
-        float recordReal;
-        memcpy(&recordReal, (char*)data + 1, REAL_SIZE);
-        result = checkScanCondition(recordReal, compOp, value);
+        if (!checkPredicate(predicates[i], predicateIndexes[i], record))
+            return false;
     }
-    else if (attr.type == TypeVarChar)
-    {
-        uint32_t varcharSize;
-        memcpy(&varcharSize, (char*)data + 1, VARCHAR_LENGTH_SIZE);
-        char recordString[varcharSize + 1];
-        memcpy(recordString, (char*)data + 1 + VARCHAR_LENGTH_SIZE, varcharSize);
-        recordString[varcharSize] = '\0';
+    return true;
+}
+
+// Compares the attribute where it sits on the page
+bool RBFM_ScanIterator::checkPredicate(const ScanPredicate &predicate, unsigned attrIndex, const char *record)
+{
+    if (predicate.value == NULL)
+        return false;
 
-        result = checkScanCondition(recordString, compOp, value);
+    uint32_t length;
+    const char *field = rbfm->findAttributeInRecord(record, attrIndex, length);
+    if (field == NULL)
+        return false;
+
+    switch (recordDescriptor[attrIndex].type)
+    {
+        case TypeInt:
+        {
+            int32_t recordInt;
+            memcpy(&recordInt, field, INT_SIZE);
+            return checkScanCondition(recordInt, predicate.compOp, predicate.value);
+        }
+        case TypeReal:
+        {
+            float recordReal;
+            memcpy(&recordReal, field, REAL_SIZE);
+            return checkScanCondition(recordReal, predicate.compOp, predicate.value);
+        }
+        default:
+            return checkScanCondition(field, length, predicate.compOp, predicate.value);
     }
-    free (data);
-    return result;
 }
 
 bool RBFM_ScanIterator::checkScanCondition(int recordInt, CompOp compOp, const void *value)
@@ -738,18 +824,17 @@ bool RBFM_ScanIterator::checkScanCondition(float recordReal, CompOp compOp, cons
     }
 }
 
-bool RBFM_ScanIterator::checkScanCondition(char *recordString, CompOp compOp, const void *value)
+// Strings compare byte by byte, a prefix before the longer string
+bool RBFM_ScanIterator::checkScanCondition(const char *recordString, uint32_t recordLength, CompOp compOp, const void *value)
 {
     if (compOp == NO_OP)
         return true;
 
-    int32_t valueSize;
-    memcpy(&valueSize, value, VARCHAR_LENGTH_SIZE);
-    char valueStr[valueSize + 1];
-    valueStr[valueSize] = '\0';
-    memcpy(valueStr, (char*) value + VARCHAR_LENGTH_SIZE, valueSize);
-
-    int cmp = strcmp(recordString, valueStr);
+    uint32_t valueLength;
+    memcpy(&valueLength, value, VARCHAR_LENGTH_SIZE);
+    int cmp = memcmp(recordString, (const char*) value + VARCHAR_LENGTH_SIZE, min(recordLength, valueLength));
+    if (cmp == 0)
+        cmp = recordLength < valueLength ? -1 : (recordLength > valueLength ? 1 : 0);
     switch (compOp)
     {
         case EQ_OP: return cmp == 0;
@@ -763,6 +848,105 @@ bool RBFM_ScanIterator::checkScanCondition(char *recordString, CompOp compOp, co
     }
 }
 
+// Gets the free space map of the file, reading the free space of any page it doesn't know about yet.
+RC RecordBasedFileManager::getFreeSpaceMap(FileHandle &fileHandle, FreeSpaceMap *&fsm)
+{
+    unsigned numPages = fileHandle.getNumberOfPages();
+    fsm = &_free_space_maps[fileHandle.getFileId()];
+    // Pages vanished, start over
+    if (fsm->getNumberOfPages() > numPages)
+        *fsm = FreeSpaceMap();
+    if (fsm->getNumberOfPages() == numPages)
+        return SUCCESS;
+
+    void *pageData = malloc(PAGE_SIZE);
+    if (pageData == NULL)
+        return RBFM_MALLOC_FAILED;
+    for (PageNum i = fsm->getNumberOfPages(); i < numPages; i++)
+    {
+        if (fileHandle.readPage(i, pageData))
+        {
+            free(pageData);
+            _free_space_maps.erase(fileHandle.getFileId());
+            return RBFM_READ_FAILED;
+        }
+        fsm->appendPage(getPageFreeSpaceSize(pageData));
+    }
+    free(pageData);
+    return SUCCESS;
+}
+
+// Records the free space of a page that was just written or appended.
+void RecordBasedFileManager::updateFreeSpaceMap(FileHandle &fileHandle, PageNum pageNum, void *page)
+{
+    auto it = _free_space_maps.find(fileHandle.getFileId());
+    // Not built yet, it will read the page when it is
+    if (it == _free_space_maps.end())
+        return;
+
+    FreeSpaceMap &fsm = it->second;
+    if (pageNum < fsm.getNumberOfPages())
+        fsm.setFreeSpace(pageNum, getPageFreeSpaceSize(page));
+    else if (pageNum == fsm.getNumberOfPages())
+        fsm.appendPage(getPageFreeSpaceSize(page));
+    else
+        _free_space_maps.erase(it);
+}
+
+FreeSpaceMap::FreeSpaceMap()
+{
+    capacity = 1;
+    numPages = 0;
+    tree.assign(2 * capacity, 0);
+}
+
+unsigned FreeSpaceMap::getNumberOfPages() const
+{
+    return numPages;
+}
+
+void FreeSpaceMap::appendPage(uint16_t freeSpace)
+{
+    // Out of leaves, double the tree and rebuild the inner nodes
+    if (numPages == capacity)
+    {
+        vector<uint16_t> grown(4 * capacity, 0);
+        copy(tree.begin() + capacity, tree.end(), grown.begin() + 2 * capacity);
+        capacity *= 2;
+        tree.swap(grown);
+        for (unsigned node = capacity - 1; node > 0; node--)
+            tree[node] = max(tree[2 * node], tree[2 * node + 1]);
+    }
+    numPages++;
+    setFreeSpace(numPages - 1, freeSpace);
+}
+
+void FreeSpaceMap::setFreeSpace(PageNum pageNum, uint16_t freeSpace)
+{
+    unsigned node = capacity + pageNum;
+    tree[node] = freeSpace;
+    for (node /= 2; node > 0; node /= 2)
+        tree[node] = max(tree[2 * node], tree[2 * node + 1]);
+}
+
+uint16_t FreeSpaceMap::getFreeSpace(PageNum pageNum) const
+{
+    return tree[capacity + pageNum];
+}
+
+bool FreeSpaceMap::findPage(unsigned size, PageNum &pageNum) const
+{
+    if (numPages == 0 || tree[1] < size)
+        return false;
+
+    // Go left whenever the left subtree has a page big enough
+    unsigned node = 1;
+    while (node < capacity)
+        node = tree[2 * node] >= size ? 2 * node : 2 * node + 1;
+    pageNum = node - capacity;
+    return true;
+}
+
 // Configures a new record based page, and puts it in "page".
 void RecordBasedFileManager::newRecordBasedPage(void * page)
 {
@@ -774,7 +958,7 @@ void RecordBasedFileManager::newRecordBasedPage(void * page)
     setSlotDirectoryHeader(page, slotHeader);
 }
 
-SlotDirectoryHeader RecordBasedFileManager::getSlotDirectoryHeader(void * page)
+SlotDirectoryHeader RecordBasedFileManager::getSlotDirectoryHeader(const void * page)
 {
     // Getting the slot directory header.
     SlotDirectoryHeader slotHeader;
@@ -788,13 +972,13 @@ void RecordBasedFileManager::setSlotDirectoryHeader(void * page, SlotDirectoryHe
     memcpy (page, &slotHeader, sizeof(SlotDirectoryHeader));
 }
 
-SlotDirectoryRecordEntry RecordBasedFileManager::getSlotDirectoryRecordEntry(void * page, unsigned recordEntryNumber)
+SlotDirectoryRecordEntry RecordBasedFileManager::getSlotDirectoryRecordEntry(const void * page, unsigned recordEntryNumber)
 {
     // Getting the slot directory entry data.
     SlotDirectoryRecordEntry recordEntry;
     memcpy  (
             &recordEntry,
-            ((char*) page + sizeof(SlotDirectoryHeader) + recordEntryNumber * sizeof(SlotDirectoryRecordEntry)),
+            ((const char*) page + sizeof(SlotDirectoryHeader) + recordEntryNumber * sizeof(SlotDirectoryRecordEntry)),
             sizeof(SlotDirectoryRecordEntry)
             );
 
@@ -1009,6 +1193,26 @@ SlotStatus RecordBasedFileManager::getSlotStatus(SlotDirectoryRecordEntry slot)
     return VALID;
 }
 
+// Whether a valid slot holds a record moved here from its home by an update
+bool RecordBasedFileManager::isForwardedRecord(SlotDirectoryRecordEntry slot)
+{
+    return slot.offset > 0 && (slot.length & RBFM_FORWARDED_RECORD);
+}
+
+// Length of the record of a valid slot, without the forwarded flag
+uint32_t RecordBasedFileManager::getRecordLength(SlotDirectoryRecordEntry slot)
+{
+    return slot.length & ~RBFM_FORWARDED_RECORD;
+}
+
+// RID a forwarded record was inserted under, stored just before the record
+RID RecordBasedFileManager::getHomeRID(const void *page, SlotDirectoryRecordEntry slot)
+{
+    RID home;
+    memcpy(&home, (const char*) page + slot.offset - sizeof(RID), sizeof(RID));
+    return home;
+}
+
 // Get first unused slot in page. Slot is considered unused if dead
 // If not dead slots returns recordEntriesNumber
 unsigned RecordBasedFileManager::getOpenSlot(void *page)
@@ -1061,60 +1265,64 @@ void RecordBasedFileManager::reorganizePage(void *page)
     for (unsigned i = 0; i < liveRecords.size(); i++)
     {
         current = liveRecords[i].recordEntry;
-        pageOffset -= current.length;
+        // A forwarded record brings its home RID along
+        unsigned prefix = isForwardedRecord(current) ? sizeof(RID) : 0;
+        unsigned length = getRecordLength(current) + prefix;
+        pageOffset -= length;
 
         // Use memmove rather than memcpy because locations may overlap
-        memmove((char*)page + pageOffset, (char*)page + current.offset, current.length);
-        current.offset = pageOffset;
+        memmove((char*)page + pageOffset, (char*)page + current.offset - prefix, length);
+        current.offset = pageOffset + prefix;
         setSlotDirectoryRecordEntry(page, liveRecords[i].slotNum, current);
     }
     header.freeSpaceOffset = pageOffset;
     setSlotDirectoryHeader(page, header);
 }
 
-void RecordBasedFileManager::getAttributeFromRecord(void *page, unsigned offset, unsigned attrIndex, AttrType type, void *data)
+void RecordBasedFileManager::getAttributeFromRecord(const void *page, unsigned offset, unsigned attrIndex, AttrType type, void *data)
 {
-    char *start = (char*)page + offset;
-    unsigned data_offset = 0;
-
-    // Get number of columns
-    RecordLength n;
-    memcpy (&n, start, sizeof(RecordLength));
-
-    // Get null indicator
-    int recordNullIndicatorSize = getNullIndicatorSize(n);
-    char recordNullIndicator[recordNullIndicatorSize];
-    memcpy (recordNullIndicator, start + sizeof(RecordLength), recordNullIndicatorSize);
+    uint32_t len;
+    const char *field = findAttributeInRecord((const char*)page + offset, attrIndex, len);
 
     // Set null indicator for result
-    char resultNullIndicator = 0;
-    if (fieldIsNull(recordNullIndicator, attrIndex))
-        resultNullIndicator |= (1 << 7);
+    char resultNullIndicator = field == NULL ? (1 << 7) : 0;
     memcpy(data, &resultNullIndicator, 1);
-    data_offset += 1;
+    unsigned data_offset = 1;
     if (resultNullIndicator) return;
 
-    // Now we know the result isn't null, so we grab it
-    unsigned header_offset = sizeof(RecordLength) + recordNullIndicatorSize;
-    // attrEnd points to end of attribute, attrStart points to the beginning
-    // Our directory at the beginning of each record contains pointers to the ends of each attribute,
-    // so we can pull attrEnd from that
-    ColumnOffset attrEnd, attrStart;
-    memcpy(&attrEnd, start + header_offset + attrIndex * sizeof(ColumnOffset), sizeof(ColumnOffset));
-    // The start is either the end of the previous attribute, or the start of the data section of the
-    // record if we are after the 0th attribute
-    if (attrIndex > 0)
-        memcpy(&attrStart, start + header_offset + (attrIndex - 1) * sizeof(ColumnOffset), sizeof(ColumnOffset));
-    else
-        attrStart = header_offset + n * sizeof(ColumnOffset);
-    // The length of any attribute is just the difference between its start and end
-    uint32_t len = attrEnd - attrStart;
     if (type == TypeVarChar)
     {
         // For varchars we have to return this length in the result
-        memcpy((char*)data + data_offset, &len, sizeof(VARCHAR_LENGTH_SIZE));
+        memcpy((char*)data + data_offset, &len, VARCHAR_LENGTH_SIZE);
         data_offset += VARCHAR_LENGTH_SIZE;
     }
     // For all types, we then copy the data into the result
-    memcpy((char*)data + data_offset, start + attrStart, len);
-}
\ No newline at end of file
+    memcpy((char*)data + data_offset, field, len);
+}
+
+// Finds an attribute of a record in place, NULL when it is null
+const char *RecordBasedFileManager::findAttributeInRecord(const char *record, unsigned attrIndex, uint32_t &length)
+{
+    // Get number of columns
+    RecordLength n;
+    memcpy (&n, record, sizeof(RecordLength));
+
+    // The null indicator follows
+    const char *recordNullIndicator = record + sizeof(RecordLength);
+    if (recordNullIndicator[attrIndex / CHAR_BIT] & (1 << (CHAR_BIT - 1 - (attrIndex % CHAR_BIT))))
+        return NULL;
+
+    // Our directory at the beginning of each record contains pointers to the ends of each attribute,
+    // so attrEnd comes from it. The start is either the end of the previous attribute, or the start
+    // of the data section of the record if we are after the 0th attribute
+    unsigned header_offset = sizeof(RecordLength) + getNullIndicatorSize(n);
+    ColumnOffset attrEnd, attrStart;
+    memcpy(&attrEnd, record + header_offset + attrIndex * sizeof(ColumnOffset), sizeof(ColumnOffset));
+    if (attrIndex > 0)
+        memcpy(&attrStart, record + header_offset + (attrIndex - 1) * sizeof(ColumnOffset), sizeof(ColumnOffset));
+    else
+        attrStart = header_offset + n * sizeof(ColumnOffset);
+    // The length of any attribute is just the difference between its start and end
+    length = attrEnd - attrStart;
+    return record + attrStart;
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <climits>
+#include <map>
 
 #include "../rbf/pfm.h"
 
@@ -58,6 +59,13 @@ typedef enum
     NO_OP       // no condition
 } CompOp;
 
+// One predicate of a conjunctive scan condition: attribute compOp value
+struct ScanPredicate {
+    string     attribute;   // attribute compared
+    CompOp     compOp;      // comparison type such as "<" and "="
+    const void *value;      // used in the comparison
+};
+
 // Slot directory headers for page organization
 // See chapter 9.6.2 of the cow book or lecture 3 slide 16 for more information
 typedef struct SlotDirectoryHeader
@@ -74,6 +82,11 @@ typedef struct SlotDirectoryRecordEntry
     int32_t offset;
 } SlotDirectoryRecordEntry;
 
+// A record moved off its page by updateRecord has this bit set in its length, and the RID
+// it was inserted under stored just before it. Scans return it there under that RID and
+// skip its tombstone, so every record comes back once without leaving the page being read.
+#define RBFM_FORWARDED_RECORD 0x80000000
+
 typedef struct IndexedRecordEntry
 {
     int32_t slotNum;
@@ -125,35 +138,52 @@ private:
   uint32_t totalPage;
   uint16_t totalSlot;
 
-  void *pageData;
-
-  AttrType type;
-  unsigned attrIndex;
+  // Current page, pinned rather than copied
+  const void *pageData;
 
   FileHandle fileHandle;
   vector<Attribute> recordDescriptor;
-  string conditionAttribute;
-  CompOp compOp;
-  const void* value;
   vector<string> attributeNames;
 
-  vector<RID> skipList;
+  // Index in the record of every projected attribute
+  vector<unsigned> projectionIndexes;
+
+  // Predicates most selective first, with the index of their attribute in the record
+  vector<ScanPredicate> predicates;
+  vector<unsigned> predicateIndexes;
 
   RC scanInit(FileHandle &fh,
         const vector<Attribute> rd,
-        const string &ca, 
-        const CompOp compOp, 
-        const void *v, 
+        const vector<ScanPredicate> &preds,
         const vector<string> &an);
 
   RC getNextSlot();
   RC getNextPage();
-  RC handleMovedRecord(bool &status, const RID rid, void *data);
-  bool checkScanCondition();
-  RC checkScanCondition(bool &result, const RID rid);
+  bool checkScanCondition(const char *record);
+  bool checkPredicate(const ScanPredicate &predicate, unsigned attrIndex, const char *record);
   bool checkScanCondition(int, CompOp, const void*);
   bool checkScanCondition(float, CompOp, const void*);
-  bool checkScanCondition(char*, CompOp, const void*);
+  bool checkScanCondition(const char*, uint32_t, CompOp, const void*);
+};
+
+
+// Free bytes of every page of a record based file, kept in a max segment tree
+// so the first page with enough room is found in O(log N) without reading any page.
+class FreeSpaceMap {
+public:
+  FreeSpaceMap();
+
+  unsigned getNumberOfPages() const;
+  void appendPage(uint16_t freeSpace);
+  void setFreeSpace(PageNum pageNum, uint16_t freeSpace);
+  uint16_t getFreeSpace(PageNum pageNum) const;
+  // Lowest numbered page with at least size free bytes
+  bool findPage(unsigned size, PageNum &pageNum) const;
+
+private:
+  vector<uint16_t> tree;  // tree[1] is the root, leaves start at capacity
+  unsigned capacity;
+  unsigned numPages;
 };
 
 
@@ -166,7 +196,8 @@ public:
   
   RC destroyFile(const string &fileName);
   
-  RC openFile(const string &fileName, FileHandle &fileHandle);
+  // A memory mapped file serves page reads straight from the mapping
+  RC openFile(const string &fileName, FileHandle &fileHandle, bool memoryMapped = false);
   
   RC closeFile(FileHandle &fileHandle);
 
@@ -186,6 +217,10 @@ public:
   // For example, refer to the Q6 of Project 1 Environment document.
   RC insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid);
 
+  // Inserts after every record of the file instead of in the first page with room,
+  // so a scan returns appended records in the order they were appended
+  RC appendRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid);
+
   RC readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data);
   
   // This method will be mainly used for debugging/testing. 
@@ -214,6 +249,13 @@ IMPORTANT, PLEASE READ: All methods below this comment (other than the construct
       const vector<string> &attributeNames, // a list of projected attributes
       RBFM_ScanIterator &rbfm_ScanIterator);
 
+  // Scan returning the records that satisfy every predicate, checked most selective first
+  RC scan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const vector<ScanPredicate> &predicates,
+      const vector<string> &attributeNames, // a list of projected attributes
+      RBFM_ScanIterator &rbfm_ScanIterator);
+
 public:
   friend class RBFM_ScanIterator;
 
@@ -225,14 +267,24 @@ private:
   static RecordBasedFileManager *_rbf_manager;
   static PagedFileManager *_pf_manager;
 
+  // Free space maps by FileHandle::getFileId(), built the first time a file gets a record
+  map<unsigned, FreeSpaceMap> _free_space_maps;
+
   // Private helper methods
 
+  // A record given its home RID is stored forwarded, see RBFM_FORWARDED_RECORD
+  RC insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid, bool append,
+      const RID *home = NULL);
+
+  RC getFreeSpaceMap(FileHandle &fileHandle, FreeSpaceMap *&fsm);
+  void updateFreeSpaceMap(FileHandle &fileHandle, PageNum pageNum, void *page);
+
   void newRecordBasedPage(void * page);
 
-  SlotDirectoryHeader getSlotDirectoryHeader(void * page);
+  SlotDirectoryHeader getSlotDirectoryHeader(const void * page);
   void setSlotDirectoryHeader(void * page, SlotDirectoryHeader slotHeader);
 
-  SlotDirectoryRecordEntry getSlotDirectoryRecordEntry(void * page, unsigned recordEntryNumber);
+  SlotDirectoryRecordEntry getSlotDirectoryRecordEntry(const void * page, unsigned recordEntryNumber);
   void setSlotDirectoryRecordEntry(void * page, unsigned recordEntryNumber, SlotDirectoryRecordEntry recordEntry);
 
   unsigned getPageFreeSpaceSize(void * page);
@@ -245,13 +297,17 @@ private:
   void getRecordAtOffset(void *record, int32_t offset, const vector<Attribute> &recordDescriptor, void *data);
 
   SlotStatus getSlotStatus (SlotDirectoryRecordEntry slot);
+  bool isForwardedRecord(SlotDirectoryRecordEntry slot);
+  uint32_t getRecordLength(SlotDirectoryRecordEntry slot);
+  RID getHomeRID(const void *page, SlotDirectoryRecordEntry slot);
   unsigned getOpenSlot(void *page);
 
   void markSlotDeleted(void *page, unsigned i);
 
   void reorganizePage(void *page);
 
-  void getAttributeFromRecord(void *page, unsigned offset, unsigned attrIndex, AttrType type,void *data);
+  void getAttributeFromRecord(const void *page, unsigned offset, unsigned attrIndex, AttrType type,void *data);
+  const char *findAttributeInRecord(const char *record, unsigned attrIndex, uint32_t &length);
 };
 
 #endif
@@ -0,0 +1,160 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_13(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Buffer pool hits and misses
+    // 2. Pin / Unpin Page
+    // 3. Eviction with a small pool, for both replacement policies
+    // 4. Sharing cached pages between two handles
+    cout << endl << "***** In RBF Test Case 13 *****" << endl;
+
+    RC rc;
+    string fileName = "test13";
+    const unsigned numPages = 16;
+
+    // Create a file with numPages pages, page i filled with byte i
+    remove(fileName.c_str());
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *buffer = malloc(PAGE_SIZE);
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        memset(buffer, i, PAGE_SIZE);
+        rc = fileHandle.appendPage(buffer);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Only 4 frames, so reading every page twice misses every time
+    rc = pfm->setBufferPoolSize(4);
+    assert(rc == success && "Resizing the buffer pool should not fail.");
+
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    unsigned hits, misses, hits1, misses1;
+    unsigned readPageCount, writePageCount, appendPageCount;
+    for (unsigned round = 0; round < 2; round++)
+    {
+        for (unsigned i = 0; i < numPages; i++)
+        {
+            rc = fileHandle.readPage(i, buffer);
+            assert(rc == success && "Reading a page should not fail.");
+            assert(((unsigned char *) buffer)[PAGE_SIZE - 1] == i && "Page content should be intact.");
+        }
+    }
+    fileHandle.collectBufferCounterValues(hits, misses);
+    fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    cout << "sequential: hits " << hits << " misses " << misses << " reads " << readPageCount << endl;
+    assert(misses == 2 * numPages && "Every read should miss when the file is larger than the pool.");
+    assert(readPageCount == misses && "Every miss should be one physical read.");
+
+    // Rereading a resident page hits
+    rc = fileHandle.readPage(numPages - 1, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    fileHandle.collectBufferCounterValues(hits1, misses1);
+    assert(hits1 == hits + 1 && misses1 == misses && "Rereading the last page should hit.");
+
+    // Pinned pages are never evicted
+    void *pinned;
+    rc = fileHandle.pinPage(0, pinned);
+    assert(rc == success && "Pinning a page should not fail.");
+    memset(pinned, 'x', PAGE_SIZE);
+    for (unsigned i = 1; i < numPages; i++)
+    {
+        rc = fileHandle.readPage(i, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+    }
+    assert(((char *) pinned)[0] == 'x' && "A pinned frame should not be reused.");
+    rc = fileHandle.unpinPage(0, true);
+    assert(rc == success && "Unpinning a page should not fail.");
+    rc = fileHandle.unpinPage(0, false);
+    assert(rc == FH_PAGE_NOT_PINNED && "Unpinning an unpinned page should fail.");
+
+    // With every frame pinned there is nothing left to evict
+    void *frames[4];
+    for (unsigned i = 0; i < 4; i++)
+    {
+        rc = fileHandle.pinPage(i, frames[i]);
+        assert(rc == success && "Pinning a page should not fail.");
+    }
+    rc = fileHandle.pinPage(4, pinned);
+    assert(rc == PFM_NO_FREE_FRAME && "Pinning with every frame pinned should fail.");
+    for (unsigned i = 0; i < 4; i++)
+        fileHandle.unpinPage(i, false);
+
+    // The dirty page is written back when evicted or at close, and must be seen by a second handle
+    FileHandle fileHandle2;
+    rc = pfm->openFile(fileName, fileHandle2);
+    assert(rc == success && "Opening the file twice should not fail.");
+    rc = fileHandle2.readPage(0, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    assert(((char *) buffer)[PAGE_SIZE - 1] == 'x' && "The second handle should see the modified page.");
+    rc = pfm->closeFile(fileHandle2);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // LRU keeps the hot page resident while we cycle through the others
+    rc = pfm->setReplacementPolicy(new LRUPolicy());
+    assert(rc == success && "Changing the replacement policy should not fail.");
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    fileHandle.collectBufferCounterValues(hits, misses);
+    for (unsigned i = 1; i < numPages; i++)
+    {
+        rc = fileHandle.readPage(0, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+        assert(((char *) buffer)[0] == 'x' && "Page 0 should have been written back.");
+        rc = fileHandle.readPage(i, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+    }
+    fileHandle.collectBufferCounterValues(hits1, misses1);
+    cout << "hot page: hits " << hits1 - hits << " misses " << misses1 - misses << endl;
+    assert(hits1 - hits == numPages - 2 && "Only the first read of page 0 should miss.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm->setReplacementPolicy(new ClockPolicy());
+    assert(rc == success && "Changing the replacement policy should not fail.");
+    rc = pfm->setBufferPoolSize(BUFFER_POOL_DEFAULT_FRAMES);
+    assert(rc == success && "Resizing the buffer pool should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(buffer);
+
+    cout << "RBF Test Case 13 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+	// To test the buffer pool underneath the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    RC rcmain = RBFTest_13(pfm);
+    return rcmain;
+}
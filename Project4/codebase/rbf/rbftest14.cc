@@ -0,0 +1,120 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_14(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Insert Records into a large file with a bounded number of page reads
+    // 2. Reuse of space freed by Delete Record
+    // 3. Update Record that has to move to another page
+    cout << endl << "***** In RBF Test Case 14 *****" << endl;
+
+    RC rc;
+    string fileName = "test14";
+
+    remove(fileName.c_str());
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(PAGE_SIZE);
+    void *returnedData = malloc(PAGE_SIZE);
+    int recordSize = 0;
+    string name(500, 'a');
+    prepareRecord(recordDescriptor.size(), nullsIndicator, name.size(), name, 25, 177.8, 6200, record, &recordSize);
+
+    // About 7 records per page
+    int numRecords = 3000;
+    vector<RID> rids;
+    RID rid;
+    for (int i = 0; i < numRecords; i++) {
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+    unsigned numPages = fileHandle.getNumberOfPages();
+    cout << "pages after " << numRecords << " inserts: " << numPages << endl;
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Every page is full, further inserts must not look at them
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    unsigned hits, misses, hits1, misses1;
+    fileHandle.collectBufferCounterValues(hits, misses);
+    int numMoreRecords = 200;
+    for (int i = 0; i < numMoreRecords; i++) {
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    fileHandle.collectBufferCounterValues(hits1, misses1);
+    cout << "page reads for " << numMoreRecords << " inserts: " << hits1 + misses1 - hits - misses << endl;
+    assert(hits1 + misses1 - hits - misses <= (unsigned) numMoreRecords && "An insert should read at most one page.");
+
+    // Space freed on an early page gets reused
+    rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[8]);
+    assert(rc == success && "Deleting a record should not fail.");
+    rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+    assert(rc == success && "Inserting a record should not fail.");
+    assert(rid.pageNum == rids[8].pageNum && "The insert should reuse the freed space.");
+
+    // A record growing out of a full page moves to the first page with room
+    rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[100]);
+    assert(rc == success && "Deleting a record should not fail.");
+    string longName(900, 'b');
+    prepareRecord(recordDescriptor.size(), nullsIndicator, longName.size(), longName, 26, 180.3, 7200, record, &recordSize);
+    rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[0]);
+    assert(rc == success && "Updating a record should not fail.");
+    rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[0], returnedData);
+    assert(rc == success && "Reading a record should not fail.");
+    assert(memcmp(record, returnedData, recordSize) == 0 && "The updated record should read back.");
+
+    // The space left on page 0 is reused too
+    prepareRecord(recordDescriptor.size(), nullsIndicator, name.size(), name, 25, 177.8, 6200, record, &recordSize);
+    rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+    assert(rc == success && "Inserting a record should not fail.");
+    assert(rid.pageNum == 0 && "The insert should reuse the space freed by the move.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 14 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the free space map of the record based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_14(rbfm);
+    return rcmain;
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Reads a page straight from the file, bypassing the paged file manager
+static bool pageOnDisk(const string &fileName, PageNum pageNum, const void *expected)
+{
+    char page[PAGE_SIZE];
+    FILE *f = fopen(fileName.c_str(), "rb");
+    if (f == NULL)
+        return false;
+    bool same = fseek(f, PAGE_SIZE * pageNum, SEEK_SET) == 0
+        && fread(page, 1, PAGE_SIZE, f) == PAGE_SIZE
+        && memcmp(page, expected, PAGE_SIZE) == 0;
+    fclose(f);
+    return same;
+}
+
+int RBFTest_15(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Durability modes of a file
+    // 2. Write Page to a cached page with and without write-through
+    cout << endl << "***** In RBF Test Case 15 *****" << endl;
+
+    RC rc;
+    string fileName = "test15";
+
+    remove(fileName.c_str());
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(fileHandle.getDurability() == DURABILITY_NONE && "Files should not be synced by default.");
+
+    void *data = malloc(PAGE_SIZE);
+    memset(data, 'a', PAGE_SIZE);
+    rc = fileHandle.appendPage(data);
+    assert(rc == success && "Appending a page should not fail.");
+    assert(pageOnDisk(fileName, 0, data) && "Appended pages are written through.");
+
+    // Without durability, a write to a cached page stays in the pool
+    unsigned readPageCount, writePageCount, appendPageCount, writePageCount1;
+    fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    memset(data, 'b', PAGE_SIZE);
+    rc = fileHandle.writePage(0, data);
+    assert(rc == success && "Writing a page should not fail.");
+    fileHandle.collectCounterValues(readPageCount, writePageCount1, appendPageCount);
+    assert(writePageCount1 == writePageCount && "A cached page should be written back later.");
+    assert(!pageOnDisk(fileName, 0, data) && "A cached page should be written back later.");
+
+    // Switching to per write durability flushes what is pending
+    rc = fileHandle.setDurability(DURABILITY_SYNC_PER_WRITE);
+    assert(rc == success && "Changing the durability should not fail.");
+    assert(pageOnDisk(fileName, 0, data) && "Pending pages should be flushed.");
+
+    // And from then on every write goes to the file
+    memset(data, 'c', PAGE_SIZE);
+    rc = fileHandle.writePage(0, data);
+    assert(rc == success && "Writing a page should not fail.");
+    assert(pageOnDisk(fileName, 0, data) && "A durable write should reach the file.");
+
+    void *frame;
+    rc = fileHandle.pinPage(0, frame);
+    assert(rc == success && "Pinning a page should not fail.");
+    memset(frame, 'd', PAGE_SIZE);
+    rc = fileHandle.unpinPage(0, true);
+    assert(rc == success && "Unpinning a page should not fail.");
+    memset(data, 'd', PAGE_SIZE);
+    assert(pageOnDisk(fileName, 0, data) && "A durable unpin should reach the file.");
+
+    // The setting belongs to the file, a second handle sees it
+    FileHandle fileHandle2;
+    rc = pfm->openFile(fileName, fileHandle2);
+    assert(rc == success && "Opening the file twice should not fail.");
+    assert(fileHandle2.getDurability() == DURABILITY_SYNC_PER_WRITE && "Durability should be shared by handles.");
+    rc = fileHandle2.setDurability(DURABILITY_SYNC_ON_CLOSE);
+    assert(rc == success && "Changing the durability should not fail.");
+    rc = pfm->closeFile(fileHandle2);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Sync on close writes everything back on the last close
+    memset(data, 'e', PAGE_SIZE);
+    rc = fileHandle.writePage(0, data);
+    assert(rc == success && "Writing a page should not fail.");
+    assert(!pageOnDisk(fileName, 0, data) && "A cached page should be written back later.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    assert(pageOnDisk(fileName, 0, data) && "Closing the file should write the page back.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(data);
+
+    cout << "RBF Test Case 15 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+	// To test the durability settings of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    RC rcmain = RBFTest_15(pfm);
+    return rcmain;
+}
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_16(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Open a file memory mapped
+    // 2. Pin Page without copying, through the mapping and through the pool
+    // 3. Append Page past the end of the mapping
+    // 4. Writes through another handle are seen by the mapping
+    cout << endl << "***** In RBF Test Case 16 *****" << endl;
+
+    RC rc;
+    string fileName = "test16";
+    const unsigned numPages = 8;
+
+    remove(fileName.c_str());
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle, true);
+    assert(rc == success && "Opening the file memory mapped should not fail.");
+
+    void *buffer = malloc(PAGE_SIZE);
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        memset(buffer, i, PAGE_SIZE);
+        rc = fileHandle.appendPage(buffer);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+
+    // Pinned pages point into the mapping and are counted as reads, not misses
+    unsigned readPageCount, writePageCount, appendPageCount, readPageCount1;
+    unsigned hits, misses, hits1, misses1;
+    fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    fileHandle.collectBufferCounterValues(hits, misses);
+    const void *pages[numPages];
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        pages[i] = fileHandle.pinPage(i);
+        assert(pages[i] != NULL && "Pinning a mapped page should not fail.");
+        assert(((const unsigned char *) pages[i])[PAGE_SIZE - 1] == i && "Page content should be intact.");
+    }
+    assert((const char *) pages[1] - (const char *) pages[0] == PAGE_SIZE && "Mapped pages should be contiguous.");
+    fileHandle.collectCounterValues(readPageCount1, writePageCount, appendPageCount);
+    fileHandle.collectBufferCounterValues(hits1, misses1);
+    assert(readPageCount1 == readPageCount + numPages && "Every pin should count as a read.");
+    assert(hits1 == hits && misses1 == misses && "Mapped pages should not go through the pool.");
+    assert(fileHandle.pinPage(numPages) == NULL && "Pinning past the end should fail.");
+
+    // A write through a second handle shows up behind the pointer we hold
+    FileHandle fileHandle2;
+    rc = pfm->openFile(fileName, fileHandle2);
+    assert(rc == success && "Opening the file twice should not fail.");
+    memset(buffer, 'w', PAGE_SIZE);
+    rc = fileHandle2.writePage(3, buffer);
+    assert(rc == success && "Writing a page should not fail.");
+    assert(((const char *) pages[3])[0] == 'w' && "The mapping should see the write.");
+    rc = pfm->closeFile(fileHandle2);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Grow the file well past the mapping, old pointers must stay valid
+    memset(buffer, 'z', PAGE_SIZE);
+    unsigned grownPages = MMAP_MIN_LENGTH / PAGE_SIZE + 16;
+    for (unsigned i = numPages; i < grownPages; i++)
+    {
+        rc = fileHandle.appendPage(buffer);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    assert(((const char *) pages[3])[0] == 'w' && "Pinned pages should survive a remap.");
+    const void *last = fileHandle.pinPage(grownPages - 1);
+    assert(last != NULL && ((const char *) last)[0] == 'z' && "The remapped file should see the new pages.");
+    rc = fileHandle.readPage(grownPages - 1, buffer);
+    assert(rc == success && memcmp(buffer, last, PAGE_SIZE) == 0 && "Read Page should match the mapping.");
+
+    for (unsigned i = 0; i < numPages; i++)
+        fileHandle.unpinPage(i);
+    fileHandle.unpinPage(grownPages - 1);
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Without a mapping the same call pins a pool frame
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    fileHandle.collectBufferCounterValues(hits, misses);
+    const void *page = fileHandle.pinPage(3);
+    assert(page != NULL && ((const char *) page)[0] == 'w' && "Pinning a pool page should not fail.");
+    fileHandle.collectBufferCounterValues(hits1, misses1);
+    assert(misses1 == misses + 1 && "The first pin should miss.");
+    rc = fileHandle.unpinPage(3);
+    assert(rc == success && "Unpinning a page should not fail.");
+    rc = fileHandle.unpinPage(3);
+    assert(rc == FH_PAGE_NOT_PINNED && "Unpinning an unpinned page should fail.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(buffer);
+
+    cout << "RBF Test Case 16 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+	// To test the memory mapped read path of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    RC rcmain = RBFTest_16(pfm);
+    return rcmain;
+}
@@ -0,0 +1,142 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Number of records a scan returns
+static int countRecords(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+        const vector<ScanPredicate> &predicates, const vector<string> &attributeNames, RC &rc)
+{
+    RBFM_ScanIterator iter;
+    rc = rbfm->scan(fileHandle, recordDescriptor, predicates, attributeNames, iter);
+    if (rc != success)
+        return -1;
+    RID rid;
+    void *data = malloc(PAGE_SIZE);
+    int count = 0;
+    while (iter.getNextRecord(rid, data) == success)
+        count++;
+    iter.close();
+    free(data);
+    return count;
+}
+
+static ScanPredicate makePredicate(const string &attribute, CompOp compOp, const void *value)
+{
+    ScanPredicate predicate = {attribute, compOp, value};
+    return predicate;
+}
+
+int RBFTest_17(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Scan with several conjunctive predicates, including a range on one attribute
+    // 2. Predicates on null fields, NO_OP predicates and unknown attributes
+    cout << endl << "***** In RBF Test Case 17 *****" << endl;
+
+    RC rc;
+    string fileName = "test17";
+
+    remove(fileName.c_str());
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    // Age = i % 100, Height = i / 10.0 except every 7th record where it is null, Salary = i,
+    // EmpName = "emp" followed by i % 10
+    unsigned char nullsIndicator[1];
+    void *record = malloc(PAGE_SIZE);
+    int recordSize = 0;
+    int numRecords = 2000;
+    RID rid;
+    for (int i = 0; i < numRecords; i++) {
+        nullsIndicator[0] = i % 7 == 0 ? 1 << 5 : 0;
+        string name = "emp" + to_string(i % 10);
+        prepareRecord(recordDescriptor.size(), nullsIndicator, name.size(), name, i % 100, i / 10.0, i, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Salary");
+    attributeNames.push_back("EmpName");
+
+    // 20 <= Age < 30 AND Salary > 500 AND EmpName = "emp3" AND Height < 150.0
+    int ageLow = 20, ageHigh = 30, salary = 500;
+    float height = 150;
+    char name[8];
+    int nameLength = 4;
+    memcpy(name, &nameLength, sizeof(int));
+    memcpy(name + sizeof(int), "emp3", nameLength);
+    vector<ScanPredicate> predicates;
+    predicates.push_back(makePredicate("Age", GE_OP, &ageLow));
+    predicates.push_back(makePredicate("Age", LT_OP, &ageHigh));
+    predicates.push_back(makePredicate("Salary", GT_OP, &salary));
+    predicates.push_back(makePredicate("EmpName", EQ_OP, name));
+    predicates.push_back(makePredicate("Height", LT_OP, &height));
+
+    int expected = 0;
+    for (int i = 0; i < numRecords; i++) {
+        if (i % 100 >= ageLow && i % 100 < ageHigh && i > salary && i % 10 == 3 && i % 7 != 0 && i / 10.0 < height)
+            expected++;
+    }
+    int count = countRecords(rbfm, fileHandle, recordDescriptor, predicates, attributeNames, rc);
+    cout << "records matching every predicate: " << count << endl;
+    assert(rc == success && count == expected && "Every predicate should hold for the records returned.");
+
+    // A NO_OP predicate holds for every record, even on an unknown attribute
+    predicates.push_back(makePredicate("Unknown", NO_OP, NULL));
+    count = countRecords(rbfm, fileHandle, recordDescriptor, predicates, attributeNames, rc);
+    assert(rc == success && count == expected && "A NO_OP predicate should not drop records.");
+
+    // No predicates at all returns everything
+    predicates.clear();
+    count = countRecords(rbfm, fileHandle, recordDescriptor, predicates, attributeNames, rc);
+    assert(rc == success && count == numRecords && "A scan without predicates should return every record.");
+
+    // Null fields fail every comparison, even !=
+    float noHeight = -1;
+    predicates.push_back(makePredicate("Height", NE_OP, &noHeight));
+    count = countRecords(rbfm, fileHandle, recordDescriptor, predicates, attributeNames, rc);
+    assert(rc == success && count == numRecords - (numRecords + 6) / 7 && "A null field should not satisfy a predicate.");
+
+    // A predicate on an attribute the records do not have
+    predicates.push_back(makePredicate("Unknown", EQ_OP, &salary));
+    countRecords(rbfm, fileHandle, recordDescriptor, predicates, attributeNames, rc);
+    assert(rc == RBFM_NO_SUCH_ATTR && "A predicate on an unknown attribute should fail.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+
+    cout << "RBF Test Case 17 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the conjunctive scan of the record based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_17(rbfm);
+    return rcmain;
+}
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const int numRecords = 500;
+
+// Name length of record i after every update so far, 0 once it is deleted
+static int nameLengths[numRecords];
+
+static void updateRecords(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+        const vector<RID> &rids, int every, int nameLength)
+{
+    unsigned char nullsIndicator[1] = {0};
+    void *record = malloc(PAGE_SIZE);
+    int recordSize = 0;
+    for (int i = 0; i < numRecords; i += every) {
+        if (nameLengths[i] == 0)
+            continue;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, nameLength, string(nameLength, 'a' + i % 26), i, i, i, record, &recordSize);
+        RC rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+        assert(rc == success && "Updating a record should not fail.");
+        nameLengths[i] = nameLength;
+    }
+    free(record);
+}
+
+// Scans every record, checking each one comes back once under the RID it was inserted with
+static void checkScan(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+        const vector<RID> &rids)
+{
+    vector<string> attributeNames;
+    for (unsigned i = 0; i < recordDescriptor.size(); i++)
+        attributeNames.push_back(recordDescriptor[i].name);
+
+    RBFM_ScanIterator iter;
+    RC rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, iter);
+    assert(rc == success && "Opening a scan should not fail.");
+
+    unsigned char nullsIndicator[1] = {0};
+    void *expected = malloc(PAGE_SIZE);
+    void *data = malloc(PAGE_SIZE);
+    int recordSize = 0;
+    vector<bool> seen(numRecords, false);
+    int count = 0;
+    RID rid;
+    while (iter.getNextRecord(rid, data) == success) {
+        int nameLength, salary;
+        memcpy(&nameLength, (char*)data + 1, sizeof(int));
+        memcpy(&salary, (char*)data + 1 + sizeof(int) + nameLength + 2 * sizeof(int), sizeof(int));
+        assert(salary >= 0 && salary < numRecords && nameLengths[salary] != 0 && !seen[salary] && "A record should be returned once.");
+        assert(rid.pageNum == rids[salary].pageNum && rid.slotNum == rids[salary].slotNum && "A moved record should keep its RID.");
+        prepareRecord(recordDescriptor.size(), nullsIndicator, nameLengths[salary], string(nameLengths[salary], 'a' + salary % 26),
+                salary, salary, salary, expected, &recordSize);
+        assert(memcmp(data, expected, recordSize) == 0 && "The scan should return the updated record.");
+        seen[salary] = true;
+        count++;
+    }
+    iter.close();
+
+    int live = 0;
+    for (int i = 0; i < numRecords; i++)
+        live += nameLengths[i] != 0;
+    cout << "records scanned: " << count << " of " << live << endl;
+    assert(count == live && "Every live record should be scanned.");
+
+    free(expected);
+    free(data);
+}
+
+int RBFTest_18(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Scan after updates that move records to other pages, and move them again
+    // 2. Moved records that shrink, grow in place and get deleted
+    cout << endl << "***** In RBF Test Case 18 *****" << endl;
+
+    RC rc;
+    string fileName = "test18";
+
+    remove(fileName.c_str());
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    unsigned char nullsIndicator[1] = {0};
+    void *record = malloc(PAGE_SIZE);
+    int recordSize = 0;
+    vector<RID> rids(numRecords);
+    for (int i = 0; i < numRecords; i++) {
+        nameLengths[i] = 8;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, nameLengths[i], string(nameLengths[i], 'a' + i % 26), i, i, i, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rids[i]);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    free(record);
+    checkScan(rbfm, fileHandle, recordDescriptor, rids);
+
+    // Full pages, every third record is moved to a new page
+    updateRecords(rbfm, fileHandle, recordDescriptor, rids, 3, 200);
+    checkScan(rbfm, fileHandle, recordDescriptor, rids);
+
+    // Moved records that no longer fit where they were moved to move again
+    updateRecords(rbfm, fileHandle, recordDescriptor, rids, 6, 1500);
+    checkScan(rbfm, fileHandle, recordDescriptor, rids);
+
+    // Moved records shrinking, then growing in place
+    updateRecords(rbfm, fileHandle, recordDescriptor, rids, 12, 4);
+    updateRecords(rbfm, fileHandle, recordDescriptor, rids, 24, 40);
+    checkScan(rbfm, fileHandle, recordDescriptor, rids);
+
+    // Deleting through the tombstone deletes the moved record
+    for (int i = 0; i < numRecords; i += 9) {
+        rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+        assert(rc == success && "Deleting a record should not fail.");
+        nameLengths[i] = 0;
+    }
+    checkScan(rbfm, fileHandle, recordDescriptor, rids);
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 18 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the scan of the record based file manager over moved records
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_18(rbfm);
+    return rcmain;
+}
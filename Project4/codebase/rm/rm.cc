@@ -25,6 +25,7 @@ RelationManager::RelationManager()
 
 RelationManager::~RelationManager()
 {
+    dropAllHandles();
 }
 
 RC RelationManager::createCatalog()
@@ -32,6 +33,7 @@ RC RelationManager::createCatalog()
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     // Create both tables and columns tables, return error if either fails
     RC rc;
+    _catalog.clear();
     rc = rbfm->createFile(getFileName(TABLES_TABLE_NAME));
     if (rc)
         return rc;
@@ -80,6 +82,10 @@ RC RelationManager::deleteCatalog()
 
     RC rc;
 
+    // Every table goes away with the catalog
+    dropAllHandles();
+    _catalog.clear();
+
     rc = rbfm->destroyFile(getFileName(TABLES_TABLE_NAME));
     if (rc)
         return rc;
@@ -120,6 +126,15 @@ RC RelationManager::createTable(const string &tableName, const vector<Attribute>
     if (rc)
         return rc;
 
+    // We know everything about the new table, so cache it right away
+    TableInfo info;
+    info.id = id;
+    info.system = false;
+    info.attrs = attrs;
+    info.attrsLoaded = true;
+    info.indexesLoaded = true;
+    _catalog[tableName] = info;
+
     return SUCCESS;
 }
 
@@ -136,6 +151,15 @@ RC RelationManager::deleteTable(const string &tableName)
     if (isSystem)
         return RM_CANNOT_MOD_SYS_TBL;
 
+    // Close the cached handles on the table and its indexes
+    vector<Attribute> recordDescriptor;
+    vector<Attribute> indexedAttributes;
+    if (getAttributes(tableName, recordDescriptor) == SUCCESS)
+        getIndexedAttributes(tableName, recordDescriptor, indexedAttributes);
+    for (size_t i = 0; i < indexedAttributes.size(); i++)
+        dropHandle(getIndexName(tableName, indexedAttributes[i].name));
+    dropHandle(getFileName(tableName));
+
     // Delete the rbfm file holding this table's entries
     rc = rbfm->destroyFile(getFileName(tableName));
     if (rc)
@@ -152,6 +176,7 @@ RC RelationManager::deleteTable(const string &tableName)
     rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
+    fileHandle.setDurability(DURABILITY_SYNC_ON_CLOSE);
 
     // Find entry with same table ID
     // Use empty projection because we only care about RID
@@ -175,6 +200,7 @@ RC RelationManager::deleteTable(const string &tableName)
     rc = rbfm->openFile(getFileName(COLUMNS_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
+    fileHandle.setDurability(DURABILITY_SYNC_ON_CLOSE);
 
     // Find all of the entries whose table-id equal this table's ID
     rbfm->scan(fileHandle, columnDescriptor, COLUMNS_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
@@ -192,6 +218,7 @@ RC RelationManager::deleteTable(const string &tableName)
     rbfm->closeFile(fileHandle);
     rbfm_si.close();
 
+    _catalog.erase(tableName);
     return SUCCESS;
 }
 
@@ -225,21 +252,16 @@ RC RelationManager::createIndex(const string &tableName, const string &attribute
     if (rc)
         return rc;
 
+    TableInfo *info;
+    if (getTableInfo(tableName, info) == SUCCESS && info->indexesLoaded)
+        info->indexedAttrs.push_back(attributeName);
+
     // Open index file
     IXFileHandle ixfileHandle;
     if ((rc = ix->openFile(ix_name, ixfileHandle))) {
         return rc;
     }
 
-
-    // Open table file to scan records
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle tableFileHandle;
-    if ((rc = rbfm->openFile(getFileName(tableName), tableFileHandle)) != SUCCESS) {
-        ix->closeFile(ixfileHandle);
-        return rc;
-    }
-
     // Gets info of the attribute to be indexed
     vector<Attribute> attrs;
     Attribute attr;
@@ -256,57 +278,17 @@ RC RelationManager::createIndex(const string &tableName, const string &attribute
     vector<string> attribute = {attributeName};
     if ((rc = scan(tableName, "", NO_OP, NULL, attribute, rmsi)) != SUCCESS) {
         ix->closeFile(ixfileHandle);
-        rbfm->closeFile(tableFileHandle);
         return rc;
     }
 
-    // Populate index with existing records
-    RID rid;
-    void *keyValue = malloc(PAGE_SIZE);
-    void *data = malloc(PAGE_SIZE);
-    while (rmsi.getNextTuple(rid, data) != RM_EOF) {
-        if ((rc = rbfm->readAttribute(tableFileHandle, attrs, rid, attributeName, keyValue)) != SUCCESS) {
-            free(data);
-            free(keyValue);
-            ix->closeFile(ixfileHandle);
-            rbfm->closeFile(tableFileHandle);
-            rmsi.close();
-            return rc;
-        }
-
-        int numNullBytes = 1;
-        char nullIndicator[numNullBytes];
-        memcpy(nullIndicator, keyValue, numNullBytes);
-        int offset = numNullBytes;
-        if (fieldIsNull(nullIndicator, 0))
-            continue;
-
-        if (attr.type == TypeVarChar) {
-            int len;
-            memcpy(&len, (char *)keyValue + offset, sizeof(int));
-            memmove(keyValue, (char *)keyValue + offset, sizeof(int) + len);
-        } else {
-            memmove(keyValue, (char *)keyValue + offset, sizeof(int));
-        }
-
-        rc = ix->insertEntry(ixfileHandle, attr, keyValue, rid);
-        if (rc) {
-            free(data);
-            free(keyValue);
-            ix->closeFile(ixfileHandle);
-            rmsi.close();
-            return rc;
-        }
-    }
-
-    free(data);
-    free(keyValue);
+    // Populate index with existing records, bottom up
+    RM_IndexEntryStream entries(rmsi, attr);
+    rc = ix->bulkLoad(ixfileHandle, attr, entries);
     rmsi.close();
     /* cerr << "attr.type: " << attr.type << endl; */
     /* ix->printBtree(ixfileHandle, attr); */
     ix->closeFile(ixfileHandle);
-    rbfm->closeFile(tableFileHandle);
-    return SUCCESS;
+    return rc;
 }
 
 string RelationManager::getIndexName(const string &tableName, const string &attributeName) {
@@ -320,23 +302,99 @@ string RelationManager::getIndexName(const string &tableName, const string &attr
 }
 
 RC RelationManager::destroyIndex(const string &tableName, const string &attributeName) {
-    return -1;
+    RC rc;
+    string ix_name = getIndexName(tableName, attributeName);
+    if (!fileExists(ix_name))
+        return RM_INDEX_DN_EXIST;
+
+    // Close our cached handle before the file goes away
+    dropHandle(ix_name);
+    IndexManager *ix = IndexManager::instance();
+    if ((rc = ix->destroyFile(ix_name)))
+        return rc;
+
+    int32_t id;
+    rc = getTableID(tableName, id);
+    if (rc)
+        return rc;
+
+    // Remove the entry from the Indexes table
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    FileHandle fileHandle;
+    rc = rbfm->openFile(getFileName(INDEX_TABLE_NAME), fileHandle);
+    if (rc)
+        return rc;
+    fileHandle.setDurability(DURABILITY_SYNC_ON_CLOSE);
+
+    RBFM_ScanIterator rbfm_si;
+    vector<string> projection = {INDEX_COL_ATTR_NAME};
+    rc = rbfm->scan(fileHandle, indexDescriptor, INDEX_COL_TABLE_ID, EQ_OP, &id, projection, rbfm_si);
+    if (rc)
+    {
+        rbfm->closeFile(fileHandle);
+        return rc;
+    }
+
+    RID rid;
+    void *data = malloc(PAGE_SIZE);
+    while ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
+    {
+        string name;
+        fromAPI(name, data);
+        if (name != attributeName)
+            continue;
+        rc = rbfm->deleteRecord(fileHandle, indexDescriptor, rid);
+        break;
+    }
+    if (rc == RBFM_EOF)
+        rc = SUCCESS;
+
+    TableInfo *info;
+    if (getTableInfo(tableName, info) == SUCCESS)
+    {
+        vector<string> &names = info->indexedAttrs;
+        names.erase(remove(names.begin(), names.end(), attributeName), names.end());
+    }
+
+    free(data);
+    rbfm_si.close();
+    rbfm->closeFile(fileHandle);
+    return rc;
 }
 
 
 // Fills the given attribute vector with the recordDescriptor of tableName
 RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &attrs)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     // Clear out any old values
     attrs.clear();
-    RC rc;
 
-    int32_t id;
-    rc = getTableID(tableName, id);
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
 
+    // Read the Columns table the first time we need this table's attributes
+    if (!info->attrsLoaded)
+    {
+        rc = scanAttributes(info->id, info->attrs);
+        if (rc)
+            return rc;
+        info->attrsLoaded = true;
+    }
+
+    attrs = info->attrs;
+    return SUCCESS;
+}
+
+// Reads the recordDescriptor of the table with the given id from the Columns table
+RC RelationManager::scanAttributes(int32_t id, vector<Attribute> &attrs)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    // Clear out any old values
+    attrs.clear();
+    RC rc;
+
     void *value = &id;
 
     // We need to get the three values that make up an Attribute: name, type, length
@@ -452,17 +510,16 @@ RC RelationManager::insertTuple(const string &tableName, const void *data, RID &
     }
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = getTableHandle(tableName, fileHandle);
     if (rc) {
         /* cerr << "third rc: " << rc << endl; */
         return rc;
     }
 
     // Let rbfm do all the work
-    rc = rbfm->insertRecord(fileHandle, recordDescriptor, data, rid);
+    rc = rbfm->insertRecord(*fileHandle, recordDescriptor, data, rid);
     if (rc) {
-        rbfm->closeFile(fileHandle);
         /* cerr << "fourth rc: " << rc << endl; */
         return rc;
     }
@@ -473,13 +530,11 @@ RC RelationManager::insertTuple(const string &tableName, const void *data, RID &
     if (indexExists(tableName, recordDescriptor, indexedAttributes)) {
         rc = updateIndexes(tableName, data, rid, recordDescriptor, indexedAttributes, true);  // This function needs to be implemented
         if (rc) {
-            rbfm->closeFile(fileHandle);
             /* cerr << "fifth rc: " << rc << endl; */
             return rc;
         }
     }
 
-    rbfm->closeFile(fileHandle);
     /* cerr << "final rc: " << rc << endl; */
     return rc;
 }
@@ -504,14 +559,13 @@ RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
         return rc;
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = getTableHandle(tableName, fileHandle);
     if (rc)
         return rc;
 
     // Let rbfm do all the work
-    rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rid);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->deleteRecord(*fileHandle, recordDescriptor, rid);
 
     return rc;
 }
@@ -543,16 +597,15 @@ RC RelationManager::updateTuple(const string &tableName, const void *data, const
     }
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = getTableHandle(tableName, fileHandle);
     if (rc) {
         /* cerr << "update fourth rc: " << rc << endl; */
         return rc;
     }
 
     // Let rbfm do all the work
-    rc = rbfm->updateRecord(fileHandle, recordDescriptor, data, rid);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->updateRecord(*fileHandle, recordDescriptor, data, rid);
     /* cerr << "update final rc: " << rc << endl; */
 
     return rc;
@@ -570,14 +623,13 @@ RC RelationManager::readTuple(const string &tableName, const RID &rid, void *dat
         return rc;
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = getTableHandle(tableName, fileHandle);
     if (rc)
         return rc;
 
     // Let rbfm do all the work
-    rc = rbfm->readRecord(fileHandle, recordDescriptor, rid, data);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->readRecord(*fileHandle, recordDescriptor, rid, data);
     return rc;
 }
 
@@ -598,13 +650,12 @@ RC RelationManager::readAttribute(const string &tableName, const RID &rid, const
     if (rc)
         return rc;
 
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = getTableHandle(tableName, fileHandle);
     if (rc)
         return rc;
 
-    rc = rbfm->readAttribute(fileHandle, recordDescriptor, rid, attributeName, data);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->readAttribute(*fileHandle, recordDescriptor, rid, attributeName, data);
     return rc;
 }
 
@@ -808,6 +859,8 @@ RC RelationManager::insertIndexes(const string &tableName, const string &attribu
     rc = rbfm->openFile(getFileName(INDEX_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
+    // Catalog changes must survive a crash
+    fileHandle.setDurability(DURABILITY_SYNC_ON_CLOSE);
     rc = getTableID(tableName, id);
     if (rc)
         return rc;
@@ -832,6 +885,8 @@ RC RelationManager::insertColumns(int32_t id, const vector<Attribute> &recordDes
     rc = rbfm->openFile(getFileName(COLUMNS_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
+    // Catalog changes must survive a crash
+    fileHandle.setDurability(DURABILITY_SYNC_ON_CLOSE);
 
     void *columnData = malloc(COLUMNS_RECORD_DATA_SIZE);
     RID rid;
@@ -859,6 +914,8 @@ RC RelationManager::insertTable(int32_t id, int32_t system, const string &tableN
     rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
     if (rc)
         return rc;
+    // Catalog changes must survive a crash
+    fileHandle.setDurability(DURABILITY_SYNC_ON_CLOSE);
 
     void *tableData = malloc (TABLES_RECORD_DATA_SIZE);
     prepareTablesRecordData(id, system, tableName, tableData);
@@ -914,91 +971,48 @@ RC RelationManager::getNextTableID(int32_t &table_id)
 // Gets the table ID of the given tableName
 RC RelationManager::getTableID(const string &tableName, int32_t &tableID)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
-    RC rc;
-
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
-
-    // We only care about the table ID
-    vector<string> projection;
-    projection.push_back(TABLES_COL_TABLE_ID);
-
-    // Fill value with the string tablename in api format (without null indicator)
-    void *value = malloc(4 + TABLES_COL_TABLE_NAME_SIZE);
-    int32_t name_len = tableName.length();
-    memcpy(value, &name_len, INT_SIZE);
-    memcpy((char*)value + INT_SIZE, tableName.c_str(), name_len);
-
-    // Find the table entries whose table-name field matches tableName
-    RBFM_ScanIterator rbfm_si;
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_NAME, EQ_OP, value, projection, rbfm_si);
-
-    // There will only be one such entry, so we use if rather than while
-    RID rid;
-    void *data = malloc (1 + INT_SIZE);
-    if ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
-    {
-        int32_t tid;
-        fromAPI(tid, data);
-        tableID = tid;
-    }
-
-    free(data);
-    free(value);
-    rbfm->closeFile(fileHandle);
-    rbfm_si.close();
-    return rc;
+    tableID = info->id;
+    return SUCCESS;
 }
 
 // Determine if table tableName is a system table. Set the boolean argument as the result
 RC RelationManager::isSystemTable(bool &system, const string &tableName)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
-    RC rc;
-
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    system = false;
+    if (rc == RBFM_EOF)
+        return SUCCESS;
     if (rc)
         return rc;
+    system = info->system;
+    return SUCCESS;
+}
 
-    // We only care about system column
-    vector<string> projection;
-    projection.push_back(TABLES_COL_SYSTEM);
-
-    // Set up value to be tableName in API format (without null indicator)
-    void *value = malloc(5 + TABLES_COL_TABLE_NAME_SIZE);
-    int32_t name_len = tableName.length();
-    memcpy(value, &name_len, INT_SIZE);
-    memcpy((char*)value + INT_SIZE, tableName.c_str(), name_len);
-
-    // Find table whose table-name is equal to tableName
-    RBFM_ScanIterator rbfm_si;
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_NAME, EQ_OP, value, projection, rbfm_si);
-
-    RID rid;
-    void *data = malloc (1 + INT_SIZE);
-    if ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
-    {
-        // Parse the system field from that table entry
-        int32_t tmp;
-        fromAPI(tmp, data);
-        system = tmp == 1;
-    }
+RC RelationManager::tableExists(bool &exists, const string &tableName)
+{
+    TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    exists = rc == SUCCESS;
     if (rc == RBFM_EOF)
-        rc = SUCCESS;
-
-    free(data);
-    free(value);
-    rbfm->closeFile(fileHandle);
-    rbfm_si.close();
-    return rc;   
+        return SUCCESS;
+    return rc;
 }
 
-RC RelationManager::tableExists(bool &exists, const string &tableName)
+// Looks tableName up in the catalog cache, reading its entry from the Tables table on a miss
+RC RelationManager::getTableInfo(const string &tableName, TableInfo *&info)
 {
+    map<string, TableInfo>::iterator it = _catalog.find(tableName);
+    if (it != _catalog.end())
+    {
+        info = &it->second;
+        return SUCCESS;
+    }
+
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     FileHandle fileHandle;
     RC rc;
@@ -1007,37 +1021,41 @@ RC RelationManager::tableExists(bool &exists, const string &tableName)
     if (rc)
         return rc;
 
-    // We only care about system column
+    // We need the table ID and the system flag
     vector<string> projection;
-    projection.push_back(TABLES_COL_TABLE_NAME);
+    projection.push_back(TABLES_COL_TABLE_ID);
+    projection.push_back(TABLES_COL_SYSTEM);
 
-    // Set up value to be tableName in API format (without null indicator)
-    void *value = malloc(5 + TABLES_COL_TABLE_NAME_SIZE);
+    // Fill value with the string tablename in api format (without null indicator)
+    void *value = malloc(4 + TABLES_COL_TABLE_NAME_SIZE);
     int32_t name_len = tableName.length();
     memcpy(value, &name_len, INT_SIZE);
     memcpy((char*)value + INT_SIZE, tableName.c_str(), name_len);
 
-    // Find table whose table-name is equal to tableName
+    // Find the table entries whose table-name field matches tableName
     RBFM_ScanIterator rbfm_si;
     rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_NAME, EQ_OP, value, projection, rbfm_si);
 
+    // There will only be one such entry, so we use if rather than while
     RID rid;
-    void *data = malloc (PAGE_SIZE);
+    void *data = malloc (1 + 2 * INT_SIZE);
     if ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
     {
-        // Parse the system field from that table entry
-        string tmp;
-        fromAPI(tmp, data);
-        exists = (tmp.compare(tableName) == 0);
+        TableInfo entry;
+        int32_t system;
+        memcpy(&entry.id, (char*) data + 1, INT_SIZE);
+        memcpy(&system, (char*) data + 1 + INT_SIZE, INT_SIZE);
+        entry.system = system == 1;
+        entry.attrsLoaded = false;
+        entry.indexesLoaded = false;
+        info = &(_catalog[tableName] = entry);
     }
-    if (rc == RBFM_EOF)
-        rc = SUCCESS;
 
     free(data);
     free(value);
     rbfm->closeFile(fileHandle);
     rbfm_si.close();
-    return rc;   
+    return rc;
 }
 
 RC RelationManager::attributeExists(bool &exists, const string &tableName, const string attr_name)
@@ -1077,7 +1095,7 @@ RC RelationManager::updateIndexes(const string &tableName, const void *data, RID
 
     string attributeName;
     IndexManager *ix = IndexManager::instance();
-    IXFileHandle ixfileHandle;
+    IXFileHandle *ixfileHandle;
     void *key = malloc(PAGE_SIZE);
     for (int i = 0; i < indexAttributes.size(); i++) {
         memset(key, 0, PAGE_SIZE);
@@ -1088,17 +1106,11 @@ RC RelationManager::updateIndexes(const string &tableName, const void *data, RID
             free(key);
             return RM_ATTR_DN_EXIST;
         }
-        // Create the index on the attribute
+        // Open index file, the cache checks that it exists
         string ix_name = getIndexName(tableName, attributeName);
-        // check if the index already exists
-        if (!fileExists(ix_name)){
+        if ((rc = getIndexHandle(ix_name, ixfileHandle))) {
             free(key);
             /* cerr << "updateIndexes: cannot getIndexName!" << endl; */
-            return RM_TABLE_DN_EXIST;
-        }
-        // Open index file
-        if ((rc = ix->openFile(ix_name, ixfileHandle))) {
-            free(key);
             return rc;
         }
 
@@ -1140,14 +1152,14 @@ RC RelationManager::updateIndexes(const string &tableName, const void *data, RID
         if (validKey) {
             if (isInsert) {
                 /* cerr << "Tried to insertEntry for attributeName: " << indexAttributes[i].name << " and a key: " << *(int *)key << endl; */
-                rc = ix->insertEntry(ixfileHandle, indexAttributes[i], key, rid);
+                rc = ix->insertEntry(*ixfileHandle, indexAttributes[i], key, rid);
                 if (rc) {
                     free(key);
                     return rc;
                 }
             }
             else {
-                rc = ix->deleteEntry(ixfileHandle, indexAttributes[i], key, rid);
+                rc = ix->deleteEntry(*ixfileHandle, indexAttributes[i], key, rid);
                 if (rc) {
                     free(key);
                     return rc;
@@ -1155,18 +1167,108 @@ RC RelationManager::updateIndexes(const string &tableName, const void *data, RID
             }
         }
 
-        /* ix->printBtree(ixfileHandle, indexAttributes[i]); */
-        rc = ix->closeFile(ixfileHandle);
-        if (rc) {
-            free(key);
-            return rc;
-        }
+        /* ix->printBtree(*ixfileHandle, indexAttributes[i]); */
     }
 
     free(key);
     return SUCCESS;
 }
 
+RC RelationManager::getTableHandle(const string &tableName, FileHandle *&fileHandle)
+{
+    string fileName = getFileName(tableName);
+    map<string, CachedHandle>::iterator it = _handles.find(fileName);
+    if (it != _handles.end())
+    {
+        _handle_lru.splice(_handle_lru.begin(), _handle_lru, it->second.lru);
+        fileHandle = it->second.fileHandle;
+        return SUCCESS;
+    }
+
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    FileHandle *handle = new FileHandle();
+    RC rc = rbfm->openFile(fileName, *handle);
+    if (rc)
+    {
+        delete handle;
+        return rc;
+    }
+    cacheHandle(fileName, handle, NULL);
+    fileHandle = handle;
+    return SUCCESS;
+}
+
+RC RelationManager::getIndexHandle(const string &indexName, IXFileHandle *&ixfileHandle)
+{
+    map<string, CachedHandle>::iterator it = _handles.find(indexName);
+    if (it != _handles.end())
+    {
+        _handle_lru.splice(_handle_lru.begin(), _handle_lru, it->second.lru);
+        ixfileHandle = it->second.ixfileHandle;
+        return SUCCESS;
+    }
+
+    if (!fileExists(indexName))
+        return RM_INDEX_DN_EXIST;
+    IndexManager *ix = IndexManager::instance();
+    IXFileHandle *handle = new IXFileHandle();
+    RC rc = ix->openFile(indexName, *handle);
+    if (rc)
+    {
+        delete handle;
+        return rc;
+    }
+    cacheHandle(indexName, NULL, handle);
+    ixfileHandle = handle;
+    return SUCCESS;
+}
+
+void RelationManager::cacheHandle(const string &fileName, FileHandle *fileHandle, IXFileHandle *ixfileHandle)
+{
+    _handle_lru.push_front(fileName);
+    CachedHandle handle;
+    handle.fileHandle = fileHandle;
+    handle.ixfileHandle = ixfileHandle;
+    handle.lru = _handle_lru.begin();
+    _handles[fileName] = handle;
+
+    while (_handle_lru.size() > RM_HANDLE_CACHE_SIZE)
+    {
+        string victim = _handle_lru.back();
+        dropHandle(victim);
+    }
+}
+
+void RelationManager::dropHandle(const string &fileName)
+{
+    map<string, CachedHandle>::iterator it = _handles.find(fileName);
+    if (it == _handles.end())
+        return;
+
+    CachedHandle handle = it->second;
+    if (handle.fileHandle != NULL)
+    {
+        RecordBasedFileManager::instance()->closeFile(*handle.fileHandle);
+        delete handle.fileHandle;
+    }
+    if (handle.ixfileHandle != NULL)
+    {
+        IndexManager::instance()->closeFile(*handle.ixfileHandle);
+        delete handle.ixfileHandle;
+    }
+    _handle_lru.erase(handle.lru);
+    _handles.erase(it);
+}
+
+void RelationManager::dropAllHandles()
+{
+    while (!_handle_lru.empty())
+    {
+        string fileName = _handle_lru.front();
+        dropHandle(fileName);
+    }
+}
+
 int RelationManager::getNullIndicatorSize(int fieldCount) 
 {
     return int(ceil((double) fieldCount / CHAR_BIT));
@@ -1261,9 +1363,23 @@ RC RelationManager::scan(const string &tableName,
       const vector<string> &attributeNames,
       RM_ScanIterator &rm_ScanIterator)
 {
-    // Open the file for the given tableName
+    vector<ScanPredicate> predicates;
+    if (compOp != NO_OP)
+    {
+        ScanPredicate predicate = {conditionAttribute, compOp, value};
+        predicates.push_back(predicate);
+    }
+    return scan(tableName, predicates, attributeNames, rm_ScanIterator);
+}
+
+RC RelationManager::scan(const string &tableName,
+      const vector<ScanPredicate> &predicates,
+      const vector<string> &attributeNames,
+      RM_ScanIterator &rm_ScanIterator)
+{
+    // Open the file for the given tableName, mapped so the scan reads pages in place
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    RC rc = rbfm->openFile(getFileName(tableName), rm_ScanIterator.fileHandle);
+    RC rc = rbfm->openFile(getFileName(tableName), rm_ScanIterator.fileHandle, true);
     if (rc)
         return rc;
 
@@ -1274,14 +1390,35 @@ RC RelationManager::scan(const string &tableName,
         return rc;
 
     // Use the underlying rbfm_scaniterator to do all the work
-    rc = rbfm->scan(rm_ScanIterator.fileHandle, recordDescriptor, conditionAttribute,
-                     compOp, value, attributeNames, rm_ScanIterator.rbfm_iter);
+    rc = rbfm->scan(rm_ScanIterator.fileHandle, recordDescriptor, predicates,
+                     attributeNames, rm_ScanIterator.rbfm_iter);
     if (rc)
         return rc;
 
     return SUCCESS;
 }
 
+// Skip tuples whose value is null, the index does not hold them
+RC RM_IndexEntryStream::getNextEntry(void *key, RID &rid)
+{
+    RC rc;
+    while ((rc = rmsi.getNextTuple(rid, data)) == SUCCESS)
+    {
+        if (data[0] & (1 << 7))
+            continue;
+
+        int32_t len = INT_SIZE;
+        if (attr.type == TypeVarChar)
+        {
+            memcpy(&len, data + 1, VARCHAR_LENGTH_SIZE);
+            len += VARCHAR_LENGTH_SIZE;
+        }
+        memcpy(key, data + 1, len);
+        return SUCCESS;
+    }
+    return rc;
+}
+
 // Let rbfm do all the work
 RC RM_ScanIterator::getNextTuple(RID &rid, void *data)
 {
@@ -1327,6 +1464,7 @@ RC RelationManager::indexScan(const string &tableName,
     }
 
     // Use the underlying rbfm_scaniterator to do all the work
+    rm_IndexScanIterator.attr = attr;
     rc = ix->scan(rm_IndexScanIterator.ixfileHandle, attr, lowKey, highKey,
                      lowKeyInclusive, highKeyInclusive, rm_IndexScanIterator.ix_iter);
     if (rc)
@@ -1341,6 +1479,12 @@ RC RM_IndexScanIterator::getNextEntry(RID &rid, void *key)
     return ix_iter.getNextEntry(rid, key);
 }
 
+RC RM_IndexScanIterator::reset(const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive)
+{
+    ix_iter.close();
+    return IndexManager::instance()->scan(ixfileHandle, attr, lowKey, highKey, lowKeyInclusive, highKeyInclusive, ix_iter);
+}
+
 // Close our file handle, rbfm_scaniterator
 RC RM_IndexScanIterator::close()
 {
@@ -1351,17 +1495,34 @@ RC RM_IndexScanIterator::close()
 }
 
 void RelationManager::getIndexedAttributes(const string &tableName, vector<Attribute> &recordDescriptor, vector<Attribute> &indexedAttributes) {
+    TableInfo *info;
+    if (getTableInfo(tableName, info) != SUCCESS)
+        return;
+
+    // Read the Indexes table the first time we need this table's indexes
+    if (!info->indexesLoaded) {
+        if (scanIndexedAttributes(info->id, info->indexedAttrs) != SUCCESS)
+            return;
+        info->indexesLoaded = true;
+    }
+
+    // If attribute name matches, we push to indexedAttributes
+    for (auto & name : info->indexedAttrs) {
+        for (auto & attr : recordDescriptor) {
+            if (attr.name == name) {
+                indexedAttributes.push_back(attr);
+            }
+        }
+    }
+}
+
+// Reads the names of the indexed attributes of the table with the given id from the Indexes table
+RC RelationManager::scanIndexedAttributes(int32_t tableId, vector<string> &attributeNames) {
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     FileHandle fileHandle;
     RC rc = rbfm->openFile(getFileName(INDEX_TABLE_NAME), fileHandle);
     if (rc != SUCCESS) {
-        return;
-    }
-    int tableId;
-    rc = getTableID(tableName, tableId);
-    if (rc){
-        rbfm->closeFile(fileHandle);
-        return;
+        return rc;
     }
 
     // Scans through indexes table by table-id
@@ -1369,7 +1530,7 @@ void RelationManager::getIndexedAttributes(const string &tableName, vector<Attri
     vector<string> attrs = {"attribute-name"};
     rbfm->scan(fileHandle, indexDescriptor, "table-id", EQ_OP, &tableId, attrs, rbfm_si);
 
-    
+    attributeNames.clear();
     RID rid;
     void *data = malloc(PAGE_SIZE);
     while (rbfm_si.getNextRecord(rid, data) != RM_EOF) {
@@ -1380,18 +1541,13 @@ void RelationManager::getIndexedAttributes(const string &tableName, vector<Attri
         char attributeName[nameLength + 1];
         memcpy(attributeName, offset + (char *)data, nameLength);
         attributeName[nameLength] = '\0';
-
-        // If attribute name matches, we push to indexedAttributes
-        for (auto & attr : recordDescriptor) {
-            if (attr.name == attributeName) {
-                indexedAttributes.push_back(attr);
-            }
-        }
+        attributeNames.push_back(attributeName);
     }
 
     free(data);
     rbfm_si.close();
     rbfm->closeFile(fileHandle);
+    return SUCCESS;
 }
 
 bool RelationManager::indexExists(const string &tableName, vector<Attribute> &recordDescriptor, vector<Attribute> &indexedAttributes) {
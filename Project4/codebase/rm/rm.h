@@ -4,6 +4,8 @@
 
 #include <string>
 #include <vector>
+#include <list>
+#include <map>
 
 #include "../rbf/rbfm.h"
 
@@ -63,6 +65,10 @@ using namespace std;
 #define RM_TABLE_DN_EXIST     3
 #define RM_ATTR_DN_EXIST      4
 #define RM_INDEX_ALR_EXISTS     5
+#define RM_INDEX_DN_EXIST     6
+
+// Number of table and index files kept open between calls
+#define RM_HANDLE_CACHE_SIZE 32
 
 typedef struct IndexedAttr
 {
@@ -94,12 +100,28 @@ public:
 
   // "data" follows the same format as RelationManager::insertTuple()
   RC getNextEntry(RID &rid, void *key);
+  // Restart the scan over a new key range without reopening the index
+  RC reset(const void *lowKey, const void *highKey, bool lowKeyInclusive, bool highKeyInclusive);
   RC close();
 
   friend class RelationManager;
 private:
   IX_ScanIterator ix_iter;
   IXFileHandle ixfileHandle;
+  Attribute attr;
+};
+
+// Feeds the non-null values of the single attribute projected by a scan to IndexManager::bulkLoad
+class RM_IndexEntryStream : public IX_EntryStream {
+public:
+  RM_IndexEntryStream(RM_ScanIterator &rmsi, const Attribute &attr) : rmsi(rmsi), attr(attr) {};
+  ~RM_IndexEntryStream() {};
+
+  RC getNextEntry(void *key, RID &rid);
+private:
+  RM_ScanIterator &rmsi;
+  Attribute attr;
+  char data[PAGE_SIZE];
 };
 
 // Relation Manager
@@ -141,6 +163,12 @@ public:
       const vector<string> &attributeNames, // a list of projected attributes
       RM_ScanIterator &rm_ScanIterator);
 
+  // Scan returning the tuples that satisfy every predicate
+  RC scan(const string &tableName,
+      const vector<ScanPredicate> &predicates,
+      const vector<string> &attributeNames, // a list of projected attributes
+      RM_ScanIterator &rm_ScanIterator);
+
   RC indexScan(const string &tableName,
       const string &attributeName,
       const void *lowKey,                   // used in the comparison
@@ -212,6 +240,43 @@ private:
   int getNullIndicatorSize(int fieldCount);
   void getIndexedAttributes(const string &tableName, vector<Attribute> &recordDescriptor, vector<Attribute> &indexedAttributes);
   bool indexExists(const string &tableName, vector<Attribute> &recordDescriptor, vector<Attribute> &indexedAttributes);
+
+  // Catalog entry of a table, read from the catalog tables on first use.
+  // Attributes and indexes are loaded separately, when first asked for.
+  typedef struct TableInfo
+  {
+      int32_t id;
+      bool system;
+      vector<Attribute> attrs;
+      bool attrsLoaded;
+      vector<string> indexedAttrs;
+      bool indexesLoaded;
+  } TableInfo;
+  map<string, TableInfo> _catalog;
+
+  RC getTableInfo(const string &tableName, TableInfo *&info);
+  RC scanAttributes(int32_t id, vector<Attribute> &attrs);
+  RC scanIndexedAttributes(int32_t tableId, vector<string> &attributeNames);
+
+  // Open handles on table and index files, keyed by file name and kept in LRU order.
+  // Only one of the two handles is set.
+  typedef struct CachedHandle
+  {
+      FileHandle *fileHandle;
+      IXFileHandle *ixfileHandle;
+      list<string>::iterator lru;
+  } CachedHandle;
+  map<string, CachedHandle> _handles;
+  list<string> _handle_lru;
+
+  // Return a cached handle on a table or index file, opening it if needed
+  RC getTableHandle(const string &tableName, FileHandle *&fileHandle);
+  RC getIndexHandle(const string &indexName, IXFileHandle *&ixfileHandle);
+  // Add a freshly opened handle, closing the least recently used ones past the limit
+  void cacheHandle(const string &fileName, FileHandle *fileHandle, IXFileHandle *ixfileHandle);
+  // Close and forget the cached handle on fileName, if any
+  void dropHandle(const string &fileName);
+  void dropAllHandles();
 };
 
 #endif
@@ -0,0 +1,149 @@
+#include "rm_test_util.h"
+
+// Counts the tuples of a table with a full scan
+static int countTuples(const string &tableName)
+{
+    RM_ScanIterator rmsi;
+    vector<string> attributes = {"Age"};
+    RC rc = rm->scan(tableName, "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+
+    RID rid;
+    char data[PAGE_SIZE];
+    int count = 0;
+    while (rmsi.getNextTuple(rid, data) != RM_EOF)
+        count++;
+    rmsi.close();
+    return count;
+}
+
+// Counts the entries of an index with a full index scan
+static int countEntries(const string &tableName, const string &attributeName)
+{
+    RM_IndexScanIterator rmisi;
+    RC rc = rm->indexScan(tableName, attributeName, NULL, NULL, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+
+    RID rid;
+    char key[PAGE_SIZE];
+    int count = 0;
+    while (rmisi.getNextEntry(rid, key) != RM_EOF)
+        count++;
+    rmisi.close();
+    return count;
+}
+
+RC TEST_RM_16(const string &tableName)
+{
+    // Functions tested
+    // 1. Insert / Read Tuple through cached file handles
+    // 2. Destroy Index while its handle is cached **
+    // 3. Delete Table and create it again while its handle is cached
+    // 4. More tables than the handle cache holds
+    cout << endl << "***** In RM Test Case 16 *****" << endl;
+
+    RID rid;
+    int tupleSize = 0;
+    void *tuple = malloc(200);
+    void *returnedData = malloc(200);
+
+    createTable(tableName);
+    vector<Attribute> attrs;
+    RC rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+
+    string name = "Handle";
+    for (int i = 0; i < 50; i++)
+    {
+        prepareTuple(attrs.size(), nullsIndicator, name.size(), name, i, 170.1, 1000 + i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rc = rm->readTuple(tableName, rid, returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        assert(memcmp(tuple, returnedData, tupleSize) == 0 && "The tuple should read back.");
+    }
+
+    // Inserts after creating the index go through the cached index handle
+    rc = rm->createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    for (int i = 50; i < 100; i++)
+    {
+        prepareTuple(attrs.size(), nullsIndicator, name.size(), name, i, 170.1, 1000 + i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    }
+    assert(countEntries(tableName, "Age") == 100 && "The index should hold every tuple.");
+
+    // Once the index is gone, inserts must not touch the old handle
+    rc = rm->destroyIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::destroyIndex() should not fail.");
+    rc = rm->destroyIndex(tableName, "Age");
+    assert(rc != success && "Destroying a missing index should fail.");
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    rc = rm->createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    assert(countEntries(tableName, "Age") == 101 && "The new index should hold every tuple.");
+    rc = rm->destroyIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::destroyIndex() should not fail.");
+
+    // A table created again under the same name starts empty
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    createTable(tableName);
+    assert(countTuples(tableName) == 0 && "The new table should be empty.");
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    rc = rm->readTuple(tableName, rid, returnedData);
+    assert(rc == success && memcmp(tuple, returnedData, tupleSize) == 0 && "The tuple should read back.");
+    assert(countTuples(tableName) == 1 && "The new table should hold one tuple.");
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    // Cycle through more tables than there are cached handles
+    int numTables = RM_HANDLE_CACHE_SIZE + 8;
+    vector<RID> rids;
+    for (int t = 0; t < numTables; t++)
+        createTable(tableName + "_" + to_string(t));
+    for (int round = 0; round < 2; round++)
+    {
+        for (int t = 0; t < numTables; t++)
+        {
+            prepareTuple(attrs.size(), nullsIndicator, name.size(), name, t, 170.1, round, tuple, &tupleSize);
+            rc = rm->insertTuple(tableName + "_" + to_string(t), tuple, rid);
+            assert(rc == success && "RelationManager::insertTuple() should not fail.");
+            rids.push_back(rid);
+        }
+    }
+    for (int round = 0; round < 2; round++)
+    {
+        for (int t = 0; t < numTables; t++)
+        {
+            prepareTuple(attrs.size(), nullsIndicator, name.size(), name, t, 170.1, round, tuple, &tupleSize);
+            rc = rm->readTuple(tableName + "_" + to_string(t), rids[round * numTables + t], returnedData);
+            assert(rc == success && memcmp(tuple, returnedData, tupleSize) == 0 && "The tuple should read back.");
+        }
+    }
+    for (int t = 0; t < numTables; t++)
+    {
+        assert(countTuples(tableName + "_" + to_string(t)) == 2 && "Every table should hold two tuples.");
+        rc = rm->deleteTable(tableName + "_" + to_string(t));
+        assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    }
+
+    free(tuple);
+    free(returnedData);
+    free(nullsIndicator);
+    cout << "***** RM Test Case 16 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    RC rcmain = TEST_RM_16("tbl_handle_cache");
+    return rcmain;
+}
@@ -0,0 +1,114 @@
+#include "rm_test_util.h"
+
+// Buffer pool accesses made by numTuples inserts into tableName
+static unsigned insertAccesses(const string &tableName, int numTuples, vector<Attribute> &attrs)
+{
+    BufferManager *bm = PagedFileManager::instance()->getBufferManager();
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char nullsIndicator[nullAttributesIndicatorActualSize];
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+
+    char tuple[200];
+    int tupleSize;
+    string name = "Catalog";
+    RID rid;
+    unsigned before = bm->hitCounter + bm->missCounter;
+    for (int i = 0; i < numTuples; i++)
+    {
+        prepareTuple(attrs.size(), nullsIndicator, name.size(), name, i, 170.1, i, tuple, &tupleSize);
+        RC rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    }
+    return bm->hitCounter + bm->missCounter - before;
+}
+
+RC TEST_RM_17(const string &tableName)
+{
+    // Functions tested
+    // 1. Insert Tuple cost does not depend on the size of the catalog
+    // 2. Get Attributes after the table is deleted and created again
+    // 3. Create / Destroy Index keep the cached index list in sync
+    cout << endl << "***** In RM Test Case 17 *****" << endl;
+
+    const int numTuples = 200;
+    const int numTables = 60;
+
+    createTable(tableName);
+    vector<Attribute> attrs;
+    RC rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    // Warm up, then measure with a small catalog
+    insertAccesses(tableName, 1, attrs);
+    unsigned small = insertAccesses(tableName, numTuples, attrs);
+
+    // Grow the catalog and measure again
+    for (int t = 0; t < numTables; t++)
+        createTable(tableName + "_" + to_string(t));
+    unsigned large = insertAccesses(tableName, numTuples, attrs);
+    cout << "page accesses for " << numTuples << " inserts: " << small << " before and "
+         << large << " after adding " << numTables << " tables" << endl;
+    assert(large <= small + 2 && "Insert cost should not grow with the catalog.");
+
+    for (int t = 0; t < numTables; t++)
+    {
+        rc = rm->deleteTable(tableName + "_" + to_string(t));
+        assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    }
+
+    // The cached descriptor must not outlive the table
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    rc = rm->getAttributes(tableName, attrs);
+    assert(rc != success && "RelationManager::getAttributes() on a deleted table should fail.");
+
+    vector<Attribute> newAttrs;
+    Attribute attr;
+    attr.name = "Key";
+    attr.type = TypeInt;
+    attr.length = (AttrLength)4;
+    newAttrs.push_back(attr);
+    rc = rm->createTable(tableName, newAttrs);
+    assert(rc == success && "RelationManager::createTable() should not fail.");
+    rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && attrs.size() == 1 && attrs[0].name == "Key" && "The new schema should be returned.");
+
+    // Inserts maintain exactly the indexes that exist
+    char tuple[1 + INT_SIZE];
+    tuple[0] = 0;
+    RID rid;
+    rc = rm->createIndex(tableName, "Key");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+    for (int i = 0; i < 10; i++)
+    {
+        memcpy(tuple + 1, &i, INT_SIZE);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    }
+    RM_IndexScanIterator rmisi;
+    rc = rm->indexScan(tableName, "Key", NULL, NULL, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    int count = 0;
+    char key[PAGE_SIZE];
+    while (rmisi.getNextEntry(rid, key) != RM_EOF)
+        count++;
+    rmisi.close();
+    assert(count == 10 && "Every insert should reach the index.");
+
+    rc = rm->destroyIndex(tableName, "Key");
+    assert(rc == success && "RelationManager::destroyIndex() should not fail.");
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "Inserting without the index should not fail.");
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    cout << "***** RM Test Case 17 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    RC rcmain = TEST_RM_17("tbl_catalog_cache");
+    return rcmain;
+}
@@ -0,0 +1,95 @@
+#include "rm_test_util.h"
+
+// Whether the table file on disk contains text
+static bool onDisk(const string &tableName, const string &text)
+{
+    FILE *file = fopen((tableName + TABLE_FILE_EXTENSION).c_str(), "rb");
+    assert(file != NULL && "The table file should exist.");
+    string contents;
+    char buffer[PAGE_SIZE];
+    size_t len;
+    while ((len = fread(buffer, 1, PAGE_SIZE, file)) > 0)
+        contents.append(buffer, len);
+    fclose(file);
+    return contents.find(text) != string::npos;
+}
+
+// Counts the tuples of a table with a full scan, the scan reads the table memory mapped
+static int countTuples(const string &tableName)
+{
+    RM_ScanIterator rmsi;
+    vector<string> attributes = {"EmpName"};
+    RC rc = rm->scan(tableName, "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+
+    RID rid;
+    char data[PAGE_SIZE];
+    int count = 0;
+    while (rmsi.getNextTuple(rid, data) != RM_EOF)
+        count++;
+    rmsi.close();
+    return count;
+}
+
+RC TEST_RM_18(const string &tableName)
+{
+    // Functions tested
+    // 1. Update Tuple after a Scan is buffered, not written through **
+    // 2. Scan sees the updates of the buffer pool
+    cout << endl << "***** In RM Test Case 18 *****" << endl;
+
+    rm->deleteTable(tableName);
+    createTable(tableName);
+    vector<Attribute> attrs;
+    RC rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    unsigned char nullsIndicator[nullAttributesIndicatorActualSize];
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+
+    char tuple[200];
+    int tupleSize;
+    RID rid;
+    vector<RID> rids;
+    string name = "Mapped";
+    for (int i = 0; i < 20; i++)
+    {
+        prepareTuple(attrs.size(), nullsIndicator, name.size(), name, i, 170.1, i, tuple, &tupleSize);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids.push_back(rid);
+    }
+    assert(countTuples(tableName) == 20 && "The scan should return every tuple.");
+
+    // The table handle stays cached after the scan, its writes still go to the pool
+    string updated = "UpdatedAfterScan";
+    prepareTuple(attrs.size(), nullsIndicator, updated.size(), updated, 0, 170.1, 0, tuple, &tupleSize);
+    rc = rm->updateTuple(tableName, tuple, rids[0]);
+    assert(rc == success && "RelationManager::updateTuple() should not fail.");
+    assert(!onDisk(tableName, updated) && "Updates after a scan should stay in the buffer pool.");
+
+    // A scan maps the file again and reads the update once the pool is written back
+    assert(countTuples(tableName) == 20 && "The scan should return every tuple.");
+    assert(onDisk(tableName, updated) && "The update should be written back before the file is mapped.");
+
+    string flushed = "FlushedAfterScan";
+    prepareTuple(attrs.size(), nullsIndicator, flushed.size(), flushed, 1, 170.1, 1, tuple, &tupleSize);
+    rc = rm->updateTuple(tableName, tuple, rids[1]);
+    assert(rc == success && "RelationManager::updateTuple() should not fail.");
+    assert(!onDisk(tableName, flushed) && "Updates after a scan should stay in the buffer pool.");
+    rc = PagedFileManager::instance()->getBufferManager()->flushAll();
+    assert(rc == success && "BufferManager::flushAll() should not fail.");
+    assert(onDisk(tableName, flushed) && "Flushing the pool should write the update.");
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    cout << "***** RM Test Case 18 finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    RC rcmain = TEST_RM_18("tbl_mapped_scan");
+    return rcmain;
+}